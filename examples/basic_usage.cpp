@@ -1,5 +1,9 @@
-#include "../include/coap-packet/CoapBuilder.h"
-#include "../include/coap-packet/CoapParser.h"
+// Build:
+//   c++ -std=c++11 -o basic_usage examples/basic_usage.cpp src/CoapPacketUnity.cpp
+
+#include "../src/CoapBuilder.h"
+#include "../src/CoapFormatter.h"
+#include "../src/CoapParser.h"
 #include <iostream>
 #include <iomanip>
 
@@ -16,61 +20,10 @@ void printHex(const std::vector<uint8_t> &buffer) {
 
 // Helper function to print packet info
 void printPacket(const CoapPacket::CoapPacket &packet) {
-  std::cout << "Version: " << static_cast<int>(packet.version) << std::endl;
-  std::cout << "Type: " << static_cast<int>(packet.type) << std::endl;
-  std::cout << "Code: " << static_cast<int>(packet.code) << std::endl;
-  std::cout << "Message ID: " << packet.message_id << std::endl;
-  std::cout << "Token Length: " << static_cast<int>(packet.token_length) << std::endl;
-
-  if (packet.token_length > 0) {
-    std::cout << "Token: ";
-    for (int i = 0; i < packet.token_length; i++) {
-      std::cout << std::hex << std::setw(2) << std::setfill('0')
-                << static_cast<int>(packet.token[i]) << " ";
-    }
-    std::cout << std::dec << std::endl;
-  }
-
-  std::cout << "Options (" << packet.options.size() << "):" << std::endl;
-  for (const auto &opt : packet.options) {
-    std::cout << "  Option " << opt.number << " (length " << opt.value.size() << "): ";
-    // Try to print as string if printable
-    bool isPrintable = true;
-    for (auto b : opt.value) {
-      if (b < 32 || b > 126) {
-        isPrintable = false;
-        break;
-      }
-    }
-    if (isPrintable && !opt.value.empty()) {
-      std::cout << "\"" << std::string(opt.value.begin(), opt.value.end()) << "\"";
-    } else {
-      for (auto b : opt.value) {
-        std::cout << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(b) << " ";
-      }
-      std::cout << std::dec;
-    }
-    std::cout << std::endl;
-  }
-
-  if (!packet.payload.empty()) {
-    std::cout << "Payload (" << packet.payload.size() << " bytes): ";
-    // Try to print as string if printable
-    bool isPrintable = true;
-    for (auto b : packet.payload) {
-      if (b < 32 || b > 126) {
-        isPrintable = false;
-        break;
-      }
-    }
-    if (isPrintable) {
-      std::cout << "\"" << std::string(packet.payload.begin(), packet.payload.end()) << "\"";
-    } else {
-      printHex(packet.payload);
-    }
-    std::cout << std::endl;
-  }
-  std::cout << std::endl;
+  char text[512];
+  size_t length = 0;
+  CoapPacket::CoapFormatter::formatText(packet, text, sizeof(text), length, 128);
+  std::cout << text << std::endl << std::endl;
 }
 
 int main() {
@@ -0,0 +1,85 @@
+#include "CoapAckBatch.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+namespace {
+
+// First header byte of an empty message of the given type (TKL 0)
+uint8_t emptyHeaderByte(uint8_t type) {
+    return static_cast<uint8_t>((COAP_VERSION << 6) | ((type & 0x03) << 4));
+}
+
+// Write one reply; returns 1 if it should be kept (message was a CON)
+size_t writeEmptyReply(uint8_t* out, bool confirmable, uint8_t code, uint8_t messageIdHigh,
+                       uint8_t messageIdLow, uint8_t replyByte) {
+    const uint8_t resetByte = emptyHeaderByte(static_cast<uint8_t>(CoapType::RST));
+    out[0] = (code == 0) ? resetByte : replyByte;
+    out[1] = 0;
+    out[2] = messageIdHigh;
+    out[3] = messageIdLow;
+    return confirmable ? 1 : 0;
+}
+
+} // namespace
+
+size_t CoapAckBatch::generate(const uint8_t* const* datagrams, const size_t* lengths, size_t count,
+                              CoapType type, uint8_t* out, uint32_t* indexes) {
+    const uint8_t replyByte = emptyHeaderByte(static_cast<uint8_t>(type));
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* datagram = datagrams[i];
+        size_t length = lengths[i];
+        if (length < 4) {
+            continue;
+        }
+        uint8_t first = datagram[0];
+        uint8_t tokenLength = first & 0x0F;
+        bool confirmable = (first & 0xF0) == ((COAP_VERSION << 6) | (static_cast<uint8_t>(CoapType::CON) << 4)) &&
+                           tokenLength <= 8 &&
+                           isValidCodeClass(datagram[1] >> 5) &&
+                           length >= 4 + static_cast<size_t>(tokenLength);
+        indexes[written] = static_cast<uint32_t>(i);
+        written += writeEmptyReply(out + written * EMPTY_MESSAGE_SIZE, confirmable, datagram[1],
+                                   datagram[2], datagram[3], replyByte);
+    }
+    return written;
+}
+
+size_t CoapAckBatch::generate(const uint8_t* types, const uint8_t* codes, const uint16_t* messageIds,
+                              const uint8_t* validity, size_t count, CoapType type,
+                              uint8_t* out, uint32_t* indexes) {
+    const uint8_t replyByte = emptyHeaderByte(static_cast<uint8_t>(type));
+    size_t written = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool valid = (validity == nullptr) || ((validity[i >> 3] >> (i & 7)) & 1) != 0;
+        bool confirmable = valid && types[i] == static_cast<uint8_t>(CoapType::CON);
+        indexes[written] = static_cast<uint32_t>(i);
+        written += writeEmptyReply(out + written * EMPTY_MESSAGE_SIZE, confirmable, codes[i],
+                                   static_cast<uint8_t>(messageIds[i] >> 8),
+                                   static_cast<uint8_t>(messageIds[i] & 0xFF), replyByte);
+    }
+    return written;
+}
+
+#if defined(__linux__)
+void CoapAckBatch::prepareSend(const uint8_t* replies, const uint32_t* indexes, size_t replyCount,
+                               const struct mmsghdr* received, struct mmsghdr* messages,
+                               struct iovec* vectors) {
+    for (size_t i = 0; i < replyCount; i++) {
+        const struct msghdr& source = received[indexes[i]].msg_hdr;
+        vectors[i].iov_base = const_cast<uint8_t*>(replies + i * EMPTY_MESSAGE_SIZE);
+        vectors[i].iov_len = EMPTY_MESSAGE_SIZE;
+
+        struct msghdr& header = messages[i].msg_hdr;
+        std::memset(&header, 0, sizeof(header));
+        header.msg_name = source.msg_name;
+        header.msg_namelen = source.msg_namelen;
+        header.msg_iov = &vectors[i];
+        header.msg_iovlen = 1;
+        messages[i].msg_len = 0;
+    }
+}
+#endif
+
+} // namespace CoapPacket
@@ -0,0 +1,65 @@
+#ifndef COAP_ACK_BATCH_H
+#define COAP_ACK_BATCH_H
+
+#include "CoapTypes.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+namespace CoapPacket {
+
+// Size of an empty message (ACK, RST or ping)
+constexpr size_t EMPTY_MESSAGE_SIZE = 4;
+
+/**
+ * Batch generation of empty ACK/RST replies to confirmable messages
+ *
+ * One pass over a received batch writes a 4-byte reply for every CON
+ * message into a contiguous buffer (EMPTY_MESSAGE_SIZE bytes per reply)
+ * and records which datagram each reply answers. Replies take the message
+ * ID of the request; empty CON messages (pings) always get an RST
+ * (RFC 7252 section 4.3). The loops are branch-free: every datagram's
+ * reply is written and only the output position depends on whether it
+ * was a CON.
+ *
+ * out must hold count * EMPTY_MESSAGE_SIZE bytes and indexes count
+ * entries; the return value is the number of replies written.
+ */
+class CoapAckBatch {
+public:
+    /**
+     * Reply to raw datagrams (e.g. a recvmmsg batch), peeking at the header
+     * Datagrams failing the CoapIngressFilter header checks are skipped.
+     */
+    static size_t generate(const uint8_t* const* datagrams, const size_t* lengths, size_t count,
+                           CoapType type, uint8_t* out, uint32_t* indexes);
+
+    /**
+     * Reply to parsed messages given as columns, e.g. CoapPacketBatch
+     * getTypes(), getCodes(), getMessageIds() and getValidity()
+     * validity is an LSB-first bitmap of usable rows, or nullptr for all.
+     */
+    static size_t generate(const uint8_t* types, const uint8_t* codes, const uint16_t* messageIds,
+                           const uint8_t* validity, size_t count, CoapType type,
+                           uint8_t* out, uint32_t* indexes);
+
+#if defined(__linux__)
+    /**
+     * Prepare sendmmsg() entries for generated replies
+     * Entry i sends reply i back to the sender of datagram indexes[i],
+     * whose address is taken from received (the recvmmsg() entries).
+     * messages and vectors must hold replyCount entries each.
+     */
+    static void prepareSend(const uint8_t* replies, const uint32_t* indexes, size_t replyCount,
+                            const struct mmsghdr* received, struct mmsghdr* messages,
+                            struct iovec* vectors);
+#endif
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_ACK_BATCH_H
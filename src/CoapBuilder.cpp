@@ -1,10 +1,14 @@
 #include "CoapBuilder.h"
+#include "CoapOptions.h"
 #include <cstring>
-#include <sstream>
 
 namespace CoapPacket {
 
-CoapBuilder::CoapBuilder() : lastError_(CoapError::OK) {
+CoapBuilder::CoapBuilder()
+    : lastError_(CoapError::OK)
+    , maxPayloadSize_(MAX_PAYLOAD_SIZE)
+    , streamOffset_(0)
+    , streamCapacity_(0) {
     packet_.clear();
 }
 
@@ -40,27 +44,24 @@ CoapBuilder& CoapBuilder::addOption(CoapOptionNumber optionNum, const std::strin
 }
 
 CoapBuilder& CoapBuilder::addOption(CoapOptionNumber optionNum, uint32_t value) {
-    std::vector<uint8_t> encoded = encodeUint(value);
-    packet_.options.emplace_back(static_cast<uint16_t>(optionNum), encoded);
+    uint8_t encoded[4];
+    size_t length = encodeUintValue(encoded, value);
+    packet_.options.emplace_back(static_cast<uint16_t>(optionNum), std::vector<uint8_t>(encoded, encoded + length));
     return *this;
 }
 
 CoapBuilder& CoapBuilder::setUriPath(const std::string& path) {
-    // Split path by '/' and create URI_PATH options
-    if (path.empty()) return *this;
-
-    std::string pathCopy = path;
-    // Remove leading slash if present
-    if (pathCopy[0] == '/') {
-        pathCopy = pathCopy.substr(1);
-    }
-
-    std::stringstream ss(pathCopy);
-    std::string segment;
-    while (std::getline(ss, segment, '/')) {
-        if (!segment.empty()) {
-            addUriPathSegment(segment);
+    // Split path by '/' and create URI_PATH options (empty segments are skipped)
+    size_t start = 0;
+    while (start < path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
         }
+        if (end > start) {
+            addUriPathSegment(path.substr(start, end - start));
+        }
+        start = end + 1;
     }
     return *this;
 }
@@ -82,20 +83,33 @@ CoapBuilder& CoapBuilder::setContentFormat(CoapContentFormat format) {
 }
 
 CoapBuilder& CoapBuilder::setPayload(const std::vector<uint8_t>& data) {
+    packet_.clearPayloadRef();
     packet_.payload = data;
     return *this;
 }
 
 CoapBuilder& CoapBuilder::setPayload(const std::string& data) {
+    packet_.clearPayloadRef();
     packet_.payload.assign(data.begin(), data.end());
     return *this;
 }
 
 CoapBuilder& CoapBuilder::setPayload(const uint8_t* data, size_t length) {
+    packet_.clearPayloadRef();
     packet_.payload.assign(data, data + length);
     return *this;
 }
 
+CoapBuilder& CoapBuilder::setPayloadRef(const uint8_t* data, size_t length, std::shared_ptr<const void> owner) {
+    packet_.setPayloadRef(data, length, std::move(owner));
+    return *this;
+}
+
+CoapBuilder& CoapBuilder::setMaxPayloadSize(size_t maxPayloadSize) {
+    maxPayloadSize_ = maxPayloadSize;
+    return *this;
+}
+
 CoapError CoapBuilder::build(CoapPacket& packet) {
     // Validate packet
     CoapError err = validate();
@@ -124,41 +138,73 @@ CoapError CoapBuilder::buildBuffer(std::vector<uint8_t>& buffer) {
     // Sort options before building
     sortOptions();
 
-    buffer.clear();
+    // 1-3. Header, token and options
+    err = encodeHead(buffer);
+    if (err != CoapError::OK) {
+        lastError_ = err;
+        return err;
+    }
 
-    // 1. Build 4-byte header
-    buffer.resize(4);
-    buffer[0] = (COAP_VERSION & 0x03) << 6;  // Version (2 bits)
-    buffer[0] |= (static_cast<uint8_t>(packet_.type) & 0x03) << 4;  // Type (2 bits)
-    buffer[0] |= (packet_.token_length & 0x0F);  // Token length (4 bits)
+    // 4. Add payload marker and payload (if any)
+    size_t payloadSize = packet_.getPayloadSize();
+    if (payloadSize > 0) {
+        const uint8_t* payload = packet_.getPayloadPtr();
+        buffer.push_back(PAYLOAD_MARKER);  // 0xFF marker
+        buffer.insert(buffer.end(), payload, payload + payloadSize);
+    }
 
-    buffer[1] = static_cast<uint8_t>(packet_.code);  // Code (8 bits)
+    lastError_ = CoapError::OK;
+    return CoapError::OK;
+}
 
-    buffer[2] = static_cast<uint8_t>(packet_.message_id >> 8);    // Message ID high byte
-    buffer[3] = static_cast<uint8_t>(packet_.message_id & 0xFF);  // Message ID low byte
+CoapError CoapBuilder::beginPayload(std::vector<uint8_t>& buffer, size_t capacity, uint8_t*& payload) {
+    payload = nullptr;
+    streamOffset_ = 0;
+    streamCapacity_ = 0;
 
-    // 2. Add token (0-8 bytes)
-    if (packet_.token_length > 0) {
-        buffer.insert(buffer.end(), packet_.token, packet_.token + packet_.token_length);
+    CoapError err = validate();
+    if (err == CoapError::OK && capacity > maxPayloadSize_) {
+        err = CoapError::PAYLOAD_TOO_LARGE;
+    }
+    // Empty messages must have no payload
+    if (err == CoapError::OK && packet_.code == CoapCode::EMPTY) {
+        err = CoapError::INVALID_FORMAT;
+    }
+    if (err != CoapError::OK) {
+        lastError_ = err;
+        return err;
     }
 
-    // 3. Pack options (delta-encoded, sorted)
-    if (!packet_.options.empty()) {
-        std::vector<uint8_t> optionsBuffer;
-        err = packOptions(optionsBuffer);
-        if (err != CoapError::OK) {
-            lastError_ = err;
-            return err;
-        }
-        buffer.insert(buffer.end(), optionsBuffer.begin(), optionsBuffer.end());
+    sortOptions();
+    err = encodeHead(buffer);
+    if (err != CoapError::OK) {
+        lastError_ = err;
+        return err;
     }
 
-    // 4. Add payload marker and payload (if any)
-    if (!packet_.payload.empty()) {
-        buffer.push_back(PAYLOAD_MARKER);  // 0xFF marker
-        buffer.insert(buffer.end(), packet_.payload.begin(), packet_.payload.end());
+    buffer.push_back(PAYLOAD_MARKER);
+    streamOffset_ = buffer.size();
+    streamCapacity_ = capacity;
+    buffer.resize(streamOffset_ + capacity);
+    payload = buffer.data() + streamOffset_;
+    lastError_ = CoapError::OK;
+    return CoapError::OK;
+}
+
+CoapError CoapBuilder::commitPayload(std::vector<uint8_t>& buffer, size_t length) {
+    if (streamOffset_ == 0 || buffer.size() != streamOffset_ + streamCapacity_) {
+        lastError_ = CoapError::INVALID_ARGUMENT;
+        return lastError_;
+    }
+    if (length > streamCapacity_) {
+        lastError_ = CoapError::BUFFER_TOO_SMALL;
+        return lastError_;
     }
 
+    // Without payload bytes the marker must go as well
+    buffer.resize(length > 0 ? streamOffset_ + length : streamOffset_ - 1);
+    streamOffset_ = 0;
+    streamCapacity_ = 0;
     lastError_ = CoapError::OK;
     return CoapError::OK;
 }
@@ -170,6 +216,9 @@ CoapError CoapBuilder::getLastError() const {
 void CoapBuilder::reset() {
     packet_.clear();
     lastError_ = CoapError::OK;
+    maxPayloadSize_ = MAX_PAYLOAD_SIZE;
+    streamOffset_ = 0;
+    streamCapacity_ = 0;
 }
 
 void CoapBuilder::sortOptions() {
@@ -179,65 +228,36 @@ void CoapBuilder::sortOptions() {
         });
 }
 
-size_t CoapBuilder::encodeOptionDeltaLength(uint8_t* buffer, uint16_t delta, uint16_t length) {
-    size_t offset = 0;
-    buffer[0] = 0;
-
-    // Encode delta (upper 4 bits)
-    if (delta < 13) {
-        buffer[0] |= (delta & 0x0F) << 4;
-    } else if (delta < 269) {
-        buffer[0] |= 13 << 4;
-        buffer[++offset] = static_cast<uint8_t>(delta - 13);
-    } else {
-        buffer[0] |= 14 << 4;
-        uint16_t extDelta = delta - 269;
-        buffer[++offset] = static_cast<uint8_t>(extDelta >> 8);
-        buffer[++offset] = static_cast<uint8_t>(extDelta & 0xFF);
-    }
+CoapError CoapBuilder::encodeHead(std::vector<uint8_t>& buffer) {
+    buffer.clear();
 
-    // Encode length (lower 4 bits)
-    if (length < 13) {
-        buffer[0] |= (length & 0x0F);
-    } else if (length < 269) {
-        buffer[0] |= 13;
-        buffer[++offset] = static_cast<uint8_t>(length - 13);
-    } else {
-        buffer[0] |= 14;
-        uint16_t extLength = length - 269;
-        buffer[++offset] = static_cast<uint8_t>(extLength >> 8);
-        buffer[++offset] = static_cast<uint8_t>(extLength & 0xFF);
-    }
+    // 1. Build 4-byte header
+    buffer.resize(4);
+    buffer[0] = (COAP_VERSION & 0x03) << 6;  // Version (2 bits)
+    buffer[0] |= (static_cast<uint8_t>(packet_.type) & 0x03) << 4;  // Type (2 bits)
+    buffer[0] |= (packet_.token_length & 0x0F);  // Token length (4 bits)
 
-    return offset + 1;  // Return total bytes written
-}
+    buffer[1] = static_cast<uint8_t>(packet_.code);  // Code (8 bits)
 
-std::vector<uint8_t> CoapBuilder::encodeUint(uint32_t value) {
-    std::vector<uint8_t> result;
+    buffer[2] = static_cast<uint8_t>(packet_.message_id >> 8);    // Message ID high byte
+    buffer[3] = static_cast<uint8_t>(packet_.message_id & 0xFF);  // Message ID low byte
 
-    if (value == 0) {
-        // Zero is encoded as empty (0-length option)
-        return result;
+    // 2. Add token (0-8 bytes)
+    if (packet_.token_length > 0) {
+        buffer.insert(buffer.end(), packet_.token, packet_.token + packet_.token_length);
     }
 
-    // Encode as big-endian, minimum bytes needed
-    if (value <= 0xFF) {
-        result.push_back(static_cast<uint8_t>(value));
-    } else if (value <= 0xFFFF) {
-        result.push_back(static_cast<uint8_t>(value >> 8));
-        result.push_back(static_cast<uint8_t>(value & 0xFF));
-    } else if (value <= 0xFFFFFF) {
-        result.push_back(static_cast<uint8_t>(value >> 16));
-        result.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
-        result.push_back(static_cast<uint8_t>(value & 0xFF));
-    } else {
-        result.push_back(static_cast<uint8_t>(value >> 24));
-        result.push_back(static_cast<uint8_t>((value >> 16) & 0xFF));
-        result.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
-        result.push_back(static_cast<uint8_t>(value & 0xFF));
+    // 3. Pack options (delta-encoded, sorted)
+    if (!packet_.options.empty()) {
+        std::vector<uint8_t> optionsBuffer;
+        CoapError err = packOptions(optionsBuffer);
+        if (err != CoapError::OK) {
+            return err;
+        }
+        buffer.insert(buffer.end(), optionsBuffer.begin(), optionsBuffer.end());
     }
 
-    return result;
+    return CoapError::OK;
 }
 
 CoapError CoapBuilder::packOptions(std::vector<uint8_t>& buffer) {
@@ -257,7 +277,7 @@ CoapError CoapBuilder::packOptions(std::vector<uint8_t>& buffer) {
 
         // Encode delta and length (max 5 bytes: 1 base + 2 for delta + 2 for length)
         uint8_t deltaLengthBuf[5];
-        size_t headerSize = encodeOptionDeltaLength(deltaLengthBuf, delta, length);
+        size_t headerSize = encodeOptionHeader(deltaLengthBuf, delta, length);
 
         // Add header bytes
         buffer.insert(buffer.end(), deltaLengthBuf, deltaLengthBuf + headerSize);
@@ -286,13 +306,13 @@ CoapError CoapBuilder::validate() {
     }
 
     // Check payload size
-    if (packet_.payload.size() > MAX_PAYLOAD_SIZE) {
+    if (packet_.getPayloadSize() > maxPayloadSize_) {
         return CoapError::PAYLOAD_TOO_LARGE;
     }
 
     // Empty messages must have no token, options, or payload
     if (packet_.code == CoapCode::EMPTY) {
-        if (packet_.token_length != 0 || !packet_.options.empty() || !packet_.payload.empty()) {
+        if (packet_.token_length != 0 || !packet_.options.empty() || packet_.getPayloadSize() > 0) {
             return CoapError::INVALID_FORMAT;
         }
     }
@@ -300,4 +320,12 @@ CoapError CoapBuilder::validate() {
     return CoapError::OK;
 }
 
+CoapMemoryUsage CoapBuilder::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.add(packet_.memoryUsage(), sizeof(packet_));
+    usage.entries = packet_.options.size();
+    return usage;
+}
+
 } // namespace CoapPacket
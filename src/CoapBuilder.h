@@ -86,6 +86,19 @@ public:
      */
     CoapBuilder& setPayload(const uint8_t* data, size_t length);
 
+    /**
+     * Reference an external payload instead of copying it
+     * The packet built by build() shares owner; buildBuffer() copies the
+     * bytes once into the output buffer.
+     */
+    CoapBuilder& setPayloadRef(const uint8_t* data, size_t length, std::shared_ptr<const void> owner = nullptr);
+
+    /**
+     * Raise the payload limit (default MAX_PAYLOAD_SIZE) for transports
+     * that carry larger messages, e.g. RFC 8323 over TCP
+     */
+    CoapBuilder& setMaxPayloadSize(size_t maxPayloadSize);
+
     /**
      * Build the packet structure
      * Returns CoapError::OK on success, error code otherwise
@@ -98,6 +111,22 @@ public:
      */
     CoapError buildBuffer(std::vector<uint8_t>& buffer);
 
+    /**
+     * Start writing the payload in place (streamed payload)
+     * Encodes header and options into buffer, appends the payload marker
+     * and reserves capacity bytes after it; payload points at them. Write
+     * the body there, then call commitPayload() with the bytes used. A
+     * payload set with setPayload() is not encoded. buffer must not be
+     * resized in between.
+     */
+    CoapError beginPayload(std::vector<uint8_t>& buffer, size_t capacity, uint8_t*& payload);
+
+    /**
+     * Finish a streamed payload of length bytes; trims the reserved span
+     * (and drops the marker if length is 0)
+     */
+    CoapError commitPayload(std::vector<uint8_t>& buffer, size_t length);
+
     /**
      * Get the last error that occurred
      */
@@ -108,9 +137,18 @@ public:
      */
     void reset();
 
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts the options added so far
+     */
+    CoapMemoryUsage memoryUsage() const;
+
 private:
     CoapPacket packet_;
     CoapError lastError_;
+    size_t maxPayloadSize_;
+    size_t streamOffset_;       // Payload offset in the output buffer, 0 if not streaming
+    size_t streamCapacity_;
 
     /**
      * Sort options by option number (required by CoAP spec)
@@ -118,14 +156,9 @@ private:
     void sortOptions();
 
     /**
-     * Encode option delta and length using CoAP delta encoding
-     */
-    size_t encodeOptionDeltaLength(uint8_t* buffer, uint16_t delta, uint16_t length);
-
-    /**
-     * Encode uint32 as variable-length big-endian bytes
+     * Encode header, token and options into buffer
      */
-    std::vector<uint8_t> encodeUint(uint32_t value);
+    CoapError encodeHead(std::vector<uint8_t>& buffer);
 
     /**
      * Pack all options into buffer using delta encoding
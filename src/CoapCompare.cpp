@@ -0,0 +1,118 @@
+#include "CoapCompare.h"
+#include "CoapOptions.h"
+#include "CoapTypes.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+namespace {
+
+bool isComparedOption(uint16_t number, uint32_t ignore) {
+    if ((ignore & COAP_FIELD_OPTIONS) != 0) {
+        return false;
+    }
+    return (ignore & COAP_FIELD_NO_CACHE_KEY) == 0 || !isNoCacheKeyOption(number);
+}
+
+// Next option not in the ignore mask
+bool nextComparedOption(CoapOptionIterator& it, CoapOptionRef& option, uint32_t ignore) {
+    while (it.next(option)) {
+        if (isComparedOption(option.number, ignore)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t compareHeaders(const uint8_t* a, const uint8_t* b, uint32_t ignore) {
+    if ((ignore & COAP_FIELD_TYPE) == 0 && ((a[0] ^ b[0]) & 0x30) != 0) {
+        return COAP_FIELD_TYPE;
+    }
+    if ((ignore & COAP_FIELD_CODE) == 0 && a[1] != b[1]) {
+        return COAP_FIELD_CODE;
+    }
+    if ((ignore & COAP_FIELD_MESSAGE_ID) == 0 && (a[2] != b[2] || a[3] != b[3])) {
+        return COAP_FIELD_MESSAGE_ID;
+    }
+    if ((ignore & COAP_FIELD_TOKEN) == 0) {
+        uint8_t tokenLength = a[0] & 0x0F;
+        if (tokenLength != (b[0] & 0x0F) || std::memcmp(a + 4, b + 4, tokenLength) != 0) {
+            return COAP_FIELD_TOKEN;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+CoapError CoapCompare::compare(const uint8_t* a, size_t aLength, const uint8_t* b, size_t bLength,
+                               uint32_t& difference, uint32_t ignore) {
+    difference = 0;
+
+    size_t aOffset = 0;
+    size_t bOffset = 0;
+    CoapError err = CoapOptionIterator::locateOptions(a, aLength, aOffset);
+    if (err != CoapError::OK) {
+        return err;
+    }
+    err = CoapOptionIterator::locateOptions(b, bLength, bOffset);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    // Header and token; a difference here still requires both option
+    // blocks to be well formed, so keep walking to report errors
+    uint32_t found = compareHeaders(a, b, ignore);
+
+    CoapOptionIterator aIt(a, aLength, aOffset);
+    CoapOptionIterator bIt(b, bLength, bOffset);
+    CoapOptionRef aOption;
+    CoapOptionRef bOption;
+    while (true) {
+        bool aMore = nextComparedOption(aIt, aOption, ignore);
+        bool bMore = nextComparedOption(bIt, bOption, ignore);
+        if (!aMore || !bMore) {
+            if (found == 0 && aMore != bMore) {
+                found = COAP_FIELD_OPTIONS;
+            }
+            // Drain the longer block so malformed trailing options are seen
+            while (aMore && nextComparedOption(aIt, aOption, ignore)) {
+            }
+            while (bMore && nextComparedOption(bIt, bOption, ignore)) {
+            }
+            break;
+        }
+        if (found == 0 &&
+            (aOption.number != bOption.number || aOption.length != bOption.length ||
+             std::memcmp(aOption.value, bOption.value, aOption.length) != 0)) {
+            found = COAP_FIELD_OPTIONS;
+        }
+    }
+
+    if (aIt.getError() != CoapError::OK) {
+        return aIt.getError();
+    }
+    if (bIt.getError() != CoapError::OK) {
+        return bIt.getError();
+    }
+
+    if (found == 0 && (ignore & COAP_FIELD_PAYLOAD) == 0) {
+        size_t aPayload = aIt.hasPayload() ? aLength - aIt.getOffset() - 1 : 0;
+        size_t bPayload = bIt.hasPayload() ? bLength - bIt.getOffset() - 1 : 0;
+        if (aPayload != bPayload ||
+            (aPayload > 0 && std::memcmp(a + aIt.getOffset() + 1, b + bIt.getOffset() + 1, aPayload) != 0)) {
+            found = COAP_FIELD_PAYLOAD;
+        }
+    }
+
+    difference = found;
+    return CoapError::OK;
+}
+
+bool CoapCompare::equals(const uint8_t* a, size_t aLength, const uint8_t* b, size_t bLength,
+                         uint32_t ignore) {
+    uint32_t difference = 0;
+    return compare(a, aLength, b, bLength, difference, ignore) == CoapError::OK && difference == 0;
+}
+
+} // namespace CoapPacket
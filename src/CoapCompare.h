@@ -0,0 +1,39 @@
+#ifndef COAP_COMPARE_H
+#define COAP_COMPARE_H
+
+#include "CoapError.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+/**
+ * Semantic comparison of encoded messages without parsing into CoapPacket
+ *
+ * Both buffers are walked in lockstep with CoapOptionIterator and options
+ * compare by number and value. Fields set in the ignore mask (COAP_FIELD_*
+ * flags) are skipped; ignored options drop out of the walk, so messages
+ * that differ only in, e.g., NoCacheKey options compare equal.
+ */
+class CoapCompare {
+public:
+    /**
+     * Compare two encoded messages
+     * difference is set to the COAP_FIELD_* flag of the first field that
+     * differs (header fields first, then options, then payload), or 0 if
+     * the messages are equal. Returns an error if either is malformed.
+     */
+    static CoapError compare(const uint8_t* a, size_t aLength, const uint8_t* b, size_t bLength,
+                             uint32_t& difference, uint32_t ignore = 0);
+
+    /**
+     * Check two encoded messages for equality; malformed messages are
+     * never equal
+     */
+    static bool equals(const uint8_t* a, size_t aLength, const uint8_t* b, size_t bLength,
+                       uint32_t ignore = 0);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_COMPARE_H
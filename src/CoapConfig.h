@@ -0,0 +1,181 @@
+#ifndef COAP_CONFIG_H
+#define COAP_CONFIG_H
+
+/**
+ * Build profile and feature selection for the single translation unit
+ * build (CoapPacketUnity.cpp)
+ *
+ * COAP_PACKET_EMBEDDED=1 selects the embedded profile: only the heap-free
+ * parts are compiled (CoapPacketView parsing, CoapWriter, raw-buffer
+ * CoapEditor, CoapFormatter, CoapLinkFormat, CoapHash, CoapCompare,
+ * CoapAckBatch, C API). Build it with -fno-exceptions -fno-rtti; nothing
+ * in the library throws or uses RTTI.
+ *
+ * Each feature can be switched with COAP_PACKET_FEATURE_<NAME>=0/1.
+ */
+
+#ifndef COAP_PACKET_EMBEDDED
+#define COAP_PACKET_EMBEDDED 0
+#endif
+
+#if COAP_PACKET_EMBEDDED
+#define COAP_PACKET_HEAP_FEATURES 0
+#else
+#define COAP_PACKET_HEAP_FEATURES 1
+#endif
+
+// Zero-copy parsing (CoapParser::parseView, CoapOptionIterator)
+#ifndef COAP_PACKET_FEATURE_VIEW
+#define COAP_PACKET_FEATURE_VIEW 1
+#endif
+
+// Heap-free encoder (CoapWriter)
+#ifndef COAP_PACKET_FEATURE_WRITER
+#define COAP_PACKET_FEATURE_WRITER 1
+#endif
+
+// In-place option editing (CoapEditor)
+#ifndef COAP_PACKET_FEATURE_EDITOR
+#define COAP_PACKET_FEATURE_EDITOR 1
+#endif
+
+// CoapPacket parsing (CoapParser::parse)
+#ifndef COAP_PACKET_FEATURE_PARSER
+#define COAP_PACKET_FEATURE_PARSER COAP_PACKET_HEAP_FEATURES
+#endif
+
+// Builder pattern API (CoapBuilder)
+#ifndef COAP_PACKET_FEATURE_BUILDER
+#define COAP_PACKET_FEATURE_BUILDER COAP_PACKET_HEAP_FEATURES
+#endif
+
+// RFC 8323 codec, WebSocket framing and stream decoder
+#ifndef COAP_PACKET_FEATURE_RELIABLE
+#define COAP_PACKET_FEATURE_RELIABLE COAP_PACKET_HEAP_FEATURES
+#endif
+
+// Byte streams, endpoints and the DTLS transport
+#ifndef COAP_PACKET_FEATURE_TRANSPORT
+#define COAP_PACKET_FEATURE_TRANSPORT COAP_PACKET_HEAP_FEATURES
+#endif
+
+// Batch ingress header filter (CoapIngressFilter)
+#ifndef COAP_PACKET_FEATURE_FILTER
+#define COAP_PACKET_FEATURE_FILTER 1
+#endif
+
+// Stable C API (CoapPacketC.h)
+#ifndef COAP_PACKET_FEATURE_C_API
+#define COAP_PACKET_FEATURE_C_API 1
+#endif
+
+// Columnar batch parsing and Arrow export (CoapPacketBatch)
+#ifndef COAP_PACKET_FEATURE_BATCH
+#define COAP_PACKET_FEATURE_BATCH COAP_PACKET_HEAP_FEATURES
+#endif
+
+// Text and JSON log formatting (CoapFormatter)
+#ifndef COAP_PACKET_FEATURE_FORMATTER
+#define COAP_PACKET_FEATURE_FORMATTER 1
+#endif
+
+// Per-thread flight recorder of message metadata (CoapFlightRecorder)
+#ifndef COAP_PACKET_FEATURE_RECORDER
+#define COAP_PACKET_FEATURE_RECORDER COAP_PACKET_HEAP_FEATURES
+#endif
+
+// CoRE link-format parser (CoapLinkFormat)
+#ifndef COAP_PACKET_FEATURE_LINK_FORMAT
+#define COAP_PACKET_FEATURE_LINK_FORMAT 1
+#endif
+
+// Hashed timer wheel (CoapTimerWheel)
+#ifndef COAP_PACKET_FEATURE_TIMER
+#define COAP_PACKET_FEATURE_TIMER COAP_PACKET_HEAP_FEATURES
+#endif
+
+// Resource directory (CoapResourceDirectory)
+#ifndef COAP_PACKET_FEATURE_RD
+#define COAP_PACKET_FEATURE_RD COAP_PACKET_HEAP_FEATURES
+#endif
+
+// Concurrent string interning (CoapStringTable)
+#ifndef COAP_PACKET_FEATURE_STRING_TABLE
+#define COAP_PACKET_FEATURE_STRING_TABLE COAP_PACKET_HEAP_FEATURES
+#endif
+
+// 64-bit message hashing (CoapHash)
+#ifndef COAP_PACKET_FEATURE_HASH
+#define COAP_PACKET_FEATURE_HASH 1
+#endif
+
+// Semantic comparison of encoded messages (CoapCompare)
+#ifndef COAP_PACKET_FEATURE_COMPARE
+#define COAP_PACKET_FEATURE_COMPARE 1
+#endif
+
+// Batch ACK/RST generation (CoapAckBatch)
+#ifndef COAP_PACKET_FEATURE_ACK_BATCH
+#define COAP_PACKET_FEATURE_ACK_BATCH 1
+#endif
+
+// Piggybacked or separate response policy (CoapResponseScheduler)
+#ifndef COAP_PACKET_FEATURE_SCHEDULER
+#define COAP_PACKET_FEATURE_SCHEDULER COAP_PACKET_HEAP_FEATURES
+#endif
+
+// Simulated datagram network for deterministic tests (CoapSimNetwork)
+#ifndef COAP_PACKET_FEATURE_SIM
+#define COAP_PACKET_FEATURE_SIM COAP_PACKET_HEAP_FEATURES
+#endif
+
+// Sampled request tracing with span export (CoapTracer)
+#ifndef COAP_PACKET_FEATURE_TRACING
+#define COAP_PACKET_FEATURE_TRACING COAP_PACKET_HEAP_FEATURES
+#endif
+
+// OpenSSL TLS engine with Linux kernel TLS offload and DTLS engines (CoapOpenSsl.h)
+// Off by default so the library has no dependencies; link with -lssl -lcrypto
+#ifndef COAP_PACKET_WITH_OPENSSL
+#define COAP_PACKET_WITH_OPENSSL 0
+#endif
+
+// Feature dependencies
+#if COAP_PACKET_WITH_OPENSSL
+#undef COAP_PACKET_FEATURE_TRANSPORT
+#define COAP_PACKET_FEATURE_TRANSPORT 1
+#endif
+
+#if COAP_PACKET_FEATURE_RELIABLE || COAP_PACKET_FEATURE_TRANSPORT || COAP_PACKET_FEATURE_C_API || \
+    COAP_PACKET_FEATURE_BATCH || COAP_PACKET_FEATURE_FORMATTER || COAP_PACKET_FEATURE_RECORDER
+#undef COAP_PACKET_FEATURE_VIEW
+#define COAP_PACKET_FEATURE_VIEW 1
+#endif
+
+#if COAP_PACKET_FEATURE_RD
+#undef COAP_PACKET_FEATURE_LINK_FORMAT
+#define COAP_PACKET_FEATURE_LINK_FORMAT 1
+#undef COAP_PACKET_FEATURE_TIMER
+#define COAP_PACKET_FEATURE_TIMER 1
+#undef COAP_PACKET_FEATURE_BUILDER
+#define COAP_PACKET_FEATURE_BUILDER 1
+#undef COAP_PACKET_FEATURE_HASH
+#define COAP_PACKET_FEATURE_HASH 1
+#endif
+
+#if COAP_PACKET_FEATURE_SCHEDULER
+#undef COAP_PACKET_FEATURE_TIMER
+#define COAP_PACKET_FEATURE_TIMER 1
+#endif
+
+#if COAP_PACKET_FEATURE_STRING_TABLE
+#undef COAP_PACKET_FEATURE_PARSER
+#define COAP_PACKET_FEATURE_PARSER 1
+#endif
+
+#if COAP_PACKET_FEATURE_C_API
+#undef COAP_PACKET_FEATURE_WRITER
+#define COAP_PACKET_FEATURE_WRITER 1
+#endif
+
+#endif // COAP_CONFIG_H
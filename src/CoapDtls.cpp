@@ -0,0 +1,271 @@
+#include "CoapDtls.h"
+#include "CoapParser.h"
+
+namespace CoapPacket {
+
+CoapDtlsSessionTable::CoapDtlsSessionTable(size_t initialCapacity) : size_(0) {
+    size_t capacity = 8;
+    while (capacity < initialCapacity) {
+        capacity <<= 1;
+    }
+    slots_.resize(capacity);
+}
+
+CoapDtlsEngine* CoapDtlsSessionTable::find(const CoapEndpoint& endpoint) const {
+    size_t index = findSlot(endpoint, endpoint.hash());
+    return slots_[index].engine;
+}
+
+CoapDtlsEngine* CoapDtlsSessionTable::touch(const CoapEndpoint& endpoint, uint64_t now) {
+    Slot& slot = slots_[findSlot(endpoint, endpoint.hash())];
+    if (slot.engine != nullptr) {
+        slot.lastActive = now;
+    }
+    return slot.engine;
+}
+
+CoapDtlsEngine* CoapDtlsSessionTable::insert(const CoapEndpoint& endpoint, CoapDtlsEngine* engine, uint64_t now) {
+    if (engine == nullptr) {
+        return erase(endpoint);
+    }
+
+    // Keep load factor below 3/4
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+        grow();
+    }
+
+    uint64_t hash = endpoint.hash();
+    size_t index = findSlot(endpoint, hash);
+    Slot& slot = slots_[index];
+    CoapDtlsEngine* displaced = slot.engine;
+    if (displaced == nullptr) {
+        slot.endpoint = endpoint;
+        slot.hash = hash;
+        size_++;
+    }
+    slot.engine = engine;
+    slot.lastActive = now;
+    return displaced != engine ? displaced : nullptr;
+}
+
+CoapDtlsEngine* CoapDtlsSessionTable::erase(const CoapEndpoint& endpoint) {
+    size_t mask = slots_.size() - 1;
+    size_t hole = findSlot(endpoint, endpoint.hash());
+    CoapDtlsEngine* engine = slots_[hole].engine;
+    if (engine == nullptr) {
+        return nullptr;
+    }
+
+    // Backward-shift deletion keeps probe sequences intact without tombstones
+    size_t next = (hole + 1) & mask;
+    while (slots_[next].engine != nullptr) {
+        size_t home = static_cast<size_t>(slots_[next].hash) & mask;
+        bool movable = (hole <= next) ? (home <= hole || home > next)
+                                      : (home <= hole && home > next);
+        if (movable) {
+            slots_[hole] = slots_[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    slots_[hole] = Slot();
+    size_--;
+    return engine;
+}
+
+size_t CoapDtlsSessionTable::size() const {
+    return size_;
+}
+
+void CoapDtlsSessionTable::clear(CoapDtlsEngineFactory& factory) {
+    for (auto& slot : slots_) {
+        if (slot.engine != nullptr) {
+            factory.destroyEngine(slot.engine);
+            slot = Slot();
+        }
+    }
+    size_ = 0;
+}
+
+size_t CoapDtlsSessionTable::expire(uint64_t now, uint64_t idleTimeout, CoapDtlsEngineFactory& factory) {
+    std::vector<Slot> old(slots_.size());
+    old.swap(slots_);
+    size_t expired = 0;
+    for (const auto& slot : old) {
+        if (slot.engine == nullptr) {
+            continue;
+        }
+        // Sessions active at now are kept even with idleTimeout 0: earlier
+        // messages of the batch being received may still point to them
+        if (now > slot.lastActive && now - slot.lastActive >= idleTimeout) {
+            factory.destroyEngine(slot.engine);
+            expired++;
+        } else {
+            place(slot);
+        }
+    }
+    size_ -= expired;
+    return expired;
+}
+
+size_t CoapDtlsSessionTable::findSlot(const CoapEndpoint& endpoint, uint64_t hash) const {
+    size_t mask = slots_.size() - 1;
+    size_t index = static_cast<size_t>(hash) & mask;
+    while (slots_[index].engine != nullptr) {
+        if (slots_[index].hash == hash && slots_[index].endpoint == endpoint) {
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+void CoapDtlsSessionTable::place(const Slot& slot) {
+    size_t mask = slots_.size() - 1;
+    size_t index = static_cast<size_t>(slot.hash) & mask;
+    while (slots_[index].engine != nullptr) {
+        index = (index + 1) & mask;
+    }
+    slots_[index] = slot;
+}
+
+void CoapDtlsSessionTable::grow() {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(old.size() * 2);
+
+    for (const auto& slot : old) {
+        if (slot.engine != nullptr) {
+            place(slot);
+        }
+    }
+}
+
+CoapDtlsTransport::CoapDtlsTransport(CoapDtlsEngineFactory& factory, size_t maxSessions, uint64_t idleTimeout)
+    : factory_(factory)
+    , maxSessions_(maxSessions)
+    , idleTimeout_(idleTimeout)
+    , nextSweep_(0)
+    , dropCount_(0) {}
+
+CoapDtlsTransport::~CoapDtlsTransport() {
+    sessions_.clear(factory_);
+}
+
+CoapDtlsEngine* CoapDtlsTransport::createSession(const CoapEndpoint& endpoint, uint64_t now) {
+    if (sessions_.size() >= maxSessions_) {
+        if (now < nextSweep_) {
+            return nullptr;
+        }
+        nextSweep_ = now + idleTimeout_ / 16 + 1;
+        if (expireSessions(now) == 0) {
+            return nullptr;
+        }
+    }
+
+    CoapDtlsEngine* session = factory_.createEngine(endpoint);
+    if (session != nullptr) {
+        CoapDtlsEngine* displaced = sessions_.insert(endpoint, session, now);
+        if (displaced != nullptr) {
+            factory_.destroyEngine(displaced);
+        }
+    }
+    return session;
+}
+
+size_t CoapDtlsTransport::receiveBatch(CoapDatagram* batch, size_t count, CoapDtlsMessage* messages,
+                                       uint64_t now) {
+    size_t messageCount = 0;
+    const CoapEndpoint* lastEndpoint = nullptr;
+    CoapDtlsEngine* session = nullptr;
+
+    for (size_t i = 0; i < count; i++) {
+        CoapDatagram& datagram = batch[i];
+
+        // Bursts from one peer share the lookup
+        if (lastEndpoint == nullptr || datagram.endpoint != *lastEndpoint) {
+            session = sessions_.touch(datagram.endpoint, now);
+            if (session == nullptr) {
+                session = createSession(datagram.endpoint, now);
+            }
+            lastEndpoint = &datagram.endpoint;
+        }
+
+        if (session == nullptr) {
+            dropCount_++;
+            continue;
+        }
+
+        uint8_t* plaintext = nullptr;
+        size_t plaintextLength = 0;
+        if (session->decrypt(datagram.data, datagram.length, plaintext, plaintextLength) != CoapError::OK) {
+            dropCount_++;
+            continue;
+        }
+        if (plaintextLength == 0) {
+            continue;  // Handshake or alert only
+        }
+
+        CoapDtlsMessage& message = messages[messageCount];
+        if (CoapParser::parseView(plaintext, plaintextLength, message.view) != CoapError::OK) {
+            dropCount_++;
+            continue;
+        }
+        message.index = i;
+        message.session = session;
+        messageCount++;
+    }
+
+    return messageCount;
+}
+
+CoapError CoapDtlsTransport::send(const CoapEndpoint& endpoint, const uint8_t* data, size_t length,
+                                  uint8_t* out, size_t capacity, size_t& outLength) {
+    CoapDtlsEngine* session = sessions_.find(endpoint);
+    if (session == nullptr) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    return session->encrypt(data, length, out, capacity, outLength);
+}
+
+CoapDtlsEngine* CoapDtlsTransport::getSession(const CoapEndpoint& endpoint) const {
+    return sessions_.find(endpoint);
+}
+
+void CoapDtlsTransport::closeSession(const CoapEndpoint& endpoint) {
+    CoapDtlsEngine* session = sessions_.erase(endpoint);
+    if (session != nullptr) {
+        factory_.destroyEngine(session);
+    }
+}
+
+size_t CoapDtlsTransport::expireSessions(uint64_t now) {
+    return sessions_.expire(now, idleTimeout_, factory_);
+}
+
+size_t CoapDtlsTransport::getSessionCount() const {
+    return sessions_.size();
+}
+
+size_t CoapDtlsTransport::getDropCount() const {
+    return dropCount_;
+}
+
+CoapMemoryUsage CoapDtlsSessionTable::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.addArray(size_, slots_.capacity(), sizeof(Slot));
+    usage.entries = size_;
+    return usage;
+}
+
+CoapMemoryUsage CoapDtlsTransport::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.add(sessions_.memoryUsage(), sizeof(sessions_));
+    usage.entries = sessions_.size();
+    return usage;
+}
+
+} // namespace CoapPacket
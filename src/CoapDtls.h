@@ -0,0 +1,235 @@
+#ifndef COAP_DTLS_H
+#define COAP_DTLS_H
+
+#include "CoapMemory.h"
+#include "CoapEndpoint.h"
+#include "CoapPacketView.h"
+#include "CoapError.h"
+#include <vector>
+
+namespace CoapPacket {
+
+// Sessions a transport keeps before new peers are rejected
+constexpr size_t DTLS_DEFAULT_MAX_SESSIONS = 16384;
+
+// Time without received datagrams after which a session may be evicted, milliseconds
+constexpr uint64_t DTLS_DEFAULT_IDLE_TIMEOUT = 300000;
+
+/**
+ * Pluggable DTLS 1.2/1.3 session (OpenSSL, mbedTLS, ...), one per peer
+ * CoapOpenSslDtlsEngine (COAP_PACKET_WITH_OPENSSL) is the bundled one.
+ */
+class CoapDtlsEngine {
+public:
+    virtual ~CoapDtlsEngine() {}
+
+    /**
+     * Process one received datagram, decrypting records in place
+     * plaintext points at the decrypted application data inside data;
+     * plaintextLength is 0 if the datagram only carried handshake or
+     * alert records (the engine sends any reply flight itself).
+     */
+    virtual CoapError decrypt(uint8_t* data, size_t length,
+                              uint8_t*& plaintext, size_t& plaintextLength) = 0;
+
+    /**
+     * Encrypt one CoAP message into a datagram
+     */
+    virtual CoapError encrypt(const uint8_t* data, size_t length,
+                              uint8_t* out, size_t capacity, size_t& outLength) = 0;
+};
+
+/**
+ * Creates and destroys sessions for new peers
+ */
+class CoapDtlsEngineFactory {
+public:
+    virtual ~CoapDtlsEngineFactory() {}
+
+    /**
+     * Create a session for a peer; return nullptr to drop its datagrams
+     */
+    virtual CoapDtlsEngine* createEngine(const CoapEndpoint& endpoint) = 0;
+
+    /**
+     * Release a session created by createEngine()
+     */
+    virtual void destroyEngine(CoapDtlsEngine* engine) = 0;
+};
+
+/**
+ * A received datagram, e.g. one entry of a recvmmsg batch
+ */
+struct CoapDatagram {
+    CoapEndpoint endpoint;
+    uint8_t* data;
+    size_t length;
+
+    CoapDatagram() : data(nullptr), length(0) {}
+};
+
+/**
+ * A CoAP message decrypted from a batch entry
+ */
+struct CoapDtlsMessage {
+    size_t index;             // Index of the datagram in the batch
+    CoapDtlsEngine* session;
+    CoapPacketView view;      // Points into the datagram buffer
+
+    CoapDtlsMessage() : index(0), session(nullptr) {}
+};
+
+/**
+ * Hash table of sessions keyed by 5-tuple
+ * Open addressing with linear probing; capacity stays a power of two.
+ */
+class CoapDtlsSessionTable {
+public:
+    explicit CoapDtlsSessionTable(size_t initialCapacity = 64);
+
+    /**
+     * Find session for endpoint, nullptr if none
+     */
+    CoapDtlsEngine* find(const CoapEndpoint& endpoint) const;
+
+    /**
+     * Find session for endpoint and mark it active at now, nullptr if none
+     */
+    CoapDtlsEngine* touch(const CoapEndpoint& endpoint, uint64_t now);
+
+    /**
+     * Insert or replace session for endpoint, active at now
+     * Returns the displaced session (nullptr if none or the same engine);
+     * the caller destroys it. engine == nullptr erases the endpoint.
+     */
+    CoapDtlsEngine* insert(const CoapEndpoint& endpoint, CoapDtlsEngine* engine, uint64_t now = 0);
+
+    /**
+     * Remove session for endpoint and return it (nullptr if none)
+     */
+    CoapDtlsEngine* erase(const CoapEndpoint& endpoint);
+
+    /**
+     * Get number of sessions
+     */
+    size_t size() const;
+
+    /**
+     * Call destroy on every session and empty the table
+     */
+    void clear(CoapDtlsEngineFactory& factory);
+
+    /**
+     * Destroy sessions not active for idleTimeout; returns how many
+     * One pass over the table that rebuilds it without the idle slots.
+     * Sessions active at now are never destroyed.
+     */
+    size_t expire(uint64_t now, uint64_t idleTimeout, CoapDtlsEngineFactory& factory);
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts sessions; engines are owned by their factory
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    struct Slot {
+        CoapEndpoint endpoint;
+        uint64_t hash;
+        uint64_t lastActive;
+        CoapDtlsEngine* engine;  // nullptr marks an empty slot
+
+        Slot() : hash(0), lastActive(0), engine(nullptr) {}
+    };
+
+    std::vector<Slot> slots_;
+    size_t size_;
+
+    size_t findSlot(const CoapEndpoint& endpoint, uint64_t hash) const;
+    void place(const Slot& slot);
+    void grow();
+};
+
+/**
+ * DTLS transport: batch decryption and parsing of received datagrams
+ *
+ * At most maxSessions sessions are kept. When the table is full, a new
+ * peer first triggers a sweep of sessions idle for idleTimeout (at most
+ * one sweep per idleTimeout / 16, so a flood of spoofed sources cannot
+ * make every datagram scan the table); if none can be evicted its
+ * datagrams are dropped before any engine is created. Established
+ * sessions are never displaced by new peers.
+ *
+ * Time arguments are milliseconds on a monotonic clock.
+ */
+class CoapDtlsTransport {
+public:
+    explicit CoapDtlsTransport(CoapDtlsEngineFactory& factory, size_t maxSessions = DTLS_DEFAULT_MAX_SESSIONS,
+                               uint64_t idleTimeout = DTLS_DEFAULT_IDLE_TIMEOUT);
+    ~CoapDtlsTransport();
+
+    /**
+     * Decrypt a batch of datagrams received at now in place and parse the
+     * CoAP messages
+     * Sessions are created for unknown peers while the table has room.
+     * Datagrams from the same peer that follow each other reuse one table
+     * lookup. Returns number of messages written to messages (at most count)
+     */
+    size_t receiveBatch(CoapDatagram* batch, size_t count, CoapDtlsMessage* messages, uint64_t now);
+
+    /**
+     * Encrypt a CoAP message for an established session
+     */
+    CoapError send(const CoapEndpoint& endpoint, const uint8_t* data, size_t length,
+                   uint8_t* out, size_t capacity, size_t& outLength);
+
+    /**
+     * Get session for endpoint, nullptr if none
+     */
+    CoapDtlsEngine* getSession(const CoapEndpoint& endpoint) const;
+
+    /**
+     * Close and destroy session for endpoint
+     */
+    void closeSession(const CoapEndpoint& endpoint);
+
+    /**
+     * Destroy sessions that received nothing for idleTimeout; returns how many
+     * Call it periodically to release sessions before the table fills.
+     */
+    size_t expireSessions(uint64_t now);
+
+    /**
+     * Get number of sessions
+     */
+    size_t getSessionCount() const;
+
+    /**
+     * Get number of datagrams dropped by decryption or parse errors, or
+     * because the session table was full
+     */
+    size_t getDropCount() const;
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts sessions; engines are owned by their factory
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    CoapDtlsEngineFactory& factory_;
+    CoapDtlsSessionTable sessions_;
+    size_t maxSessions_;
+    uint64_t idleTimeout_;
+    uint64_t nextSweep_;        // Earliest time of the next sweep on a full table
+    size_t dropCount_;
+
+    CoapDtlsEngine* createSession(const CoapEndpoint& endpoint, uint64_t now);
+
+    CoapDtlsTransport(const CoapDtlsTransport&);
+    CoapDtlsTransport& operator=(const CoapDtlsTransport&);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_DTLS_H
@@ -0,0 +1,227 @@
+#include "CoapEditor.h"
+#include "CoapOptions.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+namespace {
+
+enum class EditMode {
+    INSERT,
+    REPLACE,
+    REMOVE
+};
+
+/**
+ * Byte range of the message to replace and the headers to write in its place
+ */
+struct EditPlan {
+    size_t regionStart;
+    size_t regionEnd;
+    uint8_t optionHeader[5];
+    size_t optionHeaderLength;    // 0 when no option is written
+    uint8_t successorHeader[5];
+    size_t successorHeaderLength; // 0 when there is no successor
+    size_t replacementLength;
+    bool changed;
+};
+
+CoapError planEdit(const uint8_t* message, size_t length, uint16_t number,
+                   EditMode mode, size_t valueLength, EditPlan& plan) {
+    if (valueLength > MAX_OPTION_VALUE_SIZE) {
+        return CoapError::OPTION_TOO_LONG;
+    }
+
+    size_t offset = 0;
+    CoapError err = CoapOptionIterator::locateOptions(message, length, offset);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    // Empty messages must have no options
+    if (mode != EditMode::REMOVE && message[1] == static_cast<uint8_t>(CoapCode::EMPTY)) {
+        return CoapError::INVALID_FORMAT;
+    }
+
+    // Find the options before, at and after the edited number. Options past
+    // the successor are left untouched (and unvalidated).
+    CoapOptionIterator it(message, length, offset);
+    CoapOptionRef option;
+    CoapOptionRef successor;
+    uint16_t prevNumber = 0;
+    bool found = false;
+    bool hasSuccessor = false;
+    size_t rangeStart = 0;
+
+    while (it.next(option)) {
+        if (option.number < number || (option.number == number && mode == EditMode::INSERT)) {
+            prevNumber = option.number;
+        } else if (option.number == number) {
+            if (!found) {
+                found = true;
+                rangeStart = option.offset;
+            }
+        } else {
+            successor = option;
+            hasSuccessor = true;
+            break;
+        }
+    }
+
+    if (it.getError() != CoapError::OK) {
+        return it.getError();
+    }
+
+    size_t blockEnd = hasSuccessor ? successor.offset : it.getOffset();
+    plan.regionStart = found ? rangeStart : blockEnd;
+    plan.regionEnd = blockEnd;
+    plan.optionHeaderLength = 0;
+    plan.successorHeaderLength = 0;
+    plan.changed = !(mode == EditMode::REMOVE && !found);
+
+    uint16_t base = prevNumber;
+    if (mode != EditMode::REMOVE) {
+        plan.optionHeaderLength = encodeOptionHeader(plan.optionHeader, number - prevNumber,
+                                                     static_cast<uint16_t>(valueLength));
+        base = number;
+    } else {
+        valueLength = 0;
+    }
+
+    // The successor keeps its value; only its delta changes
+    if (hasSuccessor) {
+        plan.successorHeaderLength = encodeOptionHeader(plan.successorHeader,
+                                                        successor.number - base, successor.length);
+        plan.regionEnd = successor.offset + successor.headerLength;
+    }
+
+    plan.replacementLength = plan.optionHeaderLength + valueLength + plan.successorHeaderLength;
+    return CoapError::OK;
+}
+
+size_t editedLength(size_t length, const EditPlan& plan) {
+    return length - (plan.regionEnd - plan.regionStart) + plan.replacementLength;
+}
+
+void applyEdit(uint8_t* message, size_t length, const EditPlan& plan,
+               const uint8_t* value, size_t valueLength) {
+    // Shift everything after the region once
+    if (plan.replacementLength != plan.regionEnd - plan.regionStart) {
+        std::memmove(message + plan.regionStart + plan.replacementLength,
+                     message + plan.regionEnd, length - plan.regionEnd);
+    }
+
+    uint8_t* out = message + plan.regionStart;
+    if (plan.optionHeaderLength > 0) {
+        std::memcpy(out, plan.optionHeader, plan.optionHeaderLength);
+        out += plan.optionHeaderLength;
+        if (valueLength > 0) {
+            std::memcpy(out, value, valueLength);
+            out += valueLength;
+        }
+    }
+    if (plan.successorHeaderLength > 0) {
+        std::memcpy(out, plan.successorHeader, plan.successorHeaderLength);
+    }
+}
+
+CoapError edit(uint8_t* message, size_t& length, size_t capacity, CoapOptionNumber optionNum,
+               EditMode mode, const uint8_t* value, size_t valueLength) {
+    EditPlan plan;
+    CoapError err = planEdit(message, length, static_cast<uint16_t>(optionNum), mode, valueLength, plan);
+    if (err != CoapError::OK || !plan.changed) {
+        return err;
+    }
+
+    size_t newLength = editedLength(length, plan);
+    if (newLength > capacity) {
+        return CoapError::BUFFER_TOO_SMALL;
+    }
+
+    applyEdit(message, length, plan, value, valueLength);
+    length = newLength;
+    return CoapError::OK;
+}
+
+#if COAP_PACKET_HEAP_FEATURES
+CoapError edit(std::vector<uint8_t>& message, CoapOptionNumber optionNum, EditMode mode,
+               const uint8_t* value, size_t valueLength) {
+    EditPlan plan;
+    CoapError err = planEdit(message.data(), message.size(), static_cast<uint16_t>(optionNum),
+                             mode, valueLength, plan);
+    if (err != CoapError::OK || !plan.changed) {
+        return err;
+    }
+
+    size_t length = message.size();
+    size_t newLength = editedLength(length, plan);
+    if (newLength > length) {
+        message.resize(newLength);
+    }
+    applyEdit(message.data(), length, plan, value, valueLength);
+    if (newLength < length) {
+        message.resize(newLength);
+    }
+    return CoapError::OK;
+}
+#endif
+
+} // namespace
+
+#if COAP_PACKET_HEAP_FEATURES
+CoapError CoapEditor::insertOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                   const std::vector<uint8_t>& value) {
+    return edit(message, optionNum, EditMode::INSERT, value.data(), value.size());
+}
+
+CoapError CoapEditor::insertOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                   const std::string& value) {
+    return edit(message, optionNum, EditMode::INSERT,
+                reinterpret_cast<const uint8_t*>(value.data()), value.size());
+}
+
+CoapError CoapEditor::insertOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                   uint32_t value) {
+    uint8_t encoded[4];
+    size_t encodedLength = encodeUintValue(encoded, value);
+    return edit(message, optionNum, EditMode::INSERT, encoded, encodedLength);
+}
+
+CoapError CoapEditor::replaceOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                    const std::vector<uint8_t>& value) {
+    return edit(message, optionNum, EditMode::REPLACE, value.data(), value.size());
+}
+
+CoapError CoapEditor::replaceOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                    const std::string& value) {
+    return edit(message, optionNum, EditMode::REPLACE,
+                reinterpret_cast<const uint8_t*>(value.data()), value.size());
+}
+
+CoapError CoapEditor::replaceOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                    uint32_t value) {
+    uint8_t encoded[4];
+    size_t encodedLength = encodeUintValue(encoded, value);
+    return edit(message, optionNum, EditMode::REPLACE, encoded, encodedLength);
+}
+
+CoapError CoapEditor::removeOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum) {
+    return edit(message, optionNum, EditMode::REMOVE, nullptr, 0);
+}
+#endif
+
+CoapError CoapEditor::insertOption(uint8_t* message, size_t& length, size_t capacity,
+                                   CoapOptionNumber optionNum, const uint8_t* value, size_t valueLength) {
+    return edit(message, length, capacity, optionNum, EditMode::INSERT, value, valueLength);
+}
+
+CoapError CoapEditor::replaceOption(uint8_t* message, size_t& length, size_t capacity,
+                                    CoapOptionNumber optionNum, const uint8_t* value, size_t valueLength) {
+    return edit(message, length, capacity, optionNum, EditMode::REPLACE, value, valueLength);
+}
+
+CoapError CoapEditor::removeOption(uint8_t* message, size_t& length, CoapOptionNumber optionNum) {
+    return edit(message, length, length, optionNum, EditMode::REMOVE, nullptr, 0);
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,83 @@
+#ifndef COAP_EDITOR_H
+#define COAP_EDITOR_H
+
+#include "CoapConfig.h"
+#include "CoapTypes.h"
+#include "CoapError.h"
+#include <string>
+#include <vector>
+
+namespace CoapPacket {
+
+/**
+ * Edits options of an already encoded CoAP message in place
+ *
+ * Only the affected option and the delta of its successor are re-encoded;
+ * the remaining bytes (later options and payload) are shifted once.
+ * The message is never materialised as a CoapPacket.
+ *
+ * Option values must not point into the message being edited.
+ * The std::vector overloads allocate and are left out of the embedded
+ * profile; the raw buffer variants never allocate.
+ */
+class CoapEditor {
+public:
+#if COAP_PACKET_HEAP_FEATURES
+    /**
+     * Insert option after any existing options with the same number
+     */
+    static CoapError insertOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                  const std::vector<uint8_t>& value);
+
+    /**
+     * Insert option with string value
+     */
+    static CoapError insertOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                  const std::string& value);
+
+    /**
+     * Insert option with uint32 value (encoded as variable-length big-endian)
+     */
+    static CoapError insertOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                  uint32_t value);
+
+    /**
+     * Replace all options with this number by a single option (inserted if absent)
+     */
+    static CoapError replaceOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                   const std::vector<uint8_t>& value);
+
+    /**
+     * Replace option with string value
+     */
+    static CoapError replaceOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                   const std::string& value);
+
+    /**
+     * Replace option with uint32 value (e.g. bumping Max-Age)
+     */
+    static CoapError replaceOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum,
+                                   uint32_t value);
+
+    /**
+     * Remove all options with this number (no-op if absent)
+     */
+    static CoapError removeOption(std::vector<uint8_t>& message, CoapOptionNumber optionNum);
+#endif
+
+    /**
+     * Raw buffer variants: length is updated, capacity bounds growth
+     * Returns CoapError::BUFFER_TOO_SMALL if the edited message does not fit
+     */
+    static CoapError insertOption(uint8_t* message, size_t& length, size_t capacity,
+                                  CoapOptionNumber optionNum, const uint8_t* value, size_t valueLength);
+
+    static CoapError replaceOption(uint8_t* message, size_t& length, size_t capacity,
+                                   CoapOptionNumber optionNum, const uint8_t* value, size_t valueLength);
+
+    static CoapError removeOption(uint8_t* message, size_t& length, CoapOptionNumber optionNum);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_EDITOR_H
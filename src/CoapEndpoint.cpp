@@ -0,0 +1,145 @@
+#include "CoapEndpoint.h"
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace CoapPacket {
+
+namespace {
+
+void setMappedIPv4(uint8_t* out, const uint8_t address[4]) {
+    std::memset(out, 0, 10);
+    out[10] = 0xFF;
+    out[11] = 0xFF;
+    std::memcpy(out + 12, address, 4);
+}
+
+uint64_t load64(const uint8_t* data) {
+    uint64_t value;
+    std::memcpy(&value, data, 8);
+    return value;
+}
+
+uint64_t mix64(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+CoapError readSockaddr(const void* address, uint8_t* out, uint16_t& port) {
+    const sockaddr* sa = static_cast<const sockaddr*>(address);
+    if (sa->sa_family == AF_INET) {
+        const sockaddr_in* sin = static_cast<const sockaddr_in*>(address);
+        setMappedIPv4(out, reinterpret_cast<const uint8_t*>(&sin->sin_addr));
+        port = ntohs(sin->sin_port);
+        return CoapError::OK;
+    }
+    if (sa->sa_family == AF_INET6) {
+        const sockaddr_in6* sin6 = static_cast<const sockaddr_in6*>(address);
+        std::memcpy(out, &sin6->sin6_addr, 16);
+        port = ntohs(sin6->sin6_port);
+        return CoapError::OK;
+    }
+    return CoapError::INVALID_ARGUMENT;
+}
+#endif
+
+} // namespace
+
+bool CoapEndpoint::operator==(const CoapEndpoint& other) const {
+    return remotePort == other.remotePort &&
+           localPort == other.localPort &&
+           protocol == other.protocol &&
+           std::memcmp(remoteAddress, other.remoteAddress, 16) == 0 &&
+           std::memcmp(localAddress, other.localAddress, 16) == 0;
+}
+
+uint64_t CoapEndpoint::hash() const {
+    uint64_t h = (static_cast<uint64_t>(remotePort) << 24) |
+                 (static_cast<uint64_t>(localPort) << 8) | protocol;
+    h = mix64(h ^ load64(remoteAddress));
+    h = mix64(h ^ load64(remoteAddress + 8));
+    h = mix64(h ^ load64(localAddress));
+    h = mix64(h ^ load64(localAddress + 8));
+    return h;
+}
+
+void CoapEndpoint::setRemoteIPv4(const uint8_t address[4], uint16_t port) {
+    setMappedIPv4(remoteAddress, address);
+    remotePort = port;
+}
+
+void CoapEndpoint::setLocalIPv4(const uint8_t address[4], uint16_t port) {
+    setMappedIPv4(localAddress, address);
+    localPort = port;
+}
+
+CoapError CoapEndpoint::fromSockaddr(const void* remote, const void* local, uint8_t protocol,
+                                     CoapEndpoint& endpoint) {
+#if defined(__unix__) || defined(__APPLE__)
+    endpoint = CoapEndpoint();
+    endpoint.protocol = protocol;
+
+    if (remote == nullptr) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    CoapError err = readSockaddr(remote, endpoint.remoteAddress, endpoint.remotePort);
+    if (err != CoapError::OK) {
+        return err;
+    }
+    if (local != nullptr) {
+        return readSockaddr(local, endpoint.localAddress, endpoint.localPort);
+    }
+    return CoapError::OK;
+#else
+    (void)remote;
+    (void)local;
+    (void)protocol;
+    (void)endpoint;
+    return CoapError::INVALID_ARGUMENT;
+#endif
+}
+
+CoapError CoapEndpoint::toSockaddr(void* remote, size_t capacity, size_t& length) const {
+    length = 0;
+#if defined(__unix__) || defined(__APPLE__)
+    static const uint8_t mappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+    if (std::memcmp(remoteAddress, mappedPrefix, sizeof(mappedPrefix)) == 0) {
+        if (capacity < sizeof(sockaddr_in)) {
+            return CoapError::BUFFER_TOO_SMALL;
+        }
+        sockaddr_in sin;
+        std::memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons(remotePort);
+        std::memcpy(&sin.sin_addr, remoteAddress + 12, 4);
+        std::memcpy(remote, &sin, sizeof(sin));
+        length = sizeof(sin);
+        return CoapError::OK;
+    }
+    if (capacity < sizeof(sockaddr_in6)) {
+        return CoapError::BUFFER_TOO_SMALL;
+    }
+    sockaddr_in6 sin6;
+    std::memset(&sin6, 0, sizeof(sin6));
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_port = htons(remotePort);
+    std::memcpy(&sin6.sin6_addr, remoteAddress, 16);
+    std::memcpy(remote, &sin6, sizeof(sin6));
+    length = sizeof(sin6);
+    return CoapError::OK;
+#else
+    (void)remote;
+    (void)capacity;
+    return CoapError::INVALID_ARGUMENT;
+#endif
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,65 @@
+#ifndef COAP_ENDPOINT_H
+#define COAP_ENDPOINT_H
+
+#include "CoapError.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+// IP protocol numbers used in CoapEndpoint::protocol
+constexpr uint8_t ENDPOINT_PROTOCOL_TCP = 6;
+constexpr uint8_t ENDPOINT_PROTOCOL_UDP = 17;
+
+/**
+ * Transport 5-tuple identifying a connection or DTLS session
+ * IPv4 addresses are stored as IPv4-mapped IPv6 addresses.
+ */
+struct CoapEndpoint {
+    uint8_t remoteAddress[16];
+    uint8_t localAddress[16];
+    uint16_t remotePort;
+    uint16_t localPort;
+    uint8_t protocol;
+
+    CoapEndpoint()
+        : remoteAddress{}
+        , localAddress{}
+        , remotePort(0)
+        , localPort(0)
+        , protocol(ENDPOINT_PROTOCOL_UDP) {}
+
+    /**
+     * Compare all five fields
+     */
+    bool operator==(const CoapEndpoint& other) const;
+    bool operator!=(const CoapEndpoint& other) const { return !(*this == other); }
+
+    /**
+     * 64-bit hash of the 5-tuple
+     */
+    uint64_t hash() const;
+
+    /**
+     * Set address and port from an IPv4 address (network byte order bytes)
+     */
+    void setRemoteIPv4(const uint8_t address[4], uint16_t port);
+    void setLocalIPv4(const uint8_t address[4], uint16_t port);
+
+    /**
+     * Fill from POSIX socket addresses (struct sockaddr_in or sockaddr_in6)
+     * local may be null (e.g. a server bound to a single address)
+     */
+    static CoapError fromSockaddr(const void* remote, const void* local, uint8_t protocol,
+                                  CoapEndpoint& endpoint);
+
+    /**
+     * Write the remote address as struct sockaddr_in (IPv4-mapped
+     * addresses) or struct sockaddr_in6, e.g. for sendto()
+     */
+    CoapError toSockaddr(void* remote, size_t capacity, size_t& length) const;
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_ENDPOINT_H
@@ -27,7 +27,11 @@ enum class CoapError {
 
     // General errors
     OUT_OF_MEMORY,
-    INVALID_ARGUMENT
+    INVALID_ARGUMENT,
+
+    // Transport errors
+    CONNECTION_CLOSED,
+    TRANSPORT_ERROR
 };
 
 /**
@@ -63,6 +67,10 @@ inline const char* getErrorMessage(CoapError error) {
             return "Out of memory";
         case CoapError::INVALID_ARGUMENT:
             return "Invalid argument";
+        case CoapError::CONNECTION_CLOSED:
+            return "Connection closed or reset by peer";
+        case CoapError::TRANSPORT_ERROR:
+            return "Transport I/O error";
         default:
             return "Unknown error";
     }
@@ -0,0 +1,213 @@
+#include "CoapFilter.h"
+#include "CoapTypes.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define COAP_FILTER_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define COAP_FILTER_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace CoapPacket {
+
+namespace {
+
+typedef uint32_t (*FilterKernel)(const uint8_t*, const uint8_t*, const uint8_t*);
+
+/**
+ * First two header bytes and saturated length of each datagram, one lane
+ * per datagram. Missing bytes read as 0, which fails the version check.
+ */
+struct FilterLanes {
+    uint8_t first[INGRESS_FILTER_MAX_BATCH];
+    uint8_t code[INGRESS_FILTER_MAX_BATCH];
+    uint8_t length[INGRESS_FILTER_MAX_BATCH];
+};
+
+void gatherLanes(const uint8_t* const* datagrams, const size_t* lengths, size_t count,
+                 FilterLanes& lanes) {
+    for (size_t i = 0; i < INGRESS_FILTER_MAX_BATCH; i++) {
+        size_t length = (i < count) ? lengths[i] : 0;
+        lanes.first[i] = (length > 0) ? datagrams[i][0] : 0;
+        lanes.code[i] = (length > 1) ? datagrams[i][1] : 0;
+        lanes.length[i] = static_cast<uint8_t>(length < 255 ? length : 255);
+    }
+}
+
+uint32_t filterScalar(const uint8_t* first, const uint8_t* code, const uint8_t* length) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < INGRESS_FILTER_MAX_BATCH; i++) {
+        uint8_t tokenLength = first[i] & 0x0F;
+        bool ok = ((first[i] >> 6) == COAP_VERSION) &&
+                  tokenLength <= 8 &&
+                  isValidCodeClass(code[i] >> 5) &&
+                  length[i] >= 4 + tokenLength;
+        mask |= static_cast<uint32_t>(ok) << i;
+    }
+    return mask;
+}
+
+#if defined(COAP_FILTER_X86)
+
+uint32_t filterSse2(const uint8_t* first, const uint8_t* code, const uint8_t* length) {
+    const __m128i versionMask = _mm_set1_epi8(static_cast<char>(0xC0));
+    const __m128i version = _mm_set1_epi8(0x40);
+    const __m128i tklMask = _mm_set1_epi8(0x0F);
+    const __m128i maxTkl = _mm_set1_epi8(8);
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i classMask = _mm_set1_epi8(static_cast<char>(0xE0));
+    const __m128i class1 = _mm_set1_epi8(0x20);
+    const __m128i class6 = _mm_set1_epi8(static_cast<char>(0xC0));
+    const __m128i class7 = _mm_set1_epi8(static_cast<char>(0xE0));
+
+    uint32_t mask = 0;
+    for (size_t i = 0; i < INGRESS_FILTER_MAX_BATCH; i += 16) {
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + i));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i));
+        __m128i len = _mm_loadu_si128(reinterpret_cast<const __m128i*>(length + i));
+
+        __m128i ok = _mm_cmpeq_epi8(_mm_and_si128(b0, versionMask), version);
+        __m128i tkl = _mm_and_si128(b0, tklMask);
+        // Unsigned a <= b as min(a, b) == a
+        ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_min_epu8(tkl, maxTkl), tkl));
+        __m128i need = _mm_add_epi8(tkl, four);
+        ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_max_epu8(len, need), len));
+        __m128i cls = _mm_and_si128(b1, classMask);
+        __m128i bad = _mm_or_si128(_mm_cmpeq_epi8(cls, class1),
+                                   _mm_or_si128(_mm_cmpeq_epi8(cls, class6), _mm_cmpeq_epi8(cls, class7)));
+        ok = _mm_andnot_si128(bad, ok);
+
+        mask |= static_cast<uint32_t>(_mm_movemask_epi8(ok)) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+uint32_t filterAvx2(const uint8_t* first, const uint8_t* code, const uint8_t* length) {
+    const __m256i versionMask = _mm256_set1_epi8(static_cast<char>(0xC0));
+    const __m256i version = _mm256_set1_epi8(0x40);
+    const __m256i tklMask = _mm256_set1_epi8(0x0F);
+    const __m256i maxTkl = _mm256_set1_epi8(8);
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i classMask = _mm256_set1_epi8(static_cast<char>(0xE0));
+    const __m256i class1 = _mm256_set1_epi8(0x20);
+    const __m256i class6 = _mm256_set1_epi8(static_cast<char>(0xC0));
+    const __m256i class7 = _mm256_set1_epi8(static_cast<char>(0xE0));
+
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code));
+    __m256i len = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(length));
+
+    __m256i ok = _mm256_cmpeq_epi8(_mm256_and_si256(b0, versionMask), version);
+    __m256i tkl = _mm256_and_si256(b0, tklMask);
+    ok = _mm256_and_si256(ok, _mm256_cmpeq_epi8(_mm256_min_epu8(tkl, maxTkl), tkl));
+    __m256i need = _mm256_add_epi8(tkl, four);
+    ok = _mm256_and_si256(ok, _mm256_cmpeq_epi8(_mm256_max_epu8(len, need), len));
+    __m256i cls = _mm256_and_si256(b1, classMask);
+    __m256i bad = _mm256_or_si256(_mm256_cmpeq_epi8(cls, class1),
+                                  _mm256_or_si256(_mm256_cmpeq_epi8(cls, class6),
+                                                  _mm256_cmpeq_epi8(cls, class7)));
+    ok = _mm256_andnot_si256(bad, ok);
+
+    return static_cast<uint32_t>(_mm256_movemask_epi8(ok));
+}
+
+#elif defined(COAP_FILTER_NEON)
+
+uint32_t filterNeon(const uint8_t* first, const uint8_t* code, const uint8_t* length) {
+    static const uint8_t laneBits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t bits = vld1q_u8(laneBits);
+
+    uint32_t mask = 0;
+    for (size_t i = 0; i < INGRESS_FILTER_MAX_BATCH; i += 16) {
+        uint8x16_t b0 = vld1q_u8(first + i);
+        uint8x16_t b1 = vld1q_u8(code + i);
+        uint8x16_t len = vld1q_u8(length + i);
+
+        uint8x16_t ok = vceqq_u8(vandq_u8(b0, vdupq_n_u8(0xC0)), vdupq_n_u8(0x40));
+        uint8x16_t tkl = vandq_u8(b0, vdupq_n_u8(0x0F));
+        ok = vandq_u8(ok, vcleq_u8(tkl, vdupq_n_u8(8)));
+        ok = vandq_u8(ok, vcgeq_u8(len, vaddq_u8(tkl, vdupq_n_u8(4))));
+        uint8x16_t cls = vandq_u8(b1, vdupq_n_u8(0xE0));
+        uint8x16_t bad = vorrq_u8(vceqq_u8(cls, vdupq_n_u8(0x20)),
+                                  vorrq_u8(vceqq_u8(cls, vdupq_n_u8(0xC0)), vceqq_u8(cls, vdupq_n_u8(0xE0))));
+        ok = vbicq_u8(ok, bad);
+
+        // Movemask: weight each lane by its bit and sum per half
+        uint8x16_t weighted = vandq_u8(ok, bits);
+        uint32_t low = vaddv_u8(vget_low_u8(weighted));
+        uint32_t high = vaddv_u8(vget_high_u8(weighted));
+        mask |= (low | (high << 8)) << i;
+    }
+    return mask;
+}
+
+#endif
+
+struct KernelChoice {
+    FilterKernel kernel;
+    const char* name;
+};
+
+KernelChoice selectKernel() {
+#if defined(COAP_FILTER_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KernelChoice{filterAvx2, "avx2"};
+    }
+    return KernelChoice{filterSse2, "sse2"};
+#elif defined(COAP_FILTER_NEON)
+    return KernelChoice{filterNeon, "neon"};
+#else
+    return KernelChoice{filterScalar, "scalar"};
+#endif
+}
+
+const KernelChoice& getKernel() {
+    static const KernelChoice choice = selectKernel();
+    return choice;
+}
+
+uint32_t countMask(size_t count) {
+    return (count >= 32) ? 0xFFFFFFFFu : ((1u << count) - 1);
+}
+
+} // namespace
+
+uint32_t CoapIngressFilter::acceptMask(const uint8_t* const* datagrams, const size_t* lengths,
+                                       size_t count) {
+    if (count > INGRESS_FILTER_MAX_BATCH) {
+        count = INGRESS_FILTER_MAX_BATCH;
+    }
+    FilterLanes lanes;
+    gatherLanes(datagrams, lengths, count, lanes);
+    return getKernel().kernel(lanes.first, lanes.code, lanes.length) & countMask(count);
+}
+
+uint32_t CoapIngressFilter::acceptMaskScalar(const uint8_t* const* datagrams, const size_t* lengths,
+                                             size_t count) {
+    if (count > INGRESS_FILTER_MAX_BATCH) {
+        count = INGRESS_FILTER_MAX_BATCH;
+    }
+    FilterLanes lanes;
+    gatherLanes(datagrams, lengths, count, lanes);
+    return filterScalar(lanes.first, lanes.code, lanes.length) & countMask(count);
+}
+
+bool CoapIngressFilter::isPlausible(const uint8_t* datagram, size_t length) {
+    if (length < 4) {
+        return false;
+    }
+    uint8_t tokenLength = datagram[0] & 0x0F;
+    return ((datagram[0] >> 6) == COAP_VERSION) &&
+           tokenLength <= 8 &&
+           isValidCodeClass(datagram[1] >> 5) &&
+           length >= 4 + static_cast<size_t>(tokenLength);
+}
+
+const char* CoapIngressFilter::getKernelName() {
+    return getKernel().name;
+}
+
+} // namespace CoapPacket
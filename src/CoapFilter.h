@@ -0,0 +1,48 @@
+#ifndef COAP_FILTER_H
+#define COAP_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+// Maximum number of datagrams checked by one CoapIngressFilter call
+constexpr size_t INGRESS_FILTER_MAX_BATCH = 32;
+
+/**
+ * Line-rate plausibility check for ingress datagrams
+ *
+ * Applies the header rules of CoapParser::parse to the first two bytes of
+ * each datagram: version 1, token length <= 8, code class not 1/6/7 and
+ * length >= 4 + token length. Options and payload are not inspected.
+ *
+ * The batch kernel is chosen at runtime: AVX2 when the CPU supports it,
+ * otherwise SSE2 (x86-64) or NEON (AArch64), with a scalar fallback.
+ */
+class CoapIngressFilter {
+public:
+    /**
+     * Check a batch of up to INGRESS_FILTER_MAX_BATCH datagrams
+     * Returns a mask with bit i set if datagram i is plausibly CoAP
+     */
+    static uint32_t acceptMask(const uint8_t* const* datagrams, const size_t* lengths, size_t count);
+
+    /**
+     * Scalar reference implementation of acceptMask()
+     */
+    static uint32_t acceptMaskScalar(const uint8_t* const* datagrams, const size_t* lengths, size_t count);
+
+    /**
+     * Check a single datagram
+     */
+    static bool isPlausible(const uint8_t* datagram, size_t length);
+
+    /**
+     * Get name of the kernel selected for this CPU ("avx2", "sse2", "neon" or "scalar")
+     */
+    static const char* getKernelName();
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_FILTER_H
@@ -0,0 +1,273 @@
+#include "CoapFlightRecorder.h"
+#include <chrono>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace CoapPacket {
+
+namespace {
+
+size_t roundUpPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+uint64_t optionBit(uint16_t number) {
+    return 1ULL << (number < 63 ? number : 63);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+bool writeFully(int fd, const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        ssize_t n = ::write(fd, bytes, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * Copy a record the owning thread may be overwriting
+ * The copy is marked invalid unless its sequence is position both before
+ * and after the fields are read.
+ */
+void copyRecord(const CoapTraceRecord& source, uint64_t position, CoapTraceRecord& copy) {
+    const volatile uint32_t& sequence = source.sequence;
+    uint32_t before = sequence;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    std::memcpy(&copy, &source, sizeof(copy));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t after = sequence;
+    if (before != after || before != static_cast<uint32_t>(position)) {
+        copy.sequence = TRACE_SEQUENCE_INVALID;
+    }
+}
+
+#endif
+
+} // namespace
+
+CoapTraceRing::CoapTraceRing() : written_(0), records_(nullptr), mask_(0), claimed_(false), padding_() {}
+
+CoapTraceRecord& CoapTraceRing::nextRecord() {
+    uint64_t position = written_.load(std::memory_order_relaxed);
+    CoapTraceRecord& record = records_[position & mask_];
+    // A dump copying this slot now sees the tear
+    static_cast<volatile uint32_t&>(record.sequence) = TRACE_SEQUENCE_INVALID;
+    std::atomic_thread_fence(std::memory_order_release);
+    return record;
+}
+
+void CoapTraceRing::commit(CoapTraceRecord& record) {
+    uint64_t position = written_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    static_cast<volatile uint32_t&>(record.sequence) = static_cast<uint32_t>(position);
+    written_.store(position + 1, std::memory_order_release);
+}
+
+void CoapTraceRing::recordMessage(const CoapPacketView& view, uint64_t endpointHash, uint8_t direction,
+                                  uint64_t timestamp) {
+    CoapTraceRecord& record = nextRecord();
+    record.timestamp = timestamp;
+    record.endpoint_hash = endpointHash;
+
+    uint64_t bitmap = 0;
+    CoapOptionIterator it = view.getOptions();
+    CoapOptionRef option;
+    while (it.next(option)) {
+        bitmap |= optionBit(option.number);
+    }
+    record.option_bitmap = bitmap;
+
+    uint64_t token = loadToken(view.token, view.token_length);
+    std::memcpy(record.token, &token, sizeof(token));
+    record.payload_length = static_cast<uint32_t>(view.payload_length);
+    record.datagram_length = static_cast<uint32_t>(4 + view.token_length + view.options_length +
+                                                   (view.payload_length > 0 ? 1 + view.payload_length : 0));
+    record.message_id = view.message_id;
+    record.type = static_cast<uint8_t>(view.type);
+    record.code = static_cast<uint8_t>(view.code);
+    record.token_length = view.token_length;
+    record.error = static_cast<uint8_t>(it.getError());
+    record.direction = direction;
+    std::memset(record.reserved, 0, sizeof(record.reserved));
+    commit(record);
+}
+
+void CoapTraceRing::recordError(const uint8_t* datagram, size_t length, CoapError error, uint64_t endpointHash,
+                                uint8_t direction, uint64_t timestamp) {
+    CoapTraceRecord& record = nextRecord();
+    record.timestamp = timestamp;
+    record.endpoint_hash = endpointHash;
+    record.option_bitmap = 0;
+    std::memset(record.token, 0, sizeof(record.token));
+    record.payload_length = 0;
+    record.datagram_length = static_cast<uint32_t>(length);
+    record.message_id = 0;
+    record.type = 0;
+    record.code = 0;
+    record.token_length = 0;
+
+    if (datagram != nullptr && length >= 4) {
+        uint8_t tokenLength = datagram[0] & 0x0F;
+        record.type = (datagram[0] >> 4) & 0x03;
+        record.code = datagram[1];
+        record.message_id = static_cast<uint16_t>((datagram[2] << 8) | datagram[3]);
+        if (tokenLength <= 8 && length >= 4 + static_cast<size_t>(tokenLength)) {
+            uint64_t token = loadToken(datagram + 4, tokenLength);
+            record.token_length = tokenLength;
+            std::memcpy(record.token, &token, sizeof(token));
+        }
+    }
+
+    record.error = static_cast<uint8_t>(error);
+    record.direction = direction;
+    std::memset(record.reserved, 0, sizeof(record.reserved));
+    commit(record);
+}
+
+uint64_t CoapTraceRing::getWritten() const {
+    return written_.load(std::memory_order_acquire);
+}
+
+size_t CoapTraceRing::getCapacity() const {
+    return mask_ + 1;
+}
+
+CoapFlightRecorder::CoapFlightRecorder(size_t maxThreads, size_t recordsPerThread)
+    : rings_(maxThreads)
+    , storage_(maxThreads * roundUpPowerOfTwo(recordsPerThread > 0 ? recordsPerThread : 1))
+    , used_(0) {
+    size_t capacity = roundUpPowerOfTwo(recordsPerThread > 0 ? recordsPerThread : 1);
+    for (size_t i = 0; i < maxThreads; i++) {
+        rings_[i].records_ = storage_.data() + i * capacity;
+        rings_[i].mask_ = capacity - 1;
+    }
+}
+
+CoapTraceRing* CoapFlightRecorder::attach() {
+    // Prefer the lowest free ring so dump() only walks rings that were used
+    for (size_t i = 0; i < rings_.size(); i++) {
+        bool expected = false;
+        if (!rings_[i].claimed_.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            continue;
+        }
+        size_t used = used_.load(std::memory_order_relaxed);
+        while (used < i + 1 && !used_.compare_exchange_weak(used, i + 1, std::memory_order_release)) {
+        }
+        return &rings_[i];
+    }
+    return nullptr;
+}
+
+void CoapFlightRecorder::detach(CoapTraceRing* ring) {
+    if (ring != nullptr) {
+        ring->claimed_.store(false, std::memory_order_release);
+    }
+}
+
+CoapError CoapFlightRecorder::dump(int fd, uint64_t window) const {
+#if defined(__unix__) || defined(__APPLE__)
+    uint64_t dumpTime = now();
+    uint64_t cutoff = (window > 0 && window < dumpTime) ? dumpTime - window : 0;
+    size_t ringCount = used_.load(std::memory_order_acquire);
+    if (ringCount > rings_.size()) {
+        ringCount = rings_.size();
+    }
+
+    CoapTraceDumpHeader header;
+    std::memcpy(header.magic, TRACE_DUMP_MAGIC, sizeof(header.magic));
+    header.record_size = sizeof(CoapTraceRecord);
+    header.ring_count = static_cast<uint32_t>(ringCount);
+    header.dump_time = dumpTime;
+    header.window = window;
+    if (!writeFully(fd, &header, sizeof(header))) {
+        return CoapError::TRANSPORT_ERROR;
+    }
+
+    for (size_t i = 0; i < ringCount; i++) {
+        const CoapTraceRing& ring = rings_[i];
+        uint64_t written = ring.getWritten();
+        uint64_t capacity = ring.getCapacity();
+        uint64_t first = (written > capacity) ? written - capacity : 0;
+
+        // Records of a ring are in time order; skip those before the window
+        while (first < written && ring.records_[first & ring.mask_].timestamp < cutoff) {
+            first++;
+        }
+
+        CoapTraceRingHeader ringHeader;
+        ringHeader.ring = static_cast<uint32_t>(i);
+        ringHeader.record_count = static_cast<uint32_t>(written - first);
+        ringHeader.written = written;
+        if (!writeFully(fd, &ringHeader, sizeof(ringHeader))) {
+            return CoapError::TRANSPORT_ERROR;
+        }
+
+        // Records are checked one by one, so copy them through a stack buffer
+        CoapTraceRecord chunk[32];
+        while (first < written) {
+            size_t count = static_cast<size_t>(written - first);
+            if (count > sizeof(chunk) / sizeof(chunk[0])) {
+                count = sizeof(chunk) / sizeof(chunk[0]);
+            }
+            for (size_t j = 0; j < count; j++) {
+                copyRecord(ring.records_[(first + j) & ring.mask_], first + j, chunk[j]);
+            }
+            if (!writeFully(fd, chunk, count * sizeof(CoapTraceRecord))) {
+                return CoapError::TRANSPORT_ERROR;
+            }
+            first += count;
+        }
+    }
+    return CoapError::OK;
+#else
+    (void)fd;
+    (void)window;
+    return CoapError::INVALID_ARGUMENT;
+#endif
+}
+
+uint64_t CoapFlightRecorder::now() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+#endif
+}
+
+CoapMemoryUsage CoapFlightRecorder::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.addArray(rings_.size(), rings_.capacity(), sizeof(CoapTraceRing));
+    size_t held = 0;
+    size_t ringCount = used_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < ringCount && i < rings_.size(); i++) {
+        uint64_t written = rings_[i].getWritten();
+        held += static_cast<size_t>(written < rings_[i].getCapacity() ? written : rings_[i].getCapacity());
+    }
+    usage.addArray(held, storage_.capacity(), sizeof(CoapTraceRecord));
+    usage.entries = held;
+    return usage;
+}
+
+} // namespace CoapPacket
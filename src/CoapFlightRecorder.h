@@ -0,0 +1,179 @@
+#ifndef COAP_FLIGHT_RECORDER_H
+#define COAP_FLIGHT_RECORDER_H
+
+#include "CoapMemory.h"
+#include "CoapPacketView.h"
+#include "CoapError.h"
+#include <atomic>
+#include <vector>
+
+namespace CoapPacket {
+
+// CoapTraceRecord::direction
+constexpr uint8_t TRACE_DIRECTION_RX = 0;
+constexpr uint8_t TRACE_DIRECTION_TX = 1;
+
+// First bytes of a flight recorder dump
+constexpr char TRACE_DUMP_MAGIC[8] = {'C', 'O', 'A', 'P', 'F', 'L', 'T', '2'};
+
+// CoapTraceRecord::sequence of a record that is being written
+constexpr uint32_t TRACE_SEQUENCE_INVALID = 0xFFFFFFFF;
+
+/**
+ * Fixed-size metadata of one message
+ * option_bitmap has bit n set if option n (< 63) is present, bit 63 for
+ * any option number >= 63. sequence is the low 32 bits of the record's
+ * position in its ring. datagram_length is the size of the whole message
+ * (in the UDP encoding for recordMessage()); payload_length is the size of
+ * its payload only, 0 for recordError().
+ */
+struct CoapTraceRecord {
+    uint64_t timestamp;        // Nanoseconds since the Unix epoch
+    uint64_t endpoint_hash;    // e.g. CoapEndpoint::hash()
+    uint64_t option_bitmap;
+    uint8_t token[8];
+    uint32_t payload_length;
+    uint32_t datagram_length;
+    uint32_t sequence;
+    uint16_t message_id;
+    uint8_t type;
+    uint8_t code;
+    uint8_t token_length;
+    uint8_t error;             // CoapError, OK for valid messages
+    uint8_t direction;
+    uint8_t reserved[5];
+};
+
+static_assert(sizeof(CoapTraceRecord) == 56, "CoapTraceRecord is written to dumps as is");
+
+/**
+ * Dump layout: CoapTraceDumpHeader, then per ring a CoapTraceRingHeader
+ * followed by record_count records, oldest first
+ * A record overwritten while it was being dumped has sequence
+ * TRACE_SEQUENCE_INVALID or a sequence other than its position
+ * (written - record_count + index); readers must drop it.
+ */
+struct CoapTraceDumpHeader {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t ring_count;
+    uint64_t dump_time;
+    uint64_t window;
+};
+
+struct CoapTraceRingHeader {
+    uint32_t ring;
+    uint32_t record_count;
+    uint64_t written;          // Records written to the ring in total
+};
+
+/**
+ * Single-writer ring of trace records, owned by one thread
+ * Obtained from CoapFlightRecorder::attach() and returned with detach().
+ * Recording never blocks and never allocates; old records are overwritten.
+ */
+class CoapTraceRing {
+public:
+    CoapTraceRing();
+
+    /**
+     * Record a parsed message
+     * timestamp is typically taken once per receive batch with
+     * CoapFlightRecorder::now().
+     */
+    void recordMessage(const CoapPacketView& view, uint64_t endpointHash, uint8_t direction, uint64_t timestamp);
+
+    /**
+     * Record a datagram that failed to parse (or a message that failed to
+     * build); header fields are taken from the bytes that are present
+     */
+    void recordError(const uint8_t* datagram, size_t length, CoapError error, uint64_t endpointHash,
+                     uint8_t direction, uint64_t timestamp);
+
+    /**
+     * Get number of records written so far
+     */
+    uint64_t getWritten() const;
+
+    /**
+     * Get number of records kept
+     */
+    size_t getCapacity() const;
+
+private:
+    friend class CoapFlightRecorder;
+
+    std::atomic<uint64_t> written_;
+    CoapTraceRecord* records_;
+    size_t mask_;
+    std::atomic<bool> claimed_;
+    // Keep the write counters of different threads on separate cache lines
+    char padding_[64 - sizeof(std::atomic<uint64_t>) - sizeof(CoapTraceRecord*) - sizeof(size_t) -
+                  sizeof(std::atomic<bool>)];
+
+    CoapTraceRecord& nextRecord();
+    void commit(CoapTraceRecord& record);
+};
+
+/**
+ * Always-on recorder of message metadata
+ *
+ * Each thread attaches to its own CoapTraceRing, so recording is a few
+ * stores and one release store. A record's sequence is set to
+ * TRACE_SEQUENCE_INVALID before its fields and to its position after them.
+ * dump() writes the most recent records of all rings to a file
+ * descriptor; it only uses write() and atomic loads and can be called
+ * from a signal handler. Records written while a dump is running may
+ * overwrite the oldest records being dumped; dump() marks those it
+ * catches with TRACE_SEQUENCE_INVALID.
+ */
+class CoapFlightRecorder {
+public:
+    /**
+     * Allocate maxThreads rings of recordsPerThread records (rounded up to
+     * a power of two)
+     */
+    CoapFlightRecorder(size_t maxThreads, size_t recordsPerThread);
+
+    CoapFlightRecorder(const CoapFlightRecorder&) = delete;
+    CoapFlightRecorder& operator=(const CoapFlightRecorder&) = delete;
+
+    /**
+     * Claim a ring for the calling thread
+     * Returns nullptr if all rings are taken
+     */
+    CoapTraceRing* attach();
+
+    /**
+     * Return a ring when its thread exits
+     * Its records are kept and still dumped; the next attach() may hand
+     * the ring to another thread, which continues after them.
+     */
+    void detach(CoapTraceRing* ring);
+
+    /**
+     * Write records of the last window nanoseconds (0 for all) to fd
+     * Async-signal-safe.
+     */
+    CoapError dump(int fd, uint64_t window = 0) const;
+
+    /**
+     * Get current time in nanoseconds since the Unix epoch
+     */
+    static uint64_t now();
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts records held by rings attached at least once
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    std::vector<CoapTraceRing> rings_;
+    std::vector<CoapTraceRecord> storage_;
+    std::atomic<size_t> used_;     // Rings attached at least once
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_FLIGHT_RECORDER_H
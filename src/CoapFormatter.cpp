@@ -0,0 +1,526 @@
+#include "CoapFormatter.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+namespace {
+
+const char hexDigits[] = "0123456789abcdef";
+
+const char decimalPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+enum class OptionFormat : uint8_t {
+    EMPTY,
+    UINT,
+    STRING,
+    OPAQUE,
+    BLOCK
+};
+
+struct OptionInfo {
+    uint16_t number;
+    const char* name;
+    OptionFormat format;
+};
+
+// RFC 7252, 7641, 7959, 8613, 8768, 7967, 9175
+const OptionInfo optionInfos[] = {
+    {1, "If-Match", OptionFormat::OPAQUE},
+    {3, "Uri-Host", OptionFormat::STRING},
+    {4, "ETag", OptionFormat::OPAQUE},
+    {5, "If-None-Match", OptionFormat::EMPTY},
+    {6, "Observe", OptionFormat::UINT},
+    {7, "Uri-Port", OptionFormat::UINT},
+    {8, "Location-Path", OptionFormat::STRING},
+    {9, "OSCORE", OptionFormat::OPAQUE},
+    {11, "Uri-Path", OptionFormat::STRING},
+    {12, "Content-Format", OptionFormat::UINT},
+    {14, "Max-Age", OptionFormat::UINT},
+    {15, "Uri-Query", OptionFormat::STRING},
+    {16, "Hop-Limit", OptionFormat::UINT},
+    {17, "Accept", OptionFormat::UINT},
+    {20, "Location-Query", OptionFormat::STRING},
+    {23, "Block2", OptionFormat::BLOCK},
+    {27, "Block1", OptionFormat::BLOCK},
+    {28, "Size2", OptionFormat::UINT},
+    {35, "Proxy-Uri", OptionFormat::STRING},
+    {39, "Proxy-Scheme", OptionFormat::STRING},
+    {60, "Size1", OptionFormat::UINT},
+    {252, "Echo", OptionFormat::OPAQUE},
+    {258, "No-Response", OptionFormat::UINT},
+    {292, "Request-Tag", OptionFormat::OPAQUE}
+};
+
+const OptionInfo* findOptionInfo(uint16_t number) {
+    for (const OptionInfo& info : optionInfos) {
+        if (info.number == number) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Length of the well-formed UTF-8 sequence (RFC 3629) at data, 2 to 4
+ * Returns 0 if data does not start one (overlong forms, surrogates and
+ * code points above U+10FFFF are rejected).
+ */
+size_t utf8SequenceLength(const uint8_t* data, size_t size) {
+    uint8_t lead = data[0];
+    uint8_t low = 0x80;
+    uint8_t high = 0xBF;
+    size_t length = 0;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        low = (lead == 0xE0) ? 0xA0 : low;
+        high = (lead == 0xED) ? 0x9F : high;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        low = (lead == 0xF0) ? 0x90 : low;
+        high = (lead == 0xF4) ? 0x8F : high;
+    }
+    if (length == 0 || size < length || data[1] < low || data[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if ((data[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+/**
+ * Bounded output; one byte is kept for the terminator
+ */
+struct FormatSink {
+    char* buffer;
+    size_t capacity;
+    size_t limit;
+    size_t length;
+    bool overflow;
+
+    FormatSink(char* buf, size_t cap)
+        : buffer(buf), capacity(cap), limit(cap > 0 ? cap - 1 : 0), length(0), overflow(false) {}
+
+    void write(const char* data, size_t size) {
+        size_t room = limit - length;
+        if (size > room) {
+            size = room;
+            overflow = true;
+        }
+        if (size > 0) {
+            std::memcpy(buffer + length, data, size);
+            length += size;
+        }
+    }
+
+    void put(char c) {
+        if (length < limit) {
+            buffer[length++] = c;
+        } else {
+            overflow = true;
+        }
+    }
+
+    void puts(const char* text) {
+        write(text, std::strlen(text));
+    }
+
+    void putUint(uint64_t value) {
+        char digits[20];
+        write(digits, CoapFormatter::formatUint(value, digits, sizeof(digits)));
+    }
+
+    void putHex(const uint8_t* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            put(hexDigits[data[i] >> 4]);
+            put(hexDigits[data[i] & 0x0F]);
+        }
+    }
+
+    void putCode(uint8_t code) {
+        char text[4];
+        write(text, CoapFormatter::formatCode(code, text, sizeof(text)));
+    }
+
+    /**
+     * Quoted string; non-printable bytes become \xHH (text) or \u00HH (JSON)
+     * JSON keeps well-formed UTF-8 as is; only invalid bytes are escaped.
+     */
+    void putQuoted(const uint8_t* data, size_t size, bool json) {
+        put('"');
+        for (size_t i = 0; i < size; i++) {
+            uint8_t c = data[i];
+            size_t sequence = (json && c >= 0x80) ? utf8SequenceLength(data + i, size - i) : 0;
+            if (sequence > 0) {
+                write(reinterpret_cast<const char*>(data + i), sequence);
+                i += sequence - 1;
+            } else if (c == '"' || c == '\\') {
+                put('\\');
+                put(static_cast<char>(c));
+            } else if (c == '\n') {
+                puts("\\n");
+            } else if (c == '\r') {
+                puts("\\r");
+            } else if (c == '\t') {
+                puts("\\t");
+            } else if (c >= 0x20 && c < 0x7F) {
+                put(static_cast<char>(c));
+            } else {
+                puts(json ? "\\u00" : "\\x");
+                put(hexDigits[c >> 4]);
+                put(hexDigits[c & 0x0F]);
+            }
+        }
+        put('"');
+    }
+
+    CoapError finish(size_t& outLength) {
+        if (capacity > 0) {
+            buffer[length] = '\0';
+        }
+        outLength = length;
+        return overflow ? CoapError::BUFFER_TOO_SMALL : CoapError::OK;
+    }
+};
+
+bool isPrintableText(const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        uint8_t c = data[i];
+        if ((c < 0x20 || c >= 0x7F) && c != '\n' && c != '\r' && c != '\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+void formatOptionValue(FormatSink& sink, const OptionInfo* info, const uint8_t* value, size_t size, bool json) {
+    OptionFormat format = (info != nullptr) ? info->format : OptionFormat::OPAQUE;
+    if (size > 4 && (format == OptionFormat::UINT || format == OptionFormat::BLOCK)) {
+        format = OptionFormat::OPAQUE;
+    }
+
+    switch (format) {
+        case OptionFormat::UINT:
+            sink.putUint(decodeUintValue(value, size));
+            break;
+        case OptionFormat::BLOCK: {
+            uint32_t block = decodeUintValue(value, size);
+            if (json) {
+                sink.put('"');
+            }
+            sink.putUint(block >> 4);
+            sink.put('/');
+            sink.put((block & 0x08) ? '1' : '0');
+            sink.put('/');
+            sink.putUint(16u << (block & 0x07));
+            if (json) {
+                sink.put('"');
+            }
+            break;
+        }
+        case OptionFormat::STRING:
+            sink.putQuoted(value, size, json);
+            break;
+        case OptionFormat::EMPTY:
+            if (size == 0) {
+                sink.puts(json ? "true" : "-");
+                break;
+            }
+            // fall through
+        case OptionFormat::OPAQUE:
+            if (json) {
+                sink.put('"');
+                sink.putHex(value, size);
+                sink.put('"');
+            } else {
+                sink.puts("0x");
+                sink.putHex(value, size);
+            }
+            break;
+    }
+}
+
+void formatHeader(FormatSink& sink, uint8_t type, uint8_t code, uint16_t messageId,
+                  const uint8_t* token, size_t tokenLength, bool json) {
+    const char* typeName = CoapFormatter::getTypeName(static_cast<CoapType>(type));
+    const char* codeName = CoapFormatter::getCodeName(code);
+
+    if (json) {
+        sink.puts("{\"type\":\"");
+        sink.puts(typeName);
+        sink.puts("\",\"code\":\"");
+        sink.putCode(code);
+        sink.put('"');
+        if (codeName != nullptr) {
+            sink.puts(",\"name\":\"");
+            sink.puts(codeName);
+            sink.put('"');
+        }
+        sink.puts(",\"mid\":");
+        sink.putUint(messageId);
+        sink.puts(",\"token\":\"");
+        sink.putHex(token, tokenLength);
+        sink.puts("\",\"options\":[");
+    } else {
+        sink.puts(typeName);
+        sink.put(' ');
+        sink.putCode(code);
+        if (codeName != nullptr) {
+            sink.put(' ');
+            sink.puts(codeName);
+        }
+        sink.puts(" mid=");
+        sink.putUint(messageId);
+        if (tokenLength > 0) {
+            sink.puts(" token=");
+            sink.putHex(token, tokenLength);
+        }
+    }
+}
+
+void formatOption(FormatSink& sink, uint16_t number, const uint8_t* value, size_t size, bool first, bool json) {
+    const OptionInfo* info = findOptionInfo(number);
+    if (json) {
+        if (!first) {
+            sink.put(',');
+        }
+        sink.puts("{\"number\":");
+        sink.putUint(number);
+        if (info != nullptr) {
+            sink.puts(",\"name\":\"");
+            sink.puts(info->name);
+            sink.put('"');
+        }
+        sink.puts(",\"value\":");
+        formatOptionValue(sink, info, value, size, true);
+        sink.put('}');
+    } else {
+        sink.put(' ');
+        if (info != nullptr) {
+            sink.puts(info->name);
+        } else {
+            sink.puts("Option");
+            sink.putUint(number);
+        }
+        sink.put('=');
+        formatOptionValue(sink, info, value, size, false);
+    }
+}
+
+void formatPayload(FormatSink& sink, const uint8_t* payload, size_t size, size_t previewLength, bool json) {
+    size_t shown = (size < previewLength) ? size : previewLength;
+    bool text = isPrintableText(payload, shown);
+
+    if (json) {
+        sink.puts("],\"payload_length\":");
+        sink.putUint(size);
+        if (size > 0 && shown > 0) {
+            if (text) {
+                sink.puts(",\"payload\":");
+                sink.putQuoted(payload, shown, true);
+            } else {
+                sink.puts(",\"payload_hex\":\"");
+                sink.putHex(payload, shown);
+                sink.put('"');
+            }
+            if (shown < size) {
+                sink.puts(",\"payload_truncated\":true");
+            }
+        }
+        sink.put('}');
+    } else if (size > 0) {
+        sink.puts(" payload[");
+        sink.putUint(size);
+        sink.puts("]");
+        if (shown > 0) {
+            sink.put('=');
+            if (text) {
+                sink.putQuoted(payload, shown, false);
+            } else {
+                sink.puts("0x");
+                sink.putHex(payload, shown);
+            }
+            if (shown < size) {
+                sink.puts("...");
+            }
+        }
+    }
+}
+
+CoapError formatViewInto(const CoapPacketView& view, char* buffer, size_t capacity, size_t& length,
+                         size_t previewLength, bool json) {
+    if (buffer == nullptr && capacity > 0) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    FormatSink sink(buffer, capacity);
+    formatHeader(sink, static_cast<uint8_t>(view.type), static_cast<uint8_t>(view.code), view.message_id,
+                 view.token, view.token_length, json);
+
+    CoapOptionIterator it = view.getOptions();
+    CoapOptionRef option;
+    bool first = true;
+    while (it.next(option)) {
+        formatOption(sink, option.number, option.value, option.length, first, json);
+        first = false;
+    }
+    formatPayload(sink, view.payload, view.payload_length, previewLength, json);
+
+    CoapError err = sink.finish(length);
+    return (it.getError() != CoapError::OK) ? it.getError() : err;
+}
+
+CoapError formatPacketInto(const CoapPacket& packet, char* buffer, size_t capacity, size_t& length,
+                           size_t previewLength, bool json) {
+    if (buffer == nullptr && capacity > 0) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    FormatSink sink(buffer, capacity);
+    formatHeader(sink, static_cast<uint8_t>(packet.type), static_cast<uint8_t>(packet.code), packet.message_id,
+                 packet.token, packet.token_length, json);
+
+    bool first = true;
+    for (const CoapOption& option : packet.options) {
+        formatOption(sink, option.number, option.value.data(), option.value.size(), first, json);
+        first = false;
+    }
+    formatPayload(sink, packet.getPayloadPtr(), packet.getPayloadSize(), previewLength, json);
+
+    return sink.finish(length);
+}
+
+} // namespace
+
+CoapError CoapFormatter::formatText(const CoapPacketView& view, char* buffer, size_t capacity, size_t& length,
+                                    size_t previewLength) {
+    return formatViewInto(view, buffer, capacity, length, previewLength, false);
+}
+
+CoapError CoapFormatter::formatText(const CoapPacket& packet, char* buffer, size_t capacity, size_t& length,
+                                    size_t previewLength) {
+    return formatPacketInto(packet, buffer, capacity, length, previewLength, false);
+}
+
+CoapError CoapFormatter::formatJson(const CoapPacketView& view, char* buffer, size_t capacity, size_t& length,
+                                    size_t previewLength) {
+    return formatViewInto(view, buffer, capacity, length, previewLength, true);
+}
+
+CoapError CoapFormatter::formatJson(const CoapPacket& packet, char* buffer, size_t capacity, size_t& length,
+                                    size_t previewLength) {
+    return formatPacketInto(packet, buffer, capacity, length, previewLength, true);
+}
+
+const char* CoapFormatter::getTypeName(CoapType type) {
+    switch (type) {
+        case CoapType::CON: return "CON";
+        case CoapType::NON: return "NON";
+        case CoapType::ACK: return "ACK";
+        case CoapType::RST: return "RST";
+    }
+    return "???";
+}
+
+const char* CoapFormatter::getCodeName(uint8_t code) {
+    switch (code) {
+        case 0: return "Empty";
+        case 1: return "GET";
+        case 2: return "POST";
+        case 3: return "PUT";
+        case 4: return "DELETE";
+        case 5: return "FETCH";
+        case 6: return "PATCH";
+        case 7: return "iPATCH";
+        case (2 << 5) | 1: return "Created";
+        case (2 << 5) | 2: return "Deleted";
+        case (2 << 5) | 3: return "Valid";
+        case (2 << 5) | 4: return "Changed";
+        case (2 << 5) | 5: return "Content";
+        case (2 << 5) | 31: return "Continue";
+        case (4 << 5) | 0: return "Bad Request";
+        case (4 << 5) | 1: return "Unauthorized";
+        case (4 << 5) | 2: return "Bad Option";
+        case (4 << 5) | 3: return "Forbidden";
+        case (4 << 5) | 4: return "Not Found";
+        case (4 << 5) | 5: return "Method Not Allowed";
+        case (4 << 5) | 6: return "Not Acceptable";
+        case (4 << 5) | 8: return "Request Entity Incomplete";
+        case (4 << 5) | 9: return "Conflict";
+        case (4 << 5) | 12: return "Precondition Failed";
+        case (4 << 5) | 13: return "Request Entity Too Large";
+        case (4 << 5) | 15: return "Unsupported Content-Format";
+        case (4 << 5) | 22: return "Unprocessable Entity";
+        case (4 << 5) | 29: return "Too Many Requests";
+        case (5 << 5) | 0: return "Internal Server Error";
+        case (5 << 5) | 1: return "Not Implemented";
+        case (5 << 5) | 2: return "Bad Gateway";
+        case (5 << 5) | 3: return "Service Unavailable";
+        case (5 << 5) | 4: return "Gateway Timeout";
+        case (5 << 5) | 5: return "Proxying Not Supported";
+        case (5 << 5) | 8: return "Hop Limit Reached";
+        case (7 << 5) | 1: return "CSM";
+        case (7 << 5) | 2: return "Ping";
+        case (7 << 5) | 3: return "Pong";
+        case (7 << 5) | 4: return "Release";
+        case (7 << 5) | 5: return "Abort";
+        default: return nullptr;
+    }
+}
+
+const char* CoapFormatter::getOptionName(uint16_t number) {
+    const OptionInfo* info = findOptionInfo(number);
+    return (info != nullptr) ? info->name : nullptr;
+}
+
+size_t CoapFormatter::formatUint(uint64_t value, char* buffer, size_t capacity) {
+    // Two digits per step, written backwards
+    char digits[20];
+    size_t pos = sizeof(digits);
+    while (value >= 100) {
+        size_t pair = static_cast<size_t>(value % 100) * 2;
+        value /= 100;
+        digits[--pos] = decimalPairs[pair + 1];
+        digits[--pos] = decimalPairs[pair];
+    }
+    if (value >= 10) {
+        size_t pair = static_cast<size_t>(value) * 2;
+        digits[--pos] = decimalPairs[pair + 1];
+        digits[--pos] = decimalPairs[pair];
+    } else {
+        digits[--pos] = static_cast<char>('0' + value);
+    }
+
+    size_t count = sizeof(digits) - pos;
+    if (count > capacity) {
+        return 0;
+    }
+    std::memcpy(buffer, digits + pos, count);
+    return count;
+}
+
+size_t CoapFormatter::formatCode(uint8_t code, char* buffer, size_t capacity) {
+    if (capacity < 4) {
+        return 0;
+    }
+    uint8_t detail = code & 0x1F;
+    buffer[0] = static_cast<char>('0' + (code >> 5));
+    buffer[1] = '.';
+    buffer[2] = decimalPairs[detail * 2];
+    buffer[3] = decimalPairs[detail * 2 + 1];
+    return 4;
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,72 @@
+#ifndef COAP_FORMATTER_H
+#define COAP_FORMATTER_H
+
+#include "CoapPacket.h"
+#include "CoapPacketView.h"
+#include "CoapError.h"
+
+namespace CoapPacket {
+
+// Default number of payload bytes shown by the formatter
+constexpr size_t FORMAT_PAYLOAD_PREVIEW = 32;
+
+/**
+ * Log formatting of CoAP messages into caller buffers
+ *
+ * Text:  CON 0.01 GET mid=4660 token=a1b2 Uri-Path="sensors" Accept=50 payload[5]="hello"
+ * JSON:  {"type":"CON","code":"0.01","name":"GET","mid":4660,"token":"a1b2",
+ *         "options":[{"number":11,"name":"Uri-Path","value":"sensors"}],
+ *         "payload_length":5,"payload":"hello"}
+ *
+ * Uint options are printed as numbers (Block1/Block2 as NUM/M/SIZE),
+ * string options as quoted text (UTF-8 passes through in JSON) and opaque
+ * or unknown options as hex.
+ * Payloads are previewed as text when printable, otherwise as hex
+ * ("payload_hex" in JSON), cut at previewLength bytes.
+ *
+ * Nothing is allocated. The output is always NUL-terminated when capacity
+ * is non-zero; if it does not fit it is truncated and BUFFER_TOO_SMALL is
+ * returned. length excludes the terminator.
+ */
+class CoapFormatter {
+public:
+    static CoapError formatText(const CoapPacketView& view, char* buffer, size_t capacity, size_t& length,
+                                size_t previewLength = FORMAT_PAYLOAD_PREVIEW);
+    static CoapError formatText(const CoapPacket& packet, char* buffer, size_t capacity, size_t& length,
+                                size_t previewLength = FORMAT_PAYLOAD_PREVIEW);
+
+    static CoapError formatJson(const CoapPacketView& view, char* buffer, size_t capacity, size_t& length,
+                                size_t previewLength = FORMAT_PAYLOAD_PREVIEW);
+    static CoapError formatJson(const CoapPacket& packet, char* buffer, size_t capacity, size_t& length,
+                                size_t previewLength = FORMAT_PAYLOAD_PREVIEW);
+
+    /**
+     * Get name of a message type ("CON", "NON", "ACK", "RST")
+     */
+    static const char* getTypeName(CoapType type);
+
+    /**
+     * Get name of a code ("GET", "Content", ...), or nullptr if unassigned
+     */
+    static const char* getCodeName(uint8_t code);
+
+    /**
+     * Get name of an option ("Uri-Path", ...), or nullptr if unknown
+     */
+    static const char* getOptionName(uint16_t number);
+
+    /**
+     * Write an unsigned integer in decimal (no terminator)
+     * Returns the number of characters, or 0 if capacity is too small
+     */
+    static size_t formatUint(uint64_t value, char* buffer, size_t capacity);
+
+    /**
+     * Write a code as "c.dd" (no terminator); capacity must be at least 4
+     */
+    static size_t formatCode(uint8_t code, char* buffer, size_t capacity);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_FORMATTER_H
@@ -0,0 +1,253 @@
+#include "CoapHash.h"
+#include "CoapOptions.h"
+#include "CoapToken.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+namespace {
+
+// wyhash constants
+const uint64_t HASH_P0 = 0xA0761D6478BD642Full;
+const uint64_t HASH_P1 = 0xE7037ED1A0B428DBull;
+const uint64_t HASH_P2 = 0x8EBC6AF09C88C6E3ull;
+const uint64_t HASH_P3 = 0x589965CC75374CC3ull;
+
+// Marks the payload in the header word stream; option numbers stay below
+const uint64_t HASH_PAYLOAD_TAG = 0x10000ull;
+
+#if defined(__SIZEOF_INT128__)
+// __extension__ keeps -Wpedantic builds quiet about the non-ISO type
+__extension__ typedef unsigned __int128 HashUint128;
+#endif
+
+// 64x64 -> 128 bit multiply, folded to 64 bits
+uint64_t hashMix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    HashUint128 r = static_cast<HashUint128>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#else
+    uint64_t ha = a >> 32, la = a & 0xFFFFFFFFu;
+    uint64_t hb = b >> 32, lb = b & 0xFFFFFFFFu;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    return lo ^ hi;
+#endif
+}
+
+uint64_t hashRead8(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+uint64_t hashRead4(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+// Absorb a byte string (wyhash body: at most two reads below 17 bytes)
+uint64_t hashAbsorb(uint64_t h, const uint8_t* p, size_t length) {
+    uint64_t a;
+    uint64_t b;
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t step = (length >> 3) << 2;
+            a = (hashRead4(p) << 32) | hashRead4(p + step);
+            b = (hashRead4(p + length - 4) << 32) | hashRead4(p + length - 4 - step);
+        } else if (length > 0) {
+            a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t left = length;
+        while (left > 16) {
+            h = hashMix(hashRead8(p) ^ HASH_P1, hashRead8(p + 8) ^ h);
+            p += 16;
+            left -= 16;
+        }
+        a = hashRead8(p + left - 16);
+        b = hashRead8(p + left - 8);
+    }
+    return hashMix(a ^ HASH_P1, b ^ h);
+}
+
+// Absorb one option or the payload: a tagged length word, then the bytes
+// The word enters through an odd multiply (a bijection of the state), so
+// only one 128-bit mix is spent per short field.
+uint64_t hashField(uint64_t h, uint64_t tag, const uint8_t* data, size_t length) {
+    h = (h ^ (tag << 32) ^ length) * HASH_P3;
+    return (length > 0) ? hashAbsorb(h, data, length) : h;
+}
+
+uint64_t hashHeader(uint8_t type, uint8_t code, uint16_t messageId, uint8_t tokenLength, uint64_t token,
+                    uint32_t exclude, uint64_t seed) {
+    uint64_t word = 0;
+    if ((exclude & COAP_FIELD_TYPE) == 0) {
+        word |= type;
+    }
+    if ((exclude & COAP_FIELD_CODE) == 0) {
+        word |= static_cast<uint64_t>(code) << 8;
+    }
+    if ((exclude & COAP_FIELD_MESSAGE_ID) == 0) {
+        word |= static_cast<uint64_t>(messageId) << 16;
+    }
+    if ((exclude & COAP_FIELD_TOKEN) == 0) {
+        word |= static_cast<uint64_t>(tokenLength) << 32;
+    } else {
+        token = 0;
+    }
+    return hashMix(word ^ HASH_P1, token ^ seed ^ HASH_P0);
+}
+
+bool isHashedOption(uint16_t number, uint32_t exclude) {
+    if ((exclude & COAP_FIELD_OPTIONS) != 0) {
+        return false;
+    }
+    return (exclude & COAP_FIELD_NO_CACHE_KEY) == 0 || !isNoCacheKeyOption(number);
+}
+
+uint64_t hashFinish(uint64_t h, uint64_t count) {
+    return hashMix(h ^ HASH_P0, count ^ HASH_P1);
+}
+
+} // namespace
+
+CoapError CoapHash::hash(const uint8_t* buffer, size_t length, uint64_t& result,
+                         uint32_t exclude, uint64_t seed) {
+    size_t offset = 0;
+    CoapError err = CoapOptionIterator::locateOptions(buffer, length, offset);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    uint8_t tokenLength = buffer[0] & 0x0F;
+    uint64_t h = hashHeader((buffer[0] >> 4) & 0x03, buffer[1],
+                            static_cast<uint16_t>((buffer[2] << 8) | buffer[3]),
+                            tokenLength, loadToken(buffer + 4, tokenLength), exclude, seed);
+
+    // Same checks as CoapOptionIterator, with the decoding kept in
+    // registers: the walk is most of the cost for typical requests
+    uint64_t count = 0;
+    uint32_t number = 0;
+    while (offset < length) {
+        uint8_t byte = buffer[offset++];
+        if (byte == PAYLOAD_MARKER) {
+            if (offset >= length) {
+                return CoapError::INVALID_FORMAT;
+            }
+            if ((exclude & COAP_FIELD_PAYLOAD) == 0) {
+                h = hashField(h, HASH_PAYLOAD_TAG, buffer + offset, length - offset);
+                count++;
+            }
+            break;
+        }
+
+        uint32_t fields[2] = {static_cast<uint32_t>(byte >> 4), static_cast<uint32_t>(byte & 0x0F)};
+        for (int f = 0; f < 2; f++) {
+            if (fields[f] == 13) {
+                if (offset >= length) {
+                    return CoapError::DATAGRAM_TOO_SHORT;
+                }
+                fields[f] = buffer[offset++] + 13u;
+            } else if (fields[f] == 14) {
+                if (offset + 1 >= length) {
+                    return CoapError::DATAGRAM_TOO_SHORT;
+                }
+                fields[f] = ((static_cast<uint32_t>(buffer[offset]) << 8) | buffer[offset + 1]) + 269u;
+                offset += 2;
+            } else if (fields[f] == 15) {
+                return CoapError::INVALID_FORMAT;
+            }
+        }
+
+        // Extended values are 16-bit in the encoding (CoapOptionIterator)
+        number += fields[0] & 0xFFFF;
+        uint32_t valueLength = fields[1] & 0xFFFF;
+        if (number > 0xFFFF) {
+            return CoapError::INVALID_FORMAT;
+        }
+        if (offset + valueLength > length) {
+            return CoapError::DATAGRAM_TOO_SHORT;
+        }
+        if (valueLength > MAX_OPTION_VALUE_SIZE) {
+            return CoapError::OPTION_TOO_LONG;
+        }
+        if (isHashedOption(static_cast<uint16_t>(number), exclude)) {
+            h = hashField(h, number, buffer + offset, valueLength);
+            count++;
+        }
+        offset += valueLength;
+    }
+
+    result = hashFinish(h, count);
+    return CoapError::OK;
+}
+
+uint64_t CoapHash::hash(const CoapPacket& packet, uint32_t exclude, uint64_t seed) {
+    uint8_t tokenLength = packet.token_length <= 8 ? packet.token_length : 8;
+    uint64_t h = hashHeader(static_cast<uint8_t>(packet.type), static_cast<uint8_t>(packet.code),
+                            packet.message_id, tokenLength, loadToken(packet.token, tokenLength),
+                            exclude, seed);
+
+    // Options are hashed in wire order: by number, keeping the order of
+    // repeated options. Packets from the parser or builder already are.
+    const std::vector<CoapOption>& options = packet.options;
+    bool sorted = true;
+    for (size_t i = 1; i < options.size() && sorted; i++) {
+        sorted = options[i - 1].number <= options[i].number;
+    }
+
+    uint64_t count = 0;
+    if (sorted) {
+        for (const CoapOption& option : options) {
+            if (isHashedOption(option.number, exclude)) {
+                h = hashField(h, option.number, option.value.data(), option.value.size());
+                count++;
+            }
+        }
+    } else {
+        // Selection by (number, position) without allocating
+        size_t last = options.size();
+        for (size_t n = 0; n < options.size(); n++) {
+            size_t next = options.size();
+            for (size_t i = 0; i < options.size(); i++) {
+                bool after = (last == options.size()) ||
+                             options[i].number > options[last].number ||
+                             (options[i].number == options[last].number && i > last);
+                if (after && (next == options.size() || options[i].number < options[next].number)) {
+                    next = i;
+                }
+            }
+            last = next;
+            const CoapOption& option = options[next];
+            if (isHashedOption(option.number, exclude)) {
+                h = hashField(h, option.number, option.value.data(), option.value.size());
+                count++;
+            }
+        }
+    }
+
+    size_t payloadSize = packet.getPayloadSize();
+    if (payloadSize > 0 && (exclude & COAP_FIELD_PAYLOAD) == 0) {
+        h = hashField(h, HASH_PAYLOAD_TAG, packet.getPayloadPtr(), payloadSize);
+        count++;
+    }
+
+    return hashFinish(h, count);
+}
+
+uint64_t CoapHash::hashBytes(const uint8_t* data, size_t length, uint64_t seed) {
+    uint64_t h = hashField(seed ^ HASH_P0, 0, data, length);
+    return hashFinish(h, length);
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,46 @@
+#ifndef COAP_HASH_H
+#define COAP_HASH_H
+
+#include "CoapPacket.h"
+#include "CoapError.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+/**
+ * 64-bit message hashing for cache keys, deduplication and coalescing
+ *
+ * A message hashes to the same value whether it is given encoded or as a
+ * CoapPacket: the hash covers type, code, message ID, token, options
+ * (number and value, in option number order) and payload, minus the
+ * fields selected by an exclude mask of COAP_FIELD_* flags. Use
+ * COAP_FIELDS_NOT_CACHE_KEY to hash a request cache key.
+ *
+ * The mixing function is wyhash-style (64x64->128 multiply and fold).
+ * Hashes are not cryptographic and depend on host byte order; pass a
+ * random seed where peers can choose the hashed messages.
+ */
+class CoapHash {
+public:
+    /**
+     * Hash an encoded message
+     * Returns an error if the header or options are malformed.
+     */
+    static CoapError hash(const uint8_t* buffer, size_t length, uint64_t& result,
+                          uint32_t exclude = 0, uint64_t seed = 0);
+
+    /**
+     * Hash a packet; equals the hash of its encoding
+     */
+    static uint64_t hash(const CoapPacket& packet, uint32_t exclude = 0, uint64_t seed = 0);
+
+    /**
+     * Hash a byte string
+     */
+    static uint64_t hashBytes(const uint8_t* data, size_t length, uint64_t seed = 0);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_HASH_H
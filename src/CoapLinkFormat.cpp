@@ -0,0 +1,183 @@
+#include "CoapLinkFormat.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+namespace {
+
+bool isLinkSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ * Find end of a parameter list: the next ',' outside quotes
+ * Returns false on an unterminated quoted string.
+ */
+bool findLinkEnd(const char* data, size_t length, size_t pos, size_t& end) {
+    bool quoted = false;
+    for (; pos < length; pos++) {
+        char c = data[pos];
+        if (quoted) {
+            if (c == '\\' && pos + 1 < length) {
+                pos++;
+            } else if (c == '"') {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            break;
+        }
+    }
+    end = pos;
+    return !quoted;
+}
+
+} // namespace
+
+CoapLinkParser::CoapLinkParser(const char* data, size_t length)
+    : data_(data), length_(data != nullptr ? length : 0), pos_(0), error_(CoapError::OK) {}
+
+bool CoapLinkParser::next(CoapLink& link) {
+    if (error_ != CoapError::OK) {
+        return false;
+    }
+    while (pos_ < length_ && isLinkSpace(data_[pos_])) {
+        pos_++;
+    }
+    if (pos_ >= length_) {
+        return false;
+    }
+
+    if (data_[pos_] != '<') {
+        error_ = CoapError::INVALID_FORMAT;
+        return false;
+    }
+    const char* close = static_cast<const char*>(std::memchr(data_ + pos_ + 1, '>', length_ - pos_ - 1));
+    if (close == nullptr) {
+        error_ = CoapError::INVALID_FORMAT;
+        return false;
+    }
+    link.target = data_ + pos_ + 1;
+    link.target_length = static_cast<size_t>(close - link.target);
+
+    size_t paramsStart = static_cast<size_t>(close - data_) + 1;
+    size_t end;
+    if (!findLinkEnd(data_, length_, paramsStart, end)) {
+        error_ = CoapError::INVALID_FORMAT;
+        return false;
+    }
+    size_t paramsEnd = end;
+    while (paramsEnd > paramsStart && isLinkSpace(data_[paramsEnd - 1])) {
+        paramsEnd--;
+    }
+    link.params = data_ + paramsStart;
+    link.params_length = paramsEnd - paramsStart;
+
+    pos_ = (end < length_) ? end + 1 : end;
+    return true;
+}
+
+CoapError CoapLinkParser::getError() const {
+    return error_;
+}
+
+CoapLinkParamIterator::CoapLinkParamIterator(const CoapLink& link)
+    : data_(link.params), length_(link.params != nullptr ? link.params_length : 0), pos_(0),
+      error_(CoapError::OK) {}
+
+bool CoapLinkParamIterator::next(CoapLinkParam& param) {
+    if (error_ != CoapError::OK) {
+        return false;
+    }
+    while (pos_ < length_ && isLinkSpace(data_[pos_])) {
+        pos_++;
+    }
+    if (pos_ >= length_) {
+        return false;
+    }
+    if (data_[pos_] != ';') {
+        error_ = CoapError::INVALID_FORMAT;
+        return false;
+    }
+    pos_++;
+    while (pos_ < length_ && isLinkSpace(data_[pos_])) {
+        pos_++;
+    }
+
+    size_t nameStart = pos_;
+    while (pos_ < length_ && data_[pos_] != '=' && data_[pos_] != ';' && !isLinkSpace(data_[pos_])) {
+        pos_++;
+    }
+    if (pos_ == nameStart) {
+        error_ = CoapError::INVALID_FORMAT;
+        return false;
+    }
+    param.name = data_ + nameStart;
+    param.name_length = pos_ - nameStart;
+    param.value = nullptr;
+    param.value_length = 0;
+    param.quoted = false;
+
+    if (pos_ >= length_ || data_[pos_] != '=') {
+        return true;
+    }
+    pos_++;
+
+    if (pos_ < length_ && data_[pos_] == '"') {
+        size_t valueStart = ++pos_;
+        while (pos_ < length_ && data_[pos_] != '"') {
+            pos_ += (data_[pos_] == '\\' && pos_ + 1 < length_) ? 2 : 1;
+        }
+        if (pos_ >= length_) {
+            error_ = CoapError::INVALID_FORMAT;
+            return false;
+        }
+        param.value = data_ + valueStart;
+        param.value_length = pos_ - valueStart;
+        param.quoted = true;
+        pos_++;
+    } else {
+        size_t valueStart = pos_;
+        while (pos_ < length_ && data_[pos_] != ';' && !isLinkSpace(data_[pos_])) {
+            pos_++;
+        }
+        param.value = data_ + valueStart;
+        param.value_length = pos_ - valueStart;
+    }
+    return true;
+}
+
+CoapError CoapLinkParamIterator::getError() const {
+    return error_;
+}
+
+bool findLinkParam(const CoapLink& link, const char* name, CoapLinkParam& param) {
+    size_t nameLength = std::strlen(name);
+    CoapLinkParamIterator it(link);
+    while (it.next(param)) {
+        if (param.name_length == nameLength && std::memcmp(param.name, name, nameLength) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool containsLinkToken(const char* value, size_t valueLength, const char* token, size_t tokenLength) {
+    size_t pos = 0;
+    while (pos < valueLength) {
+        while (pos < valueLength && value[pos] == ' ') {
+            pos++;
+        }
+        size_t start = pos;
+        while (pos < valueLength && value[pos] != ' ') {
+            pos++;
+        }
+        if (pos - start == tokenLength && tokenLength > 0 && std::memcmp(value + start, token, tokenLength) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,98 @@
+#ifndef COAP_LINK_FORMAT_H
+#define COAP_LINK_FORMAT_H
+
+#include "CoapError.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+/**
+ * One link of a CoRE link-format document (RFC 6690)
+ * Points into the parsed document.
+ */
+struct CoapLink {
+    const char* target;         // URI-reference between '<' and '>'
+    size_t target_length;
+    const char* params;         // Link parameters after '>' (";rt=...;if=...")
+    size_t params_length;
+
+    CoapLink() : target(nullptr), target_length(0), params(nullptr), params_length(0) {}
+};
+
+/**
+ * One link parameter
+ * value is nullptr for parameters without a value; quoted values are
+ * returned without the quotes (escapes are kept).
+ */
+struct CoapLinkParam {
+    const char* name;
+    size_t name_length;
+    const char* value;
+    size_t value_length;
+    bool quoted;
+
+    CoapLinkParam() : name(nullptr), name_length(0), value(nullptr), value_length(0), quoted(false) {}
+};
+
+/**
+ * Zero-copy parser of application/link-format documents
+ *
+ * Usage:
+ *   CoapLinkParser parser(payload, length);
+ *   CoapLink link;
+ *   while (parser.next(link)) { ... }
+ *   if (parser.getError() != CoapError::OK) { ... }
+ */
+class CoapLinkParser {
+public:
+    CoapLinkParser(const char* data, size_t length);
+
+    /**
+     * Get next link; returns false at the end or on error
+     */
+    bool next(CoapLink& link);
+
+    /**
+     * Get error that stopped parsing (OK at the end of the document)
+     */
+    CoapError getError() const;
+
+private:
+    const char* data_;
+    size_t length_;
+    size_t pos_;
+    CoapError error_;
+};
+
+/**
+ * Iterator over the parameters of a link
+ */
+class CoapLinkParamIterator {
+public:
+    explicit CoapLinkParamIterator(const CoapLink& link);
+
+    bool next(CoapLinkParam& param);
+
+    CoapError getError() const;
+
+private:
+    const char* data_;
+    size_t length_;
+    size_t pos_;
+    CoapError error_;
+};
+
+/**
+ * Find the first parameter with the given name
+ */
+bool findLinkParam(const CoapLink& link, const char* name, CoapLinkParam& param);
+
+/**
+ * Check whether a space-separated value (e.g. rt="a b") contains token
+ */
+bool containsLinkToken(const char* value, size_t valueLength, const char* token, size_t tokenLength);
+
+} // namespace CoapPacket
+
+#endif // COAP_LINK_FORMAT_H
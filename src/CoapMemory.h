@@ -0,0 +1,84 @@
+#ifndef COAP_MEMORY_H
+#define COAP_MEMORY_H
+
+#include <cstddef>
+#include <string>
+
+namespace CoapPacket {
+
+/**
+ * Memory footprint of an object, as reported by memoryUsage()
+ *
+ * used counts bytes holding live data (including the object itself),
+ * reserved adds capacity slack: vector capacity beyond size, free table
+ * slots, partly filled arena blocks. Node-based hash tables are estimated
+ * from the standard library layout (bucket array plus one node per
+ * element); allocator headers are not counted. Memory the caller owns
+ * (external payloads, DTLS engines, stored pointers) is excluded.
+ */
+struct CoapMemoryUsage {
+    size_t used;
+    size_t reserved;
+    size_t entries;         // Live entities: options, sessions, timers, ...
+
+    CoapMemoryUsage() : used(0), reserved(0), entries(0) {}
+
+    /**
+     * Get bytes allocated but not holding live data
+     */
+    size_t getSlack() const { return reserved - used; }
+
+    /**
+     * Add an inline block (e.g. sizeof(*this))
+     */
+    void addObject(size_t bytes) {
+        used += bytes;
+        reserved += bytes;
+    }
+
+    /**
+     * Add a contiguous array of count live elements out of capacity
+     */
+    void addArray(size_t count, size_t capacity, size_t elementSize) {
+        used += count * elementSize;
+        reserved += capacity * elementSize;
+    }
+
+    /**
+     * Add a node-based hash table (std::unordered_map/set) of count
+     * elements of elementSize bytes
+     */
+    void addHashTable(size_t count, size_t buckets, size_t elementSize) {
+        // Node: next pointer and cached hash around the element
+        size_t nodes = count * (elementSize + 2 * sizeof(void*));
+        used += nodes;
+        reserved += nodes + buckets * sizeof(void*);
+    }
+
+    /**
+     * Add the heap buffer of a string, if it has one (short strings are
+     * stored inside the object)
+     */
+    void addString(const std::string& value) {
+        const char* data = value.data();
+        const char* object = reinterpret_cast<const char*>(&value);
+        if (data < object || data >= object + sizeof(value)) {
+            used += value.size() + 1;
+            reserved += value.capacity() + 1;
+        }
+    }
+
+    /**
+     * Add the usage of another object, leaving its entries out
+     * inlineBytes is the size of the object when it is a member already
+     * counted by its owner's addObject(sizeof(*this)).
+     */
+    void add(const CoapMemoryUsage& other, size_t inlineBytes = 0) {
+        used += other.used - inlineBytes;
+        reserved += other.reserved - inlineBytes;
+    }
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_MEMORY_H
@@ -0,0 +1,735 @@
+#include "CoapOpenSsl.h"
+
+#include <cstring>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#if defined(__linux__)
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace CoapPacket {
+
+namespace {
+
+// TLS 1.3 cipher suites the kernel can take over (RFC 8446 appendix B.4)
+const uint16_t OPENSSL_TLS_AES_128_GCM_SHA256 = 0x1301;
+const uint16_t OPENSSL_TLS_AES_256_GCM_SHA384 = 0x1302;
+
+// Handshake message types (RFC 8446 section 4)
+const uint8_t OPENSSL_HANDSHAKE_FINISHED = 20;
+const uint8_t OPENSSL_HANDSHAKE_KEY_UPDATE = 24;
+
+#if defined(__linux__)
+// <sys/socket.h> and <netinet/tcp.h>; defined here so older headers still build
+const int OPENSSL_SOL_TLS = 282;
+const int OPENSSL_TCP_ULP = 31;
+#endif
+
+int engineIndex() {
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+int datagramEngineIndex() {
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+int contextIndex() {
+    static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+void keyLogCallback(const SSL* ssl, const char* line) {
+    CoapOpenSslTlsEngine* engine = static_cast<CoapOpenSslTlsEngine*>(SSL_get_ex_data(ssl, engineIndex()));
+    if (engine != nullptr) {
+        engine->onKeyLog(line);
+    }
+}
+
+void messageCallback(int writing, int, int contentType, const void* data, size_t length, SSL*, void* arg) {
+    static_cast<CoapOpenSslTlsEngine*>(arg)->onRecord(writing, contentType, data, length);
+}
+
+int generateCookie(SSL* ssl, unsigned char* cookie, unsigned int* length) {
+    const CoapOpenSslContext* context =
+        static_cast<const CoapOpenSslContext*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), contextIndex()));
+    const CoapOpenSslDtlsEngine* engine =
+        static_cast<const CoapOpenSslDtlsEngine*>(SSL_get_ex_data(ssl, datagramEngineIndex()));
+    return context != nullptr && engine != nullptr && context->makeCookie(engine->getEndpoint(), cookie, *length);
+}
+
+int verifyCookie(SSL* ssl, const unsigned char* cookie, unsigned int length) {
+    uint8_t expected[EVP_MAX_MD_SIZE];
+    unsigned int expectedLength = 0;
+    return generateCookie(ssl, expected, &expectedLength) == 1 && length == expectedLength &&
+           CRYPTO_memcmp(cookie, expected, length) == 0;
+}
+
+int datagramWrite(BIO* bio, const char* data, int length) {
+    return static_cast<CoapOpenSslDtlsEngine*>(BIO_get_data(bio))->onWrite(data, length);
+}
+
+int datagramRead(BIO* bio, char* data, int length) {
+    BIO_clear_retry_flags(bio);
+    int received = static_cast<CoapOpenSslDtlsEngine*>(BIO_get_data(bio))->onRead(data, length);
+    if (received < 0) {
+        BIO_set_retry_read(bio);
+    }
+    return received;
+}
+
+long datagramControl(BIO*, int command, long, void*) {
+    switch (command) {
+        case BIO_CTRL_FLUSH:
+            return 1;
+        case BIO_CTRL_DGRAM_QUERY_MTU:
+        case BIO_CTRL_DGRAM_GET_FALLBACK_MTU:
+            return static_cast<long>(OPENSSL_DTLS_MTU);
+        default:
+            return 0;
+    }
+}
+
+int datagramCreate(BIO* bio) {
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+BIO_METHOD* createDatagramMethod() {
+    BIO_METHOD* method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "CoAP datagram");
+    if (method != nullptr) {
+        BIO_meth_set_write(method, datagramWrite);
+        BIO_meth_set_read(method, datagramRead);
+        BIO_meth_set_ctrl(method, datagramControl);
+        BIO_meth_set_create(method, datagramCreate);
+    }
+    return method;
+}
+
+/**
+ * BIO that hands OpenSSL the datagram being decrypted and sends or
+ * captures the records it writes
+ */
+BIO_METHOD* datagramMethod() {
+    static BIO_METHOD* const method = createDatagramMethod();
+    return method;
+}
+
+/**
+ * Parse the secret of a key log line "<LABEL> <client random> <secret>"
+ */
+size_t parseKeyLogSecret(const char* line, uint8_t* secret, size_t capacity) {
+    const char* hex = std::strrchr(line, ' ');
+    if (hex == nullptr) {
+        return 0;
+    }
+    hex++;
+    size_t length = std::strlen(hex) / 2;
+    if (length > capacity) {
+        return 0;
+    }
+    for (size_t i = 0; i < length; i++) {
+        int high = OPENSSL_hexchar2int(static_cast<unsigned char>(hex[2 * i]));
+        int low = OPENSSL_hexchar2int(static_cast<unsigned char>(hex[2 * i + 1]));
+        if (high < 0 || low < 0) {
+            return 0;
+        }
+        secret[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return length;
+}
+
+#if defined(__linux__)
+
+/**
+ * HKDF-Expand-Label with an empty context (RFC 8446 section 7.1)
+ * length must not exceed the digest size, so one HMAC block suffices.
+ */
+bool expandLabel(const EVP_MD* digest, const uint8_t* secret, size_t secretLength, const char* label,
+                 uint8_t* out, size_t length) {
+    uint8_t info[64];
+    size_t labelLength = std::strlen(label);
+    size_t position = 0;
+    info[position++] = static_cast<uint8_t>(length >> 8);
+    info[position++] = static_cast<uint8_t>(length);
+    info[position++] = static_cast<uint8_t>(6 + labelLength);
+    std::memcpy(info + position, "tls13 ", 6);
+    position += 6;
+    std::memcpy(info + position, label, labelLength);
+    position += labelLength;
+    info[position++] = 0;  // Context
+    info[position++] = 1;  // HKDF-Expand block counter
+
+    uint8_t block[EVP_MAX_MD_SIZE];
+    unsigned int blockLength = 0;
+    if (HMAC(digest, secret, static_cast<int>(secretLength), info, position, block, &blockLength) == nullptr ||
+        blockLength < length) {
+        return false;
+    }
+    std::memcpy(out, block, length);
+    OPENSSL_cleanse(block, sizeof(block));
+    return true;
+}
+
+/**
+ * kTLS crypto_info for one direction
+ */
+struct KernelCryptoInfo {
+    union {
+        tls12_crypto_info_aes_gcm_128 aes128;
+        tls12_crypto_info_aes_gcm_256 aes256;
+    };
+    size_t size;
+};
+
+/**
+ * Derive the record key and IV of a TLS 1.3 traffic secret for the kernel
+ */
+bool deriveCryptoInfo(uint16_t suite, const uint8_t* secret, size_t secretLength, uint64_t sequence,
+                      KernelCryptoInfo& crypto) {
+    std::memset(&crypto, 0, sizeof(crypto));
+    const EVP_MD* digest;
+    tls_crypto_info* info;
+    uint8_t* key;
+    size_t keyLength;
+    uint8_t* salt;
+    uint8_t* iv;
+    uint8_t* sequenceBytes;
+    if (suite == OPENSSL_TLS_AES_128_GCM_SHA256) {
+        digest = EVP_sha256();
+        info = &crypto.aes128.info;
+        info->cipher_type = TLS_CIPHER_AES_GCM_128;
+        key = crypto.aes128.key;
+        keyLength = sizeof(crypto.aes128.key);
+        salt = crypto.aes128.salt;
+        iv = crypto.aes128.iv;
+        sequenceBytes = crypto.aes128.rec_seq;
+        crypto.size = sizeof(crypto.aes128);
+    } else if (suite == OPENSSL_TLS_AES_256_GCM_SHA384) {
+        digest = EVP_sha384();
+        info = &crypto.aes256.info;
+        info->cipher_type = TLS_CIPHER_AES_GCM_256;
+        key = crypto.aes256.key;
+        keyLength = sizeof(crypto.aes256.key);
+        salt = crypto.aes256.salt;
+        iv = crypto.aes256.iv;
+        sequenceBytes = crypto.aes256.rec_seq;
+        crypto.size = sizeof(crypto.aes256);
+    } else {
+        return false;
+    }
+    info->version = TLS_1_3_VERSION;
+
+    // The kernel builds the nonce as salt | iv and XORs in the sequence
+    uint8_t nonce[12];
+    if (secretLength != static_cast<size_t>(EVP_MD_size(digest)) ||
+        !expandLabel(digest, secret, secretLength, "key", key, keyLength) ||
+        !expandLabel(digest, secret, secretLength, "iv", nonce, sizeof(nonce))) {
+        return false;
+    }
+    std::memcpy(salt, nonce, 4);
+    std::memcpy(iv, nonce + 4, 8);
+    for (size_t i = 0; i < 8; i++) {
+        sequenceBytes[i] = static_cast<uint8_t>(sequence >> (56 - 8 * i));
+    }
+    OPENSSL_cleanse(nonce, sizeof(nonce));
+    return true;
+}
+
+#endif
+
+} // namespace
+
+CoapOpenSslContext::CoapOpenSslContext(bool server, bool datagram)
+    : context_(nullptr)
+    , server_(server)
+    , datagram_(datagram) {
+    if (datagram) {
+        context_ = SSL_CTX_new(server ? DTLS_server_method() : DTLS_client_method());
+    } else {
+        context_ = SSL_CTX_new(server ? TLS_server_method() : TLS_client_method());
+    }
+    if (context_ == nullptr) {
+        return;
+    }
+    if (!datagram) {
+        SSL_CTX_set_min_proto_version(context_, TLS1_2_VERSION);
+        SSL_CTX_set_keylog_callback(context_, keyLogCallback);
+        return;
+    }
+    SSL_CTX_set_min_proto_version(context_, DTLS1_2_VERSION);
+    if (server) {
+        if (RAND_bytes(cookieSecret_, sizeof(cookieSecret_)) != 1 ||
+            SSL_CTX_set_ex_data(context_, contextIndex(), this) != 1) {
+            SSL_CTX_free(context_);
+            context_ = nullptr;
+            return;
+        }
+        SSL_CTX_set_options(context_, SSL_OP_COOKIE_EXCHANGE);
+        SSL_CTX_set_cookie_generate_cb(context_, generateCookie);
+        SSL_CTX_set_cookie_verify_cb(context_, verifyCookie);
+    }
+}
+
+CoapOpenSslContext::~CoapOpenSslContext() {
+    SSL_CTX_free(context_);
+    OPENSSL_cleanse(cookieSecret_, sizeof(cookieSecret_));
+}
+
+CoapError CoapOpenSslContext::loadCertificate(const char* certificateFile, const char* keyFile) {
+    if (context_ == nullptr || certificateFile == nullptr || keyFile == nullptr) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    if (SSL_CTX_use_certificate_chain_file(context_, certificateFile) != 1 ||
+        SSL_CTX_use_PrivateKey_file(context_, keyFile, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(context_) != 1) {
+        ERR_clear_error();
+        return CoapError::INVALID_FORMAT;
+    }
+    return CoapError::OK;
+}
+
+CoapError CoapOpenSslContext::loadTrustedCertificates(const char* caFile) {
+    if (context_ == nullptr || caFile == nullptr) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    if (SSL_CTX_load_verify_locations(context_, caFile, nullptr) != 1) {
+        ERR_clear_error();
+        return CoapError::INVALID_FORMAT;
+    }
+    SSL_CTX_set_verify(context_, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, nullptr);
+    return CoapError::OK;
+}
+
+bool CoapOpenSslContext::isValid() const {
+    return context_ != nullptr;
+}
+
+bool CoapOpenSslContext::isServer() const {
+    return server_;
+}
+
+bool CoapOpenSslContext::isDatagram() const {
+    return datagram_;
+}
+
+SSL_CTX* CoapOpenSslContext::getNative() const {
+    return context_;
+}
+
+bool CoapOpenSslContext::makeCookie(const CoapEndpoint& endpoint, uint8_t* cookie, unsigned int& length) const {
+    uint8_t peer[sizeof(endpoint.remoteAddress) + 2];
+    std::memcpy(peer, endpoint.remoteAddress, sizeof(endpoint.remoteAddress));
+    peer[sizeof(endpoint.remoteAddress)] = static_cast<uint8_t>(endpoint.remotePort >> 8);
+    peer[sizeof(endpoint.remoteAddress) + 1] = static_cast<uint8_t>(endpoint.remotePort);
+    return HMAC(EVP_sha256(), cookieSecret_, sizeof(cookieSecret_), peer, sizeof(peer), cookie, &length) != nullptr;
+}
+
+CoapOpenSslTlsEngine::CoapOpenSslTlsEngine(CoapOpenSslContext& context, int fd, const char* serverName)
+    : ssl_(context.isValid() && !context.isDatagram() ? SSL_new(context.getNative()) : nullptr)
+    , fd_(fd)
+    , stream_(fd)
+    , offloaded_(false)
+    , closed_(false)
+    , failed_(false)
+    , clientSecretLength_(0)
+    , serverSecretLength_(0)
+    , readRecords_(-1)
+    , writeRecords_(-1) {
+    if (ssl_ == nullptr) {
+        return;
+    }
+    if (SSL_set_fd(ssl_, fd) != 1 || SSL_set_ex_data(ssl_, engineIndex(), this) != 1) {
+        SSL_free(ssl_);
+        ssl_ = nullptr;
+        return;
+    }
+    SSL_set_msg_callback(ssl_, messageCallback);
+    SSL_set_msg_callback_arg(ssl_, this);
+    if (context.isServer()) {
+        SSL_set_accept_state(ssl_);
+    } else {
+        SSL_set_connect_state(ssl_);
+        if (serverName != nullptr) {
+            SSL_set_tlsext_host_name(ssl_, serverName);
+            SSL_set1_host(ssl_, serverName);
+        }
+    }
+}
+
+CoapOpenSslTlsEngine::~CoapOpenSslTlsEngine() {
+    SSL_free(ssl_);
+    OPENSSL_cleanse(clientSecret_, sizeof(clientSecret_));
+    OPENSSL_cleanse(serverSecret_, sizeof(serverSecret_));
+}
+
+CoapError CoapOpenSslTlsEngine::handshake(bool& done) {
+    done = false;
+    if (ssl_ == nullptr) {
+        return CoapError::OUT_OF_MEMORY;
+    }
+    ERR_clear_error();
+    int result = SSL_do_handshake(ssl_);
+    if (result == 1) {
+        done = true;
+        return CoapError::OK;
+    }
+    CoapError error = fail(result);
+    // The peer closing during the handshake is a failure, not "no data yet"
+    return error == CoapError::OK && closed_ ? CoapError::CONNECTION_CLOSED : error;
+}
+
+CoapError CoapOpenSslTlsEngine::read(uint8_t* buffer, size_t capacity, size_t& received) {
+    received = 0;
+    if (offloaded_) {
+        return stream_.read(buffer, capacity, received);
+    }
+    if (ssl_ == nullptr || failed_) {
+        return CoapError::TRANSPORT_ERROR;
+    }
+    if (capacity == 0 || closed_) {
+        return CoapError::OK;
+    }
+    ERR_clear_error();
+    int result = SSL_read_ex(ssl_, buffer, capacity, &received);
+    return result == 1 ? CoapError::OK : fail(result);
+}
+
+CoapError CoapOpenSslTlsEngine::write(const uint8_t* data, size_t length, size_t& sent) {
+    sent = 0;
+    if (offloaded_) {
+        return stream_.write(data, length, sent);
+    }
+    if (ssl_ == nullptr || failed_) {
+        return CoapError::TRANSPORT_ERROR;
+    }
+    if (length == 0) {
+        return CoapError::OK;
+    }
+    ERR_clear_error();
+    int result = SSL_write_ex(ssl_, data, length, &sent);
+    return result == 1 ? CoapError::OK : fail(result);
+}
+
+bool CoapOpenSslTlsEngine::enableKernelOffload() {
+#if defined(__linux__)
+    if (offloaded_) {
+        return true;
+    }
+    // Keys are only known for TLS 1.3, and bytes OpenSSL already buffered
+    // would be lost to the kernel
+    if (ssl_ == nullptr || failed_ || SSL_is_init_finished(ssl_) != 1 || SSL_version(ssl_) != TLS1_3_VERSION ||
+        SSL_has_pending(ssl_) || readRecords_ < 0 || writeRecords_ < 0) {
+        return false;
+    }
+
+    bool server = SSL_is_server(ssl_) == 1;
+    uint16_t suite = SSL_CIPHER_get_protocol_id(SSL_get_current_cipher(ssl_));
+    KernelCryptoInfo tx;
+    KernelCryptoInfo rx;
+    bool derived =
+        deriveCryptoInfo(suite, server ? serverSecret_ : clientSecret_,
+                         server ? serverSecretLength_ : clientSecretLength_, static_cast<uint64_t>(writeRecords_), tx) &&
+        deriveCryptoInfo(suite, server ? clientSecret_ : serverSecret_,
+                         server ? clientSecretLength_ : serverSecretLength_, static_cast<uint64_t>(readRecords_), rx);
+    bool installed = false;
+    if (derived && ::setsockopt(fd_, IPPROTO_TCP, OPENSSL_TCP_ULP, "tls", sizeof("tls")) == 0) {
+        bool transmit = ::setsockopt(fd_, OPENSSL_SOL_TLS, TLS_TX, &tx, static_cast<socklen_t>(tx.size)) == 0;
+        installed = transmit && ::setsockopt(fd_, OPENSSL_SOL_TLS, TLS_RX, &rx, static_cast<socklen_t>(rx.size)) == 0;
+        // Once the kernel encrypts writes OpenSSL can no longer use the socket
+        failed_ = transmit && !installed;
+    }
+    OPENSSL_cleanse(&tx, sizeof(tx));
+    OPENSSL_cleanse(&rx, sizeof(rx));
+    if (!installed) {
+        return false;
+    }
+
+    OPENSSL_cleanse(clientSecret_, sizeof(clientSecret_));
+    OPENSSL_cleanse(serverSecret_, sizeof(serverSecret_));
+    stream_ = CoapFdStream(fd_, true);
+    offloaded_ = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CoapOpenSslTlsEngine::isKernelOffloaded() const {
+    return offloaded_;
+}
+
+bool CoapOpenSslTlsEngine::isClosed() const {
+    return offloaded_ ? stream_.isClosed() : closed_;
+}
+
+CoapFdStream& CoapOpenSslTlsEngine::getFdStream() {
+    return stream_;
+}
+
+SSL* CoapOpenSslTlsEngine::getNative() const {
+    return ssl_;
+}
+
+void CoapOpenSslTlsEngine::onKeyLog(const char* line) {
+    if (std::strncmp(line, "CLIENT_TRAFFIC_SECRET_0 ", 24) == 0) {
+        clientSecretLength_ = parseKeyLogSecret(line, clientSecret_, sizeof(clientSecret_));
+    } else if (std::strncmp(line, "SERVER_TRAFFIC_SECRET_0 ", 24) == 0) {
+        serverSecretLength_ = parseKeyLogSecret(line, serverSecret_, sizeof(serverSecret_));
+    }
+}
+
+void CoapOpenSslTlsEngine::onRecord(int writing, int contentType, const void* data, size_t length) {
+    int64_t& records = writing ? writeRecords_ : readRecords_;
+    if (contentType == SSL3_RT_HEADER) {
+        // Called for each record before the messages it carries
+        if (records >= 0) {
+            records++;
+        }
+        return;
+    }
+    if (contentType != SSL3_RT_HANDSHAKE || length == 0) {
+        return;
+    }
+    uint8_t type = static_cast<const uint8_t*>(data)[0];
+    if (type == OPENSSL_HANDSHAKE_FINISHED) {
+        // TLS 1.3 switches to the application keys after Finished
+        records = 0;
+    } else if (type == OPENSSL_HANDSHAKE_KEY_UPDATE) {
+        // Keys no longer match the key log
+        readRecords_ = -1;
+        writeRecords_ = -1;
+    }
+}
+
+CoapError CoapOpenSslTlsEngine::fail(int result) {
+    switch (SSL_get_error(ssl_, result)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            return CoapError::OK;
+        case SSL_ERROR_ZERO_RETURN:
+            closed_ = true;
+            return CoapError::OK;
+        case SSL_ERROR_SYSCALL:
+            closed_ = true;
+            return CoapError::CONNECTION_CLOSED;
+        default:
+            ERR_clear_error();
+            failed_ = true;
+            return CoapError::TRANSPORT_ERROR;
+    }
+}
+
+CoapOpenSslDtlsEngine::CoapOpenSslDtlsEngine(CoapOpenSslContext& context, int fd, const CoapEndpoint& endpoint,
+                                             const char* serverName)
+    : ssl_(context.isValid() && context.isDatagram() ? SSL_new(context.getNative()) : nullptr)
+    , fd_(fd)
+    , endpoint_(endpoint)
+    , closed_(false)
+    , input_(nullptr)
+    , inputLength_(0)
+    , output_(nullptr)
+    , outputCapacity_(0)
+    , outputLength_(0)
+    , outputOverflow_(false) {
+    if (ssl_ == nullptr) {
+        return;
+    }
+    BIO* bio = datagramMethod() != nullptr ? BIO_new(datagramMethod()) : nullptr;
+    if (bio == nullptr || SSL_set_ex_data(ssl_, datagramEngineIndex(), this) != 1) {
+        BIO_free(bio);
+        SSL_free(ssl_);
+        ssl_ = nullptr;
+        return;
+    }
+    BIO_set_data(bio, this);
+    SSL_set_bio(ssl_, bio, bio);
+    if (context.isServer()) {
+        SSL_set_accept_state(ssl_);
+    } else {
+        SSL_set_connect_state(ssl_);
+        if (serverName != nullptr) {
+            SSL_set_tlsext_host_name(ssl_, serverName);
+            SSL_set1_host(ssl_, serverName);
+        }
+    }
+}
+
+CoapOpenSslDtlsEngine::~CoapOpenSslDtlsEngine() {
+    SSL_free(ssl_);
+}
+
+CoapError CoapOpenSslDtlsEngine::decrypt(uint8_t* data, size_t length, uint8_t*& plaintext,
+                                         size_t& plaintextLength) {
+    plaintext = nullptr;
+    plaintextLength = 0;
+    if (ssl_ == nullptr) {
+        return CoapError::OUT_OF_MEMORY;
+    }
+
+    // OpenSSL copies the whole datagram before it writes plaintext back into it
+    input_ = data;
+    inputLength_ = length;
+    ERR_clear_error();
+    size_t received = 0;
+    int result = SSL_read_ex(ssl_, data, length, &received);
+    CoapError error = result == 1 ? CoapError::OK : fail(result);
+    if (result == 1) {
+        plaintext = data;
+        plaintextLength = received;
+        // One message per datagram: drop further application records
+        size_t dropped = 0;
+        while (SSL_has_pending(ssl_) && SSL_read_ex(ssl_, data + received, length - received, &dropped) == 1) {
+        }
+        ERR_clear_error();
+    }
+    input_ = nullptr;
+    inputLength_ = 0;
+    return error;
+}
+
+CoapError CoapOpenSslDtlsEngine::encrypt(const uint8_t* data, size_t length, uint8_t* out, size_t capacity,
+                                         size_t& outLength) {
+    outLength = 0;
+    if (!isEstablished()) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+
+    output_ = out;
+    outputCapacity_ = capacity;
+    outputLength_ = 0;
+    outputOverflow_ = false;
+    ERR_clear_error();
+    size_t written = 0;
+    int result = SSL_write_ex(ssl_, data, length, &written);
+    output_ = nullptr;
+    if (outputOverflow_) {
+        ERR_clear_error();
+        return CoapError::BUFFER_TOO_SMALL;
+    }
+    if (result != 1) {
+        CoapError error = fail(result);
+        return error == CoapError::OK ? CoapError::TRANSPORT_ERROR : error;
+    }
+    outLength = outputLength_;
+    return CoapError::OK;
+}
+
+CoapError CoapOpenSslDtlsEngine::connect() {
+    if (ssl_ == nullptr) {
+        return CoapError::OUT_OF_MEMORY;
+    }
+    ERR_clear_error();
+    int result = SSL_do_handshake(ssl_);
+    return result == 1 ? CoapError::OK : fail(result);
+}
+
+CoapError CoapOpenSslDtlsEngine::handleTimeout() {
+    if (ssl_ == nullptr) {
+        return CoapError::OUT_OF_MEMORY;
+    }
+    if (DTLSv1_handle_timeout(ssl_) < 0) {
+        ERR_clear_error();
+        return CoapError::TRANSPORT_ERROR;
+    }
+    return CoapError::OK;
+}
+
+bool CoapOpenSslDtlsEngine::isEstablished() const {
+    return ssl_ != nullptr && SSL_is_init_finished(ssl_) == 1;
+}
+
+bool CoapOpenSslDtlsEngine::isClosed() const {
+    return closed_;
+}
+
+const CoapEndpoint& CoapOpenSslDtlsEngine::getEndpoint() const {
+    return endpoint_;
+}
+
+SSL* CoapOpenSslDtlsEngine::getNative() const {
+    return ssl_;
+}
+
+int CoapOpenSslDtlsEngine::onRead(char* data, int length) {
+    if (input_ == nullptr) {
+        return -1;
+    }
+    size_t received = inputLength_ < static_cast<size_t>(length) ? inputLength_ : static_cast<size_t>(length);
+    std::memcpy(data, input_, received);
+    input_ = nullptr;
+    return static_cast<int>(received);
+}
+
+int CoapOpenSslDtlsEngine::onWrite(const char* data, int length) {
+    size_t size = static_cast<size_t>(length);
+    if (output_ != nullptr) {
+        if (size > outputCapacity_ - outputLength_) {
+            outputOverflow_ = true;
+            return -1;
+        }
+        std::memcpy(output_ + outputLength_, data, size);
+        outputLength_ += size;
+        return length;
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    sockaddr_in6 address;
+    size_t addressLength = 0;
+    if (endpoint_.toSockaddr(&address, sizeof(address), addressLength) != CoapError::OK) {
+        return -1;
+    }
+    ssize_t sent = ::sendto(fd_, data, size, 0, reinterpret_cast<const sockaddr*>(&address),
+                            static_cast<socklen_t>(addressLength));
+    // A datagram lost to a full socket buffer is re-sent by the handshake timer
+    if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+        return -1;
+    }
+    return length;
+#else
+    return -1;
+#endif
+}
+
+CoapError CoapOpenSslDtlsEngine::fail(int result) {
+    switch (SSL_get_error(ssl_, result)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            return CoapError::OK;
+        case SSL_ERROR_ZERO_RETURN:
+            closed_ = true;
+            return CoapError::OK;
+        default:
+            ERR_clear_error();
+            return CoapError::TRANSPORT_ERROR;
+    }
+}
+
+CoapOpenSslDtlsEngineFactory::CoapOpenSslDtlsEngineFactory(CoapOpenSslContext& context, int fd)
+    : context_(context)
+    , fd_(fd) {}
+
+CoapDtlsEngine* CoapOpenSslDtlsEngineFactory::createEngine(const CoapEndpoint& endpoint) {
+    CoapOpenSslDtlsEngine* engine = new CoapOpenSslDtlsEngine(context_, fd_, endpoint);
+    if (engine->getNative() == nullptr) {
+        delete engine;
+        return nullptr;
+    }
+    return engine;
+}
+
+void CoapOpenSslDtlsEngineFactory::destroyEngine(CoapDtlsEngine* engine) {
+    delete static_cast<CoapOpenSslDtlsEngine*>(engine);
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,249 @@
+#ifndef COAP_OPENSSL_H
+#define COAP_OPENSSL_H
+
+#include "CoapConfig.h"
+
+#if COAP_PACKET_WITH_OPENSSL
+
+#include "CoapDtls.h"
+#include "CoapTransport.h"
+#include "CoapError.h"
+#include <openssl/ssl.h>
+
+namespace CoapPacket {
+
+// Largest DTLS datagram sent: IPv6 minimum MTU less IP and UDP headers
+constexpr size_t OPENSSL_DTLS_MTU = 1232;
+
+/**
+ * OpenSSL context shared by the sessions of one endpoint role
+ *
+ * Certificates, keys and trust anchors can be loaded from PEM files or
+ * set on getNative() with the OpenSSL API. Peers are verified once
+ * trusted certificates are loaded. A datagram server context answers
+ * each new ClientHello with a stateless cookie (RFC 6347 section 4.2.1)
+ * before it sends its certificate flight.
+ */
+class CoapOpenSslContext {
+public:
+    explicit CoapOpenSslContext(bool server, bool datagram = false);
+    ~CoapOpenSslContext();
+
+    /**
+     * Load certificate chain and private key (PEM files)
+     */
+    CoapError loadCertificate(const char* certificateFile, const char* keyFile);
+
+    /**
+     * Load trusted certificates (PEM file) and require a valid peer certificate
+     */
+    CoapError loadTrustedCertificates(const char* caFile);
+
+    /**
+     * True if the context was created
+     */
+    bool isValid() const;
+
+    /**
+     * True for the server role
+     */
+    bool isServer() const;
+
+    /**
+     * True for DTLS
+     */
+    bool isDatagram() const;
+
+    /**
+     * Get the OpenSSL context for further configuration
+     */
+    SSL_CTX* getNative() const;
+
+    /**
+     * Compute the DTLS cookie for a peer; called by OpenSSL
+     */
+    bool makeCookie(const CoapEndpoint& endpoint, uint8_t* cookie, unsigned int& length) const;
+
+private:
+    SSL_CTX* context_;
+    bool server_;
+    bool datagram_;
+    uint8_t cookieSecret_[32];
+
+    CoapOpenSslContext(const CoapOpenSslContext&);
+    CoapOpenSslContext& operator=(const CoapOpenSslContext&);
+};
+
+/**
+ * TLS 1.2/1.3 engine on a connected TCP socket
+ *
+ * The engine does not own the socket. After the handshake,
+ * enableKernelOffload() installs the TLS 1.3 traffic keys on the socket
+ * (Linux kTLS, AES-GCM cipher suites); read() and write() then go to
+ * the socket directly, and getFdStream() can be used instead of the
+ * engine. The record sequence numbers handed to the kernel are counted
+ * from OpenSSL's message callback.
+ */
+class CoapOpenSslTlsEngine : public CoapTlsEngine {
+public:
+    /**
+     * serverName is sent as SNI and checked against the peer certificate
+     * when the client context verifies peers (may be nullptr)
+     */
+    CoapOpenSslTlsEngine(CoapOpenSslContext& context, int fd, const char* serverName = nullptr);
+    ~CoapOpenSslTlsEngine() override;
+
+    CoapError handshake(bool& done) override;
+    CoapError read(uint8_t* buffer, size_t capacity, size_t& received) override;
+    CoapError write(const uint8_t* data, size_t length, size_t& sent) override;
+    bool enableKernelOffload() override;
+
+    /**
+     * True once records are processed by the kernel
+     */
+    bool isKernelOffloaded() const;
+
+    /**
+     * True once the peer has closed the stream
+     */
+    bool isClosed() const;
+
+    /**
+     * Get the socket stream; it yields plaintext after enableKernelOffload()
+     */
+    CoapFdStream& getFdStream();
+
+    /**
+     * Get the OpenSSL session (nullptr if it could not be created)
+     */
+    SSL* getNative() const;
+
+    /**
+     * Called by OpenSSL; not part of the public interface
+     */
+    void onKeyLog(const char* line);
+    void onRecord(int writing, int contentType, const void* data, size_t length);
+
+private:
+    SSL* ssl_;
+    int fd_;
+    CoapFdStream stream_;
+    bool offloaded_;
+    bool closed_;
+    bool failed_;   // Fatal TLS error, or kernel offload failed half-way
+
+    // TLS 1.3 application traffic secrets from the key log
+    uint8_t clientSecret_[48];
+    uint8_t serverSecret_[48];
+    size_t clientSecretLength_;
+    size_t serverSecretLength_;
+
+    // Records protected with the application keys, -1 until the keys are in use
+    int64_t readRecords_;
+    int64_t writeRecords_;
+
+    CoapError fail(int result);
+
+    CoapOpenSslTlsEngine(const CoapOpenSslTlsEngine&);
+    CoapOpenSslTlsEngine& operator=(const CoapOpenSslTlsEngine&);
+};
+
+/**
+ * DTLS 1.2 session with one peer on a shared UDP socket
+ *
+ * Handshake flights are sent to the peer with sendto() on fd. decrypt()
+ * and encrypt() only touch the caller's buffers: records are decrypted
+ * into the datagram they arrived in. CoAP over DTLS carries one message
+ * per record, so application records after the first in a datagram are
+ * dropped.
+ */
+class CoapOpenSslDtlsEngine : public CoapDtlsEngine {
+public:
+    /**
+     * serverName is checked against the peer certificate when the client
+     * context verifies peers (may be nullptr)
+     */
+    CoapOpenSslDtlsEngine(CoapOpenSslContext& context, int fd, const CoapEndpoint& endpoint,
+                          const char* serverName = nullptr);
+    ~CoapOpenSslDtlsEngine() override;
+
+    CoapError decrypt(uint8_t* data, size_t length, uint8_t*& plaintext, size_t& plaintextLength) override;
+    CoapError encrypt(const uint8_t* data, size_t length, uint8_t* out, size_t capacity,
+                      size_t& outLength) override;
+
+    /**
+     * Send the ClientHello (client role); replies go to decrypt()
+     */
+    CoapError connect();
+
+    /**
+     * Re-send the last handshake flight if its retransmission timer expired
+     */
+    CoapError handleTimeout();
+
+    /**
+     * True once the handshake has completed
+     */
+    bool isEstablished() const;
+
+    /**
+     * True once the peer has sent close_notify
+     */
+    bool isClosed() const;
+
+    const CoapEndpoint& getEndpoint() const;
+
+    /**
+     * Get the OpenSSL session (nullptr if it could not be created)
+     */
+    SSL* getNative() const;
+
+    /**
+     * Called by the datagram BIO; not part of the public interface
+     */
+    int onRead(char* data, int length);
+    int onWrite(const char* data, int length);
+
+private:
+    SSL* ssl_;
+    int fd_;
+    CoapEndpoint endpoint_;
+    bool closed_;
+
+    // Datagram handed to OpenSSL by decrypt()
+    const uint8_t* input_;
+    size_t inputLength_;
+
+    // Record buffer of encrypt(); nullptr sends writes to the peer
+    uint8_t* output_;
+    size_t outputCapacity_;
+    size_t outputLength_;
+    bool outputOverflow_;
+
+    CoapError fail(int result);
+
+    CoapOpenSslDtlsEngine(const CoapOpenSslDtlsEngine&);
+    CoapOpenSslDtlsEngine& operator=(const CoapOpenSslDtlsEngine&);
+};
+
+/**
+ * Creates CoapOpenSslDtlsEngine sessions for CoapDtlsTransport
+ * All sessions share the context and the server's UDP socket.
+ */
+class CoapOpenSslDtlsEngineFactory : public CoapDtlsEngineFactory {
+public:
+    CoapOpenSslDtlsEngineFactory(CoapOpenSslContext& context, int fd);
+
+    CoapDtlsEngine* createEngine(const CoapEndpoint& endpoint) override;
+    void destroyEngine(CoapDtlsEngine* engine) override;
+
+private:
+    CoapOpenSslContext& context_;
+    int fd_;
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_PACKET_WITH_OPENSSL
+
+#endif // COAP_OPENSSL_H
@@ -0,0 +1,203 @@
+#include "CoapOptions.h"
+
+namespace CoapPacket {
+
+CoapOptionIterator::CoapOptionIterator(const uint8_t* buffer, size_t length, size_t offset)
+    : buffer_(buffer)
+    , length_(length)
+    , offset_(offset)
+    , lastNumber_(0)
+    , error_(CoapError::OK)
+    , hasPayload_(false)
+    , done_(offset >= length) {}
+
+bool CoapOptionIterator::next(CoapOptionRef& option) {
+    if (done_) {
+        return false;
+    }
+
+    if (offset_ >= length_) {
+        done_ = true;
+        return false;
+    }
+
+    uint8_t deltaLengthByte = buffer_[offset_];
+
+    // Payload marker ends the option block
+    if (deltaLengthByte == PAYLOAD_MARKER) {
+        done_ = true;
+        hasPayload_ = true;
+        if (offset_ + 1 >= length_) {
+            // Payload marker present but no payload data
+            error_ = CoapError::INVALID_FORMAT;
+        }
+        return false;
+    }
+
+    size_t start = offset_++;
+
+    uint16_t delta = 0;
+    uint16_t length = 0;
+    if (!decodeField((deltaLengthByte >> 4) & 0x0F, delta) ||
+        !decodeField(deltaLengthByte & 0x0F, length)) {
+        done_ = true;
+        return false;
+    }
+
+    uint32_t number = static_cast<uint32_t>(lastNumber_) + delta;
+    if (number > 0xFFFF) {
+        error_ = CoapError::INVALID_FORMAT;
+        done_ = true;
+        return false;
+    }
+
+    if (offset_ + length > length_) {
+        error_ = CoapError::DATAGRAM_TOO_SHORT;
+        done_ = true;
+        return false;
+    }
+
+    if (length > MAX_OPTION_VALUE_SIZE) {
+        error_ = CoapError::OPTION_TOO_LONG;
+        done_ = true;
+        return false;
+    }
+
+    option.number = static_cast<uint16_t>(number);
+    option.value = buffer_ + offset_;
+    option.length = length;
+    option.offset = start;
+    option.headerLength = offset_ - start;
+
+    offset_ += length;
+    lastNumber_ = option.number;
+    return true;
+}
+
+CoapError CoapOptionIterator::getError() const {
+    return error_;
+}
+
+bool CoapOptionIterator::hasPayload() const {
+    return hasPayload_;
+}
+
+size_t CoapOptionIterator::getOffset() const {
+    return offset_;
+}
+
+CoapError CoapOptionIterator::locateOptions(const uint8_t* buffer, size_t length, size_t& offset) {
+    if (length < 4) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    if (((buffer[0] >> 6) & 0x03) != COAP_VERSION) {
+        return CoapError::INVALID_VERSION;
+    }
+
+    uint8_t tokenLength = buffer[0] & 0x0F;
+    if (tokenLength > 8) {
+        return CoapError::INVALID_TOKEN_LENGTH;
+    }
+
+    if (!isValidCodeClass(buffer[1] >> 5)) {
+        return CoapError::INVALID_CODE_CLASS;
+    }
+
+    if (4 + static_cast<size_t>(tokenLength) > length) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    offset = 4 + tokenLength;
+    return CoapError::OK;
+}
+
+bool CoapOptionIterator::decodeField(uint8_t field, uint16_t& result) {
+    if (field < 13) {
+        result = field;
+        return true;
+    } else if (field == 13) {
+        if (offset_ >= length_) {
+            error_ = CoapError::DATAGRAM_TOO_SHORT;
+            return false;
+        }
+        result = buffer_[offset_++] + 13;
+        return true;
+    } else if (field == 14) {
+        if (offset_ + 1 >= length_) {
+            error_ = CoapError::DATAGRAM_TOO_SHORT;
+            return false;
+        }
+        result = ((static_cast<uint16_t>(buffer_[offset_]) << 8) |
+                  static_cast<uint16_t>(buffer_[offset_ + 1])) + 269;
+        offset_ += 2;
+        return true;
+    }
+
+    // Field == 15 is only valid as part of the payload marker
+    error_ = CoapError::INVALID_FORMAT;
+    return false;
+}
+
+size_t getOptionHeaderSize(uint16_t delta, uint16_t length) {
+    size_t size = 1;
+    size += (delta < 13) ? 0 : (delta < 269) ? 1 : 2;
+    size += (length < 13) ? 0 : (length < 269) ? 1 : 2;
+    return size;
+}
+
+size_t encodeOptionHeader(uint8_t* buffer, uint16_t delta, uint16_t length) {
+    size_t offset = 0;
+    buffer[0] = 0;
+
+    // Encode delta (upper 4 bits)
+    if (delta < 13) {
+        buffer[0] |= (delta & 0x0F) << 4;
+    } else if (delta < 269) {
+        buffer[0] |= 13 << 4;
+        buffer[++offset] = static_cast<uint8_t>(delta - 13);
+    } else {
+        buffer[0] |= 14 << 4;
+        uint16_t extDelta = delta - 269;
+        buffer[++offset] = static_cast<uint8_t>(extDelta >> 8);
+        buffer[++offset] = static_cast<uint8_t>(extDelta & 0xFF);
+    }
+
+    // Encode length (lower 4 bits)
+    if (length < 13) {
+        buffer[0] |= (length & 0x0F);
+    } else if (length < 269) {
+        buffer[0] |= 13;
+        buffer[++offset] = static_cast<uint8_t>(length - 13);
+    } else {
+        buffer[0] |= 14;
+        uint16_t extLength = length - 269;
+        buffer[++offset] = static_cast<uint8_t>(extLength >> 8);
+        buffer[++offset] = static_cast<uint8_t>(extLength & 0xFF);
+    }
+
+    return offset + 1;
+}
+
+size_t encodeUintValue(uint8_t* buffer, uint32_t value) {
+    // Zero is encoded as empty (0-length option)
+    size_t length = (value == 0) ? 0 :
+                    (value <= 0xFF) ? 1 :
+                    (value <= 0xFFFF) ? 2 :
+                    (value <= 0xFFFFFF) ? 3 : 4;
+
+    for (size_t i = 0; i < length; i++) {
+        buffer[i] = static_cast<uint8_t>(value >> (8 * (length - 1 - i)));
+    }
+    return length;
+}
+
+uint32_t decodeUintValue(const uint8_t* data, size_t length) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < length && i < 4; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+} // namespace CoapPacket
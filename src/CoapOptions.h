@@ -0,0 +1,106 @@
+#ifndef COAP_OPTIONS_H
+#define COAP_OPTIONS_H
+
+#include "CoapTypes.h"
+#include "CoapError.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+/**
+ * Reference to a single option inside an encoded message (no copy)
+ */
+struct CoapOptionRef {
+    uint16_t number;
+    const uint8_t* value;
+    uint16_t length;
+    size_t offset;        // Offset of the option header in the buffer
+    size_t headerLength;  // Size of the delta/length header (1-5 bytes)
+
+    CoapOptionRef()
+        : number(0)
+        , value(nullptr)
+        , length(0)
+        , offset(0)
+        , headerLength(0) {}
+};
+
+/**
+ * Walks the options of an encoded CoAP message without copying them
+ */
+class CoapOptionIterator {
+public:
+    /**
+     * Iterate options starting at offset (first byte after the token)
+     */
+    CoapOptionIterator(const uint8_t* buffer, size_t length, size_t offset);
+
+    /**
+     * Advance to the next option
+     * Returns false at the end of the options or on error (see getError())
+     */
+    bool next(CoapOptionRef& option);
+
+    /**
+     * Get the error that stopped iteration (CoapError::OK if none)
+     */
+    CoapError getError() const;
+
+    /**
+     * True if iteration stopped at a payload marker
+     */
+    bool hasPayload() const;
+
+    /**
+     * Current offset. After the last option this is the end of the
+     * option block: the payload marker position, or the buffer length.
+     */
+    size_t getOffset() const;
+
+    /**
+     * Validate the 4-byte header and token of an encoded message
+     * Sets offset to the first option byte on success
+     */
+    static CoapError locateOptions(const uint8_t* buffer, size_t length, size_t& offset);
+
+private:
+    const uint8_t* buffer_;
+    size_t length_;
+    size_t offset_;
+    uint16_t lastNumber_;
+    CoapError error_;
+    bool hasPayload_;
+    bool done_;
+
+    /**
+     * Decode an extended delta or length field, advancing offset_
+     */
+    bool decodeField(uint8_t field, uint16_t& result);
+};
+
+/**
+ * Size of the delta/length header for an option (1-5 bytes)
+ */
+size_t getOptionHeaderSize(uint16_t delta, uint16_t length);
+
+/**
+ * Encode option delta and length; buffer must hold 5 bytes
+ * Returns bytes written
+ */
+size_t encodeOptionHeader(uint8_t* buffer, uint16_t delta, uint16_t length);
+
+/**
+ * Encode uint32 as variable-length big-endian bytes; buffer must hold 4 bytes
+ * Returns bytes written (0 for value 0)
+ */
+size_t encodeUintValue(uint8_t* buffer, uint32_t value);
+
+/**
+ * Decode uint from variable-length big-endian bytes (at most 4 are used)
+ */
+uint32_t decodeUintValue(const uint8_t* data, size_t length);
+
+} // namespace CoapPacket
+
+#endif // COAP_OPTIONS_H
@@ -2,7 +2,10 @@
 #define COAP_PACKET_H
 
 #include "CoapTypes.h"
+#include "CoapToken.h"
+#include "CoapMemory.h"
 #include <vector>
+#include <memory>
 #include <cstdint>
 #include <cstring>
 
@@ -13,27 +16,38 @@ namespace CoapPacket {
  */
 struct CoapOption {
     uint16_t number;
+    uint32_t value_id;  // CoapStringTable ID of value, 0 if not interned
     std::vector<uint8_t> value;
 
-    CoapOption() : number(0) {}
+    CoapOption() : number(0), value_id(0) {}
     CoapOption(uint16_t num, const std::vector<uint8_t>& val)
-        : number(num), value(val) {}
+        : number(num), value_id(0), value(val) {}
     CoapOption(uint16_t num, const uint8_t* data, size_t len)
-        : number(num), value(data, data + len) {}
+        : number(num), value_id(0), value(data, data + len) {}
 };
 
+// number and value_id share the padding before value
+static_assert(sizeof(CoapOption) == sizeof(std::vector<uint8_t>) + 8, "CoapOption must not grow past its padding");
+
 /**
  * Represents a complete CoAP packet
+ * The payload is either owned (payload) or external (payload_ref): a span
+ * of memory kept alive by payload_owner, or by the caller if payload_owner
+ * is empty. An external payload takes precedence; always access the
+ * payload through getPayloadPtr()/getPayloadSize().
  */
 struct CoapPacket {
     uint8_t version;
     CoapType type;
     uint8_t token_length;
-    uint8_t token[8];
+    uint8_t token[8];           // setToken() zeroes the bytes past token_length
     CoapCode code;
     uint16_t message_id;
     std::vector<CoapOption> options;
     std::vector<uint8_t> payload;
+    const uint8_t* payload_ref;
+    size_t payload_ref_length;
+    std::shared_ptr<const void> payload_owner;
 
     /**
      * Default constructor - initializes to empty packet
@@ -43,10 +57,28 @@ struct CoapPacket {
         , type(CoapType::CON)
         , token_length(0)
         , code(CoapCode::EMPTY)
-        , message_id(0) {
+        , message_id(0)
+        , payload_ref(nullptr)
+        , payload_ref_length(0) {
         std::memset(token, 0, sizeof(token));
     }
 
+    /**
+     * Get memory footprint; entries counts options
+     * An external payload belongs to its owner and is not counted.
+     */
+    CoapMemoryUsage memoryUsage() const {
+        CoapMemoryUsage usage;
+        usage.addObject(sizeof(*this));
+        usage.addArray(options.size(), options.capacity(), sizeof(CoapOption));
+        for (const CoapOption& option : options) {
+            usage.addArray(option.value.size(), option.value.capacity(), 1);
+        }
+        usage.addArray(payload.size(), payload.capacity(), 1);
+        usage.entries = options.size();
+        return usage;
+    }
+
     /**
      * Get pointer to token data
      */
@@ -54,10 +86,38 @@ struct CoapPacket {
         return token;
     }
 
+    /**
+     * Get token as a zero-padded uint64_t (see CoapToken.h)
+     * Bytes past token_length are masked, so the result stays correct if
+     * the public fields were written directly.
+     */
+    uint64_t getTokenValue() const {
+        uint64_t value;
+        std::memcpy(&value, token, sizeof(value));
+        return maskToken(value, token_length);
+    }
+
+    /**
+     * Get token as a hashable key
+     */
+    CoapTokenKey getTokenKey() const {
+        return CoapTokenKey(getTokenValue(), token_length);
+    }
+
+    /**
+     * Check whether the token equals the given one
+     */
+    bool hasToken(const CoapTokenKey& key) const {
+        return tokenEquals(getTokenValue(), token_length, key.value, key.length);
+    }
+
     /**
      * Get pointer to payload data
      */
     const uint8_t* getPayloadPtr() const {
+        if (payload_ref != nullptr) {
+            return payload_ref;
+        }
         return payload.empty() ? nullptr : payload.data();
     }
 
@@ -65,7 +125,35 @@ struct CoapPacket {
      * Get payload size
      */
     size_t getPayloadSize() const {
-        return payload.size();
+        return (payload_ref != nullptr) ? payload_ref_length : payload.size();
+    }
+
+    /**
+     * Check whether the payload is external
+     */
+    bool hasPayloadRef() const {
+        return payload_ref != nullptr;
+    }
+
+    /**
+     * Reference an external payload instead of owning a copy
+     * owner (e.g. the receive buffer) is kept alive with the packet; pass
+     * an empty owner if the caller guarantees the lifetime of data.
+     */
+    void setPayloadRef(const uint8_t* data, size_t length, std::shared_ptr<const void> owner = nullptr) {
+        payload.clear();
+        payload_ref = (length > 0) ? data : nullptr;
+        payload_ref_length = (length > 0) ? length : 0;
+        payload_owner = (length > 0) ? std::move(owner) : nullptr;
+    }
+
+    /**
+     * Drop an external payload reference
+     */
+    void clearPayloadRef() {
+        payload_ref = nullptr;
+        payload_ref_length = 0;
+        payload_owner.reset();
     }
 
     /**
@@ -74,10 +162,9 @@ struct CoapPacket {
     void setToken(const uint8_t* tokenData, uint8_t length) {
         if (length > 8) length = 8;
         token_length = length;
-        std::memcpy(token, tokenData, length);
-        if (length < 8) {
-            std::memset(token + length, 0, 8 - length);
-        }
+        // One 8-byte store writes the token and its zero padding
+        uint64_t value = loadToken(tokenData, length);
+        std::memcpy(token, &value, sizeof(value));
     }
 
     /**
@@ -86,12 +173,15 @@ struct CoapPacket {
     void clear() {
         version = COAP_VERSION;
         type = CoapType::CON;
-        token_length = 0;
-        std::memset(token, 0, sizeof(token));
+        if (token_length != 0) {
+            token_length = 0;
+            std::memset(token, 0, sizeof(token));
+        }
         code = CoapCode::EMPTY;
         message_id = 0;
         options.clear();
         payload.clear();
+        clearPayloadRef();
     }
 };
 
@@ -0,0 +1,258 @@
+#include "CoapPacketBatch.h"
+
+namespace CoapPacket {
+
+namespace {
+
+// Arrow consumers expect non-null data buffers even for empty columns
+const uint8_t emptyColumn[8] = {0};
+
+const void* columnData(const void* data) {
+    return data != nullptr ? data : emptyColumn;
+}
+
+struct ArrowSchemaHolder {
+    std::vector<ArrowSchema*> children;
+};
+
+struct ArrowArrayHolder {
+    const void* buffers[3];
+    std::vector<ArrowArray*> children;
+};
+
+void releaseArrowSchema(ArrowSchema* schema) {
+    ArrowSchemaHolder* holder = static_cast<ArrowSchemaHolder*>(schema->private_data);
+    for (ArrowSchema* child : holder->children) {
+        if (child->release != nullptr) {
+            child->release(child);
+        }
+        delete child;
+    }
+    delete holder;
+    schema->release = nullptr;
+}
+
+void releaseArrowArray(ArrowArray* array) {
+    ArrowArrayHolder* holder = static_cast<ArrowArrayHolder*>(array->private_data);
+    for (ArrowArray* child : holder->children) {
+        if (child->release != nullptr) {
+            child->release(child);
+        }
+        delete child;
+    }
+    delete holder;
+    array->release = nullptr;
+}
+
+void initArrowSchema(ArrowSchema* schema, const char* format, const char* name, size_t childCount) {
+    ArrowSchemaHolder* holder = new ArrowSchemaHolder();
+    for (size_t i = 0; i < childCount; i++) {
+        holder->children.push_back(new ArrowSchema());
+    }
+    schema->format = format;
+    schema->name = name;
+    schema->metadata = nullptr;
+    schema->flags = 0;
+    schema->n_children = static_cast<int64_t>(childCount);
+    schema->children = childCount > 0 ? holder->children.data() : nullptr;
+    schema->dictionary = nullptr;
+    schema->release = releaseArrowSchema;
+    schema->private_data = holder;
+}
+
+void initArrowArray(ArrowArray* array, size_t length, size_t nullCount,
+                    const void* buffer0, const void* buffer1, const void* buffer2,
+                    size_t bufferCount, size_t childCount) {
+    ArrowArrayHolder* holder = new ArrowArrayHolder();
+    holder->buffers[0] = buffer0;
+    holder->buffers[1] = buffer1;
+    holder->buffers[2] = buffer2;
+    for (size_t i = 0; i < childCount; i++) {
+        holder->children.push_back(new ArrowArray());
+    }
+    array->length = static_cast<int64_t>(length);
+    array->null_count = static_cast<int64_t>(nullCount);
+    array->offset = 0;
+    array->n_buffers = static_cast<int64_t>(bufferCount);
+    array->n_children = static_cast<int64_t>(childCount);
+    array->buffers = holder->buffers;
+    array->children = childCount > 0 ? holder->children.data() : nullptr;
+    array->dictionary = nullptr;
+    array->release = releaseArrowArray;
+    array->private_data = holder;
+}
+
+} // namespace
+
+CoapPacketBatch::CoapPacketBatch() : validCount_(0) {
+    clear();
+}
+
+void CoapPacketBatch::clear() {
+    types_.clear();
+    codes_.clear();
+    messageIds_.clear();
+    tokenOffsets_.assign(1, 0);
+    tokenData_.clear();
+    optionOffsets_.assign(1, 0);
+    optionNumbers_.clear();
+    optionValueOffsets_.clear();
+    optionValueLengths_.clear();
+    payloadOffsets_.clear();
+    payloadLengths_.clear();
+    errors_.clear();
+    validity_.clear();
+    validCount_ = 0;
+}
+
+void CoapPacketBatch::reserve(size_t messages, size_t options) {
+    types_.reserve(messages);
+    codes_.reserve(messages);
+    messageIds_.reserve(messages);
+    tokenOffsets_.reserve(messages + 1);
+    tokenData_.reserve(messages * 8);
+    optionOffsets_.reserve(messages + 1);
+    optionNumbers_.reserve(options);
+    optionValueOffsets_.reserve(options);
+    optionValueLengths_.reserve(options);
+    payloadOffsets_.reserve(messages);
+    payloadLengths_.reserve(messages);
+    errors_.reserve(messages);
+    validity_.reserve((messages + 7) / 8);
+}
+
+void CoapPacketBatch::append(const CoapPacketView& view, const uint8_t* datagram) {
+    appendRow(true, CoapError::OK);
+    types_.push_back(static_cast<uint8_t>(view.type));
+    codes_.push_back(static_cast<uint8_t>(view.code));
+    messageIds_.push_back(view.message_id);
+
+    tokenData_.insert(tokenData_.end(), view.token, view.token + view.token_length);
+    tokenOffsets_.push_back(static_cast<int32_t>(tokenData_.size()));
+
+    CoapOptionIterator it = view.getOptions();
+    CoapOptionRef option;
+    while (it.next(option)) {
+        optionNumbers_.push_back(option.number);
+        optionValueOffsets_.push_back(static_cast<uint32_t>(option.value - datagram));
+        optionValueLengths_.push_back(option.length);
+    }
+    optionOffsets_.push_back(static_cast<int32_t>(optionNumbers_.size()));
+
+    payloadOffsets_.push_back(view.payload != nullptr ? static_cast<uint32_t>(view.payload - datagram) : 0);
+    payloadLengths_.push_back(static_cast<uint32_t>(view.payload_length));
+}
+
+void CoapPacketBatch::appendError(CoapError error) {
+    appendRow(false, error);
+    types_.push_back(0);
+    codes_.push_back(0);
+    messageIds_.push_back(0);
+    tokenOffsets_.push_back(tokenOffsets_.back());
+    optionOffsets_.push_back(optionOffsets_.back());
+    payloadOffsets_.push_back(0);
+    payloadLengths_.push_back(0);
+}
+
+size_t CoapPacketBatch::size() const {
+    return types_.size();
+}
+
+size_t CoapPacketBatch::getValidCount() const {
+    return validCount_;
+}
+
+bool CoapPacketBatch::isValid(size_t row) const {
+    return (validity_[row >> 3] >> (row & 7)) & 1;
+}
+
+const uint8_t* CoapPacketBatch::getTypes() const { return types_.data(); }
+const uint8_t* CoapPacketBatch::getCodes() const { return codes_.data(); }
+const uint16_t* CoapPacketBatch::getMessageIds() const { return messageIds_.data(); }
+const uint32_t* CoapPacketBatch::getPayloadOffsets() const { return payloadOffsets_.data(); }
+const uint32_t* CoapPacketBatch::getPayloadLengths() const { return payloadLengths_.data(); }
+const uint8_t* CoapPacketBatch::getErrors() const { return errors_.data(); }
+const uint8_t* CoapPacketBatch::getValidity() const { return validity_.data(); }
+const int32_t* CoapPacketBatch::getTokenOffsets() const { return tokenOffsets_.data(); }
+const uint8_t* CoapPacketBatch::getTokenData() const { return tokenData_.data(); }
+const int32_t* CoapPacketBatch::getOptionOffsets() const { return optionOffsets_.data(); }
+const uint16_t* CoapPacketBatch::getOptionNumbers() const { return optionNumbers_.data(); }
+const uint32_t* CoapPacketBatch::getOptionValueOffsets() const { return optionValueOffsets_.data(); }
+const uint16_t* CoapPacketBatch::getOptionValueLengths() const { return optionValueLengths_.data(); }
+
+size_t CoapPacketBatch::getOptionCount() const {
+    return optionNumbers_.size();
+}
+
+CoapError CoapPacketBatch::exportArrow(ArrowSchema* schema, ArrowArray* array) const {
+    if (schema == nullptr || array == nullptr) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+
+    static const char* const names[] = {
+        "type", "code", "message_id", "token", "options", "payload_offset", "payload_length"
+    };
+    static const char* const formats[] = {"C", "C", "S", "z", "+l", "I", "I"};
+    const size_t fieldCount = sizeof(formats) / sizeof(formats[0]);
+
+    size_t rows = size();
+    size_t nullCount = rows - validCount_;
+
+    // Schema: struct of the columns, invalid rows are null at struct level
+    initArrowSchema(schema, "+s", "", fieldCount);
+    schema->flags = ARROW_FLAG_NULLABLE;
+    for (size_t i = 0; i < fieldCount; i++) {
+        initArrowSchema(schema->children[i], formats[i], names[i], (i == 4) ? 1 : 0);
+    }
+    initArrowSchema(schema->children[4]->children[0], "S", "item", 0);
+
+    // Array: column buffers are referenced, not copied
+    initArrowArray(array, rows, nullCount, nullCount > 0 ? columnData(validity_.data()) : nullptr,
+                   nullptr, nullptr, 1, fieldCount);
+    initArrowArray(array->children[0], rows, 0, nullptr, columnData(types_.data()), nullptr, 2, 0);
+    initArrowArray(array->children[1], rows, 0, nullptr, columnData(codes_.data()), nullptr, 2, 0);
+    initArrowArray(array->children[2], rows, 0, nullptr, columnData(messageIds_.data()), nullptr, 2, 0);
+    initArrowArray(array->children[3], rows, 0, nullptr, tokenOffsets_.data(),
+                   columnData(tokenData_.data()), 3, 0);
+    initArrowArray(array->children[4], rows, 0, nullptr, optionOffsets_.data(), nullptr, 2, 1);
+    initArrowArray(array->children[4]->children[0], optionNumbers_.size(), 0, nullptr,
+                   columnData(optionNumbers_.data()), nullptr, 2, 0);
+    initArrowArray(array->children[5], rows, 0, nullptr, columnData(payloadOffsets_.data()), nullptr, 2, 0);
+    initArrowArray(array->children[6], rows, 0, nullptr, columnData(payloadLengths_.data()), nullptr, 2, 0);
+
+    return CoapError::OK;
+}
+
+void CoapPacketBatch::appendRow(bool valid, CoapError error) {
+    size_t row = size();
+    if ((row & 7) == 0) {
+        validity_.push_back(0);
+    }
+    if (valid) {
+        validity_[row >> 3] |= static_cast<uint8_t>(1u << (row & 7));
+        validCount_++;
+    }
+    errors_.push_back(static_cast<uint8_t>(error));
+}
+
+CoapMemoryUsage CoapPacketBatch::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.addArray(types_.size(), types_.capacity(), sizeof(uint8_t));
+    usage.addArray(codes_.size(), codes_.capacity(), sizeof(uint8_t));
+    usage.addArray(messageIds_.size(), messageIds_.capacity(), sizeof(uint16_t));
+    usage.addArray(tokenOffsets_.size(), tokenOffsets_.capacity(), sizeof(int32_t));
+    usage.addArray(tokenData_.size(), tokenData_.capacity(), sizeof(uint8_t));
+    usage.addArray(optionOffsets_.size(), optionOffsets_.capacity(), sizeof(int32_t));
+    usage.addArray(optionNumbers_.size(), optionNumbers_.capacity(), sizeof(uint16_t));
+    usage.addArray(optionValueOffsets_.size(), optionValueOffsets_.capacity(), sizeof(uint32_t));
+    usage.addArray(optionValueLengths_.size(), optionValueLengths_.capacity(), sizeof(uint16_t));
+    usage.addArray(payloadOffsets_.size(), payloadOffsets_.capacity(), sizeof(uint32_t));
+    usage.addArray(payloadLengths_.size(), payloadLengths_.capacity(), sizeof(uint32_t));
+    usage.addArray(errors_.size(), errors_.capacity(), sizeof(uint8_t));
+    usage.addArray(validity_.size(), validity_.capacity(), sizeof(uint8_t));
+    usage.entries = size();
+    return usage;
+}
+
+} // namespace CoapPacket
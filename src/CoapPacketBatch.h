@@ -0,0 +1,161 @@
+#ifndef COAP_PACKET_BATCH_H
+#define COAP_PACKET_BATCH_H
+
+#include "CoapMemory.h"
+#include "CoapPacketView.h"
+#include "CoapError.h"
+#include <vector>
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+// Apache Arrow C data interface (ABI-stable, copied from the specification)
+extern "C" {
+
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+
+} // extern "C"
+
+#endif // ARROW_C_DATA_INTERFACE
+
+namespace CoapPacket {
+
+/**
+ * Columnar (structure-of-arrays) container for many parsed messages
+ *
+ * One row per input datagram. Rows that failed to parse are kept (with
+ * zeroed columns) so row i always matches datagram i; the validity bitmap
+ * and error column tell them apart. Variable-length columns use Arrow
+ * layouts: int32 offsets with size()+1 entries and an LSB-first bitmap.
+ * Option values and payloads are not copied; their offsets are relative
+ * to the start of the row's datagram.
+ */
+class CoapPacketBatch {
+public:
+    CoapPacketBatch();
+
+    /**
+     * Remove all rows (capacity is kept)
+     */
+    void clear();
+
+    /**
+     * Reserve space for messages and their options
+     */
+    void reserve(size_t messages, size_t options);
+
+    /**
+     * Append a parsed message; view must point into datagram
+     */
+    void append(const CoapPacketView& view, const uint8_t* datagram);
+
+    /**
+     * Append a row for a datagram that failed to parse
+     */
+    void appendError(CoapError error);
+
+    /**
+     * Get number of rows
+     */
+    size_t size() const;
+
+    /**
+     * Get number of rows that parsed successfully
+     */
+    size_t getValidCount() const;
+
+    /**
+     * Check whether row parsed successfully
+     */
+    bool isValid(size_t row) const;
+
+    // Fixed-width columns (size() entries)
+    const uint8_t* getTypes() const;
+    const uint8_t* getCodes() const;
+    const uint16_t* getMessageIds() const;
+    const uint32_t* getPayloadOffsets() const;
+    const uint32_t* getPayloadLengths() const;
+    const uint8_t* getErrors() const;      // CoapError values
+    const uint8_t* getValidity() const;    // Bitmap, bit set for valid rows
+
+    // Token column (Arrow binary: size() + 1 offsets into token data)
+    const int32_t* getTokenOffsets() const;
+    const uint8_t* getTokenData() const;
+
+    // Option columns (size() + 1 offsets into the per-option columns)
+    const int32_t* getOptionOffsets() const;
+    const uint16_t* getOptionNumbers() const;
+    const uint32_t* getOptionValueOffsets() const;
+    const uint16_t* getOptionValueLengths() const;
+
+    /**
+     * Get total number of options in all rows
+     */
+    size_t getOptionCount() const;
+
+    /**
+     * Export as an Arrow struct array without copying column data
+     * Fields: type, code, message_id, token, options (list of option
+     * numbers), payload_offset, payload_length. The batch must not be
+     * modified or destroyed until both are released.
+     */
+    CoapError exportArrow(ArrowSchema* schema, ArrowArray* array) const;
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts rows
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    std::vector<uint8_t> types_;
+    std::vector<uint8_t> codes_;
+    std::vector<uint16_t> messageIds_;
+    std::vector<int32_t> tokenOffsets_;
+    std::vector<uint8_t> tokenData_;
+    std::vector<int32_t> optionOffsets_;
+    std::vector<uint16_t> optionNumbers_;
+    std::vector<uint32_t> optionValueOffsets_;
+    std::vector<uint16_t> optionValueLengths_;
+    std::vector<uint32_t> payloadOffsets_;
+    std::vector<uint32_t> payloadLengths_;
+    std::vector<uint8_t> errors_;
+    std::vector<uint8_t> validity_;
+    size_t validCount_;
+
+    /**
+     * Append the fixed-width part of a row
+     */
+    void appendRow(bool valid, CoapError error);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_PACKET_BATCH_H
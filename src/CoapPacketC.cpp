@@ -0,0 +1,129 @@
+#include "CoapPacketC.h"
+#include "CoapParser.h"
+#include "CoapWriter.h"
+
+using namespace CoapPacket;
+
+static_assert(static_cast<int>(COAP_ERR_INVALID_ARGUMENT) == static_cast<int>(CoapError::INVALID_ARGUMENT),
+              "coap_error_t must mirror CoapError");
+static_assert(static_cast<int>(COAP_ERR_TRANSPORT_ERROR) == static_cast<int>(CoapError::TRANSPORT_ERROR),
+              "coap_error_t must mirror CoapError");
+static_assert(static_cast<int>(COAP_ERR_BUFFER_TOO_SMALL) == static_cast<int>(CoapError::BUFFER_TOO_SMALL),
+              "coap_error_t must mirror CoapError");
+
+namespace {
+
+coap_error_t toCError(CoapError error) {
+    return static_cast<coap_error_t>(error);
+}
+
+} // namespace
+
+extern "C" {
+
+coap_error_t coap_parse_view(const uint8_t* buffer, size_t length, coap_view_t* view) {
+    if (buffer == nullptr || view == nullptr) {
+        return COAP_ERR_INVALID_ARGUMENT;
+    }
+
+    CoapPacketView parsed;
+    CoapError err = CoapParser::parseView(buffer, length, parsed);
+    if (err != CoapError::OK) {
+        return toCError(err);
+    }
+
+    view->type = static_cast<uint8_t>(parsed.type);
+    view->code = static_cast<uint8_t>(parsed.code);
+    view->message_id = parsed.message_id;
+    view->token = parsed.token;
+    view->token_length = parsed.token_length;
+    view->options = parsed.options;
+    view->options_length = parsed.options_length;
+    view->payload = parsed.payload;
+    view->payload_length = parsed.payload_length;
+    return COAP_OK;
+}
+
+coap_error_t coap_build_into(const coap_message_t* message, uint8_t* out, size_t capacity,
+                             size_t* out_length) {
+    if (message == nullptr || out == nullptr || out_length == nullptr ||
+        (message->option_count > 0 && message->options == nullptr)) {
+        return COAP_ERR_INVALID_ARGUMENT;
+    }
+
+    CoapWriter writer(out, capacity);
+    writer.begin(static_cast<CoapType>(message->type & 0x03), static_cast<CoapCode>(message->code),
+                 message->message_id, message->token, message->token_length);
+    for (size_t i = 0; i < message->option_count; i++) {
+        const coap_option_t& option = message->options[i];
+        writer.addOption(static_cast<CoapOptionNumber>(option.number), option.value, option.length);
+    }
+    if (message->payload_length > 0) {
+        writer.setPayload(message->payload, message->payload_length);
+    }
+    return toCError(writer.finish(*out_length));
+}
+
+void coap_option_iter_init(coap_option_iter_t* iter, const coap_view_t* view) {
+    iter->buffer = view->options;
+    iter->length = view->options_length;
+    iter->offset = 0;
+    iter->last_number = 0;
+    iter->error = COAP_OK;
+}
+
+int coap_option_iter_next(coap_option_iter_t* iter, coap_option_t* option) {
+    if (iter->error != COAP_OK || iter->offset >= iter->length) {
+        return 0;
+    }
+
+    // A fresh iterator at the saved offset decodes the delta from zero
+    CoapOptionIterator it(iter->buffer, iter->length, iter->offset);
+    CoapOptionRef ref;
+    if (!it.next(ref)) {
+        iter->error = toCError(it.getError());
+        iter->offset = iter->length;
+        return 0;
+    }
+
+    uint32_t number = static_cast<uint32_t>(iter->last_number) + ref.number;
+    if (number > 0xFFFF) {
+        iter->error = COAP_ERR_INVALID_FORMAT;
+        return 0;
+    }
+
+    option->number = static_cast<uint16_t>(number);
+    option->length = ref.length;
+    option->value = ref.value;
+    iter->last_number = option->number;
+    iter->offset = it.getOffset();
+    return 1;
+}
+
+coap_error_t coap_option_iter_error(const coap_option_iter_t* iter) {
+    return iter->error;
+}
+
+int coap_find_option(const coap_view_t* view, uint16_t number, coap_option_t* option) {
+    coap_option_iter_t iter;
+    coap_option_iter_init(&iter, view);
+    while (coap_option_iter_next(&iter, option)) {
+        if (option->number == number) {
+            return 1;
+        }
+        if (option->number > number) {
+            break;
+        }
+    }
+    return 0;
+}
+
+uint32_t coap_decode_uint(const uint8_t* value, size_t length) {
+    return decodeUintValue(value, length);
+}
+
+const char* coap_error_message(coap_error_t error) {
+    return getErrorMessage(static_cast<CoapError>(error));
+}
+
+} // extern "C"
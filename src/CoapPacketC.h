@@ -0,0 +1,139 @@
+#ifndef COAP_PACKET_C_H
+#define COAP_PACKET_C_H
+
+/**
+ * Stable C API
+ *
+ * All functions work on caller-owned memory; no C++ objects cross the
+ * boundary and nothing is allocated. Views and options point into the
+ * parsed buffer, which must outlive them.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Error codes (same values as CoapPacket::CoapError)
+ */
+typedef enum {
+    COAP_OK = 0,
+    COAP_ERR_DATAGRAM_TOO_SHORT,
+    COAP_ERR_INVALID_VERSION,
+    COAP_ERR_INVALID_TOKEN_LENGTH,
+    COAP_ERR_INVALID_CODE_CLASS,
+    COAP_ERR_INVALID_FORMAT,
+    COAP_ERR_TOO_MANY_OPTIONS,
+    COAP_ERR_OPTION_TOO_LONG,
+    COAP_ERR_PAYLOAD_TOO_LARGE,
+    COAP_ERR_MISSING_REQUIRED_FIELD,
+    COAP_ERR_INVALID_OPTION_NUMBER,
+    COAP_ERR_BUFFER_TOO_SMALL,
+    COAP_ERR_OUT_OF_MEMORY,
+    COAP_ERR_INVALID_ARGUMENT,
+    COAP_ERR_CONNECTION_CLOSED,
+    COAP_ERR_TRANSPORT_ERROR
+} coap_error_t;
+
+/**
+ * Zero-copy view of a parsed message
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t code;
+    uint16_t message_id;
+    const uint8_t* token;
+    uint8_t token_length;
+    const uint8_t* options;     /* Encoded option block */
+    size_t options_length;
+    const uint8_t* payload;     /* NULL if there is no payload */
+    size_t payload_length;
+} coap_view_t;
+
+/**
+ * A single option
+ */
+typedef struct {
+    uint16_t number;
+    uint16_t length;
+    const uint8_t* value;
+} coap_option_t;
+
+/**
+ * Option iterator state (treat as opaque)
+ */
+typedef struct {
+    const uint8_t* buffer;
+    size_t length;
+    size_t offset;
+    uint16_t last_number;
+    coap_error_t error;
+} coap_option_iter_t;
+
+/**
+ * Message description for coap_build_into
+ * Options must be sorted by ascending option number.
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t code;
+    uint16_t message_id;
+    const uint8_t* token;
+    uint8_t token_length;
+    const coap_option_t* options;
+    size_t option_count;
+    const uint8_t* payload;
+    size_t payload_length;
+} coap_message_t;
+
+/**
+ * Parse a UDP datagram into a view
+ */
+coap_error_t coap_parse_view(const uint8_t* buffer, size_t length, coap_view_t* view);
+
+/**
+ * Encode a message into out; out_length is set to the encoded size
+ */
+coap_error_t coap_build_into(const coap_message_t* message, uint8_t* out, size_t capacity,
+                             size_t* out_length);
+
+/**
+ * Start iterating the options of a view
+ */
+void coap_option_iter_init(coap_option_iter_t* iter, const coap_view_t* view);
+
+/**
+ * Get the next option
+ * Returns 1 if an option was stored, 0 at the end or on error
+ */
+int coap_option_iter_next(coap_option_iter_t* iter, coap_option_t* option);
+
+/**
+ * Get the error that stopped iteration (COAP_OK if none)
+ */
+coap_error_t coap_option_iter_error(const coap_option_iter_t* iter);
+
+/**
+ * Find the first option with the given number
+ * Returns 1 if found, 0 otherwise
+ */
+int coap_find_option(const coap_view_t* view, uint16_t number, coap_option_t* option);
+
+/**
+ * Decode a uint option value (variable-length big-endian)
+ */
+uint32_t coap_decode_uint(const uint8_t* value, size_t length);
+
+/**
+ * Get human-readable error message
+ */
+const char* coap_error_message(coap_error_t error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COAP_PACKET_C_H */
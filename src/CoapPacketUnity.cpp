@@ -0,0 +1,104 @@
+// Single translation unit build of the library
+// Features are selected in CoapConfig.h. Helpers in anonymous namespaces
+// share one scope here, so their names must be unique across files.
+
+#include "CoapConfig.h"
+
+#include "CoapOptions.cpp"
+
+#if COAP_PACKET_FEATURE_VIEW
+#include "CoapParserView.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_WRITER
+#include "CoapWriter.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_EDITOR
+#include "CoapEditor.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_FILTER
+#include "CoapFilter.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_FORMATTER
+#include "CoapFormatter.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_HASH
+#include "CoapHash.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_COMPARE
+#include "CoapCompare.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_ACK_BATCH
+#include "CoapAckBatch.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_PARSER
+#include "CoapParser.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_BUILDER
+#include "CoapBuilder.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_STRING_TABLE
+#include "CoapStringTable.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_BATCH
+#include "CoapPacketBatch.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_RECORDER
+#include "CoapFlightRecorder.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_LINK_FORMAT
+#include "CoapLinkFormat.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_TIMER
+#include "CoapTimerWheel.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_RD
+#include "CoapResourceDirectory.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_SCHEDULER
+#include "CoapResponseScheduler.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_SIM
+#include "CoapSimNetwork.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_TRACING
+#include "CoapTracing.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_RELIABLE
+#include "CoapTcpCodec.cpp"
+#include "CoapWebSocket.cpp"
+#include "CoapStreamDecoder.cpp"
+#endif
+
+#if COAP_PACKET_FEATURE_TRANSPORT
+#include "CoapTransport.cpp"
+#include "CoapEndpoint.cpp"
+#include "CoapDtls.cpp"
+#endif
+
+#if COAP_PACKET_WITH_OPENSSL
+#include "CoapOpenSsl.cpp"
+#endif
+
+// Keep last: it brings namespace CoapPacket into scope
+#if COAP_PACKET_FEATURE_C_API
+#include "CoapPacketC.cpp"
+#endif
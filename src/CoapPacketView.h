@@ -0,0 +1,56 @@
+#ifndef COAP_PACKET_VIEW_H
+#define COAP_PACKET_VIEW_H
+
+#include "CoapTypes.h"
+#include "CoapOptions.h"
+#include "CoapToken.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+/**
+ * Zero-copy view of an encoded CoAP message
+ * Token, options and payload point into the parsed buffer, which must
+ * outlive the view.
+ */
+struct CoapPacketView {
+    CoapType type;
+    CoapCode code;
+    uint16_t message_id;
+    const uint8_t* token;
+    uint8_t token_length;
+    const uint8_t* options;     // Encoded option block (without payload marker)
+    size_t options_length;
+    const uint8_t* payload;
+    size_t payload_length;
+
+    CoapPacketView()
+        : type(CoapType::CON)
+        , code(CoapCode::EMPTY)
+        , message_id(0)
+        , token(nullptr)
+        , token_length(0)
+        , options(nullptr)
+        , options_length(0)
+        , payload(nullptr)
+        , payload_length(0) {}
+
+    /**
+     * Get an iterator over the encoded options
+     */
+    CoapOptionIterator getOptions() const {
+        return CoapOptionIterator(options, options_length, 0);
+    }
+
+    /**
+     * Get token as a hashable key (see CoapToken.h)
+     */
+    CoapTokenKey getTokenKey() const {
+        return CoapTokenKey(loadToken(token, token_length), token_length);
+    }
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_PACKET_VIEW_H
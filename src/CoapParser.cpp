@@ -1,18 +1,95 @@
 #include "CoapParser.h"
+#include "CoapOptions.h"
+#if COAP_PACKET_FEATURE_STRING_TABLE
+#include "CoapStringTable.h"
+#endif
 #include <cstring>
 
 namespace CoapPacket {
 
+#if COAP_PACKET_FEATURE_STRING_TABLE
+namespace {
+
+bool isStringOption(uint16_t number) {
+    switch (static_cast<CoapOptionNumber>(number)) {
+        case CoapOptionNumber::URI_HOST:
+        case CoapOptionNumber::LOCATION_PATH:
+        case CoapOptionNumber::URI_PATH:
+        case CoapOptionNumber::URI_QUERY:
+        case CoapOptionNumber::LOCATION_QUERY:
+        case CoapOptionNumber::PROXY_URI:
+        case CoapOptionNumber::PROXY_SCHEME:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+#endif
+
 CoapError CoapParser::parse(const uint8_t* buffer, size_t length, CoapPacket& packet) {
+    size_t offset = 0;
+    bool hasPayload = false;
+    CoapError err = parseHead(buffer, length, packet, offset, hasPayload);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    // 5. Parse payload (if marker found)
+    if (hasPayload) {
+        if (offset >= length) {
+            // Payload marker present but no payload data (error)
+            return CoapError::INVALID_FORMAT;
+        }
+
+        size_t payloadLength = length - offset;
+        if (payloadLength > MAX_PAYLOAD_SIZE) {
+            return CoapError::PAYLOAD_TOO_LARGE;
+        }
+
+        packet.payload.assign(buffer + offset, buffer + length);
+    }
+
+    return CoapError::OK;
+}
+
+CoapError CoapParser::parseExternal(const uint8_t* buffer, size_t length, CoapPacket& packet,
+                                    const std::shared_ptr<const void>& owner, size_t maxPayloadSize) {
+    size_t offset = 0;
+    bool hasPayload = false;
+    CoapError err = parseHead(buffer, length, packet, offset, hasPayload);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    if (hasPayload) {
+        if (offset >= length) {
+            return CoapError::INVALID_FORMAT;
+        }
+        if (length - offset > maxPayloadSize) {
+            return CoapError::PAYLOAD_TOO_LARGE;
+        }
+
+        // Payload stays in the receive buffer
+        packet.setPayloadRef(buffer + offset, length - offset, owner);
+    }
+
+    return CoapError::OK;
+}
+
+CoapError CoapParser::parseHead(const uint8_t* buffer, size_t length, CoapPacket& packet,
+                                size_t& offset, bool& hasPayload) {
     // Clear packet first
     packet.clear();
+    hasPayload = false;
 
     // 1. Check minimum size (4-byte header)
     if (length < 4) {
         return CoapError::DATAGRAM_TOO_SHORT;
     }
 
-    size_t offset = 0;
+    offset = 0;
 
     // 2. Parse header (4 bytes)
     uint8_t versionTypeToken = buffer[offset++];
@@ -27,9 +104,9 @@ CoapError CoapParser::parse(const uint8_t* buffer, size_t length, CoapPacket& pa
     // Extract type (bits 4-5)
     packet.type = static_cast<CoapType>((versionTypeToken >> 4) & 0x03);
 
-    // Extract token length (bits 0-3)
-    packet.token_length = versionTypeToken & 0x0F;
-    if (packet.token_length > 8) {
+    // Extract token length (bits 0-3); stored with the token once it is read
+    uint8_t tokenLength = versionTypeToken & 0x0F;
+    if (tokenLength > 8) {
         return CoapError::INVALID_TOKEN_LENGTH;
     }
 
@@ -48,16 +125,15 @@ CoapError CoapParser::parse(const uint8_t* buffer, size_t length, CoapPacket& pa
     offset += 2;
 
     // 3. Parse token (if any)
-    if (packet.token_length > 0) {
-        if (offset + packet.token_length > length) {
+    if (tokenLength > 0) {
+        if (offset + tokenLength > length) {
             return CoapError::DATAGRAM_TOO_SHORT;
         }
-        std::memcpy(packet.token, buffer + offset, packet.token_length);
-        offset += packet.token_length;
+        packet.setToken(buffer + offset, tokenLength);
+        offset += tokenLength;
     }
 
     // 4. Parse options (if any remain)
-    bool hasPayload = false;
     if (offset < length) {
         CoapError err = parseOptions(buffer, length, offset, packet.options, hasPayload);
         if (err != CoapError::OK) {
@@ -65,21 +141,6 @@ CoapError CoapParser::parse(const uint8_t* buffer, size_t length, CoapPacket& pa
         }
     }
 
-    // 5. Parse payload (if marker found)
-    if (hasPayload) {
-        if (offset >= length) {
-            // Payload marker present but no payload data (error)
-            return CoapError::INVALID_FORMAT;
-        }
-
-        size_t payloadLength = length - offset;
-        if (payloadLength > MAX_PAYLOAD_SIZE) {
-            return CoapError::PAYLOAD_TOO_LARGE;
-        }
-
-        packet.payload.assign(buffer + offset, buffer + length);
-    }
-
     return CoapError::OK;
 }
 
@@ -87,110 +148,37 @@ CoapError CoapParser::parse(const std::vector<uint8_t>& buffer, CoapPacket& pack
     return parse(buffer.data(), buffer.size(), packet);
 }
 
-CoapError CoapParser::decodeOptionDeltaLength(const uint8_t* buffer, size_t bufferLen,
-                                               size_t& offset, uint8_t field, uint16_t& result) {
-    if (field < 13) {
-        // Value is in the 4-bit field itself
-        result = field;
-        return CoapError::OK;
-    } else if (field == 13) {
-        // 8-bit extended value
-        if (offset >= bufferLen) {
-            return CoapError::DATAGRAM_TOO_SHORT;
-        }
-        result = buffer[offset++] + 13;
-        return CoapError::OK;
-    } else if (field == 14) {
-        // 16-bit extended value (big-endian)
-        if (offset + 1 >= bufferLen) {
-            return CoapError::DATAGRAM_TOO_SHORT;
-        }
-        result = ((static_cast<uint16_t>(buffer[offset]) << 8) |
-                  static_cast<uint16_t>(buffer[offset + 1])) + 269;
-        offset += 2;
-        return CoapError::OK;
-    } else {
-        // Field == 15
-        // This is either payload marker (when both delta and length are 15)
-        // or an error
-        return CoapError::INVALID_FORMAT;
-    }
-}
-
 CoapError CoapParser::parseOptions(const uint8_t* buffer, size_t bufferLen,
                                     size_t& offset, std::vector<CoapOption>& options,
                                     bool& hasPayload) {
-    hasPayload = false;
-    uint16_t lastOptionNumber = 0;
-
-    while (offset < bufferLen) {
-        uint8_t deltaLengthByte = buffer[offset];
-
-        // Check for payload marker (0xFF)
-        if (deltaLengthByte == PAYLOAD_MARKER) {
-            hasPayload = true;
-            offset++;  // Skip marker
-            return CoapError::OK;
-        }
-
-        offset++;
-
-        // Extract delta and length fields (4 bits each)
-        uint8_t deltaField = (deltaLengthByte >> 4) & 0x0F;
-        uint8_t lengthField = deltaLengthByte & 0x0F;
-
-        // Decode delta
-        uint16_t delta = 0;
-        CoapError err = decodeOptionDeltaLength(buffer, bufferLen, offset, deltaField, delta);
-        if (err != CoapError::OK) {
-            return err;
-        }
-
-        // Decode length
-        uint16_t length = 0;
-        err = decodeOptionDeltaLength(buffer, bufferLen, offset, lengthField, length);
-        if (err != CoapError::OK) {
-            return err;
-        }
-
-        // Calculate absolute option number
-        uint16_t optionNumber = lastOptionNumber + delta;
-        lastOptionNumber = optionNumber;
-
-        // Check if option value fits in buffer
-        if (offset + length > bufferLen) {
-            return CoapError::DATAGRAM_TOO_SHORT;
-        }
-
-        // Check option length limit
-        if (length > MAX_OPTION_VALUE_SIZE) {
-            return CoapError::OPTION_TOO_LONG;
-        }
-
-        // Extract option value
+    CoapOptionIterator it(buffer, bufferLen, offset);
+    CoapOptionRef ref;
+    while (it.next(ref)) {
         CoapOption option;
-        option.number = optionNumber;
-        if (length > 0) {
-            option.value.assign(buffer + offset, buffer + offset + length);
-            offset += length;
-        }
-
+        option.number = ref.number;
+        option.value.assign(ref.value, ref.value + ref.length);
         options.push_back(option);
     }
 
-    return CoapError::OK;
+    hasPayload = it.hasPayload();
+    offset = it.getOffset() + (hasPayload ? 1 : 0);
+    return it.getError();
 }
 
-uint32_t CoapParser::decodeUint(const uint8_t* data, size_t length) {
-    if (length == 0) {
-        return 0;
+#if COAP_PACKET_FEATURE_STRING_TABLE
+CoapError CoapParser::parse(const uint8_t* buffer, size_t length, CoapPacket& packet,
+                            const CoapStringTable& table) {
+    CoapError err = parse(buffer, length, packet);
+    if (err != CoapError::OK) {
+        return err;
     }
-
-    uint32_t value = 0;
-    for (size_t i = 0; i < length && i < 4; i++) {
-        value = (value << 8) | data[i];
+    for (CoapOption& option : packet.options) {
+        if (isStringOption(option.number)) {
+            option.value_id = table.find(option.value.data(), option.value.size());
+        }
     }
-    return value;
+    return CoapError::OK;
 }
+#endif
 
 } // namespace CoapPacket
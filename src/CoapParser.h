@@ -1,12 +1,18 @@
 #ifndef COAP_PARSER_H
 #define COAP_PARSER_H
 
+#include "CoapConfig.h"
 #include "CoapPacket.h"
+#include "CoapPacketView.h"
 #include "CoapError.h"
+#include <memory>
 #include <vector>
 
 namespace CoapPacket {
 
+class CoapPacketBatch;
+class CoapStringTable;
+
 /**
  * Parser class for parsing CoAP packets from UDP datagrams
  */
@@ -18,32 +24,84 @@ public:
      */
     static CoapError parse(const uint8_t* buffer, size_t length, CoapPacket& packet);
 
+#if COAP_PACKET_FEATURE_STRING_TABLE
+    /**
+     * Parse CoAP packet and set value_id of string options (Uri-Host,
+     * Uri-Path, Uri-Query, Location-*, Proxy-*) found in table
+     * The table is only read; values not in it get value_id 0.
+     */
+    static CoapError parse(const uint8_t* buffer, size_t length, CoapPacket& packet,
+                           const CoapStringTable& table);
+#endif
+
+    /**
+     * Parse CoAP packet, referencing the payload in buffer instead of copying it
+     * owner (typically the receive buffer) is stored in the packet to keep
+     * buffer alive; with an empty owner the caller must keep buffer valid
+     * while the packet is used. maxPayloadSize lifts the MAX_PAYLOAD_SIZE
+     * limit for large messages (e.g. RFC 8323 transports).
+     */
+    static CoapError parseExternal(const uint8_t* buffer, size_t length, CoapPacket& packet,
+                                   const std::shared_ptr<const void>& owner = nullptr,
+                                   size_t maxPayloadSize = MAX_PAYLOAD_SIZE);
+
     /**
      * Parse CoAP packet from vector
      * Returns CoapError::OK on success, error code otherwise
      */
     static CoapError parse(const std::vector<uint8_t>& buffer, CoapPacket& packet);
 
+    /**
+     * Parse CoAP packet into a zero-copy view of the buffer
+     * Returns CoapError::OK on success, error code otherwise
+     */
+    static CoapError parseView(const uint8_t* buffer, size_t length, CoapPacketView& view);
+
+    /**
+     * Parse the option block and payload starting at offset into a view
+     * Shared by the UDP and reliable transport (RFC 8323) parsers
+     */
+    static CoapError parseViewBody(const uint8_t* buffer, size_t length, size_t offset,
+                                   CoapPacketView& view);
+
+    /**
+     * Locate the payload with minimal work, jumping over options by their lengths
+     * Only the framing needed to find the payload is checked; option numbers
+     * and value limits are not. Call validate() for the full checks.
+     * payload is set to nullptr (and payloadLength to 0) if there is none
+     */
+    static CoapError locatePayload(const uint8_t* buffer, size_t length,
+                                   const uint8_t*& payload, size_t& payloadLength);
+
+    /**
+     * Fully validate an encoded message without storing anything
+     * (deferred second pass after locatePayload)
+     */
+    static CoapError validate(const uint8_t* buffer, size_t length);
+
+#if COAP_PACKET_FEATURE_BATCH
+    /**
+     * Parse many datagrams into columnar storage, one row per datagram
+     * Returns number of datagrams that parsed successfully
+     */
+    static size_t parseBatch(const uint8_t* const* datagrams, const size_t* lengths, size_t count,
+                             CoapPacketBatch& batch);
+#endif
+
 private:
     /**
-     * Decode option delta or length value
-     * Returns decoded value and updates offset
+     * Parse header, token and options; offset is left at the payload
      */
-    static CoapError decodeOptionDeltaLength(const uint8_t* buffer, size_t bufferLen,
-                                             size_t& offset, uint8_t field, uint16_t& result);
+    static CoapError parseHead(const uint8_t* buffer, size_t length, CoapPacket& packet,
+                               size_t& offset, bool& hasPayload);
 
     /**
-     * Parse all options from buffer
-     * Returns pointer to payload start (or nullptr if no payload)
+     * Copy all options from buffer (decoded by CoapOptionIterator)
+     * offset is left after the payload marker if there is one
      */
     static CoapError parseOptions(const uint8_t* buffer, size_t bufferLen,
                                    size_t& offset, std::vector<CoapOption>& options,
                                    bool& hasPayload);
-
-    /**
-     * Decode uint from variable-length big-endian bytes
-     */
-    static uint32_t decodeUint(const uint8_t* data, size_t length);
 };
 
 } // namespace CoapPacket
@@ -0,0 +1,139 @@
+#include "CoapParser.h"
+#if COAP_PACKET_FEATURE_BATCH
+#include "CoapPacketBatch.h"
+#endif
+
+namespace CoapPacket {
+
+CoapError CoapParser::parseView(const uint8_t* buffer, size_t length, CoapPacketView& view) {
+    view = CoapPacketView();
+
+    size_t offset = 0;
+    CoapError err = CoapOptionIterator::locateOptions(buffer, length, offset);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    view.type = static_cast<CoapType>((buffer[0] >> 4) & 0x03);
+    view.token_length = buffer[0] & 0x0F;
+    view.code = static_cast<CoapCode>(buffer[1]);
+    view.message_id = (static_cast<uint16_t>(buffer[2]) << 8) |
+                      static_cast<uint16_t>(buffer[3]);
+    view.token = buffer + 4;
+
+    err = parseViewBody(buffer, length, offset, view);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    if (view.payload_length > MAX_PAYLOAD_SIZE) {
+        return CoapError::PAYLOAD_TOO_LARGE;
+    }
+
+    return CoapError::OK;
+}
+
+CoapError CoapParser::parseViewBody(const uint8_t* buffer, size_t length, size_t offset,
+                                    CoapPacketView& view) {
+    CoapOptionIterator it(buffer, length, offset);
+    CoapOptionRef option;
+    while (it.next(option)) {
+    }
+
+    if (it.getError() != CoapError::OK) {
+        return it.getError();
+    }
+
+    view.options = buffer + offset;
+    view.options_length = it.getOffset() - offset;
+
+    if (it.hasPayload()) {
+        view.payload = buffer + it.getOffset() + 1;
+        view.payload_length = length - it.getOffset() - 1;
+    } else {
+        view.payload = nullptr;
+        view.payload_length = 0;
+    }
+
+    return CoapError::OK;
+}
+
+CoapError CoapParser::locatePayload(const uint8_t* buffer, size_t length,
+                                    const uint8_t*& payload, size_t& payloadLength) {
+    payload = nullptr;
+    payloadLength = 0;
+
+    if (length < 4) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    size_t offset = 4 + (buffer[0] & 0x0F);
+
+    while (offset < length) {
+        uint8_t deltaLengthByte = buffer[offset];
+        if (deltaLengthByte == PAYLOAD_MARKER) {
+            if (offset + 1 >= length) {
+                return CoapError::INVALID_FORMAT;
+            }
+            payload = buffer + offset + 1;
+            payloadLength = length - offset - 1;
+            return CoapError::OK;
+        }
+
+        uint8_t deltaField = deltaLengthByte >> 4;
+        uint8_t lengthField = deltaLengthByte & 0x0F;
+        if (deltaField == 15 || lengthField == 15) {
+            return CoapError::INVALID_FORMAT;
+        }
+
+        // Skip the header byte and extended delta; only the length is decoded
+        offset += 1 + (deltaField == 13 ? 1 : deltaField == 14 ? 2 : 0);
+
+        size_t valueLength = lengthField;
+        if (lengthField == 13) {
+            if (offset >= length) {
+                return CoapError::DATAGRAM_TOO_SHORT;
+            }
+            valueLength = buffer[offset] + 13;
+            offset += 1;
+        } else if (lengthField == 14) {
+            if (offset + 1 >= length) {
+                return CoapError::DATAGRAM_TOO_SHORT;
+            }
+            valueLength = ((static_cast<size_t>(buffer[offset]) << 8) | buffer[offset + 1]) + 269;
+            offset += 2;
+        }
+
+        offset += valueLength;
+    }
+
+    if (offset > length) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+    return CoapError::OK;
+}
+
+CoapError CoapParser::validate(const uint8_t* buffer, size_t length) {
+    CoapPacketView view;
+    return parseView(buffer, length, view);
+}
+
+#if COAP_PACKET_FEATURE_BATCH
+size_t CoapParser::parseBatch(const uint8_t* const* datagrams, const size_t* lengths, size_t count,
+                              CoapPacketBatch& batch) {
+    size_t valid = 0;
+    CoapPacketView view;
+    for (size_t i = 0; i < count; i++) {
+        CoapError err = parseView(datagrams[i], lengths[i], view);
+        if (err == CoapError::OK) {
+            batch.append(view, datagrams[i]);
+            valid++;
+        } else {
+            batch.appendError(err);
+        }
+    }
+    return valid;
+}
+#endif
+
+} // namespace CoapPacket
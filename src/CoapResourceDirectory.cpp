@@ -0,0 +1,945 @@
+#include "CoapResourceDirectory.h"
+#include "CoapHash.h"
+#include "CoapLinkFormat.h"
+#include "CoapOptions.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+namespace {
+
+const uint32_t RD_NO_STRING = 0xFFFFFFFFu;
+const uint32_t RD_DEAD_LINK = 0xFFFFFFFFu;
+
+// Dead links are compacted once there are this many and they outnumber live ones
+const size_t RD_COMPACT_MIN_DEAD = 256;
+
+bool parseDecimal(const std::string& text, uint32_t& value) {
+    if (text.empty() || text.size() > 10) {
+        return false;
+    }
+    uint64_t result = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        result = result * 10 + static_cast<uint64_t>(c - '0');
+    }
+    if (result > 0xFFFFFFFFu) {
+        return false;
+    }
+    value = static_cast<uint32_t>(result);
+    return true;
+}
+
+bool hasPrefix(const std::string& text, const std::string& prefix) {
+    return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+}
+
+/**
+ * Match a filter value against a parameter value, as a whole or against
+ * any of its space-separated tokens; a trailing '*' matches a prefix
+ */
+bool matchFilterValue(const std::string& actual, const std::string& filter) {
+    bool prefix = !filter.empty() && filter[filter.size() - 1] == '*';
+    std::string wanted = prefix ? filter.substr(0, filter.size() - 1) : filter;
+    if (prefix ? hasPrefix(actual, wanted) : actual == wanted) {
+        return true;
+    }
+    size_t pos = 0;
+    while (pos < actual.size()) {
+        size_t end = actual.find(' ', pos);
+        if (end == std::string::npos) {
+            end = actual.size();
+        }
+        size_t length = end - pos;
+        if (prefix ? (length >= wanted.size() && actual.compare(pos, wanted.size(), wanted) == 0)
+                   : (length == wanted.size() && actual.compare(pos, length, wanted) == 0)) {
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+bool isRegistrationFilter(const std::string& name) {
+    return name == "ep" || name == "d" || name == "base";
+}
+
+/**
+ * Collects the part of a comma-separated result that falls in one block
+ */
+struct RdSlice {
+    size_t offset;
+    size_t size;
+    size_t position;
+    bool first;
+    bool more;
+    std::string& out;
+
+    RdSlice(size_t sliceOffset, size_t sliceSize, std::string& output)
+        : offset(sliceOffset), size(sliceSize), position(0), first(true), more(false), out(output) {}
+
+    /**
+     * Add one entry; returns false once the slice is complete
+     */
+    bool add(const std::string& entry) {
+        size_t end = offset + size;
+        if (!first) {
+            addBytes(",", 1);
+        }
+        first = false;
+        addBytes(entry.data(), entry.size());
+        if (position > end) {
+            more = true;
+            return false;
+        }
+        return true;
+    }
+
+    void addBytes(const char* data, size_t length) {
+        size_t end = offset + size;
+        size_t from = (offset > position) ? offset - position : 0;
+        size_t to = (end > position) ? end - position : 0;
+        if (to > length) {
+            to = length;
+        }
+        if (from < to) {
+            out.append(data + from, to - from);
+        }
+        position += length;
+    }
+};
+
+CoapError validateLinkDocument(const char* links, size_t linksLength) {
+    CoapLinkParser parser(links, linksLength);
+    CoapLink link;
+    while (parser.next(link)) {
+        CoapLinkParamIterator params(link);
+        CoapLinkParam param;
+        while (params.next(param)) {}
+        if (params.getError() != CoapError::OK) {
+            return params.getError();
+        }
+    }
+    return parser.getError();
+}
+
+void appendDecimal(std::string& out, uint32_t value) {
+    char digits[10];
+    size_t pos = sizeof(digits);
+    do {
+        digits[--pos] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    out.append(digits + pos, sizeof(digits) - pos);
+}
+
+std::string optionString(const CoapOption& option) {
+    return std::string(option.value.begin(), option.value.end());
+}
+
+} // namespace
+
+CoapResourceDirectory::CoapResourceDirectory(uint64_t now)
+    : nextId_(1)
+    , liveLinks_(0)
+    , rtName_(0)
+    , ifName_(0)
+    , timers_(4096, now) {
+    rtName_ = intern("rt", 2);
+    ifName_ = intern("if", 2);
+}
+
+CoapError CoapResourceDirectory::registerEndpoint(const CoapRdRegistration& registration, const char* links,
+                                                  size_t linksLength, uint64_t now, uint32_t& id) {
+    if (registration.endpoint.empty()) {
+        return CoapError::MISSING_REQUIRED_FIELD;
+    }
+    if (registration.lifetime == 0) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+
+    // Validate the document before changing any state
+    CoapError err = validateLinkDocument(links, linksLength);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    expire(now);
+
+    uint32_t endpointId = intern(registration.endpoint.data(), registration.endpoint.size());
+    uint32_t sectorId = intern(registration.sector.data(), registration.sector.size());
+    uint32_t baseId = intern(registration.base.data(), registration.base.size());
+
+    // Same ep and d: replace the existing registration
+    uint32_t row = RD_NO_STRING;
+    Postings::const_iterator posting = epIndex_.find(endpointId);
+    if (posting != epIndex_.end()) {
+        for (uint32_t candidate : posting->second) {
+            if (regSector_[candidate] == sectorId) {
+                row = candidate;
+                break;
+            }
+        }
+    }
+
+    if (row != RD_NO_STRING) {
+        // The row already holds references to ep and d
+        release(endpointId);
+        release(sectorId);
+        release(regBase_[row]);
+        killLinks(row);
+    } else {
+        if (!freeRows_.empty()) {
+            row = freeRows_.back();
+            freeRows_.pop_back();
+        } else {
+            row = static_cast<uint32_t>(regId_.size());
+            regId_.push_back(0);
+            regEndpoint_.push_back(0);
+            regSector_.push_back(0);
+            regBase_.push_back(0);
+            regLifetime_.push_back(0);
+            regTimer_.push_back(TIMER_INVALID);
+            regLinkBegin_.push_back(0);
+            regLinkEnd_.push_back(0);
+        }
+        regId_[row] = nextId_++;
+        regEndpoint_[row] = endpointId;
+        regSector_[row] = sectorId;
+        regTimer_[row] = TIMER_INVALID;
+        idToRow_[regId_[row]] = row;
+        epIndex_[endpointId].push_back(row);
+    }
+
+    regBase_[row] = baseId;
+    regLifetime_[row] = registration.lifetime;
+    scheduleExpiry(row, now);
+    appendLinks(row, links, linksLength);
+    compactLinks();
+
+    id = regId_[row];
+    return CoapError::OK;
+}
+
+CoapError CoapResourceDirectory::updateRegistration(uint32_t id, uint32_t lifetime, const std::string& base,
+                                                    const char* links, size_t linksLength, uint64_t now) {
+    expire(now);
+    std::unordered_map<uint32_t, uint32_t>::const_iterator it = idToRow_.find(id);
+    if (it == idToRow_.end()) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    uint32_t row = it->second;
+
+    if (links != nullptr) {
+        CoapError err = validateLinkDocument(links, linksLength);
+        if (err != CoapError::OK) {
+            return err;
+        }
+        killLinks(row);
+        appendLinks(row, links, linksLength);
+        compactLinks();
+    }
+
+    if (lifetime > 0) {
+        regLifetime_[row] = lifetime;
+    }
+    if (!base.empty()) {
+        uint32_t baseId = intern(base.data(), base.size());
+        release(regBase_[row]);
+        regBase_[row] = baseId;
+    }
+    scheduleExpiry(row, now);
+    return CoapError::OK;
+}
+
+CoapError CoapResourceDirectory::removeRegistration(uint32_t id) {
+    std::unordered_map<uint32_t, uint32_t>::const_iterator it = idToRow_.find(id);
+    if (it == idToRow_.end()) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    timers_.cancel(regTimer_[it->second]);
+    removeRow(it->second);
+    compactLinks();
+    return CoapError::OK;
+}
+
+size_t CoapResourceDirectory::expire(uint64_t now) {
+    std::vector<uint64_t> expired;
+    timers_.advance(now, expired);
+
+    size_t removed = 0;
+    for (uint64_t cookie : expired) {
+        std::unordered_map<uint32_t, uint32_t>::const_iterator it = idToRow_.find(static_cast<uint32_t>(cookie));
+        if (it != idToRow_.end()) {
+            regTimer_[it->second] = TIMER_INVALID;
+            removeRow(it->second);
+            removed++;
+        }
+    }
+    if (removed > 0) {
+        compactLinks();
+    }
+    return removed;
+}
+
+CoapError CoapResourceDirectory::lookupResources(const CoapRdQuery& query, size_t offset, size_t size,
+                                                 std::string& out, bool& more) const {
+    out.clear();
+    more = false;
+
+    // Pick the indexed filter with the fewest candidate links
+    const std::vector<uint32_t>* linkCandidates = nullptr;
+    const std::vector<uint32_t>* rowCandidates = nullptr;
+    size_t best = linkRow_.size() + 1;
+    static const std::vector<uint32_t> none;
+
+    for (const auto& filter : query.filters) {
+        const std::string& value = filter.second;
+        if (value.empty() || value[value.size() - 1] == '*') {
+            continue;
+        }
+        uint32_t valueId = findString(value);
+        if (filter.first == "rt" || filter.first == "if") {
+            const Postings& index = (filter.first == "rt") ? rtIndex_ : ifIndex_;
+            Postings::const_iterator it = (valueId != RD_NO_STRING) ? index.find(valueId) : index.end();
+            const std::vector<uint32_t>& posting = (it != index.end()) ? it->second : none;
+            if (posting.size() < best) {
+                best = posting.size();
+                linkCandidates = &posting;
+                rowCandidates = nullptr;
+            }
+        } else if (filter.first == "ep") {
+            Postings::const_iterator it = (valueId != RD_NO_STRING) ? epIndex_.find(valueId) : epIndex_.end();
+            const std::vector<uint32_t>& posting = (it != epIndex_.end()) ? it->second : none;
+            size_t count = 0;
+            for (uint32_t row : posting) {
+                count += regLinkEnd_[row] - regLinkBegin_[row];
+            }
+            if (count < best) {
+                best = count;
+                rowCandidates = &posting;
+                linkCandidates = nullptr;
+            }
+        }
+    }
+
+    RdSlice slice(offset, size, out);
+    std::string entry;
+    if (rowCandidates != nullptr) {
+        for (uint32_t row : *rowCandidates) {
+            for (uint32_t link = regLinkBegin_[row]; link < regLinkEnd_[row]; link++) {
+                if (matchLink(link, query)) {
+                    entry.clear();
+                    formatLink(link, entry);
+                    if (!slice.add(entry)) {
+                        more = true;
+                        return CoapError::OK;
+                    }
+                }
+            }
+        }
+    } else if (linkCandidates != nullptr) {
+        for (uint32_t link : *linkCandidates) {
+            if (linkRow_[link] != RD_DEAD_LINK && matchLink(link, query)) {
+                entry.clear();
+                formatLink(link, entry);
+                if (!slice.add(entry)) {
+                    more = true;
+                    return CoapError::OK;
+                }
+            }
+        }
+    } else {
+        for (uint32_t link = 0; link < linkRow_.size(); link++) {
+            if (linkRow_[link] != RD_DEAD_LINK && matchLink(link, query)) {
+                entry.clear();
+                formatLink(link, entry);
+                if (!slice.add(entry)) {
+                    more = true;
+                    return CoapError::OK;
+                }
+            }
+        }
+    }
+    return CoapError::OK;
+}
+
+CoapError CoapResourceDirectory::lookupEndpoints(const CoapRdQuery& query, size_t offset, size_t size,
+                                                 std::string& out, bool& more) const {
+    out.clear();
+    more = false;
+
+    bool linkFilters = false;
+    const std::vector<uint32_t>* rowCandidates = nullptr;
+    static const std::vector<uint32_t> none;
+    for (const auto& filter : query.filters) {
+        if (!isRegistrationFilter(filter.first)) {
+            linkFilters = true;
+        } else if (filter.first == "ep" && !filter.second.empty() &&
+                   filter.second[filter.second.size() - 1] != '*') {
+            uint32_t valueId = findString(filter.second);
+            Postings::const_iterator it = (valueId != RD_NO_STRING) ? epIndex_.find(valueId) : epIndex_.end();
+            rowCandidates = (it != epIndex_.end()) ? &it->second : &none;
+        }
+    }
+
+    RdSlice slice(offset, size, out);
+    std::string entry;
+    size_t rows = (rowCandidates != nullptr) ? rowCandidates->size() : regId_.size();
+    for (size_t i = 0; i < rows; i++) {
+        uint32_t row = (rowCandidates != nullptr) ? (*rowCandidates)[i] : static_cast<uint32_t>(i);
+        if (regId_[row] == 0 || !matchRegistration(row, query, linkFilters)) {
+            continue;
+        }
+        entry.clear();
+        formatRegistration(row, entry);
+        if (!slice.add(entry)) {
+            more = true;
+            return CoapError::OK;
+        }
+    }
+    return CoapError::OK;
+}
+
+CoapError CoapResourceDirectory::handleRequest(const CoapPacket& request, const std::string& sourceBase,
+                                               uint64_t now, CoapBuilder& response) {
+    std::vector<std::string> path;
+    CoapRdQuery query;
+    bool badFormat = false;
+    for (const CoapOption& option : request.options) {
+        if (option.number == static_cast<uint16_t>(CoapOptionNumber::URI_PATH)) {
+            path.push_back(optionString(option));
+        } else if (option.number == static_cast<uint16_t>(CoapOptionNumber::URI_QUERY)) {
+            std::string item = optionString(option);
+            size_t eq = item.find('=');
+            query.add(item.substr(0, eq), (eq != std::string::npos) ? item.substr(eq + 1) : std::string());
+        } else if (option.number == static_cast<uint16_t>(CoapOptionNumber::CONTENT_FORMAT)) {
+            badFormat = decodeUintValue(option.value.data(), option.value.size()) !=
+                        static_cast<uint32_t>(CoapContentFormat::LINK_FORMAT);
+        }
+    }
+
+    const char* payload = reinterpret_cast<const char*>(request.getPayloadPtr());
+    size_t payloadLength = request.getPayloadSize();
+
+    if (path.size() == 2 && path[0] == "rd-lookup" && (path[1] == "res" || path[1] == "ep")) {
+        if (request.code != CoapCode::GET) {
+            response.setCode(CoapCode::METHOD_NOT_ALLOWED_4_05);
+            return CoapError::OK;
+        }
+        expire(now);
+        return handleLookup(request, path[1] == "res", query, response);
+    }
+
+    if (path.empty() || path[0] != "rd" || path.size() > 2) {
+        response.setCode(CoapCode::NOT_FOUND_4_04);
+        return CoapError::OK;
+    }
+    if (request.code == CoapCode::POST && badFormat) {
+        response.setCode(CoapCode::UNSUPPORTED_CONTENT_FORMAT_4_15);
+        return CoapError::OK;
+    }
+
+    CoapRdRegistration registration;
+    registration.lifetime = 0;
+    for (const auto& item : query.filters) {
+        if (item.first == "ep") {
+            registration.endpoint = item.second;
+        } else if (item.first == "d") {
+            registration.sector = item.second;
+        } else if (item.first == "base") {
+            registration.base = item.second;
+        } else if (item.first == "lt" && (!parseDecimal(item.second, registration.lifetime) ||
+                                          registration.lifetime == 0)) {
+            response.setCode(CoapCode::BAD_REQUEST_4_00);
+            return CoapError::OK;
+        }
+    }
+
+    if (path.size() == 1) {
+        if (request.code != CoapCode::POST) {
+            response.setCode(CoapCode::METHOD_NOT_ALLOWED_4_05);
+            return CoapError::OK;
+        }
+        if (registration.lifetime == 0) {
+            registration.lifetime = RD_DEFAULT_LIFETIME;
+        }
+        if (registration.base.empty()) {
+            registration.base = sourceBase;
+        }
+        uint32_t id;
+        if (registerEndpoint(registration, payload, payloadLength, now, id) != CoapError::OK) {
+            response.setCode(CoapCode::BAD_REQUEST_4_00);
+            return CoapError::OK;
+        }
+        std::string idText;
+        appendDecimal(idText, id);
+        response.setCode(CoapCode::CREATED_2_01)
+            .addOption(CoapOptionNumber::LOCATION_PATH, std::string("rd"))
+            .addOption(CoapOptionNumber::LOCATION_PATH, idText);
+        return CoapError::OK;
+    }
+
+    uint32_t id;
+    if (!parseDecimal(path[1], id) || idToRow_.find(id) == idToRow_.end()) {
+        response.setCode(CoapCode::NOT_FOUND_4_04);
+        return CoapError::OK;
+    }
+    if (request.code == CoapCode::DELETE) {
+        removeRegistration(id);
+        response.setCode(CoapCode::DELETED_2_02);
+    } else if (request.code == CoapCode::POST) {
+        CoapError err = updateRegistration(id, registration.lifetime, registration.base,
+                                           payloadLength > 0 ? payload : nullptr, payloadLength, now);
+        if (err == CoapError::INVALID_ARGUMENT) {
+            response.setCode(CoapCode::NOT_FOUND_4_04);
+        } else {
+            response.setCode(err == CoapError::OK ? CoapCode::CHANGED_2_04 : CoapCode::BAD_REQUEST_4_00);
+        }
+    } else {
+        response.setCode(CoapCode::METHOD_NOT_ALLOWED_4_05);
+    }
+    return CoapError::OK;
+}
+
+size_t CoapResourceDirectory::getRegistrationCount() const {
+    return idToRow_.size();
+}
+
+size_t CoapResourceDirectory::getLinkCount() const {
+    return liveLinks_;
+}
+
+CoapMemoryUsage CoapResourceDirectory::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+
+    size_t strings = strings_.size() - freeStrings_.size();
+    usage.addArray(strings, strings_.capacity(), sizeof(std::string));
+    for (const std::string& value : strings_) {
+        usage.addString(value);
+    }
+    usage.addArray(strings, stringRefs_.capacity(), sizeof(uint32_t));
+    usage.addArray(0, freeStrings_.capacity(), sizeof(uint32_t));
+    usage.addHashTable(stringIds_.size(), stringIds_.bucket_count(),
+                       sizeof(std::pair<const uint64_t, uint32_t>));
+
+    size_t rows = idToRow_.size();
+    usage.addArray(rows, regId_.capacity(), sizeof(uint32_t));
+    usage.addArray(rows, regEndpoint_.capacity(), sizeof(uint32_t));
+    usage.addArray(rows, regSector_.capacity(), sizeof(uint32_t));
+    usage.addArray(rows, regBase_.capacity(), sizeof(uint32_t));
+    usage.addArray(rows, regLifetime_.capacity(), sizeof(uint32_t));
+    usage.addArray(rows, regTimer_.capacity(), sizeof(uint64_t));
+    usage.addArray(rows, regLinkBegin_.capacity(), sizeof(uint32_t));
+    usage.addArray(rows, regLinkEnd_.capacity(), sizeof(uint32_t));
+    usage.addArray(0, freeRows_.capacity(), sizeof(uint32_t));
+    usage.addHashTable(rows, idToRow_.bucket_count(), sizeof(std::pair<const uint32_t, uint32_t>));
+
+    usage.addArray(liveLinks_, linkRow_.capacity(), sizeof(uint32_t));
+    usage.addArray(liveLinks_, linkTarget_.capacity(), sizeof(uint32_t));
+    usage.addArray(liveLinks_, linkParamBegin_.capacity(), sizeof(uint32_t));
+    usage.addArray(paramName_.size(), paramName_.capacity(), sizeof(uint32_t));
+    usage.addArray(paramValue_.size(), paramValue_.capacity(), sizeof(uint32_t));
+    usage.addArray(paramQuoted_.size(), paramQuoted_.capacity(), sizeof(uint8_t));
+
+    const Postings* indexes[] = {&rtIndex_, &ifIndex_, &epIndex_};
+    for (const Postings* postings : indexes) {
+        usage.addHashTable(postings->size(), postings->bucket_count(), sizeof(Postings::value_type));
+        for (const auto& entry : *postings) {
+            usage.addArray(entry.second.size(), entry.second.capacity(), sizeof(uint32_t));
+        }
+    }
+
+    usage.add(timers_.memoryUsage(), sizeof(timers_));
+    usage.entries = rows;
+    return usage;
+}
+
+uint32_t CoapResourceDirectory::intern(const char* data, size_t length) {
+    uint32_t id = findString(data, length);
+    if (id != RD_NO_STRING) {
+        stringRefs_[id]++;
+        return id;
+    }
+
+    // Copy before strings_ grows: data may point into one of its strings
+    std::string value(data, length);
+    if (!freeStrings_.empty()) {
+        id = freeStrings_.back();
+        freeStrings_.pop_back();
+        strings_[id].swap(value);
+        stringRefs_[id] = 1;
+    } else {
+        id = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(std::string());
+        strings_.back().swap(value);
+        stringRefs_.push_back(1);
+    }
+    stringIds_.insert(std::make_pair(CoapHash::hashBytes(reinterpret_cast<const uint8_t*>(strings_[id].data()),
+                                                         length), id));
+    return id;
+}
+
+void CoapResourceDirectory::release(uint32_t id) {
+    if (id == RD_NO_STRING || --stringRefs_[id] > 0) {
+        return;
+    }
+    const std::string& value = strings_[id];
+    uint64_t hash = CoapHash::hashBytes(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    auto range = stringIds_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == id) {
+            stringIds_.erase(it);
+            break;
+        }
+    }
+    std::string().swap(strings_[id]);
+    freeStrings_.push_back(id);
+}
+
+uint32_t CoapResourceDirectory::findString(const char* data, size_t length) const {
+    uint64_t hash = CoapHash::hashBytes(reinterpret_cast<const uint8_t*>(data), length);
+    auto range = stringIds_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        const std::string& value = strings_[it->second];
+        if (value.size() == length && (length == 0 || std::memcmp(value.data(), data, length) == 0)) {
+            return it->second;
+        }
+    }
+    return RD_NO_STRING;
+}
+
+uint32_t CoapResourceDirectory::findString(const std::string& value) const {
+    return findString(value.data(), value.size());
+}
+
+CoapError CoapResourceDirectory::appendLinks(uint32_t row, const char* links, size_t linksLength) {
+    regLinkBegin_[row] = static_cast<uint32_t>(linkRow_.size());
+
+    CoapLinkParser parser(links, linksLength);
+    CoapLink link;
+    while (parser.next(link)) {
+        uint32_t index = static_cast<uint32_t>(linkRow_.size());
+        linkRow_.push_back(row);
+        linkTarget_.push_back(intern(link.target, link.target_length));
+        linkParamBegin_.push_back(static_cast<uint32_t>(paramName_.size()));
+
+        CoapLinkParamIterator params(link);
+        CoapLinkParam param;
+        while (params.next(param)) {
+            paramName_.push_back(intern(param.name, param.name_length));
+            paramValue_.push_back(param.value != nullptr ? intern(param.value, param.value_length) : RD_NO_STRING);
+            paramQuoted_.push_back(param.quoted ? 1 : 0);
+        }
+        indexLink(index);
+        liveLinks_++;
+    }
+
+    regLinkEnd_[row] = static_cast<uint32_t>(linkRow_.size());
+    return parser.getError();
+}
+
+void CoapResourceDirectory::killLinks(uint32_t row) {
+    for (uint32_t link = regLinkBegin_[row]; link < regLinkEnd_[row]; link++) {
+        linkRow_[link] = RD_DEAD_LINK;
+    }
+    liveLinks_ -= regLinkEnd_[row] - regLinkBegin_[row];
+    regLinkBegin_[row] = 0;
+    regLinkEnd_[row] = 0;
+}
+
+void CoapResourceDirectory::indexLink(uint32_t link) {
+    uint32_t begin = linkParamBegin_[link];
+    uint32_t end = (link + 1 < linkParamBegin_.size()) ? linkParamBegin_[link + 1]
+                                                       : static_cast<uint32_t>(paramName_.size());
+    for (uint32_t p = begin; p < end; p++) {
+        if ((paramName_[p] != rtName_ && paramName_[p] != ifName_) || paramValue_[p] == RD_NO_STRING) {
+            continue;
+        }
+        Postings& index = (paramName_[p] == rtName_) ? rtIndex_ : ifIndex_;
+        size_t pos = 0;
+        while (pos < strings_[paramValue_[p]].size()) {
+            // intern() may grow strings_, so value is looked up per token
+            const std::string& value = strings_[paramValue_[p]];
+            size_t tokenEnd = value.find(' ', pos);
+            if (tokenEnd == std::string::npos) {
+                tokenEnd = value.size();
+            }
+            if (tokenEnd > pos) {
+                uint32_t tokenId = findString(value.data() + pos, tokenEnd - pos);
+                Postings::iterator entry = (tokenId != RD_NO_STRING) ? index.find(tokenId) : index.end();
+                if (entry == index.end()) {
+                    tokenId = intern(value.data() + pos, tokenEnd - pos);
+                    entry = index.insert(std::make_pair(tokenId, std::vector<uint32_t>())).first;
+                }
+                std::vector<uint32_t>& posting = entry->second;
+                if (posting.empty() || posting.back() != link) {
+                    posting.push_back(link);
+                }
+            }
+            pos = tokenEnd + 1;
+        }
+    }
+}
+
+void CoapResourceDirectory::compactLinks() {
+    size_t dead = linkRow_.size() - liveLinks_;
+    if (dead < RD_COMPACT_MIN_DEAD || dead < liveLinks_) {
+        return;
+    }
+
+    std::vector<uint32_t> linkRow;
+    std::vector<uint32_t> linkTarget;
+    std::vector<uint32_t> linkParamBegin;
+    std::vector<uint32_t> paramName;
+    std::vector<uint32_t> paramValue;
+    std::vector<uint8_t> paramQuoted;
+    linkRow.reserve(liveLinks_);
+    linkTarget.reserve(liveLinks_);
+    linkParamBegin.reserve(liveLinks_);
+
+    // Live links keep their relative order, so a client paging a lookup
+    // with Block2 sees the same sequence; dead links release their strings
+    for (uint32_t link = 0; link < linkRow_.size(); link++) {
+        uint32_t paramEnd = (link + 1 < linkParamBegin_.size()) ? linkParamBegin_[link + 1]
+                                                                : static_cast<uint32_t>(paramName_.size());
+        uint32_t row = linkRow_[link];
+        if (row == RD_DEAD_LINK) {
+            release(linkTarget_[link]);
+            for (uint32_t p = linkParamBegin_[link]; p < paramEnd; p++) {
+                release(paramName_[p]);
+                release(paramValue_[p]);
+            }
+            continue;
+        }
+
+        // Links of a row are contiguous, so its range starts at its first live link
+        if (linkRow.empty() || linkRow.back() != row) {
+            regLinkBegin_[row] = static_cast<uint32_t>(linkRow.size());
+        }
+        linkRow.push_back(row);
+        linkTarget.push_back(linkTarget_[link]);
+        linkParamBegin.push_back(static_cast<uint32_t>(paramName.size()));
+        for (uint32_t p = linkParamBegin_[link]; p < paramEnd; p++) {
+            paramName.push_back(paramName_[p]);
+            paramValue.push_back(paramValue_[p]);
+            paramQuoted.push_back(paramQuoted_[p]);
+        }
+        regLinkEnd_[row] = static_cast<uint32_t>(linkRow.size());
+    }
+
+    linkRow_.swap(linkRow);
+    linkTarget_.swap(linkTarget);
+    linkParamBegin_.swap(linkParamBegin);
+    paramName_.swap(paramName);
+    paramValue_.swap(paramValue);
+    paramQuoted_.swap(paramQuoted);
+
+    const Postings* indexes[] = {&rtIndex_, &ifIndex_};
+    for (const Postings* index : indexes) {
+        for (const auto& entry : *index) {
+            release(entry.first);
+        }
+    }
+    rtIndex_.clear();
+    ifIndex_.clear();
+    for (uint32_t link = 0; link < linkRow_.size(); link++) {
+        indexLink(link);
+    }
+}
+
+void CoapResourceDirectory::removeRow(uint32_t row) {
+    killLinks(row);
+
+    std::vector<uint32_t>& posting = epIndex_[regEndpoint_[row]];
+    for (size_t i = 0; i < posting.size(); i++) {
+        if (posting[i] == row) {
+            posting[i] = posting.back();
+            posting.pop_back();
+            break;
+        }
+    }
+    if (posting.empty()) {
+        epIndex_.erase(regEndpoint_[row]);
+    }
+    release(regEndpoint_[row]);
+    release(regSector_[row]);
+    release(regBase_[row]);
+
+    idToRow_.erase(regId_[row]);
+    regId_[row] = 0;
+    regTimer_[row] = TIMER_INVALID;
+    freeRows_.push_back(row);
+}
+
+void CoapResourceDirectory::scheduleExpiry(uint32_t row, uint64_t now) {
+    timers_.cancel(regTimer_[row]);
+    regTimer_[row] = timers_.schedule(now + regLifetime_[row], regId_[row]);
+}
+
+bool CoapResourceDirectory::matchLink(uint32_t link, const CoapRdQuery& query) const {
+    for (const auto& filter : query.filters) {
+        if (!isRegistrationFilter(filter.first) && !matchLinkParam(link, filter.first, filter.second)) {
+            return false;
+        }
+    }
+    return matchRegistration(linkRow_[link], query, false);
+}
+
+bool CoapResourceDirectory::matchRegistration(uint32_t row, const CoapRdQuery& query, bool linkFilters) const {
+    for (const auto& filter : query.filters) {
+        const std::string* actual = nullptr;
+        if (filter.first == "ep") {
+            actual = &strings_[regEndpoint_[row]];
+        } else if (filter.first == "d") {
+            actual = &strings_[regSector_[row]];
+        } else if (filter.first == "base") {
+            actual = &strings_[regBase_[row]];
+        }
+        if (actual != nullptr && !matchFilterValue(*actual, filter.second)) {
+            return false;
+        }
+    }
+    if (!linkFilters) {
+        return true;
+    }
+
+    // Endpoint lookup with link filters: some link must match all of them
+    for (uint32_t link = regLinkBegin_[row]; link < regLinkEnd_[row]; link++) {
+        bool match = true;
+        for (const auto& filter : query.filters) {
+            if (!isRegistrationFilter(filter.first) && !matchLinkParam(link, filter.first, filter.second)) {
+                match = false;
+                break;
+            }
+        }
+        if (match) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CoapResourceDirectory::matchLinkParam(uint32_t link, const std::string& name, const std::string& value) const {
+    if (name == "href") {
+        return matchFilterValue(strings_[linkTarget_[link]], value);
+    }
+    uint32_t nameId = findString(name);
+    if (nameId == RD_NO_STRING) {
+        return false;
+    }
+    uint32_t end = (link + 1 < linkParamBegin_.size()) ? linkParamBegin_[link + 1]
+                                                       : static_cast<uint32_t>(paramName_.size());
+    for (uint32_t p = linkParamBegin_[link]; p < end; p++) {
+        if (paramName_[p] != nameId) {
+            continue;
+        }
+        if (value.empty() || (paramValue_[p] != RD_NO_STRING && matchFilterValue(strings_[paramValue_[p]], value))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CoapResourceDirectory::formatLink(uint32_t link, std::string& out) const {
+    uint32_t row = linkRow_[link];
+    const std::string& base = strings_[regBase_[row]];
+    const std::string& target = strings_[linkTarget_[link]];
+
+    // Targets are resolved against the registration base
+    out += '<';
+    if (target.find("://") == std::string::npos) {
+        out += base;
+        if (target.empty() || target[0] != '/') {
+            out += '/';
+        }
+    }
+    out += target;
+    out += '>';
+
+    bool anchor = false;
+    uint32_t end = (link + 1 < linkParamBegin_.size()) ? linkParamBegin_[link + 1]
+                                                       : static_cast<uint32_t>(paramName_.size());
+    for (uint32_t p = linkParamBegin_[link]; p < end; p++) {
+        const std::string& name = strings_[paramName_[p]];
+        anchor = anchor || name == "anchor";
+        out += ';';
+        out += name;
+        if (paramValue_[p] != RD_NO_STRING) {
+            out += '=';
+            if (paramQuoted_[p]) {
+                out += '"';
+            }
+            out += strings_[paramValue_[p]];
+            if (paramQuoted_[p]) {
+                out += '"';
+            }
+        }
+    }
+    if (!anchor) {
+        out += ";anchor=\"";
+        out += base;
+        out += '"';
+    }
+}
+
+void CoapResourceDirectory::formatRegistration(uint32_t row, std::string& out) const {
+    out += "</rd/";
+    appendDecimal(out, regId_[row]);
+    out += ">;ep=\"";
+    out += strings_[regEndpoint_[row]];
+    out += '"';
+    if (!strings_[regSector_[row]].empty()) {
+        out += ";d=\"";
+        out += strings_[regSector_[row]];
+        out += '"';
+    }
+    out += ";base=\"";
+    out += strings_[regBase_[row]];
+    out += "\";lt=";
+    appendDecimal(out, regLifetime_[row]);
+}
+
+CoapError CoapResourceDirectory::handleLookup(const CoapPacket& request, bool resources, CoapRdQuery& query,
+                                              CoapBuilder& response) const {
+    uint32_t blockNumber = 0;
+    uint32_t sizeExponent = 6;
+    for (const CoapOption& option : request.options) {
+        if (option.number == static_cast<uint16_t>(CoapOptionNumber::BLOCK2) && option.value.size() <= 3) {
+            uint32_t block = decodeUintValue(option.value.data(), option.value.size());
+            blockNumber = block >> 4;
+            // SZX 7 (BERT) is served as 1024-byte blocks
+            sizeExponent = ((block & 0x07) == 7) ? 6 : (block & 0x07);
+        }
+    }
+    size_t blockSize = static_cast<size_t>(16) << sizeExponent;
+    if (blockSize > RD_DEFAULT_BLOCK_SIZE) {
+        blockSize = RD_DEFAULT_BLOCK_SIZE;
+        sizeExponent = 6;
+    }
+
+    std::string body;
+    bool more = false;
+    CoapError err = resources
+        ? lookupResources(query, static_cast<size_t>(blockNumber) * blockSize, blockSize, body, more)
+        : lookupEndpoints(query, static_cast<size_t>(blockNumber) * blockSize, blockSize, body, more);
+    if (err != CoapError::OK) {
+        return err;
+    }
+    if (blockNumber > 0 && body.empty()) {
+        response.setCode(CoapCode::BAD_OPTION_4_02);
+        return CoapError::OK;
+    }
+
+    response.setCode(CoapCode::CONTENT_2_05).setContentFormat(CoapContentFormat::LINK_FORMAT);
+    if (more || blockNumber > 0) {
+        response.addOption(CoapOptionNumber::BLOCK2, (blockNumber << 4) | (more ? 0x08u : 0u) | sizeExponent);
+    }
+    response.setPayload(body);
+    return CoapError::OK;
+}
+
+} // namespace CoapPacket
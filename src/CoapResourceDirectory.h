@@ -0,0 +1,208 @@
+#ifndef COAP_RESOURCE_DIRECTORY_H
+#define COAP_RESOURCE_DIRECTORY_H
+
+#include "CoapBuilder.h"
+#include "CoapPacket.h"
+#include "CoapTimerWheel.h"
+#include "CoapError.h"
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace CoapPacket {
+
+// Registration lifetime when "lt" is not given (RFC 9176 section 5.3), seconds
+constexpr uint32_t RD_DEFAULT_LIFETIME = 90000;
+
+// Block size of lookup responses when the request has no Block2 option
+constexpr size_t RD_DEFAULT_BLOCK_SIZE = 1024;
+
+/**
+ * Registration parameters (RFC 9176 section 5.3)
+ * base is the scheme and authority links are resolved against
+ * (e.g. "coap://[2001:db8::1]:5683").
+ */
+struct CoapRdRegistration {
+    std::string endpoint;      // ep
+    std::string sector;        // d
+    std::string base;          // base
+    uint32_t lifetime;         // lt, seconds
+
+    CoapRdRegistration() : lifetime(RD_DEFAULT_LIFETIME) {}
+};
+
+/**
+ * Lookup filter (RFC 9176 section 7)
+ * Each filter is a name/value pair from the query; all must match. "ep",
+ * "d" and "base" match registration parameters, "href" the link target
+ * and any other name a link parameter. For space-separated parameters
+ * (rt, if) any token may match. A trailing '*' matches a prefix.
+ */
+struct CoapRdQuery {
+    std::vector<std::pair<std::string, std::string>> filters;
+
+    CoapRdQuery& add(const std::string& name, const std::string& value) {
+        filters.push_back(std::make_pair(name, value));
+        return *this;
+    }
+};
+
+/**
+ * Resource directory registration store (RFC 9176)
+ *
+ * Registrations and their links are kept in columns of interned string
+ * IDs. Interned strings are reference counted and released with the
+ * registration, or with its replaced links when they are compacted, so
+ * the pool only holds strings in use. rt, if and ep have inverted indexes, so lookups only visit the
+ * rows of the most selective indexed filter. Lifetimes expire through a
+ * timer wheel with one-second ticks.
+ *
+ * Lookup results are produced slice by slice: a Block2 request only
+ * serialises the links up to the end of the requested block.
+ *
+ * Time arguments are seconds on a monotonic clock.
+ */
+class CoapResourceDirectory {
+public:
+    explicit CoapResourceDirectory(uint64_t now = 0);
+
+    /**
+     * Register an endpoint with a link-format document
+     * An existing registration with the same ep and d is replaced.
+     */
+    CoapError registerEndpoint(const CoapRdRegistration& registration, const char* links, size_t linksLength,
+                               uint64_t now, uint32_t& id);
+
+    /**
+     * Refresh a registration (RFC 9176 section 5.3.1)
+     * lifetime 0 keeps the current lifetime, empty base keeps the current
+     * base and links == nullptr keeps the current links.
+     */
+    CoapError updateRegistration(uint32_t id, uint32_t lifetime, const std::string& base,
+                                 const char* links, size_t linksLength, uint64_t now);
+
+    /**
+     * Remove a registration; returns INVALID_ARGUMENT if it does not exist
+     */
+    CoapError removeRegistration(uint32_t id);
+
+    /**
+     * Remove registrations whose lifetime ended; returns how many
+     */
+    size_t expire(uint64_t now);
+
+    /**
+     * Resource lookup: bytes [offset, offset + size) of the link-format
+     * result; more is set if the result continues after the slice
+     */
+    CoapError lookupResources(const CoapRdQuery& query, size_t offset, size_t size,
+                              std::string& out, bool& more) const;
+
+    /**
+     * Endpoint lookup, sliced like lookupResources()
+     */
+    CoapError lookupEndpoints(const CoapRdQuery& query, size_t offset, size_t size,
+                              std::string& out, bool& more) const;
+
+    /**
+     * Serve a request to the registration and lookup interfaces
+     *   POST   /rd?ep=..&d=..&lt=..&base=..   register (2.01, Location-Path rd/<id>)
+     *   POST   /rd/<id>?lt=..&base=..         update (2.04)
+     *   DELETE /rd/<id>                       remove (2.02)
+     *   GET    /rd-lookup/res?filters         resource lookup, Block2 sliced
+     *   GET    /rd-lookup/ep?filters          endpoint lookup, Block2 sliced
+     * sourceBase is used as base when a registration does not give one.
+     * Sets code, options and payload of response; type, message ID and
+     * token are left to the caller.
+     */
+    CoapError handleRequest(const CoapPacket& request, const std::string& sourceBase, uint64_t now,
+                            CoapBuilder& response);
+
+    /**
+     * Get number of registrations
+     */
+    size_t getRegistrationCount() const;
+
+    /**
+     * Get number of registered links
+     */
+    size_t getLinkCount() const;
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts registrations; free rows, free string IDs and dead
+     * link rows are slack
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    typedef std::unordered_map<uint32_t, std::vector<uint32_t>> Postings;
+
+    // Interned strings; IDs index strings_ and stringRefs_. stringIds_ maps
+    // the hash of a string to its IDs, so lookups need no temporary string.
+    std::vector<std::string> strings_;
+    std::vector<uint32_t> stringRefs_;
+    std::vector<uint32_t> freeStrings_;
+    std::unordered_multimap<uint64_t, uint32_t> stringIds_;
+
+    // Registration columns, one row per registration slot
+    std::vector<uint32_t> regId_;
+    std::vector<uint32_t> regEndpoint_;
+    std::vector<uint32_t> regSector_;
+    std::vector<uint32_t> regBase_;
+    std::vector<uint32_t> regLifetime_;
+    std::vector<uint64_t> regTimer_;
+    std::vector<uint32_t> regLinkBegin_;
+    std::vector<uint32_t> regLinkEnd_;
+    std::vector<uint32_t> freeRows_;
+    std::unordered_map<uint32_t, uint32_t> idToRow_;
+    uint32_t nextId_;
+
+    // Link columns; links of a registration are contiguous, replaced
+    // links are marked dead and dropped by compactLinks(), which keeps the
+    // order of the live links (lookups return links in this order)
+    std::vector<uint32_t> linkRow_;
+    std::vector<uint32_t> linkTarget_;
+    std::vector<uint32_t> linkParamBegin_;
+    std::vector<uint32_t> paramName_;
+    std::vector<uint32_t> paramValue_;
+    std::vector<uint8_t> paramQuoted_;
+    size_t liveLinks_;
+
+    // Inverted indexes: rt/if token -> link rows, ep -> registration rows
+    // Each rt/if key holds one reference to its token string.
+    Postings rtIndex_;
+    Postings ifIndex_;
+    Postings epIndex_;
+    uint32_t rtName_;
+    uint32_t ifName_;
+
+    CoapTimerWheel timers_;
+
+    uint32_t intern(const char* data, size_t length);
+    void release(uint32_t id);
+    uint32_t findString(const char* data, size_t length) const;
+    uint32_t findString(const std::string& value) const;
+
+    CoapError appendLinks(uint32_t row, const char* links, size_t linksLength);
+    void killLinks(uint32_t row);
+    void indexLink(uint32_t link);
+    void compactLinks();
+    void removeRow(uint32_t row);
+    void scheduleExpiry(uint32_t row, uint64_t now);
+
+    bool matchLink(uint32_t link, const CoapRdQuery& query) const;
+    bool matchRegistration(uint32_t row, const CoapRdQuery& query, bool linkFilters) const;
+    bool matchLinkParam(uint32_t link, const std::string& name, const std::string& value) const;
+
+    void formatLink(uint32_t link, std::string& out) const;
+    void formatRegistration(uint32_t row, std::string& out) const;
+
+    CoapError handleLookup(const CoapPacket& request, bool resources, CoapRdQuery& query,
+                           CoapBuilder& response) const;
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_RESOURCE_DIRECTORY_H
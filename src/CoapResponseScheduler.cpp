@@ -0,0 +1,215 @@
+#include "CoapResponseScheduler.h"
+#include "CoapToken.h"
+
+namespace CoapPacket {
+
+CoapResponseScheduler::CoapResponseScheduler(uint32_t piggybackWindow, uint16_t firstMessageId, uint64_t now,
+                                             uint32_t exchangeLifetime)
+    : window_(piggybackWindow)
+    , lifetime_(exchangeLifetime)
+    , nextMessageId_(firstMessageId)
+    , timers_(4096, now)
+    , count_(0)
+    , completed_(0)
+    , piggybacked_(0)
+    , separate_(0) {}
+
+uint64_t CoapResponseScheduler::accept(uint64_t endpointHash, CoapType type, uint16_t messageId,
+                                       uint64_t cookie, uint64_t now, CoapRequestState& state,
+                                       CoapResponsePlan& plan) {
+    state = CoapRequestState::NEW;
+    uint64_t key = pendingKey(endpointHash, messageId);
+    std::unordered_map<uint64_t, uint32_t>::const_iterator found = pending_.find(key);
+    if (found != pending_.end()) {
+        Request& request = requests_[found->second];
+        if (request.endpointHash == endpointHash && request.messageId == messageId) {
+            uint64_t handle = (static_cast<uint64_t>(request.generation) << 32) |
+                              (static_cast<uint64_t>(found->second) + 1);
+            if (request.completed) {
+                // The response was lost: re-send it, do not run the handler again
+                state = CoapRequestState::COMPLETED;
+                plan = request.plan;
+                return handle;
+            }
+            // The client retransmitted, so it stopped waiting for a
+            // piggybacked response, or did not get the empty ACK:
+            // acknowledge (again) on the next poll()
+            state = CoapRequestState::PENDING;
+            if (request.type == CoapType::CON) {
+                request.resend = request.acked;
+                timers_.cancel(request.timer);
+                request.timer = timers_.schedule(now, handle);
+            }
+            return handle;
+        }
+    }
+
+    uint32_t row;
+    if (!freeRows_.empty()) {
+        row = freeRows_.back();
+        freeRows_.pop_back();
+    } else {
+        row = static_cast<uint32_t>(requests_.size());
+        Request empty = {0, TIMER_INVALID, CoapResponsePlan(), 0, 0, CoapType::CON, false, false, false, false};
+        requests_.push_back(empty);
+    }
+
+    Request& request = requests_[row];
+    request.endpointHash = endpointHash;
+    request.plan = CoapResponsePlan();
+    request.plan.cookie = cookie;
+    request.messageId = messageId;
+    request.type = type;
+    request.active = true;
+    request.acked = false;
+    request.resend = false;
+    request.completed = false;
+    request.timer = TIMER_INVALID;
+
+    uint64_t handle = (static_cast<uint64_t>(request.generation) << 32) | (static_cast<uint64_t>(row) + 1);
+    if (type == CoapType::CON) {
+        request.timer = timers_.schedule(now + window_, handle);
+    }
+    if (found == pending_.end()) {
+        pending_[key] = row;
+    }
+    count_++;
+    return handle;
+}
+
+CoapError CoapResponseScheduler::complete(uint64_t handle, uint64_t now, CoapResponsePlan& plan) {
+    Request* request = lookup(handle);
+    if (request == nullptr || request->completed) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+
+    // The response also ends a pending re-send of the empty ACK
+    timers_.cancel(request->timer);
+    CoapResponsePlan& stored = request->plan;
+    if (request->type != CoapType::CON) {
+        stored.type = CoapType::NON;
+        stored.messageId = nextMessageId_++;
+        stored.separate = false;
+    } else if (!request->acked) {
+        stored.type = CoapType::ACK;
+        stored.messageId = request->messageId;
+        stored.separate = false;
+        piggybacked_++;
+    } else {
+        stored.type = CoapType::CON;
+        stored.messageId = nextMessageId_++;
+        stored.separate = true;
+        separate_++;
+    }
+    plan = stored;
+
+    // Remember the exchange so a retransmission is answered from the stored response
+    request->completed = true;
+    request->resend = false;
+    request->timer = timers_.schedule(now + lifetime_, handle);
+    count_--;
+    completed_++;
+    return CoapError::OK;
+}
+
+bool CoapResponseScheduler::cancel(uint64_t handle) {
+    Request* request = lookup(handle);
+    if (request == nullptr) {
+        return false;
+    }
+    timers_.cancel(request->timer);
+    release(static_cast<uint32_t>((handle & 0xFFFFFFFFu) - 1));
+    return true;
+}
+
+size_t CoapResponseScheduler::poll(uint64_t now, std::vector<CoapEmptyAck>& acks) {
+    expired_.clear();
+    timers_.advance(now, expired_);
+
+    size_t added = 0;
+    for (uint64_t handle : expired_) {
+        Request* request = lookup(handle);
+        if (request != nullptr && request->completed) {
+            request->timer = TIMER_INVALID;
+            release(static_cast<uint32_t>((handle & 0xFFFFFFFFu) - 1));
+            continue;
+        }
+        if (request == nullptr || (request->acked && !request->resend)) {
+            continue;
+        }
+        request->acked = true;
+        request->resend = false;
+        request->timer = TIMER_INVALID;
+        CoapEmptyAck ack = {request->plan.cookie, request->endpointHash, request->messageId};
+        acks.push_back(ack);
+        added++;
+    }
+    return added;
+}
+
+size_t CoapResponseScheduler::size() const {
+    return count_;
+}
+
+size_t CoapResponseScheduler::getCompletedCount() const {
+    return completed_;
+}
+
+uint64_t CoapResponseScheduler::getPiggybackedCount() const {
+    return piggybacked_;
+}
+
+uint64_t CoapResponseScheduler::getSeparateCount() const {
+    return separate_;
+}
+
+CoapResponseScheduler::Request* CoapResponseScheduler::lookup(uint64_t handle) {
+    uint64_t low = handle & 0xFFFFFFFFu;
+    if (low == 0 || low > requests_.size()) {
+        return nullptr;
+    }
+    Request& request = requests_[static_cast<size_t>(low - 1)];
+    if (!request.active || request.generation != static_cast<uint32_t>(handle >> 32)) {
+        return nullptr;
+    }
+    return &request;
+}
+
+void CoapResponseScheduler::release(uint32_t row) {
+    Request& request = requests_[row];
+    std::unordered_map<uint64_t, uint32_t>::iterator found =
+        pending_.find(pendingKey(request.endpointHash, request.messageId));
+    if (found != pending_.end() && found->second == row) {
+        pending_.erase(found);
+    }
+    if (request.completed) {
+        completed_--;
+    } else {
+        count_--;
+    }
+    request.active = false;
+    request.completed = false;
+    request.timer = TIMER_INVALID;
+    request.generation++;
+    freeRows_.push_back(row);
+}
+
+uint64_t CoapResponseScheduler::pendingKey(uint64_t endpointHash, uint16_t messageId) {
+    // Rows store endpoint and MID, so a key collision only costs the
+    // duplicate check for the colliding request
+    return hashToken(endpointHash, 0) ^ messageId;
+}
+
+CoapMemoryUsage CoapResponseScheduler::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.add(timers_.memoryUsage(), sizeof(timers_));
+    usage.addArray(count_ + completed_, requests_.capacity(), sizeof(Request));
+    usage.addArray(0, freeRows_.capacity(), sizeof(uint32_t));
+    usage.addHashTable(pending_.size(), pending_.bucket_count(), sizeof(std::pair<const uint64_t, uint32_t>));
+    usage.addArray(0, expired_.capacity(), sizeof(uint64_t));
+    usage.entries = count_ + completed_;
+    return usage;
+}
+
+} // namespace CoapPacket
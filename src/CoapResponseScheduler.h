@@ -0,0 +1,162 @@
+#ifndef COAP_RESPONSE_SCHEDULER_H
+#define COAP_RESPONSE_SCHEDULER_H
+
+#include "CoapMemory.h"
+#include "CoapTimerWheel.h"
+#include "CoapTypes.h"
+#include "CoapError.h"
+#include <unordered_map>
+#include <vector>
+
+namespace CoapPacket {
+
+// Time a CON request may wait for a piggybacked response, milliseconds;
+// half of ACK_TIMEOUT (RFC 7252 section 4.8) leaves room for path delay
+constexpr uint32_t RESPONSE_PIGGYBACK_WINDOW = 1000;
+
+// Time a completed exchange is remembered, milliseconds (EXCHANGE_LIFETIME,
+// RFC 7252 section 4.8.2)
+constexpr uint32_t RESPONSE_EXCHANGE_LIFETIME = 247000;
+
+/**
+ * What accept() found for a request's endpoint and MID
+ */
+enum class CoapRequestState : uint8_t {
+    NEW,            // First copy: run the handler
+    PENDING,        // Retransmission while the handler runs
+    COMPLETED       // Retransmission after complete(): re-send the stored response
+};
+
+/**
+ * How to send the response of a completed request
+ */
+struct CoapResponsePlan {
+    uint64_t cookie;        // Cookie passed to accept() with the first copy
+    CoapType type;          // ACK (piggybacked), CON (separate) or NON
+    uint16_t messageId;     // Request MID for ACK, a fresh MID otherwise
+    bool separate;          // An empty ACK was sent before
+
+    CoapResponsePlan() : cookie(0), type(CoapType::ACK), messageId(0), separate(false) {}
+};
+
+/**
+ * Empty ACK that is due for a pending request
+ */
+struct CoapEmptyAck {
+    uint64_t cookie;
+    uint64_t endpointHash;
+    uint16_t messageId;
+};
+
+/**
+ * Server-side piggyback or separate response policy (RFC 7252 section 5.2)
+ *
+ * Each accepted CON request gets a deadline in a timer wheel. If the
+ * handler completes before the deadline the response is piggybacked on
+ * the ACK (one packet). Otherwise poll() reports the empty ACK when the
+ * deadline passes and the response goes out later as a separate CON.
+ * A retransmission of a pending request moves its deadline to now, since
+ * the client has already given up waiting. A retransmission that arrives
+ * after the empty ACK means the ACK was lost: poll() reports it again.
+ *
+ * Completed exchanges are remembered for the exchange lifetime, so a
+ * retransmission after a lost response is reported as COMPLETED with the
+ * stored plan instead of running the handler again (RFC 7252 section
+ * 4.5). The caller re-sends the response it kept under plan.cookie; for a
+ * separate response it re-sends the empty ACK, since the separate CON is
+ * retransmitted on its own.
+ *
+ * Time arguments are milliseconds on a monotonic clock.
+ */
+class CoapResponseScheduler {
+public:
+    explicit CoapResponseScheduler(uint32_t piggybackWindow = RESPONSE_PIGGYBACK_WINDOW,
+                                   uint16_t firstMessageId = 0, uint64_t now = 0,
+                                   uint32_t exchangeLifetime = RESPONSE_EXCHANGE_LIFETIME);
+
+    /**
+     * Start tracking a request from endpointHash; returns its handle
+     * If the same endpoint and MID are pending or were completed within
+     * the exchange lifetime, state is PENDING or COMPLETED and the handle
+     * of the first copy is returned. For COMPLETED, plan is the plan that
+     * complete() returned.
+     */
+    uint64_t accept(uint64_t endpointHash, CoapType type, uint16_t messageId, uint64_t cookie,
+                    uint64_t now, CoapRequestState& state, CoapResponsePlan& plan);
+
+    /**
+     * The handler finished: decide how to send the response
+     * The exchange is remembered until now plus the exchange lifetime.
+     * Returns INVALID_ARGUMENT for unknown or already completed handles.
+     */
+    CoapError complete(uint64_t handle, uint64_t now, CoapResponsePlan& plan);
+
+    /**
+     * Stop tracking a request (pending or completed) without responding
+     */
+    bool cancel(uint64_t handle);
+
+    /**
+     * Advance time, forget expired exchanges and append the empty ACKs
+     * that became due
+     * Returns the number appended.
+     */
+    size_t poll(uint64_t now, std::vector<CoapEmptyAck>& acks);
+
+    /**
+     * Get number of pending requests
+     */
+    size_t size() const;
+
+    /**
+     * Get number of completed exchanges still remembered
+     */
+    size_t getCompletedCount() const;
+
+    /**
+     * Get number of responses piggybacked / sent separately so far
+     */
+    uint64_t getPiggybackedCount() const;
+    uint64_t getSeparateCount() const;
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts pending and completed exchanges
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    struct Request {
+        uint64_t endpointHash;
+        uint64_t timer;
+        CoapResponsePlan plan;  // cookie is set on accept(), the rest on complete()
+        uint32_t generation;
+        uint16_t messageId;
+        CoapType type;
+        bool active;
+        bool acked;
+        bool resend;        // Empty ACK was lost; report it again on poll()
+        bool completed;     // Kept until the exchange lifetime ends
+    };
+
+    uint32_t window_;
+    uint32_t lifetime_;
+    uint16_t nextMessageId_;
+    CoapTimerWheel timers_;
+    std::vector<Request> requests_;
+    std::vector<uint32_t> freeRows_;
+    std::unordered_map<uint64_t, uint32_t> pending_;   // (endpoint, MID) key -> row
+    std::vector<uint64_t> expired_;
+    size_t count_;
+    size_t completed_;
+    uint64_t piggybacked_;
+    uint64_t separate_;
+
+    Request* lookup(uint64_t handle);
+    void release(uint32_t row);
+    static uint64_t pendingKey(uint64_t endpointHash, uint16_t messageId);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_RESPONSE_SCHEDULER_H
@@ -0,0 +1,278 @@
+#include "CoapSimNetwork.h"
+#include <cmath>
+
+namespace CoapPacket {
+
+namespace {
+
+// Shape of the PARETO delay tail; heavy but with a finite mean
+const double SIM_PARETO_SHAPE = 1.5;
+
+// Cap on sampled extra delay, in multiples of jitter
+const double SIM_DELAY_CAP = 1000.0;
+
+} // namespace
+
+CoapSimNetwork::CoapSimNetwork(uint64_t seed)
+    : now_(0)
+    , rng_(seed)
+    , sequence_(0)
+    , nodes_(0) {}
+
+uint32_t CoapSimNetwork::addNode() {
+    uint32_t count = nodes_ + 1;
+    std::vector<LinkState> links(static_cast<size_t>(count) * count);
+    for (uint32_t from = 0; from < count; from++) {
+        for (uint32_t to = 0; to < count; to++) {
+            LinkState& state = links[static_cast<size_t>(from) * count + to];
+            if (from < nodes_ && to < nodes_) {
+                state = links_[static_cast<size_t>(from) * nodes_ + to];
+            } else {
+                state.link = defaultLink_;
+                state.busyUntil = 0;
+                state.configured = false;
+            }
+        }
+    }
+    links_.swap(links);
+    inboxes_.resize(count);
+    return nodes_++;
+}
+
+CoapError CoapSimNetwork::setLink(uint32_t from, uint32_t to, const CoapSimLink& link) {
+    if (from >= nodes_ || to >= nodes_) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+    LinkState& state = linkState(from, to);
+    state.link = link;
+    state.configured = true;
+    return CoapError::OK;
+}
+
+void CoapSimNetwork::setDefaultLink(const CoapSimLink& link) {
+    defaultLink_ = link;
+    for (LinkState& state : links_) {
+        if (!state.configured) {
+            state.link = link;
+        }
+    }
+}
+
+CoapError CoapSimNetwork::send(uint32_t from, uint32_t to, const uint8_t* data, size_t length) {
+    if (from >= nodes_ || to >= nodes_ || (data == nullptr && length > 0)) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+
+    LinkState& state = linkState(from, to);
+    const CoapSimLink& link = state.link;
+    state.stats.sent++;
+    state.stats.bytesSent += length;
+    stats_.sent++;
+    stats_.bytesSent += length;
+
+    if (link.mtu != 0 && length > link.mtu) {
+        state.stats.dropped++;
+        stats_.dropped++;
+        return CoapError::OK;
+    }
+
+    // Serialisation: the datagram leaves once the bytes queued before it
+    // are on the wire. Loss is decided after queueing, like a lossy path
+    // behind the sender's interface.
+    uint64_t departure = now_;
+    if (link.bandwidth != 0) {
+        uint64_t start = state.busyUntil > now_ ? state.busyUntil : now_;
+        if (link.queueLimit != 0) {
+            uint64_t backlog = (start - now_) * link.bandwidth / 1000000u;
+            if (backlog + length > link.queueLimit) {
+                state.stats.dropped++;
+                stats_.dropped++;
+                return CoapError::OK;
+            }
+        }
+        departure = start + (static_cast<uint64_t>(length) * 1000000u + link.bandwidth - 1) / link.bandwidth;
+        state.busyUntil = departure;
+    }
+
+    if (chance(link.loss)) {
+        state.stats.lost++;
+        stats_.lost++;
+        return CoapError::OK;
+    }
+
+    uint64_t arrival = departure + sampleDelay(link);
+    if (chance(link.reorder)) {
+        arrival += link.reorderDelay;
+        state.stats.reordered++;
+        stats_.reordered++;
+    }
+    schedule(arrival, from, to, data, length);
+
+    if (chance(link.duplicate)) {
+        state.stats.duplicated++;
+        stats_.duplicated++;
+        schedule(departure + sampleDelay(link), from, to, data, length);
+    }
+    return CoapError::OK;
+}
+
+bool CoapSimNetwork::receive(uint32_t node, CoapSimDatagram& datagram) {
+    if (node >= nodes_ || inboxes_[node].empty()) {
+        return false;
+    }
+    datagram = std::move(inboxes_[node].front());
+    inboxes_[node].pop_front();
+    return true;
+}
+
+size_t CoapSimNetwork::pending(uint32_t node) const {
+    return node < nodes_ ? inboxes_[node].size() : 0;
+}
+
+bool CoapSimNetwork::advance() {
+    if (events_.empty()) {
+        return false;
+    }
+    advanceTo(events_.top().time);
+    return true;
+}
+
+size_t CoapSimNetwork::advanceTo(uint64_t now) {
+    size_t delivered = 0;
+    while (!events_.empty() && events_.top().time <= now) {
+        Event event = events_.top();
+        events_.pop();
+        if (event.time > now_) {
+            now_ = event.time;
+        }
+        deliver(event);
+        delivered++;
+    }
+    if (now > now_) {
+        now_ = now;
+    }
+    return delivered;
+}
+
+uint64_t CoapSimNetwork::getTime() const {
+    return now_;
+}
+
+uint64_t CoapSimNetwork::getNextEventTime() const {
+    return events_.empty() ? UINT64_MAX : events_.top().time;
+}
+
+CoapSimStats CoapSimNetwork::getStats(uint32_t from, uint32_t to) const {
+    if (from >= nodes_ || to >= nodes_) {
+        return CoapSimStats();
+    }
+    return links_[static_cast<size_t>(from) * nodes_ + to].stats;
+}
+
+const CoapSimStats& CoapSimNetwork::getStats() const {
+    return stats_;
+}
+
+CoapSimNetwork::LinkState& CoapSimNetwork::linkState(uint32_t from, uint32_t to) {
+    return links_[static_cast<size_t>(from) * nodes_ + to];
+}
+
+void CoapSimNetwork::schedule(uint64_t time, uint32_t from, uint32_t to, const uint8_t* data, size_t length) {
+    uint32_t slot;
+    if (!freeSlots_.empty()) {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(inFlight_.size());
+        inFlight_.push_back(CoapSimDatagram());
+    }
+
+    CoapSimDatagram& datagram = inFlight_[slot];
+    datagram.from = from;
+    datagram.to = to;
+    datagram.sentAt = now_;
+    datagram.deliveredAt = time;
+    datagram.data.assign(data, data + length);
+
+    Event event = {time, sequence_++, slot};
+    events_.push(event);
+}
+
+void CoapSimNetwork::deliver(const Event& event) {
+    CoapSimDatagram& datagram = inFlight_[event.slot];
+    LinkState& state = linkState(datagram.from, datagram.to);
+    state.stats.delivered++;
+    state.stats.bytesDelivered += datagram.data.size();
+    stats_.delivered++;
+    stats_.bytesDelivered += datagram.data.size();
+
+    inboxes_[datagram.to].push_back(std::move(datagram));
+    inFlight_[event.slot].data.clear();
+    freeSlots_.push_back(event.slot);
+}
+
+uint64_t CoapSimNetwork::sampleDelay(const CoapSimLink& link) {
+    double extra = 0;
+    switch (link.delay) {
+        case CoapSimDelay::FIXED:
+            break;
+        case CoapSimDelay::UNIFORM:
+            extra = nextUnit() * link.jitter;
+            break;
+        case CoapSimDelay::EXPONENTIAL:
+            extra = -std::log(1.0 - nextUnit()) * link.jitter;
+            break;
+        case CoapSimDelay::PARETO:
+            extra = (std::pow(1.0 - nextUnit(), -1.0 / SIM_PARETO_SHAPE) - 1.0) * link.jitter;
+            break;
+    }
+    double cap = SIM_DELAY_CAP * link.jitter;
+    if (extra > cap) {
+        extra = cap;
+    }
+    return link.latency + static_cast<uint64_t>(extra);
+}
+
+uint64_t CoapSimNetwork::nextRandom() {
+    // splitmix64: full period and good enough for traffic models
+    uint64_t z = (rng_ += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double CoapSimNetwork::nextUnit() {
+    // 53 random bits in [0, 1)
+    return static_cast<double>(nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+bool CoapSimNetwork::chance(double probability) {
+    // Disabled effects draw nothing, so clean links do not consume the
+    // random sequence
+    return probability > 0 && nextUnit() < probability;
+}
+
+CoapMemoryUsage CoapSimNetwork::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.addArray(links_.size(), links_.capacity(), sizeof(LinkState));
+    usage.addArray(inboxes_.size(), inboxes_.capacity(), sizeof(std::deque<CoapSimDatagram>));
+    size_t datagrams = 0;
+    for (const std::deque<CoapSimDatagram>& inbox : inboxes_) {
+        usage.addArray(inbox.size(), inbox.size(), sizeof(CoapSimDatagram));
+        for (const CoapSimDatagram& datagram : inbox) {
+            usage.addArray(datagram.data.size(), datagram.data.capacity(), sizeof(uint8_t));
+        }
+        datagrams += inbox.size();
+    }
+    usage.addArray(events_.size(), inFlight_.capacity(), sizeof(CoapSimDatagram));
+    for (const CoapSimDatagram& datagram : inFlight_) {
+        usage.addArray(datagram.data.size(), datagram.data.capacity(), sizeof(uint8_t));
+    }
+    usage.addArray(0, freeSlots_.capacity(), sizeof(uint32_t));
+    usage.addArray(events_.size(), events_.size(), sizeof(Event));
+    usage.entries = datagrams + events_.size();
+    return usage;
+}
+
+} // namespace CoapPacket
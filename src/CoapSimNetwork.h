@@ -0,0 +1,206 @@
+#ifndef COAP_SIM_NETWORK_H
+#define COAP_SIM_NETWORK_H
+
+#include "CoapMemory.h"
+#include "CoapError.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <queue>
+#include <vector>
+
+namespace CoapPacket {
+
+/**
+ * One-way delay distribution of a simulated link
+ */
+enum class CoapSimDelay : uint8_t {
+    FIXED = 0,          // Always latency
+    UNIFORM = 1,        // latency + uniform [0, jitter]
+    EXPONENTIAL = 2,    // latency + exponential with mean jitter
+    PARETO = 3          // latency + Pareto tail (shape 1.5) scaled by jitter
+};
+
+/**
+ * Properties of a directed simulated link
+ * Times are microseconds of virtual time. Jitter alone can reorder
+ * datagrams, as on a real multipath network.
+ */
+struct CoapSimLink {
+    uint32_t latency;           // Base one-way delay
+    uint32_t jitter;            // Spread of the delay distribution
+    CoapSimDelay delay;
+    double loss;                // Probability that a datagram is dropped
+    double duplicate;           // Probability that a datagram arrives twice
+    double reorder;             // Probability that a datagram is held back
+    uint32_t reorderDelay;      // Extra delay of held back datagrams
+    uint64_t bandwidth;         // Bytes per second, 0 for unlimited
+    size_t queueLimit;          // Bytes waiting for the wire before tail drop, 0 for unlimited
+    size_t mtu;                 // Larger datagrams are dropped, 0 for unlimited
+
+    CoapSimLink()
+        : latency(0)
+        , jitter(0)
+        , delay(CoapSimDelay::FIXED)
+        , loss(0)
+        , duplicate(0)
+        , reorder(0)
+        , reorderDelay(0)
+        , bandwidth(0)
+        , queueLimit(0)
+        , mtu(0) {}
+};
+
+/**
+ * Traffic counters of a link or of the whole network
+ */
+struct CoapSimStats {
+    uint64_t sent;
+    uint64_t delivered;
+    uint64_t lost;              // Random loss
+    uint64_t dropped;           // Queue overflow or MTU
+    uint64_t duplicated;
+    uint64_t reordered;
+    uint64_t bytesSent;
+    uint64_t bytesDelivered;
+
+    CoapSimStats()
+        : sent(0), delivered(0), lost(0), dropped(0), duplicated(0), reordered(0),
+          bytesSent(0), bytesDelivered(0) {}
+};
+
+/**
+ * Datagram delivered to a simulated node
+ */
+struct CoapSimDatagram {
+    uint32_t from;
+    uint32_t to;
+    uint64_t sentAt;
+    uint64_t deliveredAt;
+    std::vector<uint8_t> data;
+};
+
+/**
+ * In-process simulated datagram network on a virtual clock
+ *
+ * Nodes exchange datagrams over directed links with configurable delay,
+ * loss, duplication, reordering and bandwidth. Nothing happens in real
+ * time: advance() jumps the clock to the next delivery, so minutes of
+ * traffic simulate in milliseconds. All randomness comes from one seeded
+ * generator and events with equal times keep send order, so a run is
+ * fully reproducible from its seed.
+ *
+ * Typical loop: send() from protocol code, then advance() (or
+ * advanceTo() the earliest protocol timer) and drain receive() per node.
+ */
+class CoapSimNetwork {
+public:
+    explicit CoapSimNetwork(uint64_t seed = 1);
+
+    /**
+     * Add a node; returns its id (ids are assigned from 0)
+     */
+    uint32_t addNode();
+
+    /**
+     * Set the link used from one node to another
+     * Links without their own settings use the default link.
+     */
+    CoapError setLink(uint32_t from, uint32_t to, const CoapSimLink& link);
+    void setDefaultLink(const CoapSimLink& link);
+
+    /**
+     * Send a datagram; it is copied and delivered according to the link
+     * Returns INVALID_ARGUMENT for unknown nodes. Lost or dropped
+     * datagrams still return OK, as UDP would.
+     */
+    CoapError send(uint32_t from, uint32_t to, const uint8_t* data, size_t length);
+
+    /**
+     * Take the next delivered datagram of a node; false if none is waiting
+     */
+    bool receive(uint32_t node, CoapSimDatagram& datagram);
+
+    /**
+     * Get number of datagrams waiting in a node's inbox
+     */
+    size_t pending(uint32_t node) const;
+
+    /**
+     * Move the clock to the next delivery and deliver everything due then
+     * Returns false (clock unchanged) if nothing is in flight.
+     */
+    bool advance();
+
+    /**
+     * Move the clock to now, delivering everything due by then
+     * Returns the number of datagrams delivered; now must not be in the past.
+     */
+    size_t advanceTo(uint64_t now);
+
+    /**
+     * Get the virtual time in microseconds
+     */
+    uint64_t getTime() const;
+
+    /**
+     * Get the time of the next delivery, or UINT64_MAX if nothing is in flight
+     */
+    uint64_t getNextEventTime() const;
+
+    /**
+     * Get counters of one link or of the whole network
+     */
+    CoapSimStats getStats(uint32_t from, uint32_t to) const;
+    const CoapSimStats& getStats() const;
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts datagrams in flight or waiting in inboxes
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    struct LinkState {
+        CoapSimLink link;
+        CoapSimStats stats;
+        uint64_t busyUntil;     // When the wire finishes the queued bytes
+        bool configured;
+    };
+
+    struct Event {
+        uint64_t time;
+        uint64_t sequence;
+        uint32_t slot;          // Index into inFlight_
+    };
+
+    struct EventLater {
+        bool operator()(const Event& a, const Event& b) const {
+            return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+        }
+    };
+
+    uint64_t now_;
+    uint64_t rng_;
+    uint64_t sequence_;
+    uint32_t nodes_;
+    CoapSimLink defaultLink_;
+    CoapSimStats stats_;
+    std::vector<LinkState> links_;                  // nodes_ x nodes_, row = sender
+    std::vector<std::deque<CoapSimDatagram>> inboxes_;
+    std::vector<CoapSimDatagram> inFlight_;
+    std::vector<uint32_t> freeSlots_;
+    std::priority_queue<Event, std::vector<Event>, EventLater> events_;
+
+    LinkState& linkState(uint32_t from, uint32_t to);
+    void schedule(uint64_t time, uint32_t from, uint32_t to, const uint8_t* data, size_t length);
+    void deliver(const Event& event);
+    uint64_t sampleDelay(const CoapSimLink& link);
+    uint64_t nextRandom();
+    double nextUnit();
+    bool chance(double probability);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_SIM_NETWORK_H
@@ -0,0 +1,102 @@
+#include "CoapStreamDecoder.h"
+#include "CoapTcpCodec.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+CoapStreamDecoder::CoapStreamDecoder(size_t maxMessageSize)
+    : buffer_(maxMessageSize)
+    , readPos_(0)
+    , writePos_(0)
+    , pending_(0) {}
+
+CoapError CoapStreamDecoder::fill(CoapByteStream& stream, size_t& received) {
+    uint8_t* out = getWritePtr();
+    CoapError err = stream.read(out, getWritable(), received);
+    if (err != CoapError::OK) {
+        return err;
+    }
+    commit(received);
+    return CoapError::OK;
+}
+
+uint8_t* CoapStreamDecoder::getWritePtr() {
+    compact();
+    return buffer_.data() + writePos_;
+}
+
+size_t CoapStreamDecoder::getWritable() const {
+    return buffer_.size() - writePos_;
+}
+
+void CoapStreamDecoder::commit(size_t length) {
+    writePos_ += length;
+    if (writePos_ > buffer_.size()) {
+        writePos_ = buffer_.size();
+    }
+}
+
+CoapError CoapStreamDecoder::next(CoapPacketView& view) {
+    readPos_ += pending_;
+    pending_ = 0;
+
+    const uint8_t* data = buffer_.data() + readPos_;
+    size_t available = writePos_ - readPos_;
+
+    size_t size = 0;
+    CoapError err = CoapTcpCodec::getMessageSize(data, available, size);
+    if (err != CoapError::OK) {
+        return err;
+    }
+    if (size > buffer_.size()) {
+        return CoapError::PAYLOAD_TOO_LARGE;
+    }
+    if (size > available) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    size_t consumed = 0;
+    err = CoapTcpCodec::parse(data, available, view, consumed);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    pending_ = consumed;
+    return CoapError::OK;
+}
+
+size_t CoapStreamDecoder::getBuffered() const {
+    return writePos_ - readPos_ - pending_;
+}
+
+void CoapStreamDecoder::reset() {
+    readPos_ = 0;
+    writePos_ = 0;
+    pending_ = 0;
+}
+
+void CoapStreamDecoder::compact() {
+    readPos_ += pending_;
+    pending_ = 0;
+
+    if (readPos_ == 0) {
+        return;
+    }
+
+    // Only the tail of a partially received message is moved
+    size_t remaining = writePos_ - readPos_;
+    if (remaining > 0) {
+        std::memmove(buffer_.data(), buffer_.data() + readPos_, remaining);
+    }
+    readPos_ = 0;
+    writePos_ = remaining;
+}
+
+CoapMemoryUsage CoapStreamDecoder::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.addArray(writePos_ - readPos_, buffer_.capacity(), sizeof(uint8_t));
+    return usage;
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,84 @@
+#ifndef COAP_STREAM_DECODER_H
+#define COAP_STREAM_DECODER_H
+
+#include "CoapMemory.h"
+#include "CoapPacketView.h"
+#include "CoapTransport.h"
+#include "CoapError.h"
+#include <vector>
+
+namespace CoapPacket {
+
+// Default Max-Message-Size for reliable transports (RFC 8323 section 5.3.1)
+constexpr size_t DEFAULT_MAX_MESSAGE_SIZE = 1152;
+
+/**
+ * Incremental decoder for length-prefixed CoAP messages (TCP/TLS)
+ *
+ * Bytes are read straight into the decoder's buffer (by a CoapByteStream
+ * or by the caller via getWritePtr()/commit()) and messages are parsed
+ * in place. A view returned by next() stays valid until the next call to
+ * next(), fill() or getWritePtr().
+ */
+class CoapStreamDecoder {
+public:
+    explicit CoapStreamDecoder(size_t maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE);
+
+    /**
+     * Read from stream into the free space of the buffer
+     */
+    CoapError fill(CoapByteStream& stream, size_t& received);
+
+    /**
+     * Get pointer to free space for the caller to write received bytes into
+     */
+    uint8_t* getWritePtr();
+
+    /**
+     * Get number of bytes that can be written at getWritePtr()
+     */
+    size_t getWritable() const;
+
+    /**
+     * Mark length bytes written at getWritePtr() as received
+     */
+    void commit(size_t length);
+
+    /**
+     * Parse the next complete message
+     * Returns CoapError::DATAGRAM_TOO_SHORT if more bytes are needed and
+     * CoapError::PAYLOAD_TOO_LARGE if the message exceeds the maximum size
+     */
+    CoapError next(CoapPacketView& view);
+
+    /**
+     * Get number of received bytes not yet returned as messages
+     */
+    size_t getBuffered() const;
+
+    /**
+     * Drop all buffered bytes
+     */
+    void reset();
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * used counts buffered bytes; entries is always 0
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    std::vector<uint8_t> buffer_;
+    size_t readPos_;
+    size_t writePos_;
+    size_t pending_;  // Size of the message last returned by next()
+
+    /**
+     * Release the last message and move a partial message to the front
+     */
+    void compact();
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_STREAM_DECODER_H
@@ -0,0 +1,215 @@
+#include "CoapStringTable.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+namespace {
+
+// Bytes per arena block; longer strings get their own block
+const size_t STRING_ARENA_BLOCK = 16384;
+
+uint32_t hashString(const char* data, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+} // namespace
+
+CoapStringTable::CoapStringTable(size_t maxStrings)
+    : maxStrings_(maxStrings < STRING_TABLE_MAX_STRINGS ? maxStrings : STRING_TABLE_MAX_STRINGS)
+    , count_(0)
+    , index_(createIndex(64))
+    , chunks_((maxStrings_ + CHUNK_SIZE - 1) / CHUNK_SIZE)
+    , arenaNext_(nullptr)
+    , arenaLeft_(0)
+    , arenaBytes_(0)
+    , stringBytes_(0) {
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+CoapStringTable::~CoapStringTable() {
+    destroyIndex(index_.load(std::memory_order_relaxed));
+    for (Index* index : retired_) {
+        destroyIndex(index);
+    }
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+    for (char* block : arena_) {
+        delete[] block;
+    }
+}
+
+uint32_t CoapStringTable::intern(const char* data, size_t length) {
+    uint32_t hash = hashString(data, length);
+    uint32_t id = lookup(index_.load(std::memory_order_acquire), data, length, hash);
+    if (id != STRING_ID_NONE) {
+        return id;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Index* index = index_.load(std::memory_order_relaxed);
+    id = lookup(index, data, length, hash);
+    if (id != STRING_ID_NONE) {
+        return id;
+    }
+
+    uint32_t count = count_.load(std::memory_order_relaxed);
+    if (count >= maxStrings_ || length > 0xFFFFFFFFu) {
+        return STRING_ID_NONE;
+    }
+    id = count + 1;
+
+    size_t chunk = count >> CHUNK_SHIFT;
+    Entry* entries = chunks_[chunk].load(std::memory_order_relaxed);
+    if (entries == nullptr) {
+        entries = new Entry[CHUNK_SIZE];
+        chunks_[chunk].store(entries, std::memory_order_release);
+    }
+    Entry& slot = entries[count & (CHUNK_SIZE - 1)];
+    slot.data = store(data, length);
+    slot.length = static_cast<uint32_t>(length);
+    slot.hash = hash;
+    count_.store(id, std::memory_order_release);
+
+    // Keep the load factor at or below one half; readers switch over to
+    // the larger copy when it is published
+    if (static_cast<size_t>(id) * 2 > index->mask + 1) {
+        Index* grown = createIndex((index->mask + 1) * 2);
+        for (uint32_t existing = 1; existing <= id; existing++) {
+            insertIndex(grown, entry(existing).hash, existing);
+        }
+        index_.store(grown, std::memory_order_release);
+        retired_.push_back(index);
+    } else {
+        insertIndex(index, hash, id);
+    }
+    return id;
+}
+
+uint32_t CoapStringTable::intern(const uint8_t* data, size_t length) {
+    return intern(reinterpret_cast<const char*>(data), length);
+}
+
+uint32_t CoapStringTable::find(const char* data, size_t length) const {
+    return lookup(index_.load(std::memory_order_acquire), data, length, hashString(data, length));
+}
+
+uint32_t CoapStringTable::find(const uint8_t* data, size_t length) const {
+    return find(reinterpret_cast<const char*>(data), length);
+}
+
+const char* CoapStringTable::get(uint32_t id, size_t& length) const {
+    if (id == STRING_ID_NONE || id > count_.load(std::memory_order_acquire)) {
+        length = 0;
+        return nullptr;
+    }
+    const Entry& e = entry(id);
+    length = e.length;
+    return e.data;
+}
+
+size_t CoapStringTable::size() const {
+    return count_.load(std::memory_order_acquire);
+}
+
+CoapMemoryUsage CoapStringTable::memoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = count_.load(std::memory_order_relaxed);
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.addArray(chunks_.size(), chunks_.capacity(), sizeof(std::atomic<Entry*>));
+    size_t allocatedChunks = 0;
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        if (chunks_[i].load(std::memory_order_relaxed) != nullptr) {
+            allocatedChunks++;
+        }
+    }
+    usage.addArray(count, allocatedChunks * CHUNK_SIZE, sizeof(Entry));
+    const Index* index = index_.load(std::memory_order_relaxed);
+    usage.addObject(sizeof(Index));
+    usage.addArray(count, index->mask + 1, sizeof(std::atomic<uint32_t>));
+    for (const Index* old : retired_) {
+        usage.addArray(0, sizeof(Index) + (old->mask + 1) * sizeof(std::atomic<uint32_t>), 1);
+    }
+    usage.addArray(retired_.size(), retired_.capacity(), sizeof(Index*));
+    usage.addArray(arena_.size(), arena_.capacity(), sizeof(char*));
+    usage.addArray(stringBytes_, arenaBytes_, 1);
+    usage.entries = count;
+    return usage;
+}
+
+const CoapStringTable::Entry& CoapStringTable::entry(uint32_t id) const {
+    uint32_t index = id - 1;
+    return chunks_[index >> CHUNK_SHIFT].load(std::memory_order_acquire)[index & (CHUNK_SIZE - 1)];
+}
+
+uint32_t CoapStringTable::lookup(const Index* index, const char* data, size_t length, uint32_t hash) const {
+    size_t pos = hash & index->mask;
+    while (true) {
+        uint32_t id = index->slots[pos].load(std::memory_order_acquire);
+        if (id == STRING_ID_NONE) {
+            return STRING_ID_NONE;
+        }
+        const Entry& e = entry(id);
+        if (e.hash == hash && e.length == length && (length == 0 || std::memcmp(e.data, data, length) == 0)) {
+            return id;
+        }
+        pos = (pos + 1) & index->mask;
+    }
+}
+
+const char* CoapStringTable::store(const char* data, size_t length) {
+    stringBytes_ += length;
+    if (length > STRING_ARENA_BLOCK / 4) {
+        arenaBytes_ += length;
+        char* block = new char[length];
+        std::memcpy(block, data, length);
+        arena_.push_back(block);
+        return block;
+    }
+    if (length > arenaLeft_ || arenaNext_ == nullptr) {
+        arenaNext_ = new char[STRING_ARENA_BLOCK];
+        arenaLeft_ = STRING_ARENA_BLOCK;
+        arenaBytes_ += STRING_ARENA_BLOCK;
+        arena_.push_back(arenaNext_);
+    }
+    char* out = arenaNext_;
+    if (length > 0) {
+        std::memcpy(out, data, length);
+    }
+    arenaNext_ += length;
+    arenaLeft_ -= length;
+    return out;
+}
+
+CoapStringTable::Index* CoapStringTable::createIndex(size_t capacity) {
+    Index* index = new Index();
+    index->mask = capacity - 1;
+    index->slots = new std::atomic<uint32_t>[capacity];
+    for (size_t i = 0; i < capacity; i++) {
+        index->slots[i].store(STRING_ID_NONE, std::memory_order_relaxed);
+    }
+    return index;
+}
+
+void CoapStringTable::destroyIndex(Index* index) {
+    delete[] index->slots;
+    delete index;
+}
+
+void CoapStringTable::insertIndex(Index* index, uint32_t hash, uint32_t id) {
+    size_t pos = hash & index->mask;
+    while (index->slots[pos].load(std::memory_order_relaxed) != STRING_ID_NONE) {
+        pos = (pos + 1) & index->mask;
+    }
+    index->slots[pos].store(id, std::memory_order_release);
+}
+
+} // namespace CoapPacket
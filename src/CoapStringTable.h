@@ -0,0 +1,109 @@
+#ifndef COAP_STRING_TABLE_H
+#define COAP_STRING_TABLE_H
+
+#include "CoapMemory.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace CoapPacket {
+
+// ID returned for strings that are not in the table
+constexpr uint32_t STRING_ID_NONE = 0;
+
+// Upper bound of CoapStringTable capacity
+constexpr size_t STRING_TABLE_MAX_STRINGS = 1u << 20;
+
+/**
+ * Interning table mapping byte strings to small integer IDs (1, 2, ...)
+ *
+ * Read-mostly and safe for concurrent use: find() and get() take no locks
+ * and never block; intern() serialises writers on a mutex. The hash index
+ * grows RCU-style: a larger copy is built and published with one atomic
+ * store while readers keep using the old one. Old index versions and all
+ * string bytes stay allocated until the table is destroyed, so pointers
+ * returned by get() remain valid for its lifetime.
+ */
+class CoapStringTable {
+public:
+    /**
+     * maxStrings bounds the number of IDs (at most STRING_TABLE_MAX_STRINGS)
+     */
+    explicit CoapStringTable(size_t maxStrings = 65536);
+    ~CoapStringTable();
+
+    CoapStringTable(const CoapStringTable&) = delete;
+    CoapStringTable& operator=(const CoapStringTable&) = delete;
+
+    /**
+     * Get the ID of a string, adding it if needed
+     * Returns STRING_ID_NONE when the table is full.
+     */
+    uint32_t intern(const char* data, size_t length);
+    uint32_t intern(const uint8_t* data, size_t length);
+
+    /**
+     * Get the ID of a string without adding it (lock-free)
+     */
+    uint32_t find(const char* data, size_t length) const;
+    uint32_t find(const uint8_t* data, size_t length) const;
+
+    /**
+     * Get the bytes of an ID (lock-free); nullptr for unknown IDs
+     */
+    const char* get(uint32_t id, size_t& length) const;
+
+    /**
+     * Get number of interned strings
+     */
+    size_t size() const;
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts strings; retired index versions count as slack.
+     * Takes the writer lock.
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    struct Entry {
+        const char* data;
+        uint32_t length;
+        uint32_t hash;
+    };
+
+    struct Index {
+        size_t mask;
+        std::atomic<uint32_t>* slots;
+    };
+
+    static const size_t CHUNK_SHIFT = 10;
+    static const size_t CHUNK_SIZE = 1u << CHUNK_SHIFT;
+
+    size_t maxStrings_;
+    std::atomic<uint32_t> count_;
+    std::atomic<Index*> index_;
+    std::vector<std::atomic<Entry*>> chunks_;   // Entries, CHUNK_SIZE per chunk
+
+    // Writer state, guarded by mutex_
+    mutable std::mutex mutex_;
+    std::vector<Index*> retired_;
+    std::vector<char*> arena_;
+    char* arenaNext_;
+    size_t arenaLeft_;
+    size_t arenaBytes_;     // Allocated for string bytes
+    size_t stringBytes_;    // Stored string bytes
+
+    const Entry& entry(uint32_t id) const;
+    uint32_t lookup(const Index* index, const char* data, size_t length, uint32_t hash) const;
+    const char* store(const char* data, size_t length);
+    static Index* createIndex(size_t capacity);
+    static void destroyIndex(Index* index);
+    static void insertIndex(Index* index, uint32_t hash, uint32_t id);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_STRING_TABLE_H
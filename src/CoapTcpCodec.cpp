@@ -0,0 +1,212 @@
+#include "CoapTcpCodec.h"
+#include "CoapParser.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+CoapError CoapTcpCodec::getMessageSize(const uint8_t* buffer, size_t length, size_t& size) {
+    if (length < 1) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    uint8_t lenField = buffer[0] >> 4;
+    uint8_t tokenLength = buffer[0] & 0x0F;
+    if (tokenLength > 8) {
+        return CoapError::INVALID_TOKEN_LENGTH;
+    }
+
+    // Extended length: 13 -> 1 byte, 14 -> 2 bytes, 15 -> 4 bytes
+    size_t extLength = (lenField < 13) ? 0 : (lenField == 13) ? 1 : (lenField == 14) ? 2 : 4;
+    if (length < 1 + extLength) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    uint64_t bodyLength = lenField;
+    if (lenField == 13) {
+        bodyLength = static_cast<uint64_t>(buffer[1]) + 13;
+    } else if (lenField == 14) {
+        bodyLength = ((static_cast<uint64_t>(buffer[1]) << 8) | buffer[2]) + 269;
+    } else if (lenField == 15) {
+        bodyLength = ((static_cast<uint64_t>(buffer[1]) << 24) |
+                      (static_cast<uint64_t>(buffer[2]) << 16) |
+                      (static_cast<uint64_t>(buffer[3]) << 8) |
+                      static_cast<uint64_t>(buffer[4])) + 65805;
+    }
+
+    // Header byte, extended length, code, token, options and payload
+    uint64_t total = 1 + extLength + 1 + tokenLength + bodyLength;
+    if (total > static_cast<uint64_t>(static_cast<size_t>(-1))) {
+        return CoapError::PAYLOAD_TOO_LARGE;
+    }
+
+    size = static_cast<size_t>(total);
+    return CoapError::OK;
+}
+
+CoapError CoapTcpCodec::parse(const uint8_t* buffer, size_t length, CoapPacketView& view,
+                              size_t& consumed) {
+    size_t size = 0;
+    CoapError err = getMessageSize(buffer, length, size);
+    if (err != CoapError::OK) {
+        return err;
+    }
+    if (size > length) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    uint8_t lenField = buffer[0] >> 4;
+    size_t offset = 1 + ((lenField < 13) ? 0 : (lenField == 13) ? 1 : (lenField == 14) ? 2 : 4);
+
+    err = parseBody(buffer, size, offset, buffer[0] & 0x0F, view);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    consumed = size;
+    return CoapError::OK;
+}
+
+CoapError CoapTcpCodec::parseWebSocket(const uint8_t* buffer, size_t length, CoapPacketView& view) {
+    if (length < 2) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    // Len must be zero; the WebSocket frame carries the length
+    if ((buffer[0] >> 4) != 0) {
+        return CoapError::INVALID_FORMAT;
+    }
+
+    uint8_t tokenLength = buffer[0] & 0x0F;
+    if (tokenLength > 8) {
+        return CoapError::INVALID_TOKEN_LENGTH;
+    }
+
+    return parseBody(buffer, length, 1, tokenLength, view);
+}
+
+CoapError CoapTcpCodec::serialize(const CoapPacket& packet, std::vector<uint8_t>& buffer,
+                                  size_t headroom) {
+    return serializeMessage(packet, true, buffer, headroom);
+}
+
+CoapError CoapTcpCodec::serializeWebSocket(const CoapPacket& packet, std::vector<uint8_t>& buffer,
+                                           size_t headroom) {
+    return serializeMessage(packet, false, buffer, headroom);
+}
+
+CoapError CoapTcpCodec::parseBody(const uint8_t* buffer, size_t length, size_t offset,
+                                  uint8_t tokenLength, CoapPacketView& view) {
+    view = CoapPacketView();
+
+    if (offset + 1 + tokenLength > length) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    view.code = static_cast<CoapCode>(buffer[offset++]);
+    if (!isValidReliableCodeClass(getCodeClass(view.code))) {
+        return CoapError::INVALID_CODE_CLASS;
+    }
+
+    view.token = buffer + offset;
+    view.token_length = tokenLength;
+    offset += tokenLength;
+
+    return CoapParser::parseViewBody(buffer, length, offset, view);
+}
+
+CoapError CoapTcpCodec::serializeMessage(const CoapPacket& packet, bool lengthPrefixed,
+                                         std::vector<uint8_t>& buffer, size_t headroom) {
+    if (packet.token_length > 8) {
+        return CoapError::INVALID_TOKEN_LENGTH;
+    }
+    if (!isValidReliableCodeClass(getCodeClass(packet.code))) {
+        return CoapError::INVALID_CODE_CLASS;
+    }
+
+    // Size the option block and payload
+    size_t bodyLength = 0;
+    uint16_t lastOptionNumber = 0;
+    for (const auto& option : packet.options) {
+        if (option.number < lastOptionNumber) {
+            return CoapError::INVALID_ARGUMENT;
+        }
+        if (option.value.size() > MAX_OPTION_VALUE_SIZE) {
+            return CoapError::OPTION_TOO_LONG;
+        }
+        uint16_t length = static_cast<uint16_t>(option.value.size());
+        bodyLength += getOptionHeaderSize(option.number - lastOptionNumber, length) + length;
+        lastOptionNumber = option.number;
+    }
+
+    size_t payloadSize = packet.getPayloadSize();
+    if (payloadSize > 0) {
+        bodyLength += 1 + payloadSize;
+    }
+
+    // Len nibble and extended length
+    uint8_t lenField = 0;
+    uint8_t extLength[4];
+    size_t extSize = 0;
+    if (lengthPrefixed) {
+        if (bodyLength < 13) {
+            lenField = static_cast<uint8_t>(bodyLength);
+        } else if (bodyLength < 269) {
+            lenField = 13;
+            extLength[extSize++] = static_cast<uint8_t>(bodyLength - 13);
+        } else if (bodyLength < 65805) {
+            lenField = 14;
+            size_t ext = bodyLength - 269;
+            extLength[extSize++] = static_cast<uint8_t>(ext >> 8);
+            extLength[extSize++] = static_cast<uint8_t>(ext & 0xFF);
+        } else {
+            uint64_t ext = static_cast<uint64_t>(bodyLength) - 65805;
+            if (ext > 0xFFFFFFFFu) {
+                return CoapError::PAYLOAD_TOO_LARGE;
+            }
+            lenField = 15;
+            extLength[extSize++] = static_cast<uint8_t>(ext >> 24);
+            extLength[extSize++] = static_cast<uint8_t>((ext >> 16) & 0xFF);
+            extLength[extSize++] = static_cast<uint8_t>((ext >> 8) & 0xFF);
+            extLength[extSize++] = static_cast<uint8_t>(ext & 0xFF);
+        }
+    }
+
+    buffer.resize(headroom + 1 + extSize + 1 + packet.token_length + bodyLength);
+    uint8_t* out = buffer.data() + headroom;
+
+    // 1. Length/TKL byte, extended length and code
+    *out++ = static_cast<uint8_t>((lenField << 4) | (packet.token_length & 0x0F));
+    if (extSize > 0) {
+        std::memcpy(out, extLength, extSize);
+        out += extSize;
+    }
+    *out++ = static_cast<uint8_t>(packet.code);
+
+    // 2. Token
+    if (packet.token_length > 0) {
+        std::memcpy(out, packet.token, packet.token_length);
+        out += packet.token_length;
+    }
+
+    // 3. Options (delta-encoded)
+    lastOptionNumber = 0;
+    for (const auto& option : packet.options) {
+        uint16_t length = static_cast<uint16_t>(option.value.size());
+        out += encodeOptionHeader(out, option.number - lastOptionNumber, length);
+        if (length > 0) {
+            std::memcpy(out, option.value.data(), length);
+            out += length;
+        }
+        lastOptionNumber = option.number;
+    }
+
+    // 4. Payload marker and payload
+    if (payloadSize > 0) {
+        *out++ = PAYLOAD_MARKER;
+        std::memcpy(out, packet.getPayloadPtr(), payloadSize);
+    }
+
+    return CoapError::OK;
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,69 @@
+#ifndef COAP_TCP_CODEC_H
+#define COAP_TCP_CODEC_H
+
+#include "CoapPacket.h"
+#include "CoapPacketView.h"
+#include "CoapError.h"
+#include <vector>
+
+namespace CoapPacket {
+
+/**
+ * Codec for the CoAP message format of reliable transports (RFC 8323)
+ *
+ * Messages carry no type or message ID; views report CON and 0 for both.
+ * TCP/TLS messages are length-prefixed (section 3.2), WebSocket messages
+ * rely on the WebSocket frame length (section 4.2).
+ * Payload size is bounded by the transport (Max-Message-Size), not
+ * MAX_PAYLOAD_SIZE.
+ */
+class CoapTcpCodec {
+public:
+    /**
+     * Get the total size of the length-prefixed message at the start of buffer
+     * Returns CoapError::DATAGRAM_TOO_SHORT if the header is incomplete
+     */
+    static CoapError getMessageSize(const uint8_t* buffer, size_t length, size_t& size);
+
+    /**
+     * Parse a length-prefixed (TCP/TLS) message into a zero-copy view
+     * consumed is set to the message size
+     * Returns CoapError::DATAGRAM_TOO_SHORT if the message is incomplete
+     */
+    static CoapError parse(const uint8_t* buffer, size_t length, CoapPacketView& view, size_t& consumed);
+
+    /**
+     * Parse a WebSocket message (one frame payload) into a zero-copy view
+     */
+    static CoapError parseWebSocket(const uint8_t* buffer, size_t length, CoapPacketView& view);
+
+    /**
+     * Serialize packet as a length-prefixed (TCP/TLS) message
+     * The message is written after headroom bytes, which are left for the caller
+     * Options must be sorted by number (as produced by CoapBuilder::build)
+     */
+    static CoapError serialize(const CoapPacket& packet, std::vector<uint8_t>& buffer, size_t headroom = 0);
+
+    /**
+     * Serialize packet as a WebSocket message (no length field)
+     */
+    static CoapError serializeWebSocket(const CoapPacket& packet, std::vector<uint8_t>& buffer,
+                                        size_t headroom = 0);
+
+private:
+    /**
+     * Parse code, token, options and payload after the length field
+     */
+    static CoapError parseBody(const uint8_t* buffer, size_t length, size_t offset,
+                               uint8_t tokenLength, CoapPacketView& view);
+
+    /**
+     * Serialize with or without the length field
+     */
+    static CoapError serializeMessage(const CoapPacket& packet, bool lengthPrefixed,
+                                      std::vector<uint8_t>& buffer, size_t headroom);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_TCP_CODEC_H
@@ -0,0 +1,141 @@
+#include "CoapTimerWheel.h"
+
+namespace CoapPacket {
+
+namespace {
+
+const uint32_t TIMER_NIL = 0xFFFFFFFFu;
+
+size_t roundUpSlots(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+CoapTimerWheel::CoapTimerWheel(size_t slots, uint64_t start)
+    : slots_(roundUpSlots(slots > 0 ? slots : 1), TIMER_NIL)
+    , freeList_(TIMER_NIL)
+    , mask_(slots_.size() - 1)
+    , count_(0)
+    , now_(start) {}
+
+uint64_t CoapTimerWheel::schedule(uint64_t expiry, uint64_t cookie) {
+    uint32_t index;
+    if (freeList_ != TIMER_NIL) {
+        index = freeList_;
+        freeList_ = timers_[index].next;
+    } else {
+        index = static_cast<uint32_t>(timers_.size());
+        Timer timer = {0, 0, TIMER_NIL, TIMER_NIL, 0, false};
+        timers_.push_back(timer);
+    }
+
+    Timer& timer = timers_[index];
+    timer.expiry = (expiry > now_) ? expiry : now_;
+    timer.cookie = cookie;
+    timer.active = true;
+    link(index);
+    count_++;
+
+    // Generation in the high half makes handles of reused entries distinct
+    return (static_cast<uint64_t>(timer.generation) << 32) | (static_cast<uint64_t>(index) + 1);
+}
+
+bool CoapTimerWheel::cancel(uint64_t handle) {
+    uint64_t low = handle & 0xFFFFFFFFu;
+    if (low == 0 || low > timers_.size()) {
+        return false;
+    }
+    uint32_t index = static_cast<uint32_t>(low - 1);
+    Timer& timer = timers_[index];
+    if (!timer.active || timer.generation != static_cast<uint32_t>(handle >> 32)) {
+        return false;
+    }
+    unlink(index);
+    release(index);
+    return true;
+}
+
+size_t CoapTimerWheel::advance(uint64_t now, std::vector<uint64_t>& expired) {
+    if (now < now_) {
+        return 0;
+    }
+
+    // The current slot is visited again: timers scheduled in the past sit there
+    uint64_t ticks = now - now_ + 1;
+    if (ticks > slots_.size()) {
+        ticks = slots_.size();
+    }
+
+    size_t fired = 0;
+    for (uint64_t t = 0; t < ticks; t++) {
+        uint32_t index = slots_[static_cast<size_t>((now_ + t) & mask_)];
+        while (index != TIMER_NIL) {
+            uint32_t next = timers_[index].next;
+            if (timers_[index].expiry <= now) {
+                expired.push_back(timers_[index].cookie);
+                unlink(index);
+                release(index);
+                fired++;
+            }
+            index = next;
+        }
+    }
+    now_ = now;
+    return fired;
+}
+
+size_t CoapTimerWheel::size() const {
+    return count_;
+}
+
+uint64_t CoapTimerWheel::getTime() const {
+    return now_;
+}
+
+void CoapTimerWheel::link(uint32_t index) {
+    Timer& timer = timers_[index];
+    uint32_t& head = slots_[static_cast<size_t>(timer.expiry & mask_)];
+    timer.prev = TIMER_NIL;
+    timer.next = head;
+    if (head != TIMER_NIL) {
+        timers_[head].prev = index;
+    }
+    head = index;
+}
+
+void CoapTimerWheel::unlink(uint32_t index) {
+    Timer& timer = timers_[index];
+    if (timer.prev != TIMER_NIL) {
+        timers_[timer.prev].next = timer.next;
+    } else {
+        slots_[static_cast<size_t>(timer.expiry & mask_)] = timer.next;
+    }
+    if (timer.next != TIMER_NIL) {
+        timers_[timer.next].prev = timer.prev;
+    }
+}
+
+void CoapTimerWheel::release(uint32_t index) {
+    Timer& timer = timers_[index];
+    timer.active = false;
+    timer.generation++;
+    timer.next = freeList_;
+    freeList_ = index;
+    count_--;
+}
+
+CoapMemoryUsage CoapTimerWheel::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.addArray(count_, timers_.capacity(), sizeof(Timer));
+    usage.addArray(slots_.size(), slots_.capacity(), sizeof(uint32_t));
+    usage.entries = count_;
+    return usage;
+}
+
+} // namespace CoapPacket
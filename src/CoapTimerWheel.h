@@ -0,0 +1,88 @@
+#ifndef COAP_TIMER_WHEEL_H
+#define COAP_TIMER_WHEEL_H
+
+#include "CoapMemory.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CoapPacket {
+
+// Handle value never returned by CoapTimerWheel::schedule()
+constexpr uint64_t TIMER_INVALID = 0;
+
+/**
+ * Hashed timer wheel
+ *
+ * Time is an abstract tick count chosen by the caller (e.g. seconds for
+ * registration lifetimes, milliseconds for response deadlines). Timers
+ * hash into slots by expiry, so schedule() and cancel() are O(1) and
+ * advance() visits only the slots of the elapsed ticks. Each timer
+ * carries a caller cookie that advance() returns when it fires.
+ */
+class CoapTimerWheel {
+public:
+    /**
+     * slots is rounded up to a power of two; start is the current tick
+     */
+    explicit CoapTimerWheel(size_t slots = 4096, uint64_t start = 0);
+
+    /**
+     * Schedule a timer at tick expiry (a past expiry fires on the next
+     * advance()); returns its handle
+     */
+    uint64_t schedule(uint64_t expiry, uint64_t cookie);
+
+    /**
+     * Cancel a pending timer; returns false if it already fired or the
+     * handle is stale
+     */
+    bool cancel(uint64_t handle);
+
+    /**
+     * Move time forward to now and append cookies of expired timers
+     * Returns the number of timers that fired.
+     */
+    size_t advance(uint64_t now, std::vector<uint64_t>& expired);
+
+    /**
+     * Get number of pending timers
+     */
+    size_t size() const;
+
+    /**
+     * Get the current tick
+     */
+    uint64_t getTime() const;
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts pending timers; the slot array is always in use
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    struct Timer {
+        uint64_t expiry;
+        uint64_t cookie;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;
+        bool active;
+    };
+
+    std::vector<Timer> timers_;
+    std::vector<uint32_t> slots_;     // Head of each slot's list
+    uint32_t freeList_;
+    size_t mask_;
+    size_t count_;
+    uint64_t now_;
+
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_TIMER_WHEEL_H
@@ -0,0 +1,136 @@
+#ifndef COAP_TOKEN_H
+#define COAP_TOKEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace CoapPacket {
+
+/**
+ * Token helpers
+ *
+ * A token (0-8 bytes) is handled as one uint64_t holding its bytes in
+ * memory order, zero-padded, plus its length. Matching two tokens is then
+ * one 64-bit compare and hashing one multiply-xorshift, instead of byte
+ * loops. Values are only comparable on the same host (the layout follows
+ * host byte order).
+ */
+
+/**
+ * Token as a hashable key
+ */
+struct CoapTokenKey {
+    uint64_t value;     // Token bytes, zero-padded
+    uint8_t length;
+
+    CoapTokenKey() : value(0), length(0) {}
+    CoapTokenKey(uint64_t tokenValue, uint8_t tokenLength) : value(tokenValue), length(tokenLength) {}
+
+    bool operator==(const CoapTokenKey& other) const {
+        return value == other.value && length == other.length;
+    }
+    bool operator!=(const CoapTokenKey& other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * Load a token into a zero-padded uint64_t; reads exactly length bytes
+ * 0, 4 and 8 byte tokens (the common sizes) compile to a single load.
+ */
+inline uint64_t loadToken(const uint8_t* token, uint8_t length) {
+    uint64_t value = 0;
+    switch (length) {
+        case 0:
+            break;
+        case 8:
+            std::memcpy(&value, token, 8);
+            break;
+        case 4:
+            std::memcpy(&value, token, 4);
+            break;
+        default:
+            std::memcpy(&value, token, length < 8 ? length : 8);
+            break;
+    }
+    return value;
+}
+
+/**
+ * Clear the bytes of value past length (0-8)
+ * For tokens loaded with an unchecked 8-byte read, e.g. from an encoded
+ * message with at least 8 bytes after the header.
+ */
+inline uint64_t maskToken(uint64_t value, uint8_t length) {
+    // Eight 0xFF then eight 0x00: the 8 bytes at 8 - length are the mask
+    // in memory order, independent of host byte order
+    static const uint8_t masks[16] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    uint64_t mask;
+    std::memcpy(&mask, masks + 8 - (length < 8 ? length : 8), 8);
+    return value & mask;
+}
+
+/**
+ * Load the token of an encoded message (length bytes of datagram)
+ * Returns false if the header is truncated or the token length invalid.
+ */
+inline bool loadMessageToken(const uint8_t* datagram, size_t length, CoapTokenKey& key) {
+    if (length < 4) {
+        return false;
+    }
+    uint8_t tokenLength = datagram[0] & 0x0F;
+    if (tokenLength > 8 || length < 4 + static_cast<size_t>(tokenLength)) {
+        return false;
+    }
+    uint64_t value;
+    if (length >= 12) {
+        std::memcpy(&value, datagram + 4, 8);
+        value = maskToken(value, tokenLength);
+    } else {
+        value = loadToken(datagram + 4, tokenLength);
+    }
+    key = CoapTokenKey(value, tokenLength);
+    return true;
+}
+
+/**
+ * Compare two tokens given as zero-padded values
+ */
+inline bool tokenEquals(uint64_t a, uint8_t aLength, uint64_t b, uint8_t bLength) {
+    return a == b && aLength == bLength;
+}
+
+/**
+ * Compare two tokens given as byte arrays
+ */
+inline bool tokenEquals(const uint8_t* a, uint8_t aLength, const uint8_t* b, uint8_t bLength) {
+    return aLength == bLength && loadToken(a, aLength) == loadToken(b, bLength);
+}
+
+/**
+ * Hash a token value (splitmix64 finaliser); length is mixed in so that
+ * tokens differing only in trailing zero bytes hash differently
+ */
+inline uint64_t hashToken(uint64_t value, uint8_t length) {
+    uint64_t x = value ^ (static_cast<uint64_t>(length) * 0x9E3779B97F4A7C15ull);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Hash functor for unordered containers keyed by CoapTokenKey
+ */
+struct CoapTokenKeyHash {
+    size_t operator()(const CoapTokenKey& key) const {
+        return static_cast<size_t>(hashToken(key.value, key.length));
+    }
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_TOKEN_H
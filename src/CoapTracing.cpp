@@ -0,0 +1,308 @@
+#include "CoapTracing.h"
+#include "CoapOptions.h"
+#include "CoapToken.h"
+#include <random>
+
+namespace CoapPacket {
+
+namespace {
+
+const char spanHexDigits[] = "0123456789abcdef";
+
+const char* const SPAN_STAGE_NAMES[] = {"receive", "parse", "handle", "build", "send", "forward"};
+
+size_t roundUpSpans(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+uint64_t readBe64(const uint8_t* p) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+void writeBe64(uint8_t* p, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = static_cast<uint8_t>(value);
+        value >>= 8;
+    }
+}
+
+/**
+ * Bounded JSON writer; sets overflow instead of writing past capacity
+ */
+class SpanWriter {
+public:
+    SpanWriter(char* buffer, size_t capacity) : buffer_(buffer), capacity_(capacity), length_(0), overflow_(false) {}
+
+    void text(const char* value) {
+        while (*value != '\0') {
+            put(*value++);
+        }
+    }
+
+    void hex(uint64_t value) {
+        put('"');
+        for (int shift = 60; shift >= 0; shift -= 4) {
+            put(spanHexDigits[(value >> shift) & 0x0F]);
+        }
+        put('"');
+    }
+
+    void decimal(uint64_t value) {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (count > 0) {
+            put(digits[--count]);
+        }
+    }
+
+    size_t length() const { return length_; }
+    bool overflow() const { return overflow_; }
+
+private:
+    char* buffer_;
+    size_t capacity_;
+    size_t length_;
+    bool overflow_;
+
+    void put(char c) {
+        if (length_ < capacity_) {
+            buffer_[length_++] = c;
+        } else {
+            overflow_ = true;
+        }
+    }
+};
+
+} // namespace
+
+CoapSpanBuffer::CoapSpanBuffer() : head_(0), tail_(0), dropped_(0), spans_(nullptr), mask_(0), claimed_(false) {}
+
+uint64_t CoapSpanBuffer::getDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+void CoapSpanBuffer::append(const CoapTraceContext& context, CoapSpanStage stage, uint64_t start, uint64_t end,
+                            uint8_t status) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > mask_) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    CoapSpan& span = spans_[head & mask_];
+    span.traceId = context.traceId;
+    span.spanId = context.spanId;
+    span.parentId = context.parentId;
+    span.start = start;
+    span.end = end;
+    span.stage = stage;
+    span.status = status;
+    head_.store(head + 1, std::memory_order_release);
+}
+
+CoapTracer::CoapTracer(double sampleRate, size_t maxThreads, size_t spansPerThread, uint16_t optionNumber,
+                       uint64_t seed)
+    : buffers_(maxThreads)
+    , storage_(maxThreads * roundUpSpans(spansPerThread > 0 ? spansPerThread : 1))
+    , used_(0)
+    , nextId_(0)
+    , idBase_(seed)
+    , threshold_(0)
+    , seed_(seed)
+    , optionNumber_(optionNumber) {
+    size_t capacity = roundUpSpans(spansPerThread > 0 ? spansPerThread : 1);
+    for (size_t i = 0; i < maxThreads; i++) {
+        buffers_[i].spans_ = storage_.data() + i * capacity;
+        buffers_[i].mask_ = capacity - 1;
+    }
+    if (seed == 0) {
+        // Tracers on different hops must not share an ID sequence
+        std::random_device entropy;
+        idBase_ = (static_cast<uint64_t>(entropy()) << 32) ^ entropy();
+    }
+    if (sampleRate >= 1.0) {
+        threshold_ = UINT64_MAX;
+    } else if (sampleRate > 0) {
+        threshold_ = static_cast<uint64_t>(sampleRate * 18446744073709551616.0);
+    }
+}
+
+CoapSpanBuffer* CoapTracer::attach() {
+    // Prefer the lowest free buffer so exportJson() only walks buffers that were used
+    for (size_t i = 0; i < buffers_.size(); i++) {
+        bool expected = false;
+        if (!buffers_[i].claimed_.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            continue;
+        }
+        size_t used = used_.load(std::memory_order_relaxed);
+        while (used < i + 1 && !used_.compare_exchange_weak(used, i + 1, std::memory_order_release)) {
+        }
+        return &buffers_[i];
+    }
+    return nullptr;
+}
+
+void CoapTracer::detach(CoapSpanBuffer* buffer) {
+    if (buffer != nullptr) {
+        buffer->claimed_.store(false, std::memory_order_release);
+    }
+}
+
+bool CoapTracer::peek(const uint8_t* datagram, size_t length, CoapTraceContext& context) const {
+    context = CoapTraceContext();
+    size_t offset = 0;
+    if (CoapOptionIterator::locateOptions(datagram, length, offset) != CoapError::OK) {
+        return false;
+    }
+
+    // Options are sorted, so the walk stops at the first larger number
+    CoapOptionIterator options(datagram, length, offset);
+    CoapOptionRef option;
+    bool found = false;
+    while (options.next(option) && option.number <= optionNumber_) {
+        if (option.number == optionNumber_) {
+            found = decode(option.value, option.length, context) == CoapError::OK;
+            break;
+        }
+    }
+    if (options.getError() != CoapError::OK) {
+        context = CoapTraceContext();
+        return false;
+    }
+
+    if (!found) {
+        // The hash only decides sampling; the IDs must be unique
+        uint8_t tokenLength = datagram[0] & 0x0F;
+        uint64_t key = hashToken(loadToken(datagram + 4, tokenLength) ^ seed_, tokenLength) ^
+                       (static_cast<uint64_t>(datagram[2]) << 8 | datagram[3]);
+        uint64_t draw = hashToken(key, 8);
+        context.sampled = draw < threshold_ || threshold_ == UINT64_MAX;
+        if (!context.sampled) {
+            return false;
+        }
+        context.traceId = newId();
+    } else if (!context.sampled) {
+        return false;
+    }
+    context.spanId = newId();
+    return true;
+}
+
+uint64_t CoapTracer::newId() const {
+    // splitmix64: the finaliser is a bijection, so IDs repeat only after 2^64 draws
+    uint64_t id = 0;
+    while (id == 0) {
+        uint64_t step = nextId_.fetch_add(1, std::memory_order_relaxed) + 1;
+        id = hashToken(idBase_ + step * 0x9E3779B97F4A7C15ull, 8);
+    }
+    return id;
+}
+
+CoapError CoapTracer::encode(const CoapTraceContext& context, uint8_t* value, size_t capacity, size_t& length) {
+    length = 0;
+    if (value == nullptr || capacity < TRACE_OPTION_SIZE) {
+        return CoapError::BUFFER_TOO_SMALL;
+    }
+    value[0] = context.sampled ? TRACE_FLAG_SAMPLED : 0;
+    writeBe64(value + 1, context.traceId);
+    writeBe64(value + 9, context.spanId);
+    length = TRACE_OPTION_SIZE;
+    return CoapError::OK;
+}
+
+CoapError CoapTracer::decode(const uint8_t* value, size_t length, CoapTraceContext& context) {
+    if (value == nullptr || length != TRACE_OPTION_SIZE) {
+        return CoapError::INVALID_FORMAT;
+    }
+    context.sampled = (value[0] & TRACE_FLAG_SAMPLED) != 0;
+    context.traceId = readBe64(value + 1);
+    context.parentId = readBe64(value + 9);
+    return CoapError::OK;
+}
+
+size_t CoapTracer::exportJson(std::string& out) {
+    size_t count = used_.load(std::memory_order_acquire);
+    if (count > buffers_.size()) {
+        count = buffers_.size();
+    }
+
+    char line[256];
+    size_t exported = 0;
+    for (size_t i = 0; i < count; i++) {
+        CoapSpanBuffer& buffer = buffers_[i];
+        uint64_t tail = buffer.tail_.load(std::memory_order_relaxed);
+        uint64_t head = buffer.head_.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            size_t length = 0;
+            if (formatSpan(buffer.spans_[tail & buffer.mask_], line, sizeof(line), length) == CoapError::OK) {
+                out.append(line, length);
+                out.push_back('\n');
+                exported++;
+            }
+        }
+        buffer.tail_.store(tail, std::memory_order_release);
+    }
+    return exported;
+}
+
+CoapError CoapTracer::formatSpan(const CoapSpan& span, char* buffer, size_t capacity, size_t& length) {
+    length = 0;
+    SpanWriter writer(buffer, capacity);
+    writer.text("{\"trace\":");
+    writer.hex(span.traceId);
+    writer.text(",\"span\":");
+    writer.hex(span.spanId);
+    writer.text(",\"parent\":");
+    writer.hex(span.parentId);
+    writer.text(",\"stage\":\"");
+    size_t stage = static_cast<size_t>(span.stage);
+    if (stage < sizeof(SPAN_STAGE_NAMES) / sizeof(SPAN_STAGE_NAMES[0])) {
+        writer.text(SPAN_STAGE_NAMES[stage]);
+    } else {
+        writer.decimal(stage);
+    }
+    writer.text("\",\"start\":");
+    writer.decimal(span.start);
+    writer.text(",\"duration\":");
+    writer.decimal(span.end > span.start ? span.end - span.start : 0);
+    writer.text(",\"status\":");
+    writer.decimal(span.status);
+    writer.text("}");
+    if (writer.overflow()) {
+        return CoapError::BUFFER_TOO_SMALL;
+    }
+    length = writer.length();
+    return CoapError::OK;
+}
+
+uint16_t CoapTracer::getOptionNumber() const {
+    return optionNumber_;
+}
+
+CoapMemoryUsage CoapTracer::memoryUsage() const {
+    CoapMemoryUsage usage;
+    usage.addObject(sizeof(*this));
+    usage.addArray(buffers_.size(), buffers_.capacity(), sizeof(CoapSpanBuffer));
+    size_t queued = 0;
+    size_t count = used_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count && i < buffers_.size(); i++) {
+        queued += static_cast<size_t>(buffers_[i].head_.load(std::memory_order_acquire) -
+                                      buffers_[i].tail_.load(std::memory_order_acquire));
+    }
+    usage.addArray(queued, storage_.capacity(), sizeof(CoapSpan));
+    usage.entries = queued;
+    return usage;
+}
+
+} // namespace CoapPacket
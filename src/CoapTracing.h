@@ -0,0 +1,198 @@
+#ifndef COAP_TRACING_H
+#define COAP_TRACING_H
+
+#include "CoapMemory.h"
+#include "CoapError.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace CoapPacket {
+
+// Default trace option: experimental range (RFC 7252 section 12.2),
+// elective, safe-to-forward and NoCacheKey, so proxies pass it on and
+// caches ignore it
+constexpr uint16_t TRACE_OPTION_DEFAULT = 65020;
+
+// Trace option value: flags, trace ID, span ID of the sender
+constexpr size_t TRACE_OPTION_SIZE = 17;
+
+// Trace option flags
+constexpr uint8_t TRACE_FLAG_SAMPLED = 0x01;
+
+/**
+ * Trace context of one request on this hop
+ * parentId is the span of the previous hop (0 at the root).
+ */
+struct CoapTraceContext {
+    uint64_t traceId;
+    uint64_t spanId;
+    uint64_t parentId;
+    bool sampled;
+
+    CoapTraceContext() : traceId(0), spanId(0), parentId(0), sampled(false) {}
+};
+
+/**
+ * Pipeline stage of a span record
+ */
+enum class CoapSpanStage : uint8_t {
+    RECEIVE = 0,
+    PARSE = 1,
+    HANDLE = 2,
+    BUILD = 3,
+    SEND = 4,
+    FORWARD = 5         // Waiting for the next hop (proxy)
+};
+
+/**
+ * One stage of a sampled request; all stages of a hop share spanId
+ */
+struct CoapSpan {
+    uint64_t traceId;
+    uint64_t spanId;
+    uint64_t parentId;
+    uint64_t start;         // Nanoseconds, caller's clock
+    uint64_t end;
+    CoapSpanStage stage;
+    uint8_t status;         // e.g. CoapError or response code
+};
+
+/**
+ * Single-producer span queue, owned by one thread
+ * Obtained from CoapTracer::attach() and returned with detach().
+ * record() costs one branch for
+ * unsampled requests; sampled spans are dropped (and counted) when the
+ * exporter falls behind.
+ */
+class CoapSpanBuffer {
+public:
+    CoapSpanBuffer();
+
+    /**
+     * Record a stage of a request if its context is sampled
+     */
+    void record(const CoapTraceContext& context, CoapSpanStage stage, uint64_t start, uint64_t end,
+                uint8_t status = 0) {
+        if (context.sampled) {
+            append(context, stage, start, end, status);
+        }
+    }
+
+    /**
+     * Get number of spans dropped because the buffer was full
+     */
+    uint64_t getDropped() const;
+
+private:
+    friend class CoapTracer;
+
+    std::atomic<uint64_t> head_;    // Written by the owner
+    std::atomic<uint64_t> tail_;    // Written by the exporter
+    std::atomic<uint64_t> dropped_;
+    CoapSpan* spans_;
+    size_t mask_;
+    std::atomic<bool> claimed_;
+
+    void append(const CoapTraceContext& context, CoapSpanStage stage, uint64_t start, uint64_t end,
+                uint8_t status);
+};
+
+/**
+ * Sampled request tracing across proxy hops
+ *
+ * The trace context travels in a vendor option (TRACE_OPTION_DEFAULT or a
+ * configured number). peek() reads it from the raw datagram before
+ * parsing and makes the sampling decision once: requests carrying a
+ * context follow the upstream decision, others are sampled by a hash of
+ * token and message ID, so retransmissions get the same decision without
+ * shared state. Trace and span IDs do not come from that hash, since
+ * unrelated clients may reuse a token and message ID; they are drawn
+ * from a per-tracer splitmix64 sequence started at seed (or at a random
+ * value when seed is 0). Stages are recorded into per-thread CoapSpanBuffers and
+ * exportJson() drains them as JSON lines.
+ */
+class CoapTracer {
+public:
+    /**
+     * sampleRate is the fraction of root requests traced (0 to 1)
+     * maxThreads buffers of spansPerThread spans (rounded up to a power of
+     * two) are allocated up front.
+     */
+    CoapTracer(double sampleRate, size_t maxThreads, size_t spansPerThread,
+               uint16_t optionNumber = TRACE_OPTION_DEFAULT, uint64_t seed = 0);
+
+    CoapTracer(const CoapTracer&) = delete;
+    CoapTracer& operator=(const CoapTracer&) = delete;
+
+    /**
+     * Claim a span buffer for the calling thread
+     * Returns nullptr if all buffers are taken
+     */
+    CoapSpanBuffer* attach();
+
+    /**
+     * Return a buffer when its thread exits
+     * Queued spans are still exported; the next attach() may hand the
+     * buffer to another thread.
+     */
+    void detach(CoapSpanBuffer* buffer);
+
+    /**
+     * Set up the context of a received request from its raw bytes
+     * Returns context.sampled. Messages with a malformed header, or
+     * malformed options before the trace option, are never sampled.
+     */
+    bool peek(const uint8_t* datagram, size_t length, CoapTraceContext& context) const;
+
+    /**
+     * Encode the option value that continues context on the next hop
+     * value must hold TRACE_OPTION_SIZE bytes
+     */
+    static CoapError encode(const CoapTraceContext& context, uint8_t* value, size_t capacity, size_t& length);
+
+    /**
+     * Decode a trace option value into traceId, parentId and sampled
+     */
+    static CoapError decode(const uint8_t* value, size_t length, CoapTraceContext& context);
+
+    /**
+     * Drain all buffers and append one JSON line per span to out
+     * Returns the number of spans exported. Call from one thread at a time.
+     */
+    size_t exportJson(std::string& out);
+
+    /**
+     * Format one span as a JSON object (no newline)
+     */
+    static CoapError formatSpan(const CoapSpan& span, char* buffer, size_t capacity, size_t& length);
+
+    /**
+     * Get the option number carrying the trace context
+     */
+    uint16_t getOptionNumber() const;
+
+    /**
+     * Get memory footprint (see CoapMemoryUsage)
+     * entries counts spans waiting for export
+     */
+    CoapMemoryUsage memoryUsage() const;
+
+private:
+    std::vector<CoapSpanBuffer> buffers_;
+    std::vector<CoapSpan> storage_;
+    std::atomic<size_t> used_;     // Buffers attached at least once
+    mutable std::atomic<uint64_t> nextId_;
+    uint64_t idBase_;
+    uint64_t threshold_;
+    uint64_t seed_;
+    uint16_t optionNumber_;
+
+    uint64_t newId() const;
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_TRACING_H
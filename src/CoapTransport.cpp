@@ -0,0 +1,190 @@
+#include "CoapTransport.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace CoapPacket {
+
+#if defined(__linux__)
+namespace {
+
+// <linux/tls.h>; defined here so older headers still build
+const int KTLS_SOL_TLS = 282;
+const int KTLS_GET_RECORD_TYPE = 2;
+
+// TLS content types, alert and handshake message types (RFC 8446)
+const uint8_t TLS_RECORD_ALERT = 21;
+const uint8_t TLS_RECORD_HANDSHAKE = 22;
+const uint8_t TLS_RECORD_APPLICATION_DATA = 23;
+const uint8_t TLS_ALERT_CLOSE_NOTIFY = 0;
+const uint8_t TLS_HANDSHAKE_NEW_SESSION_TICKET = 4;
+
+} // namespace
+#endif
+
+CoapFdStream::CoapFdStream(int fd, bool kernelTls) : fd_(fd), kernelTls_(kernelTls), closed_(false), lastErrno_(0) {}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+CoapError CoapFdStream::fail(int error) {
+    if (error == EAGAIN || error == EWOULDBLOCK || error == EINTR) {
+        return CoapError::OK;
+    }
+    lastErrno_ = error;
+    switch (error) {
+        case ECONNRESET:
+        case ECONNABORTED:
+        case EPIPE:
+        case ENOTCONN:
+        case ESHUTDOWN:
+            closed_ = true;
+            return CoapError::CONNECTION_CLOSED;
+        case EBADF:
+        case EFAULT:
+        case EINVAL:
+        case ENOTSOCK:
+            return CoapError::INVALID_ARGUMENT;
+        case ENOMEM:
+        case ENOBUFS:
+            return CoapError::OUT_OF_MEMORY;
+        default:
+            return CoapError::TRANSPORT_ERROR;
+    }
+}
+
+CoapError CoapFdStream::read(uint8_t* buffer, size_t capacity, size_t& received) {
+    received = 0;
+    if (kernelTls_) {
+        return readRecord(buffer, capacity, received);
+    }
+    ssize_t n = ::read(fd_, buffer, capacity);
+    if (n > 0) {
+        received = static_cast<size_t>(n);
+        return CoapError::OK;
+    }
+    if (n == 0) {
+        closed_ = capacity > 0;
+        return CoapError::OK;
+    }
+    return fail(errno);
+}
+
+#if defined(__linux__)
+
+CoapError CoapFdStream::readRecord(uint8_t* buffer, size_t capacity, size_t& received) {
+    // Control messages must be aligned for struct cmsghdr
+    union {
+        char buffer[CMSG_SPACE(sizeof(uint8_t))];
+        struct cmsghdr align;
+    } control;
+
+    for (;;) {
+        struct iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = capacity;
+        struct msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+
+        ssize_t n = ::recvmsg(fd_, &message, 0);
+        if (n < 0) {
+            return fail(errno);
+        }
+        if (n == 0) {
+            closed_ = capacity > 0;
+            return CoapError::OK;
+        }
+
+        uint8_t recordType = TLS_RECORD_APPLICATION_DATA;
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == KTLS_SOL_TLS && cmsg->cmsg_type == KTLS_GET_RECORD_TYPE) {
+                recordType = *CMSG_DATA(cmsg);
+            }
+        }
+        if (recordType == TLS_RECORD_APPLICATION_DATA) {
+            received = static_cast<size_t>(n);
+            return CoapError::OK;
+        }
+
+        // Control record: its bytes are not application data. A session
+        // ticket is dropped and the next record read, so OK with 0 bytes
+        // keeps meaning "no data yet".
+        if (recordType == TLS_RECORD_HANDSHAKE && buffer[0] == TLS_HANDSHAKE_NEW_SESSION_TICKET) {
+            continue;
+        }
+        if (recordType == TLS_RECORD_ALERT && n >= 2) {
+            closed_ = true;
+            if (buffer[1] == TLS_ALERT_CLOSE_NOTIFY) {
+                return CoapError::OK;
+            }
+            lastErrno_ = buffer[1];
+            return CoapError::CONNECTION_CLOSED;
+        }
+        lastErrno_ = EIO;
+        return CoapError::TRANSPORT_ERROR;
+    }
+}
+
+#else
+
+CoapError CoapFdStream::readRecord(uint8_t* buffer, size_t capacity, size_t& received) {
+    // Kernel TLS is Linux only; other systems read plaintext sockets
+    ssize_t n = ::read(fd_, buffer, capacity);
+    if (n < 0) {
+        return fail(errno);
+    }
+    received = static_cast<size_t>(n);
+    closed_ = n == 0 && capacity > 0;
+    return CoapError::OK;
+}
+
+#endif
+
+CoapError CoapFdStream::write(const uint8_t* data, size_t length, size_t& sent) {
+    sent = 0;
+    ssize_t n = ::write(fd_, data, length);
+    if (n >= 0) {
+        sent = static_cast<size_t>(n);
+        return CoapError::OK;
+    }
+    return fail(errno);
+}
+
+#else
+
+CoapError CoapFdStream::fail(int error) {
+    lastErrno_ = error;
+    return CoapError::INVALID_ARGUMENT;
+}
+
+CoapError CoapFdStream::readRecord(uint8_t*, size_t, size_t& received) {
+    received = 0;
+    return CoapError::INVALID_ARGUMENT;
+}
+
+CoapError CoapFdStream::read(uint8_t*, size_t, size_t& received) {
+    received = 0;
+    return CoapError::INVALID_ARGUMENT;
+}
+
+CoapError CoapFdStream::write(const uint8_t*, size_t, size_t& sent) {
+    sent = 0;
+    return CoapError::INVALID_ARGUMENT;
+}
+
+#endif
+
+bool CoapFdStream::isClosed() const {
+    return closed_;
+}
+
+int CoapFdStream::getLastErrno() const {
+    return lastErrno_;
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,95 @@
+#ifndef COAP_TRANSPORT_H
+#define COAP_TRANSPORT_H
+
+#include "CoapError.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+/**
+ * Byte stream carrying CoAP messages (TCP, TLS, ...)
+ * Implementations report "no data yet" as OK with 0 bytes transferred,
+ * a reset or aborted connection as CONNECTION_CLOSED and other I/O
+ * failures as TRANSPORT_ERROR.
+ */
+class CoapByteStream {
+public:
+    virtual ~CoapByteStream() {}
+
+    /**
+     * Read up to capacity bytes into buffer
+     */
+    virtual CoapError read(uint8_t* buffer, size_t capacity, size_t& received) = 0;
+
+    /**
+     * Write up to length bytes from data
+     */
+    virtual CoapError write(const uint8_t* data, size_t length, size_t& sent) = 0;
+};
+
+/**
+ * Pluggable TLS engine (OpenSSL, mbedTLS, ...) for CoAP over TLS
+ *
+ * read() returns decrypted application data and write() encrypts it.
+ * Engines decrypt straight into the buffer they are given, so a
+ * CoapStreamDecoder can hand them its free space and parse in place.
+ * CoapOpenSslTlsEngine (COAP_PACKET_WITH_OPENSSL) is the bundled one.
+ */
+class CoapTlsEngine : public CoapByteStream {
+public:
+    /**
+     * Drive the handshake; returns OK once it has completed
+     * done is false while more network I/O is needed
+     */
+    virtual CoapError handshake(bool& done) = 0;
+
+    /**
+     * Hand record processing to the kernel (Linux kTLS) after the handshake
+     * Returns true if the underlying socket now yields plaintext directly;
+     * reads can then bypass the engine (see CoapFdStream).
+     */
+    virtual bool enableKernelOffload() { return false; }
+};
+
+/**
+ * Byte stream over a POSIX file descriptor
+ * Used for plain TCP and for sockets with kernel TLS enabled.
+ *
+ * With kernelTls set (after CoapTlsEngine::enableKernelOffload()), reads
+ * use recvmsg() and check the TLS record type: TLS 1.3 NewSessionTicket
+ * messages are skipped, close_notify ends the stream and other alerts
+ * or handshake messages (e.g. KeyUpdate, which the kernel cannot apply)
+ * fail the read. A plain read() would fail with EIO on such records.
+ */
+class CoapFdStream : public CoapByteStream {
+public:
+    explicit CoapFdStream(int fd, bool kernelTls = false);
+
+    CoapError read(uint8_t* buffer, size_t capacity, size_t& received) override;
+    CoapError write(const uint8_t* data, size_t length, size_t& sent) override;
+
+    /**
+     * True once the peer has closed the stream
+     */
+    bool isClosed() const;
+
+    /**
+     * Get errno of the last failed call (0 if none), or the TLS alert
+     * description for a fatal alert on a kernel TLS socket
+     */
+    int getLastErrno() const;
+
+private:
+    int fd_;
+    bool kernelTls_;
+    bool closed_;
+    int lastErrno_;
+
+    CoapError fail(int error);
+    CoapError readRecord(uint8_t* buffer, size_t capacity, size_t& received);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_TRANSPORT_H
@@ -71,7 +71,14 @@ enum class CoapCode : uint8_t {
     BAD_GATEWAY_5_02 = 162,            // (5 << 5) | 2
     SERVICE_UNAVAILABLE_5_03 = 163,    // (5 << 5) | 3
     GATEWAY_TIMEOUT_5_04 = 164,        // (5 << 5) | 4
-    PROXYING_NOT_SUPPORTED_5_05 = 165  // (5 << 5) | 5
+    PROXYING_NOT_SUPPORTED_5_05 = 165, // (5 << 5) | 5
+
+    // Signaling codes (7.xx, RFC 8323 reliable transports only)
+    CSM_7_01 = 225,                    // (7 << 5) | 1
+    PING_7_02 = 226,                   // (7 << 5) | 2
+    PONG_7_03 = 227,                   // (7 << 5) | 3
+    RELEASE_7_04 = 228,                // (7 << 5) | 4
+    ABORT_7_05 = 229                   // (7 << 5) | 5
 };
 
 /**
@@ -99,6 +106,28 @@ enum class CoapOptionNumber : uint16_t {
     SIZE1 = 60
 };
 
+/**
+ * Message fields, as bit flags selecting what CoapHash and CoapCompare skip
+ */
+constexpr uint32_t COAP_FIELD_TYPE = 0x01;
+constexpr uint32_t COAP_FIELD_CODE = 0x02;
+constexpr uint32_t COAP_FIELD_MESSAGE_ID = 0x04;
+constexpr uint32_t COAP_FIELD_TOKEN = 0x08;
+constexpr uint32_t COAP_FIELD_OPTIONS = 0x10;         // All options
+constexpr uint32_t COAP_FIELD_NO_CACHE_KEY = 0x20;    // NoCacheKey options only
+constexpr uint32_t COAP_FIELD_PAYLOAD = 0x40;
+
+// Fields outside the cache key of a request (RFC 7252 section 5.6)
+constexpr uint32_t COAP_FIELDS_NOT_CACHE_KEY =
+    COAP_FIELD_TYPE | COAP_FIELD_MESSAGE_ID | COAP_FIELD_TOKEN | COAP_FIELD_NO_CACHE_KEY;
+
+/**
+ * Check if an option is marked NoCacheKey (RFC 7252 section 5.4.6)
+ */
+constexpr bool isNoCacheKeyOption(uint16_t number) {
+    return (number & 0x1E) == 0x1C;
+}
+
 /**
  * CoAP Content Format Codes
  */
@@ -115,31 +144,38 @@ enum class CoapContentFormat : uint16_t {
 /**
  * Helper function to get code class (3 most significant bits)
  */
-inline uint8_t getCodeClass(CoapCode code) {
+constexpr uint8_t getCodeClass(CoapCode code) {
     return static_cast<uint8_t>(code) >> 5;
 }
 
 /**
  * Helper function to get code detail (5 least significant bits)
  */
-inline uint8_t getCodeDetail(CoapCode code) {
+constexpr uint8_t getCodeDetail(CoapCode code) {
     return static_cast<uint8_t>(code) & 0x1F;
 }
 
 /**
  * Helper function to create a CoAP code from class and detail
  */
-inline CoapCode makeCode(uint8_t codeClass, uint8_t detail) {
+constexpr CoapCode makeCode(uint8_t codeClass, uint8_t detail) {
     return static_cast<CoapCode>((codeClass << 5) | detail);
 }
 
 /**
  * Check if code class is valid (1, 6, 7 are reserved)
  */
-inline bool isValidCodeClass(uint8_t codeClass) {
+constexpr bool isValidCodeClass(uint8_t codeClass) {
     return codeClass != 1 && codeClass != 6 && codeClass != 7;
 }
 
+/**
+ * Check if code class is valid on reliable transports (7 is signaling)
+ */
+constexpr bool isValidReliableCodeClass(uint8_t codeClass) {
+    return codeClass != 1 && codeClass != 6;
+}
+
 } // namespace CoapPacket
 
 #endif // COAP_TYPES_H
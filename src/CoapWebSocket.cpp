@@ -0,0 +1,204 @@
+#include "CoapWebSocket.h"
+#include "CoapTcpCodec.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace CoapPacket {
+
+CoapError CoapWebSocket::parseFrameHeader(const uint8_t* buffer, size_t length,
+                                          CoapWebSocketFrame& frame) {
+    if (length < 2) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+
+    frame.fin = (buffer[0] & 0x80) != 0;
+    frame.opcode = buffer[0] & 0x0F;
+    frame.masked = (buffer[1] & 0x80) != 0;
+
+    size_t offset = 2;
+    uint8_t len7 = buffer[1] & 0x7F;
+    if (len7 < 126) {
+        frame.payloadLength = len7;
+    } else if (len7 == 126) {
+        if (length < offset + 2) {
+            return CoapError::DATAGRAM_TOO_SHORT;
+        }
+        frame.payloadLength = (static_cast<uint64_t>(buffer[2]) << 8) | buffer[3];
+        offset += 2;
+    } else {
+        if (length < offset + 8) {
+            return CoapError::DATAGRAM_TOO_SHORT;
+        }
+        frame.payloadLength = 0;
+        for (size_t i = 0; i < 8; i++) {
+            frame.payloadLength = (frame.payloadLength << 8) | buffer[offset + i];
+        }
+        offset += 8;
+    }
+
+    if (frame.masked) {
+        if (length < offset + 4) {
+            return CoapError::DATAGRAM_TOO_SHORT;
+        }
+        std::memcpy(frame.maskKey, buffer + offset, 4);
+        offset += 4;
+    }
+
+    frame.headerLength = offset;
+
+    // Reserved bits must be zero (no extensions are negotiated); checked
+    // last so the frame can still be skipped
+    if ((buffer[0] & 0x70) != 0) {
+        return CoapError::INVALID_FORMAT;
+    }
+    return CoapError::OK;
+}
+
+CoapError CoapWebSocket::parseMessage(uint8_t* buffer, size_t length, CoapWebSocketFrame& frame,
+                                      CoapPacketView& view, size_t& consumed) {
+    consumed = 0;
+    view = CoapPacketView();
+    frame = CoapWebSocketFrame();
+    CoapError err = parseFrameHeader(buffer, length, frame);
+    if (err == CoapError::DATAGRAM_TOO_SHORT) {
+        return err;
+    }
+
+    if (frame.payloadLength > length - frame.headerLength) {
+        return CoapError::DATAGRAM_TOO_SHORT;
+    }
+    size_t payloadLength = static_cast<size_t>(frame.payloadLength);
+    consumed = frame.headerLength + payloadLength;
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    // Zero the key once applied so a second parse does not mask again
+    uint8_t* payload = buffer + frame.headerLength;
+    if (frame.masked) {
+        unmask(payload, payloadLength, frame.maskKey);
+        std::memset(buffer + frame.headerLength - 4, 0, 4);
+    }
+
+    if (frame.isControl()) {
+        if (!frame.fin || payloadLength > WEBSOCKET_MAX_CONTROL_PAYLOAD) {
+            return CoapError::INVALID_FORMAT;
+        }
+        return CoapError::OK;
+    }
+
+    // Each CoAP message is exactly one unfragmented binary frame
+    if (!frame.fin || frame.opcode != WEBSOCKET_OPCODE_BINARY) {
+        return CoapError::INVALID_FORMAT;
+    }
+
+    return CoapTcpCodec::parseWebSocket(payload, payloadLength, view);
+}
+
+CoapError CoapWebSocket::buildMessage(const CoapPacket& packet, std::vector<uint8_t>& buffer,
+                                      size_t& frameOffset, const uint8_t* maskKey) {
+    CoapError err = CoapTcpCodec::serializeWebSocket(packet, buffer, WEBSOCKET_MAX_HEADER_SIZE);
+    if (err != CoapError::OK) {
+        return err;
+    }
+
+    size_t payloadLength = buffer.size() - WEBSOCKET_MAX_HEADER_SIZE;
+    size_t headerLength = getFrameHeaderSize(payloadLength, maskKey != nullptr);
+    frameOffset = WEBSOCKET_MAX_HEADER_SIZE - headerLength;
+
+    // Write the header directly in front of the serialized message
+    uint8_t* out = buffer.data() + frameOffset;
+    *out++ = 0x80 | WEBSOCKET_OPCODE_BINARY;  // FIN + binary
+    uint8_t maskBit = (maskKey != nullptr) ? 0x80 : 0x00;
+    if (payloadLength < 126) {
+        *out++ = maskBit | static_cast<uint8_t>(payloadLength);
+    } else if (payloadLength <= 0xFFFF) {
+        *out++ = maskBit | 126;
+        *out++ = static_cast<uint8_t>(payloadLength >> 8);
+        *out++ = static_cast<uint8_t>(payloadLength & 0xFF);
+    } else {
+        *out++ = maskBit | 127;
+        uint64_t length64 = payloadLength;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            *out++ = static_cast<uint8_t>((length64 >> shift) & 0xFF);
+        }
+    }
+
+    if (maskKey != nullptr) {
+        std::memcpy(out, maskKey, 4);
+        unmask(buffer.data() + WEBSOCKET_MAX_HEADER_SIZE, payloadLength, maskKey);
+    }
+
+    return CoapError::OK;
+}
+
+CoapError CoapWebSocket::buildControl(uint8_t opcode, const uint8_t* payload, size_t length,
+                                      std::vector<uint8_t>& buffer, const uint8_t* maskKey) {
+    if ((opcode & 0x08) == 0 || opcode > 0x0F || length > WEBSOCKET_MAX_CONTROL_PAYLOAD ||
+        (payload == nullptr && length > 0)) {
+        return CoapError::INVALID_ARGUMENT;
+    }
+
+    buffer.clear();
+    buffer.push_back(static_cast<uint8_t>(0x80 | opcode));
+    buffer.push_back(static_cast<uint8_t>((maskKey != nullptr ? 0x80 : 0x00) | length));
+    if (maskKey != nullptr) {
+        buffer.insert(buffer.end(), maskKey, maskKey + 4);
+    }
+    size_t offset = buffer.size();
+    if (length > 0) {
+        buffer.insert(buffer.end(), payload, payload + length);
+    }
+    if (maskKey != nullptr) {
+        unmask(buffer.data() + offset, length, maskKey);
+    }
+    return CoapError::OK;
+}
+
+void CoapWebSocket::unmask(uint8_t* data, size_t length, const uint8_t* maskKey) {
+    // The key is replicated in memory order, so every wide step stays in phase
+    // as long as it advances by a multiple of 4 bytes
+    uint32_t key32;
+    std::memcpy(&key32, maskKey, 4);
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    __m128i key128 = _mm_set1_epi32(static_cast<int>(key32));
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(block, key128));
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t key128 = vreinterpretq_u8_u32(vdupq_n_u32(key32));
+    for (; i + 16 <= length; i += 16) {
+        vst1q_u8(data + i, veorq_u8(vld1q_u8(data + i), key128));
+    }
+#endif
+
+    uint64_t key64 = (static_cast<uint64_t>(key32) << 32) | key32;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t block;
+        std::memcpy(&block, data + i, 8);
+        block ^= key64;
+        std::memcpy(data + i, &block, 8);
+    }
+
+    for (; i < length; i++) {
+        data[i] ^= maskKey[i & 3];
+    }
+}
+
+size_t CoapWebSocket::getFrameHeaderSize(uint64_t payloadLength, bool masked) {
+    size_t size = 2;
+    if (payloadLength >= 126) {
+        size += (payloadLength <= 0xFFFF) ? 2 : 8;
+    }
+    return size + (masked ? 4 : 0);
+}
+
+} // namespace CoapPacket
@@ -0,0 +1,114 @@
+#ifndef COAP_WEBSOCKET_H
+#define COAP_WEBSOCKET_H
+
+#include "CoapPacket.h"
+#include "CoapPacketView.h"
+#include "CoapError.h"
+#include <vector>
+
+namespace CoapPacket {
+
+// Largest WebSocket frame header (2 + 8-byte length + 4-byte mask key)
+constexpr size_t WEBSOCKET_MAX_HEADER_SIZE = 14;
+
+// WebSocket binary frame opcode (CoAP messages are always binary frames)
+constexpr uint8_t WEBSOCKET_OPCODE_BINARY = 0x2;
+
+// WebSocket control frame opcodes (RFC 6455 section 5.5)
+constexpr uint8_t WEBSOCKET_OPCODE_CLOSE = 0x8;
+constexpr uint8_t WEBSOCKET_OPCODE_PING = 0x9;
+constexpr uint8_t WEBSOCKET_OPCODE_PONG = 0xA;
+
+// Largest control frame payload
+constexpr size_t WEBSOCKET_MAX_CONTROL_PAYLOAD = 125;
+
+/**
+ * Decoded WebSocket frame header (RFC 6455 section 5.2)
+ */
+struct CoapWebSocketFrame {
+    bool fin;
+    uint8_t opcode;
+    bool masked;
+    uint8_t maskKey[4];
+    uint64_t payloadLength;
+    size_t headerLength;
+
+    CoapWebSocketFrame()
+        : fin(false)
+        , opcode(0)
+        , masked(false)
+        , maskKey{0, 0, 0, 0}
+        , payloadLength(0)
+        , headerLength(0) {}
+
+    /**
+     * True for close, ping and pong frames
+     */
+    bool isControl() const {
+        return (opcode & 0x08) != 0;
+    }
+};
+
+/**
+ * WebSocket framing for CoAP over WebSockets (RFC 8323 section 4)
+ *
+ * Incoming frames are unmasked in place and parsed into a zero-copy view.
+ * Outgoing messages are serialized after WEBSOCKET_MAX_HEADER_SIZE bytes of
+ * headroom and the frame header is written directly in front of them.
+ * Ping, pong and close frames are handed back to the caller, which answers
+ * them with buildControl(). Connection setup (HTTP upgrade) is left to the
+ * caller.
+ */
+class CoapWebSocket {
+public:
+    /**
+     * Parse a frame header
+     * Returns CoapError::DATAGRAM_TOO_SHORT if the header is incomplete
+     */
+    static CoapError parseFrameHeader(const uint8_t* buffer, size_t length, CoapWebSocketFrame& frame);
+
+    /**
+     * Parse one frame: a binary frame holding a CoAP message or a control frame
+     * buffer is modified: the payload is unmasked in place and the mask key
+     * in the header is zeroed, so parsing the same frame again sees the same
+     * bytes. For a control frame OK is returned with an empty view; its
+     * payload is frame.payloadLength bytes at buffer + frame.headerLength.
+     * Once the whole frame is in buffer, consumed is set to its size, also
+     * on error, so the caller can skip a bad frame.
+     * Returns CoapError::DATAGRAM_TOO_SHORT (consumed 0) if the frame is
+     * incomplete and CoapError::INVALID_FORMAT for text, fragmented or
+     * malformed frames
+     */
+    static CoapError parseMessage(uint8_t* buffer, size_t length, CoapWebSocketFrame& frame,
+                                  CoapPacketView& view, size_t& consumed);
+
+    /**
+     * Build a binary frame holding the packet
+     * The frame starts at buffer[frameOffset] and runs to the end of buffer.
+     * Pass a mask key when sending from the client side.
+     */
+    static CoapError buildMessage(const CoapPacket& packet, std::vector<uint8_t>& buffer,
+                                  size_t& frameOffset, const uint8_t* maskKey = nullptr);
+
+    /**
+     * Build a control frame (e.g. the pong answering a ping) into buffer
+     * Returns CoapError::INVALID_ARGUMENT for other opcodes or payloads
+     * above WEBSOCKET_MAX_CONTROL_PAYLOAD
+     */
+    static CoapError buildControl(uint8_t opcode, const uint8_t* payload, size_t length,
+                                  std::vector<uint8_t>& buffer, const uint8_t* maskKey = nullptr);
+
+    /**
+     * XOR data with the 4-byte mask key in place (masking and unmasking)
+     */
+    static void unmask(uint8_t* data, size_t length, const uint8_t* maskKey);
+
+    /**
+     * Size of a frame header for the given payload length
+     */
+    static size_t getFrameHeaderSize(uint64_t payloadLength, bool masked);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_WEBSOCKET_H
@@ -0,0 +1,240 @@
+#include "CoapWriter.h"
+#include "CoapOptions.h"
+#include <cstring>
+
+namespace CoapPacket {
+
+CoapWriter::CoapWriter(uint8_t* buffer, size_t capacity)
+    : buffer_(buffer)
+    , capacity_(capacity)
+    , length_(0)
+    , lastOptionNumber_(0)
+    , started_(false)
+    , hasPayload_(false)
+    , payloadPending_(false)
+    , payloadAvailable_(0)
+    , lastError_(CoapError::OK) {}
+
+CoapWriter& CoapWriter::begin(CoapType type, CoapCode code, uint16_t messageId,
+                              const uint8_t* token, uint8_t tokenLength) {
+    length_ = 0;
+    lastOptionNumber_ = 0;
+    hasPayload_ = false;
+    payloadPending_ = false;
+    payloadAvailable_ = 0;
+    started_ = false;
+    lastError_ = CoapError::OK;
+
+    if (tokenLength > 8) {
+        lastError_ = CoapError::INVALID_TOKEN_LENGTH;
+        return *this;
+    }
+    if (!isValidCodeClass(getCodeClass(code))) {
+        lastError_ = CoapError::INVALID_CODE_CLASS;
+        return *this;
+    }
+    // Empty messages must have no token
+    if (code == CoapCode::EMPTY && tokenLength != 0) {
+        lastError_ = CoapError::INVALID_FORMAT;
+        return *this;
+    }
+    if (4 + static_cast<size_t>(tokenLength) > capacity_) {
+        lastError_ = CoapError::BUFFER_TOO_SMALL;
+        return *this;
+    }
+
+    buffer_[0] = static_cast<uint8_t>((COAP_VERSION << 6) |
+                                      ((static_cast<uint8_t>(type) & 0x03) << 4) |
+                                      (tokenLength & 0x0F));
+    buffer_[1] = static_cast<uint8_t>(code);
+    buffer_[2] = static_cast<uint8_t>(messageId >> 8);
+    buffer_[3] = static_cast<uint8_t>(messageId & 0xFF);
+    if (tokenLength > 0) {
+        std::memcpy(buffer_ + 4, token, tokenLength);
+    }
+
+    length_ = 4 + tokenLength;
+    started_ = true;
+    return *this;
+}
+
+CoapWriter& CoapWriter::addOption(CoapOptionNumber optionNum, const uint8_t* value, size_t length) {
+    uint16_t number = static_cast<uint16_t>(optionNum);
+    if (!checkOption(number, length)) {
+        return *this;
+    }
+
+    uint16_t delta = number - lastOptionNumber_;
+    uint16_t valueLength = static_cast<uint16_t>(length);
+    if (length_ + getOptionHeaderSize(delta, valueLength) + length > capacity_) {
+        lastError_ = CoapError::BUFFER_TOO_SMALL;
+        return *this;
+    }
+
+    length_ += encodeOptionHeader(buffer_ + length_, delta, valueLength);
+    if (length > 0) {
+        std::memcpy(buffer_ + length_, value, length);
+        length_ += length;
+    }
+    lastOptionNumber_ = number;
+    return *this;
+}
+
+CoapWriter& CoapWriter::addOption(CoapOptionNumber optionNum, const char* value) {
+    return addOption(optionNum, reinterpret_cast<const uint8_t*>(value), std::strlen(value));
+}
+
+CoapWriter& CoapWriter::addOption(CoapOptionNumber optionNum, uint32_t value) {
+    uint8_t encoded[4];
+    size_t length = encodeUintValue(encoded, value);
+    return addOption(optionNum, encoded, length);
+}
+
+CoapWriter& CoapWriter::setUriPath(const char* path) {
+    const char* segment = path;
+    while (lastError_ == CoapError::OK && *segment != '\0') {
+        const char* end = segment;
+        while (*end != '\0' && *end != '/') {
+            end++;
+        }
+        if (end > segment) {
+            addOption(CoapOptionNumber::URI_PATH, reinterpret_cast<const uint8_t*>(segment),
+                      static_cast<size_t>(end - segment));
+        }
+        segment = (*end == '/') ? end + 1 : end;
+    }
+    return *this;
+}
+
+CoapWriter& CoapWriter::setPayload(const uint8_t* data, size_t length) {
+    if (lastError_ != CoapError::OK) {
+        return *this;
+    }
+    if (!started_ || hasPayload_) {
+        lastError_ = CoapError::INVALID_FORMAT;
+        return *this;
+    }
+    if (length == 0) {
+        return *this;
+    }
+    if (length > MAX_PAYLOAD_SIZE) {
+        lastError_ = CoapError::PAYLOAD_TOO_LARGE;
+        return *this;
+    }
+    // Empty messages must have no payload
+    if (buffer_[1] == static_cast<uint8_t>(CoapCode::EMPTY)) {
+        lastError_ = CoapError::INVALID_FORMAT;
+        return *this;
+    }
+    if (length_ + 1 + length > capacity_) {
+        lastError_ = CoapError::BUFFER_TOO_SMALL;
+        return *this;
+    }
+
+    buffer_[length_++] = PAYLOAD_MARKER;
+    std::memcpy(buffer_ + length_, data, length);
+    length_ += length;
+    hasPayload_ = true;
+    return *this;
+}
+
+CoapWriter& CoapWriter::beginPayload(uint8_t*& payload, size_t& available) {
+    payload = nullptr;
+    available = 0;
+    if (lastError_ != CoapError::OK) {
+        return *this;
+    }
+    if (!started_ || hasPayload_) {
+        lastError_ = CoapError::INVALID_FORMAT;
+        return *this;
+    }
+    // Empty messages must have no payload
+    if (buffer_[1] == static_cast<uint8_t>(CoapCode::EMPTY)) {
+        lastError_ = CoapError::INVALID_FORMAT;
+        return *this;
+    }
+    if (length_ + 1 >= capacity_) {
+        lastError_ = CoapError::BUFFER_TOO_SMALL;
+        return *this;
+    }
+
+    // The marker is written now and kept only if bytes are committed
+    buffer_[length_] = PAYLOAD_MARKER;
+    available = capacity_ - length_ - 1;
+    if (available > MAX_PAYLOAD_SIZE) {
+        available = MAX_PAYLOAD_SIZE;
+    }
+    payload = buffer_ + length_ + 1;
+    payloadAvailable_ = available;
+    payloadPending_ = true;
+    hasPayload_ = true;
+    return *this;
+}
+
+CoapWriter& CoapWriter::commitPayload(size_t length) {
+    if (lastError_ != CoapError::OK) {
+        return *this;
+    }
+    if (!payloadPending_) {
+        lastError_ = CoapError::INVALID_FORMAT;
+        return *this;
+    }
+    if (length > payloadAvailable_) {
+        lastError_ = CoapError::BUFFER_TOO_SMALL;
+        return *this;
+    }
+
+    if (length > 0) {
+        length_ += 1 + length;
+    }
+    payloadPending_ = false;
+    return *this;
+}
+
+CoapError CoapWriter::finish(size_t& length) {
+    if (lastError_ == CoapError::OK && !started_) {
+        lastError_ = CoapError::MISSING_REQUIRED_FIELD;
+    }
+    if (lastError_ == CoapError::OK && payloadPending_) {
+        lastError_ = CoapError::INVALID_FORMAT;
+    }
+    if (lastError_ != CoapError::OK) {
+        return lastError_;
+    }
+    length = length_;
+    return CoapError::OK;
+}
+
+CoapError CoapWriter::getLastError() const {
+    return lastError_;
+}
+
+size_t CoapWriter::getLength() const {
+    return length_;
+}
+
+bool CoapWriter::checkOption(uint16_t number, size_t length) {
+    if (lastError_ != CoapError::OK) {
+        return false;
+    }
+    if (!started_ || hasPayload_) {
+        lastError_ = CoapError::INVALID_FORMAT;
+        return false;
+    }
+    // Empty messages must have no options
+    if (buffer_[1] == static_cast<uint8_t>(CoapCode::EMPTY)) {
+        lastError_ = CoapError::INVALID_FORMAT;
+        return false;
+    }
+    if (number < lastOptionNumber_) {
+        lastError_ = CoapError::INVALID_OPTION_NUMBER;
+        return false;
+    }
+    if (length > MAX_OPTION_VALUE_SIZE) {
+        lastError_ = CoapError::OPTION_TOO_LONG;
+        return false;
+    }
+    return true;
+}
+
+} // namespace CoapPacket
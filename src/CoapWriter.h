@@ -0,0 +1,107 @@
+#ifndef COAP_WRITER_H
+#define COAP_WRITER_H
+
+#include "CoapTypes.h"
+#include "CoapError.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CoapPacket {
+
+/**
+ * Heap-free encoder writing a CoAP message directly into a caller buffer
+ *
+ * Options must be added in ascending option number order (no sorting is
+ * done). Errors are sticky: after the first failure all calls are ignored
+ * and finish() returns the error.
+ *
+ * Example:
+ *   CoapWriter writer(buffer, sizeof(buffer));
+ *   CoapError err = writer.begin(CoapType::CON, CoapCode::GET, 1234, token, 2)
+ *                         .setUriPath("/sensors/temp")
+ *                         .finish(length);
+ */
+class CoapWriter {
+public:
+    CoapWriter(uint8_t* buffer, size_t capacity);
+
+    /**
+     * Write the header and token (restarts the message)
+     */
+    CoapWriter& begin(CoapType type, CoapCode code, uint16_t messageId,
+                      const uint8_t* token, uint8_t tokenLength);
+
+    /**
+     * Add option with raw byte value
+     */
+    CoapWriter& addOption(CoapOptionNumber optionNum, const uint8_t* value, size_t length);
+
+    /**
+     * Add option with NUL-terminated string value
+     */
+    CoapWriter& addOption(CoapOptionNumber optionNum, const char* value);
+
+    /**
+     * Add option with uint32 value (encoded as variable-length big-endian)
+     */
+    CoapWriter& addOption(CoapOptionNumber optionNum, uint32_t value);
+
+    /**
+     * Convenience: Set URI path (e.g., "/sensors/temp")
+     * Splits on '/' and writes one URI_PATH option per segment
+     */
+    CoapWriter& setUriPath(const char* path);
+
+    /**
+     * Write payload marker and payload
+     */
+    CoapWriter& setPayload(const uint8_t* data, size_t length);
+
+    /**
+     * Start writing the payload in place (streamed payload)
+     * payload points right after the payload marker and available is the
+     * space for the body; write it there, then call commitPayload()
+     */
+    CoapWriter& beginPayload(uint8_t*& payload, size_t& available);
+
+    /**
+     * Finish a streamed payload of length bytes (0 drops the marker)
+     */
+    CoapWriter& commitPayload(size_t length);
+
+    /**
+     * Finish the message; length is set to the encoded size
+     * Returns CoapError::OK on success, first error otherwise
+     */
+    CoapError finish(size_t& length);
+
+    /**
+     * Get the last error that occurred
+     */
+    CoapError getLastError() const;
+
+    /**
+     * Get number of bytes written so far
+     */
+    size_t getLength() const;
+
+private:
+    uint8_t* buffer_;
+    size_t capacity_;
+    size_t length_;
+    uint16_t lastOptionNumber_;
+    bool started_;
+    bool hasPayload_;
+    bool payloadPending_;       // beginPayload() without commitPayload()
+    size_t payloadAvailable_;
+    CoapError lastError_;
+
+    /**
+     * Check that an option may be written next
+     */
+    bool checkOption(uint16_t number, size_t length);
+};
+
+} // namespace CoapPacket
+
+#endif // COAP_WRITER_H
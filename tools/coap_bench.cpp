@@ -0,0 +1,856 @@
+// CoAP server load generator
+//
+// Each thread owns a connected UDP socket and sends batches of requests
+// with sendmmsg, collecting responses with recvmmsg. Requests are stamped
+// from templates encoded once with CoapBuilder: only the message ID, the
+// token and (for Block2 follow-ups) the block number are patched per send.
+//
+// Open-loop mode (--rate) sends on a fixed schedule regardless of response
+// times. Latency is measured from the scheduled send time, so a stalled
+// server is charged for the requests it delayed (coordinated omission).
+// Closed-loop mode (--concurrency) keeps N requests outstanding per
+// thread; with --expected-interval the histogram is back-filled with the
+// samples a fixed-rate client would have seen during each stall.
+//
+// Notifications whose token no longer matches a request (Observe
+// registrations complete on their first response) are answered with RST,
+// which cancels the observation (RFC 7641 section 3.6).
+//
+// Build:
+//   c++ -std=c++11 -O2 -pthread -Isrc -o coap-bench
+//       tools/coap_bench.cpp src/CoapPacketUnity.cpp
+//
+// Usage:
+//   coap-bench [--threads N] (--rate R | --concurrency C) [--duration S]
+//              [--mix get=W,post=W,observe=W,block2=W] [--path P] [--payload BYTES]
+//              [--non] [--batch N] [--timeout MS] [--expected-interval US] host:port
+
+#include "CoapBuilder.h"
+#include "CoapParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using namespace CoapPacket;
+
+namespace {
+
+const size_t TOKEN_SIZE = 8;
+const size_t RECEIVE_SIZE = 2048;
+const size_t REPLY_SIZE = 4;
+const uint32_t BLOCK2_SIZE_EXPONENT = 6;    // 1024-byte blocks
+const int SOCKET_BUFFER = 4 * 1024 * 1024;
+
+enum RequestKind { KIND_GET, KIND_POST, KIND_OBSERVE, KIND_BLOCK2, KIND_COUNT };
+
+const char* const KIND_NAMES[KIND_COUNT] = {"get", "post", "observe", "block2"};
+
+struct Options {
+    unsigned threads;
+    double rate;                    // Requests per second over all threads (open loop)
+    unsigned concurrency;           // Outstanding requests per thread (closed loop)
+    double duration;
+    unsigned weights[KIND_COUNT];
+    std::string path;
+    size_t payload;
+    bool nonConfirmable;
+    unsigned batch;
+    uint64_t timeoutNs;
+    uint64_t expectedIntervalNs;
+    unsigned maxOutstanding;        // Per thread, open loop
+    const char* target;
+
+    Options()
+        : threads(1), rate(0), concurrency(0), duration(10), weights{1, 0, 0, 0}, path("/bench"),
+          payload(64), nonConfirmable(false), batch(32), timeoutNs(5000000000ULL),
+          expectedIntervalNs(0), maxOutstanding(65536), target(nullptr) {}
+};
+
+/**
+ * Log-linear latency histogram in nanoseconds
+ * 64 sub-buckets per power of two bound the error to about 1.6%.
+ */
+class Histogram {
+public:
+    Histogram() : counts_((64 - SUB_BITS + 1) << SUB_BITS, 0), total_(0), max_(0), sum_(0) {}
+
+    void record(uint64_t value) {
+        counts_[indexOf(value)]++;
+        total_++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+
+    /**
+     * Record value plus the samples lost while it stalled a client that
+     * expected to send every interval (HdrHistogram's correction)
+     */
+    void recordCorrected(uint64_t value, uint64_t interval) {
+        record(value);
+        if (interval == 0) {
+            return;
+        }
+        for (uint64_t missing = value > interval ? value - interval : 0; missing >= interval;
+             missing -= interval) {
+            record(missing);
+        }
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < counts_.size(); i++) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t percentile(double percent) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * static_cast<double>(total_));
+        if (rank >= total_) {
+            rank = total_ - 1;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); i++) {
+            seen += counts_[i];
+            if (seen > rank) {
+                return std::min(valueOf(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ == 0 ? 0 : static_cast<double>(sum_) / static_cast<double>(total_); }
+
+private:
+    static const int SUB_BITS = 6;
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t max_;
+    uint64_t sum_;
+
+    static size_t indexOf(uint64_t value) {
+        if (value < (1u << SUB_BITS)) {
+            return static_cast<size_t>(value);
+        }
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return (static_cast<size_t>(shift + 1) << SUB_BITS) +
+               static_cast<size_t>((value >> shift) - (1u << SUB_BITS));
+    }
+
+    // Upper end of a bucket, so percentiles never under-report
+    static uint64_t valueOf(size_t index) {
+        if (index < (1u << SUB_BITS)) {
+            return index;
+        }
+        int shift = static_cast<int>(index >> SUB_BITS) - 1;
+        uint64_t low = (static_cast<uint64_t>(index & ((1u << SUB_BITS) - 1)) + (1u << SUB_BITS)) << shift;
+        return low + ((1ULL << shift) - 1);
+    }
+};
+
+/**
+ * Encoded request with the offsets patched per send
+ */
+struct Template {
+    std::vector<uint8_t> bytes;
+    size_t block2Offset;        // Block2 value, or 0 if absent
+    size_t block2Length;
+};
+
+struct Slot {
+    uint64_t intended;          // Scheduled send time of the first exchange
+    uint64_t sent;              // Actual send time of the current exchange
+    uint32_t generation;
+    uint32_t block;
+    uint8_t kind;
+    bool busy;
+};
+
+struct WorkerResult {
+    Histogram corrected;
+    Histogram uncorrected;
+    uint64_t sent;              // Datagrams, including Block2 follow-ups
+    uint64_t completed[KIND_COUNT];
+    uint64_t failed;            // 4.xx/5.xx responses and RST
+    uint64_t timeouts;
+    uint64_t stale;             // Messages with unknown tokens (answered with RST)
+    uint64_t malformed;
+    uint64_t sendErrors;
+    uint64_t lateStarts;        // Open loop: sends over 1 ms behind schedule
+
+    WorkerResult()
+        : sent(0), completed{0, 0, 0, 0}, failed(0), timeouts(0), stale(0), malformed(0),
+          sendErrors(0), lateStarts(0) {}
+};
+
+uint64_t monotonicNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t decodeUint(const uint8_t* value, size_t length) {
+    uint32_t result = 0;
+    for (size_t i = 0; i < length; i++) {
+        result = (result << 8) | value[i];
+    }
+    return result;
+}
+
+// Offset of the last option value in an encoded message without payload
+size_t lastOptionOffset(const std::vector<uint8_t>& bytes, size_t& length) {
+    size_t offset = 0;
+    length = 0;
+    if (CoapOptionIterator::locateOptions(bytes.data(), bytes.size(), offset) != CoapError::OK) {
+        return 0;
+    }
+    CoapOptionIterator options(bytes.data(), bytes.size(), offset);
+    CoapOptionRef option;
+    size_t valueOffset = 0;
+    while (options.next(option)) {
+        valueOffset = option.offset + option.headerLength;
+        length = option.length;
+    }
+    return valueOffset;
+}
+
+bool buildTemplate(const Options& options, RequestKind kind, uint32_t blockValue, Template& result) {
+    const uint8_t token[TOKEN_SIZE] = {0};
+    CoapBuilder builder;
+    builder.setType(options.nonConfirmable ? CoapType::NON : CoapType::CON)
+        .setCode(kind == KIND_POST ? CoapCode::POST : CoapCode::GET)
+        .setMessageId(0)
+        .setToken(token, TOKEN_SIZE)
+        .setUriPath(options.path);
+    if (kind == KIND_OBSERVE) {
+        builder.addOption(CoapOptionNumber::OBSERVE, static_cast<uint32_t>(0));
+    }
+    if (kind == KIND_POST) {
+        builder.setContentFormat(CoapContentFormat::OCTET_STREAM)
+            .setPayload(std::vector<uint8_t>(options.payload, 0x5A));
+    }
+    if (kind == KIND_BLOCK2) {
+        builder.addOption(CoapOptionNumber::BLOCK2, blockValue);
+    }
+    if (builder.buildBuffer(result.bytes) != CoapError::OK) {
+        return false;
+    }
+    result.block2Offset = 0;
+    result.block2Length = 0;
+    if (kind == KIND_BLOCK2) {
+        // Block2 (23) sorts after Uri-Path (11), so it is the last option
+        result.block2Offset = lastOptionOffset(result.bytes, result.block2Length);
+    }
+    return true;
+}
+
+/**
+ * Templates of one run; Block2 has one per encoded length of the value
+ */
+struct Templates {
+    Template kinds[KIND_COUNT];
+    Template block2[3];
+
+    bool build(const Options& options) {
+        for (int kind = 0; kind < KIND_COUNT; kind++) {
+            if (!buildTemplate(options, static_cast<RequestKind>(kind), BLOCK2_SIZE_EXPONENT, kinds[kind])) {
+                return false;
+            }
+        }
+        // Smallest block numbers needing 1, 2 and 3 value bytes
+        const uint32_t blocks[3] = {0, 16, 4096};
+        for (int i = 0; i < 3; i++) {
+            if (!buildTemplate(options, KIND_BLOCK2, (blocks[i] << 4) | BLOCK2_SIZE_EXPONENT, block2[i]) ||
+                block2[i].block2Length != static_cast<size_t>(i + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t maxSize() const {
+        size_t size = 0;
+        for (int kind = 0; kind < KIND_COUNT; kind++) {
+            size = std::max(size, kinds[kind].bytes.size());
+        }
+        return std::max(size, block2[2].bytes.size());
+    }
+};
+
+/**
+ * Weighted request kind choice from a per-thread xorshift generator
+ */
+class KindChooser {
+public:
+    KindChooser(const unsigned* weights, uint64_t seed) : state_(seed | 1), total_(0) {
+        for (int kind = 0; kind < KIND_COUNT; kind++) {
+            total_ += weights[kind];
+            bounds_[kind] = total_;
+        }
+    }
+
+    RequestKind next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        uint32_t pick = static_cast<uint32_t>(state_ % total_);
+        int kind = 0;
+        while (pick >= bounds_[kind]) {
+            kind++;
+        }
+        return static_cast<RequestKind>(kind);
+    }
+
+private:
+    uint64_t state_;
+    uint32_t total_;
+    uint32_t bounds_[KIND_COUNT];
+};
+
+class Worker {
+public:
+    Worker(const Options& options, const Templates& templates, int fd, unsigned index, WorkerResult& result)
+        : options_(options)
+        , templates_(templates)
+        , fd_(fd)
+        , result_(result)
+        , chooser_(options.weights, 0x9E3779B97F4A7C15ULL * (index + 1))
+        , messageId_(static_cast<uint16_t>(index * 7919))
+        , requestSize_(templates.maxSize())
+        , outgoing_(0)
+        , replies_(0)
+        , outstanding_(0) {
+        size_t slots = options.concurrency != 0 ? options.concurrency : options.maxOutstanding;
+        slots_.resize(slots);
+        for (size_t i = slots; i > 0; i--) {
+            Slot& slot = slots_[i - 1];
+            slot.generation = 0;
+            slot.busy = false;
+            freeSlots_.push_back(static_cast<uint32_t>(i - 1));
+        }
+        sendBuffer_.resize(options.batch * requestSize_);
+        sendVectors_.resize(options.batch);
+        sendMessages_.resize(options.batch);
+        replyBuffer_.resize(options.batch * REPLY_SIZE);
+        replyVectors_.resize(options.batch);
+        replyMessages_.resize(options.batch);
+        receiveBuffer_.resize(options.batch * RECEIVE_SIZE);
+        receiveVectors_.resize(options.batch);
+        receiveMessages_.resize(options.batch);
+    }
+
+    void run(uint64_t start, uint64_t stop) {
+        double interval = 0;
+        if (options_.rate > 0) {
+            interval = 1e9 * options_.threads / options_.rate;
+        }
+        uint64_t scheduled = 0;
+        uint64_t lastExpiry = start;
+        uint64_t drainUntil = stop + std::min<uint64_t>(options_.timeoutNs, 1000000000ULL);
+
+        for (;;) {
+            uint64_t now = monotonicNs();
+            bool sending = now < stop;
+            if (!sending && (outstanding_ == 0 || now >= drainUntil)) {
+                break;
+            }
+
+            // Queue new requests
+            while (sending && outgoing_ < options_.batch && !freeSlots_.empty()) {
+                uint64_t intended = now;
+                if (interval > 0) {
+                    intended = start + static_cast<uint64_t>(static_cast<double>(scheduled) * interval);
+                    if (intended > now) {
+                        break;
+                    }
+                    if (now - intended > static_cast<uint64_t>(interval) + 1000000u) {
+                        result_.lateStarts++;
+                    }
+                    scheduled++;
+                } else if (outstanding_ >= options_.concurrency) {
+                    break;
+                }
+                uint32_t index = freeSlots_.back();
+                freeSlots_.pop_back();
+                Slot& slot = slots_[index];
+                slot.intended = intended;
+                slot.kind = static_cast<uint8_t>(chooser_.next());
+                slot.block = 0;
+                slot.busy = true;
+                outstanding_++;
+                queueRequest(index, now);
+            }
+
+            bool idle = outgoing_ == 0;
+            flushRequests();
+            if (receive() > 0) {
+                idle = false;
+            }
+            flushReplies();
+
+            if (now - lastExpiry > 10000000u) {
+                expire(now);
+                lastExpiry = now;
+            }
+
+            if (idle) {
+                int waitMs = 1;
+                if (interval > 0 && sending) {
+                    uint64_t next = start + static_cast<uint64_t>(static_cast<double>(scheduled) * interval);
+                    waitMs = next > now + 1000000u ? 1 : 0;
+                }
+                struct pollfd descriptor = {fd_, POLLIN, 0};
+                poll(&descriptor, 1, waitMs);
+            }
+        }
+
+        // Requests still unanswered after the drain
+        for (const Slot& slot : slots_) {
+            if (slot.busy) {
+                result_.timeouts++;
+            }
+        }
+    }
+
+private:
+    const Options& options_;
+    const Templates& templates_;
+    int fd_;
+    WorkerResult& result_;
+    KindChooser chooser_;
+    uint16_t messageId_;
+    size_t requestSize_;
+
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+
+    std::vector<uint8_t> sendBuffer_;
+    std::vector<struct iovec> sendVectors_;
+    std::vector<struct mmsghdr> sendMessages_;
+    unsigned outgoing_;
+
+    std::vector<uint8_t> replyBuffer_;
+    std::vector<struct iovec> replyVectors_;
+    std::vector<struct mmsghdr> replyMessages_;
+    unsigned replies_;
+
+    std::vector<uint8_t> receiveBuffer_;
+    std::vector<struct iovec> receiveVectors_;
+    std::vector<struct mmsghdr> receiveMessages_;
+
+    size_t outstanding_;
+
+    // Stamp the current exchange of a slot into the send batch
+    void queueRequest(uint32_t index, uint64_t now) {
+        Slot& slot = slots_[index];
+        const Template* source = &templates_.kinds[slot.kind];
+        if (slot.kind == KIND_BLOCK2 && slot.block > 0) {
+            source = &templates_.block2[slot.block < 16 ? 0 : (slot.block < 4096 ? 1 : 2)];
+        }
+
+        uint8_t* out = &sendBuffer_[outgoing_ * requestSize_];
+        std::memcpy(out, source->bytes.data(), source->bytes.size());
+        uint16_t messageId = messageId_++;
+        out[2] = static_cast<uint8_t>(messageId >> 8);
+        out[3] = static_cast<uint8_t>(messageId);
+        uint64_t token = (static_cast<uint64_t>(slot.generation) << 32) | index;
+        std::memcpy(out + 4, &token, TOKEN_SIZE);
+        if (source->block2Length != 0) {
+            uint32_t value = (slot.block << 4) | BLOCK2_SIZE_EXPONENT;
+            for (size_t i = 0; i < source->block2Length; i++) {
+                out[source->block2Offset + i] =
+                    static_cast<uint8_t>(value >> (8 * (source->block2Length - 1 - i)));
+            }
+        }
+
+        sendVectors_[outgoing_].iov_base = out;
+        sendVectors_[outgoing_].iov_len = source->bytes.size();
+        slot.sent = now;
+        outgoing_++;
+    }
+
+    void queueReply(CoapType type, uint16_t messageId) {
+        if (replies_ == options_.batch) {
+            flushReplies();
+        }
+        uint8_t* out = &replyBuffer_[replies_ * REPLY_SIZE];
+        out[0] = static_cast<uint8_t>((COAP_VERSION << 6) | (static_cast<uint8_t>(type) << 4));
+        out[1] = 0;
+        out[2] = static_cast<uint8_t>(messageId >> 8);
+        out[3] = static_cast<uint8_t>(messageId);
+        replyVectors_[replies_].iov_base = out;
+        replyVectors_[replies_].iov_len = REPLY_SIZE;
+        replies_++;
+    }
+
+    // Send a batch; returns the number of datagrams the kernel accepted
+    uint64_t flushBatch(std::vector<struct iovec>& vectors, std::vector<struct mmsghdr>& messages, unsigned count) {
+        for (unsigned i = 0; i < count; i++) {
+            std::memset(&messages[i], 0, sizeof(messages[i]));
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        unsigned done = 0;
+        uint64_t accepted = 0;
+        while (done < count) {
+            int sent = sendmmsg(fd_, &messages[done], count - done, 0);
+            if (sent <= 0) {
+                // e.g. ECONNREFUSED from an earlier ICMP error: skip one
+                result_.sendErrors++;
+                done++;
+                continue;
+            }
+            done += static_cast<unsigned>(sent);
+            accepted += static_cast<uint64_t>(sent);
+        }
+        return accepted;
+    }
+
+    void flushRequests() {
+        result_.sent += flushBatch(sendVectors_, sendMessages_, outgoing_);
+        outgoing_ = 0;
+    }
+
+    void flushReplies() {
+        flushBatch(replyVectors_, replyMessages_, replies_);
+        replies_ = 0;
+    }
+
+    int receive() {
+        for (unsigned i = 0; i < options_.batch; i++) {
+            receiveVectors_[i].iov_base = &receiveBuffer_[i * RECEIVE_SIZE];
+            receiveVectors_[i].iov_len = RECEIVE_SIZE;
+            std::memset(&receiveMessages_[i], 0, sizeof(receiveMessages_[i]));
+            receiveMessages_[i].msg_hdr.msg_iov = &receiveVectors_[i];
+            receiveMessages_[i].msg_hdr.msg_iovlen = 1;
+        }
+        int count = recvmmsg(fd_, receiveMessages_.data(), options_.batch, MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            return 0;
+        }
+        uint64_t now = monotonicNs();
+        for (int i = 0; i < count; i++) {
+            handleResponse(&receiveBuffer_[i * RECEIVE_SIZE], receiveMessages_[i].msg_len, now);
+        }
+        return count;
+    }
+
+    void handleResponse(const uint8_t* data, size_t length, uint64_t now) {
+        CoapPacketView view;
+        if (CoapParser::parseView(data, length, view) != CoapError::OK) {
+            result_.malformed++;
+            return;
+        }
+        if (view.code == CoapCode::EMPTY && view.type == CoapType::ACK) {
+            return;     // Separate response follows
+        }
+
+        uint64_t token = 0;
+        Slot* slot = nullptr;
+        uint32_t index = 0;
+        if (view.token_length == TOKEN_SIZE) {
+            std::memcpy(&token, view.token, TOKEN_SIZE);
+            index = static_cast<uint32_t>(token);
+            if (index < slots_.size() && slots_[index].busy &&
+                slots_[index].generation == static_cast<uint32_t>(token >> 32)) {
+                slot = &slots_[index];
+            }
+        }
+        if (slot == nullptr) {
+            result_.stale++;
+            if (view.type == CoapType::CON || view.type == CoapType::NON) {
+                queueReply(CoapType::RST, view.message_id);
+            }
+            return;
+        }
+        if (view.type == CoapType::CON) {
+            queueReply(CoapType::ACK, view.message_id);
+        }
+
+        uint8_t codeClass = static_cast<uint8_t>(view.code) >> 5;
+        if (view.type == CoapType::RST || codeClass != 2) {
+            result_.failed++;
+            release(index);
+            return;
+        }
+
+        if (slot->kind == KIND_BLOCK2) {
+            CoapOptionIterator options = view.getOptions();
+            CoapOptionRef option;
+            while (options.next(option)) {
+                if (option.number == static_cast<uint16_t>(CoapOptionNumber::BLOCK2) && option.length <= 3) {
+                    uint32_t value = decodeUint(option.value, option.length);
+                    if ((value & 0x08) != 0 && (value >> 4) < 0xFFFFF) {
+                        // More blocks: fetch the next one on the same slot
+                        slot->block = (value >> 4) + 1;
+                        if (outgoing_ == options_.batch) {
+                            flushRequests();
+                        }
+                        queueRequest(index, now);
+                        return;
+                    }
+                }
+            }
+        }
+
+        result_.completed[slot->kind]++;
+        if (options_.rate > 0) {
+            result_.corrected.record(now - slot->intended);
+        } else {
+            result_.corrected.recordCorrected(now - slot->intended, options_.expectedIntervalNs);
+        }
+        result_.uncorrected.record(now - slot->sent);
+        release(index);
+    }
+
+    void release(uint32_t index) {
+        Slot& slot = slots_[index];
+        slot.busy = false;
+        slot.generation++;
+        freeSlots_.push_back(index);
+        outstanding_--;
+    }
+
+    void expire(uint64_t now) {
+        for (uint32_t i = 0; i < slots_.size(); i++) {
+            if (slots_[i].busy && slots_[i].sent + options_.timeoutNs < now) {
+                result_.timeouts++;
+                release(i);
+            }
+        }
+    }
+};
+
+int openSocket(const struct addrinfo* address) {
+    int fd = socket(address->ai_family, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &SOCKET_BUFFER, sizeof(SOCKET_BUFFER));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &SOCKET_BUFFER, sizeof(SOCKET_BUFFER));
+    if (connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool parseMix(const std::string& mix, unsigned* weights) {
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        weights[kind] = 0;
+    }
+    size_t start = 0;
+    unsigned total = 0;
+    while (start < mix.size()) {
+        size_t end = mix.find(',', start);
+        if (end == std::string::npos) {
+            end = mix.size();
+        }
+        std::string entry = mix.substr(start, end - start);
+        size_t equals = entry.find('=');
+        std::string name = entry.substr(0, equals);
+        unsigned weight = equals == std::string::npos ? 1 : static_cast<unsigned>(std::atoi(entry.c_str() + equals + 1));
+        int kind = 0;
+        while (kind < KIND_COUNT && name != KIND_NAMES[kind]) {
+            kind++;
+        }
+        if (kind == KIND_COUNT) {
+            return false;
+        }
+        weights[kind] = weight;
+        total += weight;
+        start = end + 1;
+    }
+    return total > 0;
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--rate" && i + 1 < argc) {
+            options.rate = std::atof(argv[++i]);
+        } else if (arg == "--concurrency" && i + 1 < argc) {
+            options.concurrency = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--duration" && i + 1 < argc) {
+            options.duration = std::atof(argv[++i]);
+        } else if (arg == "--mix" && i + 1 < argc) {
+            if (!parseMix(argv[++i], options.weights)) {
+                return false;
+            }
+        } else if (arg == "--path" && i + 1 < argc) {
+            options.path = argv[++i];
+        } else if (arg == "--payload" && i + 1 < argc) {
+            options.payload = static_cast<size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--non") {
+            options.nonConfirmable = true;
+        } else if (arg == "--batch" && i + 1 < argc) {
+            options.batch = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            options.timeoutNs = static_cast<uint64_t>(std::atoll(argv[++i])) * 1000000ULL;
+        } else if (arg == "--expected-interval" && i + 1 < argc) {
+            options.expectedIntervalNs = static_cast<uint64_t>(std::atoll(argv[++i])) * 1000ULL;
+        } else if (arg[0] != '-' && options.target == nullptr) {
+            options.target = argv[i];
+        } else {
+            return false;
+        }
+    }
+    // Exactly one of the two modes
+    if ((options.rate > 0) == (options.concurrency > 0)) {
+        return false;
+    }
+    options.threads = std::max(1u, options.threads);
+    options.batch = std::max(1u, std::min(options.batch, 1024u));
+    return options.target != nullptr;
+}
+
+bool resolve(const char* target, struct addrinfo*& address) {
+    std::string text = target;
+    size_t colon = text.rfind(':');
+    std::string host = colon == std::string::npos ? text : text.substr(0, colon);
+    std::string port = colon == std::string::npos ? "5683" : text.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &address);
+    if (error != 0) {
+        std::fprintf(stderr, "%s: %s\n", target, gai_strerror(error));
+        return false;
+    }
+    return true;
+}
+
+void printLatency(const char* title, const Histogram& histogram) {
+    const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    std::printf("%-24s", title);
+    for (double percent : percentiles) {
+        std::printf(" p%-5g %9.1f", percent, histogram.percentile(percent) / 1000.0);
+    }
+    std::printf("  max %9.1f  mean %9.1f us  (%llu samples)\n", histogram.max() / 1000.0,
+                histogram.mean() / 1000.0, static_cast<unsigned long long>(histogram.count()));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr,
+                     "usage: %s [--threads N] (--rate R | --concurrency C) [--duration S]\n"
+                     "       [--mix get=W,post=W,observe=W,block2=W] [--path P] [--payload BYTES]\n"
+                     "       [--non] [--batch N] [--timeout MS] [--expected-interval US] host:port\n",
+                     argv[0]);
+        return 2;
+    }
+
+    Templates templates;
+    if (!templates.build(options)) {
+        std::fprintf(stderr, "cannot encode request templates (path or payload too large?)\n");
+        return 1;
+    }
+
+    struct addrinfo* address = nullptr;
+    if (!resolve(options.target, address)) {
+        return 1;
+    }
+    std::vector<int> sockets;
+    for (unsigned i = 0; i < options.threads; i++) {
+        int fd = openSocket(address);
+        if (fd < 0) {
+            std::perror("socket");
+            freeaddrinfo(address);
+            return 1;
+        }
+        sockets.push_back(fd);
+    }
+    freeaddrinfo(address);
+
+    std::vector<WorkerResult> results(options.threads);
+    uint64_t start = monotonicNs() + 10000000u;     // Let all threads start together
+    uint64_t stop = start + static_cast<uint64_t>(options.duration * 1e9);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < options.threads; i++) {
+        workers.push_back(std::thread([&, i]() {
+            Worker worker(options, templates, sockets[i], i, results[i]);
+            while (monotonicNs() < start) {
+            }
+            worker.run(start, stop);
+        }));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (int fd : sockets) {
+        close(fd);
+    }
+
+    // Merge per-thread results
+    WorkerResult total;
+    for (const auto& result : results) {
+        total.corrected.merge(result.corrected);
+        total.uncorrected.merge(result.uncorrected);
+        total.sent += result.sent;
+        for (int kind = 0; kind < KIND_COUNT; kind++) {
+            total.completed[kind] += result.completed[kind];
+        }
+        total.failed += result.failed;
+        total.timeouts += result.timeouts;
+        total.stale += result.stale;
+        total.malformed += result.malformed;
+        total.sendErrors += result.sendErrors;
+        total.lateStarts += result.lateStarts;
+    }
+    uint64_t completed = 0;
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        completed += total.completed[kind];
+    }
+
+    if (options.rate > 0) {
+        std::printf("open loop: %.0f req/s target, %u threads, %.1f s\n", options.rate, options.threads,
+                    options.duration);
+    } else {
+        std::printf("closed loop: %u outstanding x %u threads, %.1f s\n", options.concurrency,
+                    options.threads, options.duration);
+    }
+    std::printf("completed: %llu (%.0f req/s)  get %llu  post %llu  observe %llu  block2 %llu\n",
+                static_cast<unsigned long long>(completed), completed / options.duration,
+                static_cast<unsigned long long>(total.completed[KIND_GET]),
+                static_cast<unsigned long long>(total.completed[KIND_POST]),
+                static_cast<unsigned long long>(total.completed[KIND_OBSERVE]),
+                static_cast<unsigned long long>(total.completed[KIND_BLOCK2]));
+    std::printf("datagrams sent: %llu  failed: %llu  timeouts: %llu  stale: %llu  malformed: %llu  "
+                "send errors: %llu  late starts: %llu\n",
+                static_cast<unsigned long long>(total.sent), static_cast<unsigned long long>(total.failed),
+                static_cast<unsigned long long>(total.timeouts), static_cast<unsigned long long>(total.stale),
+                static_cast<unsigned long long>(total.malformed),
+                static_cast<unsigned long long>(total.sendErrors),
+                static_cast<unsigned long long>(total.lateStarts));
+    std::printf("\nlatency (us)\n");
+    printLatency("corrected", total.corrected);
+    printLatency("uncorrected (service)", total.uncorrected);
+    return 0;
+}
@@ -0,0 +1,478 @@
+// CoAP over DTLS loopback test
+//
+// Generates a self-signed certificate for "localhost" and runs a DTLS
+// server and --clients clients over 127.0.0.1 in one event loop. The
+// server receives with recvmmsg() and hands each batch to
+// CoapDtlsTransport::receiveBatch(), which creates a
+// CoapOpenSslDtlsEngine per peer through CoapOpenSslDtlsEngineFactory.
+// New clients first get a HelloVerifyRequest cookie, then finish the
+// handshake and verify the certificate and host name. Each client sends
+// --count requests, a few at a time, and checks that every 2.05 reply
+// echoes its token and payload.
+//
+// The transport holds exactly --clients sessions with an idle timeout of
+// 0. At the end one client's request and a new peer's ClientHello arrive
+// in the same batch: the sweep for the new peer must evict the idle
+// sessions but keep the one the request's message points to.
+// Exits 0 when all checks pass.
+//
+// Build:
+//   c++ -std=c++11 -O2 -DCOAP_PACKET_WITH_OPENSSL=1 -Isrc -o coap-dtls-loopback
+//       tools/coap_dtls_loopback.cpp src/CoapPacketUnity.cpp -lssl -lcrypto
+//
+// Usage:
+//   coap-dtls-loopback [--clients N] [--count N] [--seed S]
+
+#include "CoapBuilder.h"
+#include "CoapOpenSsl.h"
+#include "CoapParser.h"
+
+#if !COAP_PACKET_WITH_OPENSSL
+#error "build with -DCOAP_PACKET_WITH_OPENSSL=1"
+#endif
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/x509v3.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace CoapPacket;
+
+namespace {
+
+struct Options {
+    size_t clients;
+    size_t count;
+    uint64_t seed;
+
+    Options() : clients(4), count(200), seed(1) {}
+};
+
+// Requests a client keeps in flight
+const size_t WINDOW = 4;
+
+// Datagrams per recvmmsg() call and their buffer size
+const size_t BATCH = 16;
+const size_t DATAGRAM_SIZE = 2048;
+
+uint64_t nextRandom(uint64_t& state) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return state >> 33;
+}
+
+uint64_t nowMs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+    }
+    return condition;
+}
+
+/**
+ * Self-signed P-256 certificate for "localhost", valid for a day
+ */
+bool makeCertificate(EVP_PKEY*& key, X509*& certificate) {
+    key = EVP_EC_gen("P-256");
+    certificate = X509_new();
+    if (key == nullptr || certificate == nullptr) {
+        return false;
+    }
+    X509_set_version(certificate, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certificate), -60);
+    X509_gmtime_adj(X509_getm_notAfter(certificate), 24 * 3600);
+    X509_NAME* name = X509_get_subject_name(certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1,
+                               -1, 0);
+    X509_set_issuer_name(certificate, name);
+    X509_set_pubkey(certificate, key);
+
+    X509V3_CTX context;
+    X509V3_set_ctx_nodb(&context);
+    X509V3_set_ctx(&context, certificate, certificate, nullptr, nullptr, 0);
+    X509_EXTENSION* altName = X509V3_EXT_conf_nid(nullptr, &context, NID_subject_alt_name, "DNS:localhost");
+    bool ok = altName != nullptr && X509_add_ext(certificate, altName, -1) == 1 &&
+              X509_sign(certificate, key, EVP_sha256()) > 0;
+    X509_EXTENSION_free(altName);
+    return ok;
+}
+
+/**
+ * Non-blocking UDP socket bound to an ephemeral port on 127.0.0.1
+ */
+int openSocket(CoapEndpoint& local) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0) {
+        std::perror("bind");
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    CoapEndpoint::fromSockaddr(&address, nullptr, ENDPOINT_PROTOCOL_UDP, local);
+    return fd;
+}
+
+bool sendTo(int fd, const CoapEndpoint& endpoint, const uint8_t* data, size_t length) {
+    sockaddr_in6 address;
+    size_t addressLength = 0;
+    return endpoint.toSockaddr(&address, sizeof(address), addressLength) == CoapError::OK &&
+           ::sendto(fd, data, length, 0, reinterpret_cast<const sockaddr*>(&address),
+                    static_cast<socklen_t>(addressLength)) == static_cast<ssize_t>(length);
+}
+
+/**
+ * DTLS server: one recvmmsg() batch per step through CoapDtlsTransport
+ */
+class Server {
+public:
+    Server(CoapOpenSslContext& context, int fd, size_t maxSessions)
+        : fd_(fd)
+        , factory_(context, fd)
+        , transport_(factory_, maxSessions, 0)
+        , buffer_(BATCH * DATAGRAM_SIZE)
+        , requests_(0)
+        , replyErrors_(0) {}
+
+    /**
+     * Receive and answer one batch; returns number of datagrams received
+     */
+    size_t step() {
+        mmsghdr headers[BATCH];
+        iovec vectors[BATCH];
+        sockaddr_in6 addresses[BATCH];
+        for (size_t i = 0; i < BATCH; i++) {
+            vectors[i].iov_base = &buffer_[i * DATAGRAM_SIZE];
+            vectors[i].iov_len = DATAGRAM_SIZE;
+            std::memset(&headers[i], 0, sizeof(headers[i]));
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+            headers[i].msg_hdr.msg_name = &addresses[i];
+            headers[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+        }
+        int count = ::recvmmsg(fd_, headers, BATCH, MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            return 0;
+        }
+
+        CoapDatagram batch[BATCH];
+        for (int i = 0; i < count; i++) {
+            CoapEndpoint::fromSockaddr(&addresses[i], nullptr, ENDPOINT_PROTOCOL_UDP, batch[i].endpoint);
+            batch[i].data = &buffer_[static_cast<size_t>(i) * DATAGRAM_SIZE];
+            batch[i].length = headers[i].msg_len;
+        }
+        CoapDtlsMessage messages[BATCH];
+        size_t messageCount = transport_.receiveBatch(batch, static_cast<size_t>(count), messages, nowMs());
+
+        for (size_t i = 0; i < messageCount; i++) {
+            const CoapPacketView& view = messages[i].view;
+            requests_++;
+            std::vector<uint8_t> response;
+            CoapBuilder builder;
+            builder.setType(CoapType::ACK)
+                .setCode(CoapCode::CONTENT_2_05)
+                .setMessageId(view.message_id)
+                .setToken(view.token, view.token_length)
+                .setPayload(view.payload, view.payload_length)
+                .buildBuffer(response);
+            // Use the session of the message, as a server would before the next batch
+            uint8_t record[DATAGRAM_SIZE];
+            size_t recordLength = 0;
+            if (messages[i].session->encrypt(response.data(), response.size(), record, sizeof(record),
+                                             recordLength) != CoapError::OK ||
+                !sendTo(fd_, batch[messages[i].index].endpoint, record, recordLength)) {
+                replyErrors_++;
+            }
+        }
+        return static_cast<size_t>(count);
+    }
+
+    CoapDtlsTransport& getTransport() { return transport_; }
+    size_t getRequests() const { return requests_; }
+    size_t getReplyErrors() const { return replyErrors_; }
+
+private:
+    int fd_;
+    CoapOpenSslDtlsEngineFactory factory_;
+    CoapDtlsTransport transport_;
+    std::vector<uint8_t> buffer_;
+    size_t requests_;
+    size_t replyErrors_;
+};
+
+/**
+ * DTLS client sending requests with up to WINDOW in flight
+ */
+class Client {
+public:
+    Client(CoapOpenSslContext& context, const CoapEndpoint& server, size_t index)
+        : fd_(openSocket(endpoint_))
+        , engine_(context, fd_, server, "localhost")
+        , server_(server)
+        , index_(index)
+        , sent_(0)
+        , answered_(0)
+        , failed_(false) {}
+
+    ~Client() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    bool start() {
+        return check(fd_ >= 0 && engine_.connect() == CoapError::OK, "client hello");
+    }
+
+    /**
+     * Send requests up to limit (at most WINDOW unanswered)
+     */
+    void send(size_t limit, uint64_t& state) {
+        while (!failed_ && engine_.isEstablished() && sent_ < limit && sent_ < answered_ + WINDOW) {
+            uint8_t token[4] = {static_cast<uint8_t>(index_), static_cast<uint8_t>(sent_),
+                                static_cast<uint8_t>(sent_ >> 8), 0xD7};
+            std::string body(static_cast<size_t>(nextRandom(state) % 1000), static_cast<char>('a' + sent_ % 26));
+            bodies_.push_back(body);
+
+            std::vector<uint8_t> request;
+            CoapBuilder builder;
+            builder.setType(CoapType::CON)
+                .setCode(CoapCode::POST)
+                .setMessageId(static_cast<uint16_t>(sent_))
+                .setToken(token, sizeof(token))
+                .setUriPath("/echo");
+            if (!body.empty()) {
+                builder.setPayload(body);
+            }
+            builder.buildBuffer(request);
+            uint8_t record[DATAGRAM_SIZE];
+            size_t recordLength = 0;
+            failed_ = !check(engine_.encrypt(request.data(), request.size(), record, sizeof(record),
+                                             recordLength) == CoapError::OK, "encrypt request") ||
+                      !check(sendTo(fd_, server_, record, recordLength), "send request");
+            sent_++;
+        }
+    }
+
+    /**
+     * Process received datagrams; returns number received
+     */
+    size_t receive() {
+        size_t received = 0;
+        uint8_t datagram[DATAGRAM_SIZE];
+        ssize_t n;
+        while (!failed_ && (n = ::recv(fd_, datagram, sizeof(datagram), MSG_DONTWAIT)) > 0) {
+            received++;
+            uint8_t* plaintext = nullptr;
+            size_t length = 0;
+            if (!check(engine_.decrypt(datagram, static_cast<size_t>(n), plaintext, length) == CoapError::OK,
+                       "client decrypt")) {
+                failed_ = true;
+            } else if (length > 0) {
+                handleResponse(plaintext, length);
+            }
+        }
+        engine_.handleTimeout();
+        return received;
+    }
+
+    bool isEstablished() const { return engine_.isEstablished(); }
+    bool hasFailed() const { return failed_; }
+    size_t getAnswered() const { return answered_; }
+    size_t getSent() const { return sent_; }
+    int getFd() const { return fd_; }
+
+    /**
+     * Endpoint of this client as the server sees it
+     */
+    const CoapEndpoint& getEndpoint() const { return endpoint_; }
+
+private:
+    CoapEndpoint endpoint_;  // Before fd_: openSocket() fills it
+    int fd_;
+    CoapOpenSslDtlsEngine engine_;
+    CoapEndpoint server_;
+    size_t index_;
+    size_t sent_;
+    size_t answered_;
+    bool failed_;
+    std::vector<std::string> bodies_;
+
+    void handleResponse(const uint8_t* data, size_t length) {
+        CoapPacketView view;
+        if (!check(CoapParser::parseView(data, length, view) == CoapError::OK, "response parses")) {
+            failed_ = true;
+            return;
+        }
+        size_t sequence = static_cast<size_t>(view.token[1]) | (static_cast<size_t>(view.token[2]) << 8);
+        failed_ = !check(view.code == CoapCode::CONTENT_2_05 && view.type == CoapType::ACK, "response code") ||
+                  !check(view.token[0] == static_cast<uint8_t>(index_) && sequence == answered_,
+                         "responses in order") ||
+                  !check(std::string(reinterpret_cast<const char*>(view.payload), view.payload_length) ==
+                         bodies_[sequence], "echoed payload");
+        answered_++;
+    }
+};
+
+/**
+ * Run server and clients until done() or the deadline passes
+ */
+bool runLoop(Server& server, std::vector<Client*>& clients, int serverFd, uint64_t& state, size_t limit,
+             const std::function<bool()>& done) {
+    uint64_t deadline = nowMs() + 20000;
+    while (!done()) {
+        if (nowMs() > deadline) {
+            return check(false, "finished before the deadline");
+        }
+        size_t activity = server.step();
+        for (Client* client : clients) {
+            activity += client->receive();
+            client->send(limit, state);
+            if (client->hasFailed()) {
+                return false;
+            }
+        }
+        if (activity == 0) {
+            std::vector<pollfd> fds(1);
+            fds[0].fd = serverFd;
+            fds[0].events = POLLIN;
+            for (Client* client : clients) {
+                pollfd entry;
+                entry.fd = client->getFd();
+                entry.events = POLLIN;
+                fds.push_back(entry);
+            }
+            ::poll(fds.data(), fds.size(), 10);
+        }
+    }
+    return true;
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--clients" && i + 1 < argc) {
+            options.clients = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--count" && i + 1 < argc) {
+            options.count = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = static_cast<uint64_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return options.clients >= 2 && options.clients <= 64 && options.count > 0 && options.count <= 65536;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--clients N] [--count N] [--seed S]\n", argv[0]);
+        return 2;
+    }
+
+    EVP_PKEY* key = nullptr;
+    X509* certificate = nullptr;
+    CoapOpenSslContext serverContext(true, true);
+    CoapOpenSslContext clientContext(false, true);
+    if (!check(makeCertificate(key, certificate), "self-signed certificate") ||
+        !check(SSL_CTX_use_certificate(serverContext.getNative(), certificate) == 1 &&
+               SSL_CTX_use_PrivateKey(serverContext.getNative(), key) == 1, "server certificate") ||
+        !check(X509_STORE_add_cert(SSL_CTX_get_cert_store(clientContext.getNative()), certificate) == 1,
+               "trust certificate")) {
+        return 1;
+    }
+    SSL_CTX_set_verify(clientContext.getNative(), SSL_VERIFY_PEER, nullptr);
+
+    CoapEndpoint serverEndpoint;
+    int serverFd = openSocket(serverEndpoint);
+    if (serverFd < 0) {
+        return 1;
+    }
+    uint64_t state = options.seed;
+    bool ok;
+    {
+        Server server(serverContext, serverFd, options.clients);
+        std::vector<Client*> clients;
+        for (size_t i = 0; i < options.clients; i++) {
+            clients.push_back(new Client(clientContext, serverEndpoint, i));
+        }
+        ok = true;
+        for (Client* client : clients) {
+            ok = client->start() && ok;
+        }
+
+        // Handshakes and requests
+        ok = ok && runLoop(server, clients, serverFd, state, options.count, [&clients, &options]() {
+            for (Client* client : clients) {
+                if (client->getAnswered() < options.count) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        ok = ok && check(server.getTransport().getSessionCount() == options.clients, "one session per client");
+
+        // A request and a new peer's ClientHello in one batch on a full table
+        Client stranger(clientContext, serverEndpoint, options.clients);
+        if (ok) {
+            // Let the other sessions go idle for at least a millisecond
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            Client& first = *clients[0];
+            first.send(options.count + 1, state);
+            ok = stranger.start();
+            uint64_t waited = nowMs();
+            while (ok && server.step() == 0 && nowMs() - waited < 1000) {
+            }
+            CoapDtlsTransport& transport = server.getTransport();
+            ok = ok && check(server.getReplyErrors() == 0, "reply through the message's session") &&
+                 check(transport.getSession(first.getEndpoint()) != nullptr, "active session kept") &&
+                 check(transport.getSessionCount() == 2, "idle sessions evicted for the new peer");
+
+            std::vector<Client*> remaining;
+            remaining.push_back(&first);
+            remaining.push_back(&stranger);
+            ok = ok && runLoop(server, remaining, serverFd, state, options.count + 1, [&first]() {
+                return first.getAnswered() == first.getSent();
+            });
+            ok = ok && runLoop(server, remaining, serverFd, state, 1, [&stranger]() {
+                return stranger.getAnswered() == 1;
+            });
+        }
+
+        size_t answered = 0;
+        for (Client* client : clients) {
+            answered += client->getAnswered();
+            delete client;
+        }
+        std::printf("clients %zu, requests %zu, answered %zu, dropped %zu: %s\n", options.clients, server.getRequests(),
+                    answered + stranger.getAnswered(), server.getTransport().getDropCount(), ok ? "ok" : "FAILED");
+    }
+    ::close(serverFd);
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+// Memory footprint report
+//
+// Fills each stateful table of the library with --count entities and
+// prints the bytes per entity from memoryUsage(): used (live data) and
+// reserved (including capacity slack). Packet sizes are reported per
+// option count. Use it to size nodes, e.g. --count 1000000 for a million
+// pending exchanges or DTLS sessions.
+//
+// Build:
+//   c++ -std=c++11 -O2 -Isrc -o coap-footprint
+//       tools/coap_footprint.cpp src/CoapPacketUnity.cpp
+//
+// Usage:
+//   coap-footprint [--count N] [--payload BYTES]
+
+#include "CoapBuilder.h"
+#include "CoapDtls.h"
+#include "CoapParser.h"
+#include "CoapPacketBatch.h"
+#include "CoapResourceDirectory.h"
+#include "CoapResponseScheduler.h"
+#include "CoapSimNetwork.h"
+#include "CoapStringTable.h"
+#include "CoapTimerWheel.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace CoapPacket;
+
+namespace {
+
+struct Options {
+    size_t count;
+    size_t payload;
+
+    Options() : count(100000), payload(64) {}
+};
+
+void printHeader() {
+    std::printf("%-36s %10s %14s %14s %10s %10s\n", "entity", "count", "used", "reserved", "used/ea",
+                "rsvd/ea");
+}
+
+void printRow(const char* name, const CoapMemoryUsage& usage, size_t count) {
+    double divisor = count > 0 ? static_cast<double>(count) : 1.0;
+    std::printf("%-36s %10zu %14zu %14zu %10.1f %10.1f\n", name, count, usage.used, usage.reserved,
+                usage.used / divisor, usage.reserved / divisor);
+}
+
+std::vector<uint8_t> buildRequest(uint16_t messageId, size_t options, size_t payload) {
+    const uint8_t token[4] = {0xA1, 0xB2, 0xC3, static_cast<uint8_t>(messageId)};
+    CoapBuilder builder;
+    builder.setType(CoapType::CON).setCode(payload > 0 ? CoapCode::POST : CoapCode::GET)
+        .setMessageId(messageId).setToken(token, sizeof(token));
+    for (size_t i = 0; i < options; i++) {
+        builder.addUriPathSegment("seg" + std::to_string(i));
+    }
+    if (payload > 0) {
+        builder.setPayload(std::vector<uint8_t>(payload, 0x42));
+    }
+    std::vector<uint8_t> buffer;
+    builder.buildBuffer(buffer);
+    return buffer;
+}
+
+void reportPackets(const Options& options) {
+    const size_t optionCounts[] = {0, 1, 4, 8, 16};
+    for (size_t optionCount : optionCounts) {
+        std::vector<uint8_t> datagram = buildRequest(1, optionCount, options.payload);
+        CoapPacket::CoapPacket packet;
+        CoapParser::parse(datagram.data(), datagram.size(), packet);
+        std::string name = "CoapPacket, " + std::to_string(optionCount) + " options, " +
+                           std::to_string(options.payload) + " B payload";
+        printRow(name.c_str(), packet.memoryUsage(), 1);
+    }
+}
+
+void reportBatch(const Options& options) {
+    std::vector<uint8_t> datagram = buildRequest(1, 4, options.payload);
+    std::vector<const uint8_t*> datagrams(options.count, datagram.data());
+    std::vector<size_t> lengths(options.count, datagram.size());
+    CoapPacketBatch batch;
+    CoapParser::parseBatch(datagrams.data(), lengths.data(), options.count, batch);
+    printRow("CoapPacketBatch row (4 options)", batch.memoryUsage(), batch.size());
+}
+
+void reportScheduler(const Options& options) {
+    CoapResponseScheduler scheduler;
+    CoapRequestState state = CoapRequestState::NEW;
+    CoapResponsePlan plan;
+    for (size_t i = 0; i < options.count; i++) {
+        scheduler.accept(i, CoapType::CON, static_cast<uint16_t>(i), i, 0, state, plan);
+    }
+    printRow("CoapResponseScheduler exchange", scheduler.memoryUsage(), scheduler.size());
+}
+
+void reportTimers(const Options& options) {
+    CoapTimerWheel timers;
+    for (size_t i = 0; i < options.count; i++) {
+        timers.schedule(i % 100000, i);
+    }
+    printRow("CoapTimerWheel timer", timers.memoryUsage(), timers.size());
+}
+
+void reportSessions(const Options& options) {
+    CoapDtlsSessionTable sessions;
+    // Engines are never called; any non-null pointer marks a session
+    CoapDtlsEngine* engine = reinterpret_cast<CoapDtlsEngine*>(&sessions);
+    for (size_t i = 0; i < options.count; i++) {
+        CoapEndpoint endpoint;
+        const uint8_t address[4] = {10, static_cast<uint8_t>(i >> 16), static_cast<uint8_t>(i >> 8),
+                                    static_cast<uint8_t>(i)};
+        endpoint.setRemoteIPv4(address, 5684);
+        sessions.insert(endpoint, engine);
+    }
+    printRow("CoapDtlsSessionTable session", sessions.memoryUsage(), sessions.size());
+}
+
+void reportStrings(const Options& options) {
+    size_t count = options.count < STRING_TABLE_MAX_STRINGS ? options.count : STRING_TABLE_MAX_STRINGS;
+    CoapStringTable strings(count);
+    for (size_t i = 0; i < count; i++) {
+        std::string value = "/sensors/" + std::to_string(i);
+        strings.intern(value.data(), value.size());
+    }
+    printRow("CoapStringTable string (~14 B)", strings.memoryUsage(), strings.size());
+}
+
+void reportDirectory(const Options& options) {
+    CoapResourceDirectory directory;
+    const std::string links = "</temp>;rt=\"temperature\";if=\"sensor\",</hum>;rt=\"humidity\"";
+    for (size_t i = 0; i < options.count; i++) {
+        CoapRdRegistration registration;
+        registration.endpoint = "node" + std::to_string(i);
+        registration.base = "coap://[2001:db8::1]";
+        uint32_t id = 0;
+        directory.registerEndpoint(registration, links.data(), links.size(), 0, id);
+    }
+    printRow("CoapResourceDirectory reg (2 links)", directory.memoryUsage(),
+             directory.getRegistrationCount());
+}
+
+void reportSimulation(const Options& options) {
+    CoapSimNetwork network;
+    uint32_t client = network.addNode();
+    uint32_t server = network.addNode();
+    CoapSimLink link;
+    link.latency = 1000000;
+    network.setDefaultLink(link);
+    std::vector<uint8_t> datagram = buildRequest(1, 4, options.payload);
+    for (size_t i = 0; i < options.count; i++) {
+        network.send(client, server, datagram.data(), datagram.size());
+    }
+    printRow("CoapSimNetwork datagram in flight", network.memoryUsage(), options.count);
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            options.count = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--payload" && i + 1 < argc) {
+            options.payload = static_cast<size_t>(std::atoll(argv[++i]));
+        } else {
+            return false;
+        }
+    }
+    return options.count > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--count N] [--payload BYTES]\n", argv[0]);
+        return 2;
+    }
+
+    printHeader();
+    reportPackets(options);
+    reportBatch(options);
+    reportScheduler(options);
+    reportTimers(options);
+    reportSessions(options);
+    reportStrings(options);
+    reportDirectory(options);
+    reportSimulation(options);
+    return 0;
+}
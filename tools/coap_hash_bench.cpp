@@ -0,0 +1,192 @@
+// Message hash benchmark
+//
+// Latency: CoapHash::hash() of an encoded GET with 4 options, next to a
+// bare CoapOptionIterator walk of the same message (the floor for any
+// wire-format hash), CoapHash::hash() of the parsed CoapPacket and
+// CoapHash::hashBytes() of the raw datagram.
+//
+// Quality: hashes --count distinct request cache keys (Uri-Path and
+// Uri-Query vary; type, message ID and token vary too but are excluded
+// by COAP_FIELDS_NOT_CACHE_KEY), counts 64-bit collisions and reports the
+// chi-square of the low --bucket-bits bits divided by its degrees of
+// freedom (about 1.0 for a uniform hash).
+//
+// Build:
+//   c++ -std=c++11 -O2 -Isrc -o coap-hash-bench
+//       tools/coap_hash_bench.cpp src/CoapPacketUnity.cpp
+//
+// Usage:
+//   coap-hash-bench [--count N] [--rounds R] [--bucket-bits B] [--seed S]
+
+#include "CoapHash.h"
+#include "CoapOptions.h"
+#include "CoapParser.h"
+#include "CoapWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace CoapPacket;
+
+namespace {
+
+struct Options {
+    size_t count;
+    size_t rounds;
+    unsigned bucketBits;
+    uint64_t seed;
+
+    Options() : count(4000000), rounds(2000000), bucketBits(20), seed(0) {}
+};
+
+double nowNs() {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void printRow(const char* name, double nanoseconds, size_t operations, uint64_t check) {
+    std::printf("%-36s %8.2f ns/op   (check %llu)\n", name, nanoseconds / static_cast<double>(operations),
+                static_cast<unsigned long long>(check));
+}
+
+/**
+ * Encode a GET for /<path>/<leaf>?<query> with a 4-byte token and Accept
+ */
+CoapError writeRequest(uint8_t* buffer, size_t capacity, uint16_t messageId, uint32_t token,
+                       const std::string& path, const std::string& leaf, const std::string& query,
+                       size_t& length) {
+    const uint8_t tokenBytes[4] = {static_cast<uint8_t>(token), static_cast<uint8_t>(token >> 8),
+                                   static_cast<uint8_t>(token >> 16), static_cast<uint8_t>(token >> 24)};
+    CoapWriter writer(buffer, capacity);
+    return writer.begin(CoapType::CON, CoapCode::GET, messageId, tokenBytes, sizeof(tokenBytes))
+        .addOption(CoapOptionNumber::URI_PATH, reinterpret_cast<const uint8_t*>(path.data()), path.size())
+        .addOption(CoapOptionNumber::URI_PATH, reinterpret_cast<const uint8_t*>(leaf.data()), leaf.size())
+        .addOption(CoapOptionNumber::URI_QUERY, reinterpret_cast<const uint8_t*>(query.data()), query.size())
+        .addOption(CoapOptionNumber::ACCEPT, static_cast<uint32_t>(50))
+        .finish(length);
+}
+
+void benchLatency(const Options& options) {
+    uint8_t message[64];
+    size_t length = 0;
+    writeRequest(message, sizeof(message), 0x1234, 0xA1B2C3D4, "sensors", "temp", "unit=c", length);
+    CoapPacket::CoapPacket packet;
+    CoapParser::parse(message, length, packet);
+    std::printf("request: %zu bytes, 4 options\n", length);
+
+    uint64_t sum = 0;
+    double start = nowNs();
+    for (size_t i = 0; i < options.rounds; i++) {
+        // Vary one byte so the loop cannot be hoisted
+        message[3] = static_cast<uint8_t>(i);
+        size_t offset = 0;
+        CoapOptionIterator::locateOptions(message, length, offset);
+        CoapOptionIterator it(message, length, offset);
+        CoapOptionRef option;
+        while (it.next(option)) {
+            sum += option.number + option.length;
+        }
+    }
+    printRow("CoapOptionIterator walk", nowNs() - start, options.rounds, sum);
+
+    sum = 0;
+    start = nowNs();
+    for (size_t i = 0; i < options.rounds; i++) {
+        message[3] = static_cast<uint8_t>(i);
+        uint64_t hash = 0;
+        CoapHash::hash(message, length, hash);
+        sum += hash;
+    }
+    printRow("CoapHash::hash (encoded)", nowNs() - start, options.rounds, sum);
+
+    sum = 0;
+    start = nowNs();
+    for (size_t i = 0; i < options.rounds; i++) {
+        packet.message_id = static_cast<uint16_t>(i);
+        sum += CoapHash::hash(packet);
+    }
+    printRow("CoapHash::hash (CoapPacket)", nowNs() - start, options.rounds, sum);
+
+    sum = 0;
+    start = nowNs();
+    for (size_t i = 0; i < options.rounds; i++) {
+        message[3] = static_cast<uint8_t>(i);
+        sum += CoapHash::hashBytes(message, length);
+    }
+    printRow("CoapHash::hashBytes (datagram)", nowNs() - start, options.rounds, sum);
+}
+
+void benchQuality(const Options& options) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(options.count);
+    uint8_t message[128];
+    for (size_t i = 0; i < options.count; i++) {
+        // Distinct cache keys: i is spread over a path segment and the query
+        std::string leaf = "r" + std::to_string(i % 1000);
+        std::string query = "id=" + std::to_string(i / 1000);
+        size_t length = 0;
+        writeRequest(message, sizeof(message), static_cast<uint16_t>(i * 7), static_cast<uint32_t>(i * 2654435761u),
+                     "sensors", leaf, query, length);
+        uint64_t hash = 0;
+        CoapHash::hash(message, length, hash, COAP_FIELDS_NOT_CACHE_KEY, options.seed);
+        hashes.push_back(hash);
+    }
+
+    size_t buckets = static_cast<size_t>(1) << options.bucketBits;
+    std::vector<uint32_t> counts(buckets, 0);
+    for (uint64_t hash : hashes) {
+        counts[static_cast<size_t>(hash) & (buckets - 1)]++;
+    }
+    double expected = static_cast<double>(hashes.size()) / static_cast<double>(buckets);
+    double chiSquare = 0;
+    for (uint32_t count : counts) {
+        double diff = count - expected;
+        chiSquare += diff * diff / expected;
+    }
+
+    std::sort(hashes.begin(), hashes.end());
+    size_t collisions = 0;
+    for (size_t i = 1; i < hashes.size(); i++) {
+        collisions += hashes[i] == hashes[i - 1];
+    }
+
+    std::printf("cache keys: %zu, 64-bit collisions: %zu\n", hashes.size(), collisions);
+    std::printf("low %u bits: chi-square/df %.3f\n", options.bucketBits,
+                chiSquare / static_cast<double>(buckets - 1));
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            options.count = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            options.rounds = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--bucket-bits" && i + 1 < argc) {
+            options.bucketBits = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = static_cast<uint64_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return options.count > 0 && options.rounds > 0 && options.bucketBits > 0 && options.bucketBits <= 28;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--count N] [--rounds R] [--bucket-bits B] [--seed S]\n", argv[0]);
+        return 2;
+    }
+
+    benchLatency(options);
+    benchQuality(options);
+    return 0;
+}
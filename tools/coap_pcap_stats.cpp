@@ -0,0 +1,596 @@
+// Offline CoAP capture analyser
+//
+// Memory-maps a pcap file, splits it into one chunk per thread at record
+// boundaries and parses the CoAP datagrams of each chunk with
+// CoapParser::parseBatch. Per-endpoint and per-resource statistics are
+// merged at the end. Retransmissions are detected per worker, so a CON
+// message and its retransmission landing in different chunks are missed.
+//
+// Build:
+//   c++ -std=c++11 -O2 -pthread -Isrc -o coap-pcap-stats
+//       tools/coap_pcap_stats.cpp src/CoapPacketUnity.cpp
+//
+// Usage:
+//   coap-pcap-stats [--threads N] [--port P]... [--all-udp] [--top N] capture.pcap
+
+#include "CoapPacketBatch.h"
+#include "CoapParser.h"
+#include "CoapEndpoint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace CoapPacket;
+
+namespace {
+
+// EXCHANGE_LIFETIME (RFC 7252 section 4.8.2): a CON message ID seen again
+// from the same endpoint within this window counts as a retransmission
+const uint64_t RETRANSMIT_WINDOW_NS = 247ULL * 1000000000ULL;
+
+// Record headers that must chain correctly when resynchronising a chunk
+const int RESYNC_RECORDS = 8;
+
+const size_t BATCH_SIZE = 1024;
+
+// Link types (tcpdump.org/linktypes.html)
+const uint32_t LINKTYPE_NULL = 0;
+const uint32_t LINKTYPE_ETHERNET = 1;
+const uint32_t LINKTYPE_RAW = 101;
+const uint32_t LINKTYPE_LINUX_SLL = 113;
+const uint32_t LINKTYPE_IPV4 = 228;
+const uint32_t LINKTYPE_IPV6 = 229;
+const uint32_t LINKTYPE_LINUX_SLL2 = 276;
+
+struct Options {
+    unsigned threads;
+    std::vector<uint16_t> ports;
+    bool allUdp;
+    size_t top;
+    const char* path;
+
+    Options() : threads(0), allUdp(false), top(20), path(nullptr) {}
+};
+
+struct Capture {
+    const uint8_t* data;
+    size_t size;
+    bool swapped;
+    bool nanoseconds;
+    uint32_t snapLength;
+    uint32_t linkType;
+};
+
+struct Stats {
+    uint64_t messages;
+    uint64_t retransmits;
+    uint64_t payloadBytes;
+    uint64_t payloadMax;
+    uint64_t codes[256];
+
+    Stats() : messages(0), retransmits(0), payloadBytes(0), payloadMax(0), codes() {}
+
+    void add(uint8_t code, uint32_t payloadLength, bool retransmit) {
+        messages++;
+        retransmits += retransmit ? 1 : 0;
+        payloadBytes += payloadLength;
+        payloadMax = std::max<uint64_t>(payloadMax, payloadLength);
+        codes[code]++;
+    }
+
+    void merge(const Stats& other) {
+        messages += other.messages;
+        retransmits += other.retransmits;
+        payloadBytes += other.payloadBytes;
+        payloadMax = std::max(payloadMax, other.payloadMax);
+        for (size_t i = 0; i < 256; i++) {
+            codes[i] += other.codes[i];
+        }
+    }
+};
+
+struct EndpointHash {
+    size_t operator()(const CoapEndpoint& endpoint) const {
+        return static_cast<size_t>(endpoint.hash());
+    }
+};
+
+struct ChunkResult {
+    uint64_t records;
+    uint64_t udpDatagrams;
+    uint64_t parseErrors;
+    std::unordered_map<CoapEndpoint, Stats, EndpointHash> endpoints;
+    std::unordered_map<std::string, Stats> resources;
+
+    ChunkResult() : records(0), udpDatagrams(0), parseErrors(0) {}
+};
+
+/**
+ * Datagrams of one batch with their sender and timestamp
+ */
+struct PendingBatch {
+    std::vector<const uint8_t*> datagrams;
+    std::vector<size_t> lengths;
+    std::vector<CoapEndpoint> senders;
+    std::vector<uint64_t> timestamps;
+};
+
+uint32_t read32(const uint8_t* p, bool swapped) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    if (swapped) {
+        value = ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) |
+                ((value >> 8) & 0xFF00) | (value >> 24);
+    }
+    return value;
+}
+
+uint16_t readBe16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+bool openCapture(const char* path, Capture& capture) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        std::perror(path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 24) {
+        std::fprintf(stderr, "%s: not a pcap file\n", path);
+        close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::perror("mmap");
+        return false;
+    }
+    madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    capture.data = static_cast<const uint8_t*>(mapped);
+    capture.size = static_cast<size_t>(st.st_size);
+
+    uint32_t magic;
+    std::memcpy(&magic, capture.data, 4);
+    switch (magic) {
+        case 0xA1B2C3D4: capture.swapped = false; capture.nanoseconds = false; break;
+        case 0xD4C3B2A1: capture.swapped = true;  capture.nanoseconds = false; break;
+        case 0xA1B23C4D: capture.swapped = false; capture.nanoseconds = true;  break;
+        case 0x4D3CB2A1: capture.swapped = true;  capture.nanoseconds = true;  break;
+        default:
+            std::fprintf(stderr, "%s: unsupported capture format (pcapng is not supported)\n", path);
+            return false;
+    }
+    capture.snapLength = read32(capture.data + 16, capture.swapped);
+    capture.linkType = read32(capture.data + 20, capture.swapped) & 0x0FFFFFFF;
+    return true;
+}
+
+/**
+ * Check that a plausible chain of record headers starts at offset
+ */
+bool isRecordBoundary(const Capture& capture, size_t offset) {
+    uint32_t snap = capture.snapLength > 0 ? capture.snapLength : 262144;
+    uint32_t maxFraction = capture.nanoseconds ? 1000000000u : 1000000u;
+    for (int i = 0; i < RESYNC_RECORDS; i++) {
+        if (offset == capture.size) {
+            return true;
+        }
+        if (offset + 16 > capture.size) {
+            return false;
+        }
+        const uint8_t* header = capture.data + offset;
+        uint32_t fraction = read32(header + 4, capture.swapped);
+        uint32_t captured = read32(header + 8, capture.swapped);
+        uint32_t original = read32(header + 12, capture.swapped);
+        if (fraction >= maxFraction || captured > snap || captured > original ||
+            offset + 16 + captured > capture.size) {
+            return false;
+        }
+        offset += 16 + captured;
+    }
+    return true;
+}
+
+/**
+ * Split the records into count chunks; returns count + 1 boundaries
+ */
+std::vector<size_t> splitCapture(const Capture& capture, unsigned count) {
+    std::vector<size_t> bounds(1, 24);
+    size_t span = (capture.size - 24) / count;
+    for (unsigned i = 1; i < count; i++) {
+        size_t offset = std::max(bounds.back(), 24 + span * i);
+        while (offset < capture.size && !isRecordBoundary(capture, offset)) {
+            offset++;
+        }
+        bounds.push_back(offset);
+    }
+    bounds.push_back(capture.size);
+    return bounds;
+}
+
+/**
+ * Extract the UDP payload of a captured frame
+ */
+bool decodeUdp(const Capture& capture, const uint8_t* frame, size_t length,
+               CoapEndpoint& sender, const uint8_t*& payload, size_t& payloadLength) {
+    size_t offset = 0;
+    uint16_t etherType = 0;
+
+    switch (capture.linkType) {
+        case LINKTYPE_ETHERNET:
+            if (length < 14) return false;
+            etherType = readBe16(frame + 12);
+            offset = 14;
+            while ((etherType == 0x8100 || etherType == 0x88A8) && offset + 4 <= length) {
+                etherType = readBe16(frame + offset + 2);
+                offset += 4;
+            }
+            break;
+        case LINKTYPE_LINUX_SLL:
+            if (length < 16) return false;
+            etherType = readBe16(frame + 14);
+            offset = 16;
+            break;
+        case LINKTYPE_LINUX_SLL2:
+            if (length < 20) return false;
+            etherType = readBe16(frame);
+            offset = 20;
+            break;
+        case LINKTYPE_NULL: {
+            if (length < 4) return false;
+            uint32_t family;
+            std::memcpy(&family, frame, 4);
+            if (family > 0xFFFF) {
+                family = read32(frame, true);
+            }
+            etherType = (family == 2) ? 0x0800 : (family == 24 || family == 28 || family == 30) ? 0x86DD : 0;
+            offset = 4;
+            break;
+        }
+        case LINKTYPE_RAW:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            if (length < 1) return false;
+            etherType = ((frame[0] >> 4) == 6) ? 0x86DD : 0x0800;
+            break;
+        default:
+            return false;
+    }
+
+    const uint8_t* ip = frame + offset;
+    size_t ipLength = length - offset;
+    const uint8_t* udp = nullptr;
+    size_t udpLength = 0;
+    sender = CoapEndpoint();
+
+    if (etherType == 0x0800) {
+        if (ipLength < 20 || (ip[0] >> 4) != 4) return false;
+        size_t headerLength = (ip[0] & 0x0F) * 4u;
+        size_t totalLength = readBe16(ip + 2);
+        // Fragments (other than unfragmented datagrams) are skipped
+        if (ip[9] != 17 || (readBe16(ip + 6) & 0x3FFF) != 0 ||
+            headerLength < 20 || totalLength < headerLength || totalLength > ipLength) {
+            return false;
+        }
+        udp = ip + headerLength;
+        udpLength = totalLength - headerLength;
+        sender.setRemoteIPv4(ip + 12, 0);
+        sender.setLocalIPv4(ip + 16, 0);
+    } else if (etherType == 0x86DD) {
+        if (ipLength < 40 || (ip[0] >> 4) != 6 || ip[6] != 17) return false;
+        size_t payloadLen = readBe16(ip + 4);
+        if (40 + payloadLen > ipLength) return false;
+        udp = ip + 40;
+        udpLength = payloadLen;
+        std::memcpy(sender.remoteAddress, ip + 8, 16);
+        std::memcpy(sender.localAddress, ip + 24, 16);
+    } else {
+        return false;
+    }
+
+    if (udpLength < 8) return false;
+    size_t datagramLength = readBe16(udp + 4);
+    if (datagramLength < 8 || datagramLength > udpLength) return false;
+
+    sender.remotePort = readBe16(udp);
+    sender.localPort = readBe16(udp + 2);
+    payload = udp + 8;
+    payloadLength = datagramLength - 8;
+    return true;
+}
+
+bool isCoapPort(const Options& options, const CoapEndpoint& endpoint) {
+    if (options.allUdp) {
+        return true;
+    }
+    for (uint16_t port : options.ports) {
+        if (endpoint.remotePort == port || endpoint.localPort == port) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Statistics state of one worker thread
+ */
+class ChunkAnalyser {
+public:
+    explicit ChunkAnalyser(ChunkResult& result) : result_(result) {
+        batch_.reserve(BATCH_SIZE, BATCH_SIZE * 4);
+    }
+
+    void add(const CoapEndpoint& sender, uint64_t timestamp, const uint8_t* datagram, size_t length) {
+        pending_.datagrams.push_back(datagram);
+        pending_.lengths.push_back(length);
+        pending_.senders.push_back(sender);
+        pending_.timestamps.push_back(timestamp);
+        if (pending_.datagrams.size() == BATCH_SIZE) {
+            flush();
+        }
+    }
+
+    void flush() {
+        size_t count = pending_.datagrams.size();
+        if (count == 0) {
+            return;
+        }
+
+        batch_.clear();
+        CoapParser::parseBatch(pending_.datagrams.data(), pending_.lengths.data(), count, batch_);
+
+        const uint8_t* codes = batch_.getCodes();
+        const uint8_t* types = batch_.getTypes();
+        const uint16_t* messageIds = batch_.getMessageIds();
+        const uint32_t* payloadLengths = batch_.getPayloadLengths();
+        const int32_t* optionOffsets = batch_.getOptionOffsets();
+        const uint16_t* optionNumbers = batch_.getOptionNumbers();
+        const uint32_t* valueOffsets = batch_.getOptionValueOffsets();
+        const uint16_t* valueLengths = batch_.getOptionValueLengths();
+
+        for (size_t i = 0; i < count; i++) {
+            if (!batch_.isValid(i)) {
+                result_.parseErrors++;
+                continue;
+            }
+
+            // Per sender: only the source address/port identify it
+            CoapEndpoint sender = pending_.senders[i];
+            std::memset(sender.localAddress, 0, sizeof(sender.localAddress));
+            sender.localPort = 0;
+
+            bool retransmit = false;
+            if (types[i] == static_cast<uint8_t>(CoapType::CON)) {
+                retransmit = isRetransmit(sender, messageIds[i], pending_.timestamps[i]);
+            }
+            result_.endpoints[sender].add(codes[i], payloadLengths[i], retransmit);
+
+            // Per resource: requests only, keyed by Uri-Path
+            uint8_t codeClass = codes[i] >> 5;
+            if (codeClass != 0 || codes[i] == 0) {
+                continue;
+            }
+            path_.clear();
+            for (int32_t o = optionOffsets[i]; o < optionOffsets[i + 1]; o++) {
+                if (optionNumbers[o] == static_cast<uint16_t>(CoapOptionNumber::URI_PATH)) {
+                    path_.push_back('/');
+                    path_.append(reinterpret_cast<const char*>(pending_.datagrams[i] + valueOffsets[o]),
+                                 valueLengths[o]);
+                }
+            }
+            if (path_.empty()) {
+                path_ = "/";
+            }
+            result_.resources[path_].add(codes[i], payloadLengths[i], retransmit);
+        }
+
+        pending_.datagrams.clear();
+        pending_.lengths.clear();
+        pending_.senders.clear();
+        pending_.timestamps.clear();
+    }
+
+private:
+    ChunkResult& result_;
+    PendingBatch pending_;
+    CoapPacketBatch batch_;
+    std::string path_;
+    std::unordered_map<CoapEndpoint, std::unordered_map<uint16_t, uint64_t>, EndpointHash> lastSeen_;
+
+    bool isRetransmit(const CoapEndpoint& sender, uint16_t messageId, uint64_t timestamp) {
+        std::unordered_map<uint16_t, uint64_t>& seen = lastSeen_[sender];
+        std::unordered_map<uint16_t, uint64_t>::iterator it = seen.find(messageId);
+        bool retransmit = it != seen.end() && timestamp - it->second <= RETRANSMIT_WINDOW_NS;
+        seen[messageId] = timestamp;
+        return retransmit;
+    }
+};
+
+void analyseChunk(const Capture& capture, const Options& options, size_t begin, size_t end,
+                  ChunkResult& result) {
+    ChunkAnalyser analyser(result);
+    size_t offset = begin;
+    while (offset + 16 <= end) {
+        const uint8_t* header = capture.data + offset;
+        uint64_t seconds = read32(header, capture.swapped);
+        uint64_t fraction = read32(header + 4, capture.swapped);
+        uint32_t captured = read32(header + 8, capture.swapped);
+        if (offset + 16 + captured > capture.size) {
+            break;
+        }
+        uint64_t timestamp = seconds * 1000000000ULL + (capture.nanoseconds ? fraction : fraction * 1000);
+
+        result.records++;
+        CoapEndpoint sender;
+        const uint8_t* datagram = nullptr;
+        size_t length = 0;
+        if (decodeUdp(capture, header + 16, captured, sender, datagram, length) &&
+            isCoapPort(options, sender)) {
+            result.udpDatagrams++;
+            analyser.add(sender, timestamp, datagram, length);
+        }
+        offset += 16 + captured;
+    }
+    analyser.flush();
+}
+
+std::string formatEndpoint(const CoapEndpoint& endpoint) {
+    static const uint8_t mappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+    char address[INET6_ADDRSTRLEN];
+    if (std::memcmp(endpoint.remoteAddress, mappedPrefix, 12) == 0) {
+        inet_ntop(AF_INET, endpoint.remoteAddress + 12, address, sizeof(address));
+        return std::string(address) + ":" + std::to_string(endpoint.remotePort);
+    }
+    inet_ntop(AF_INET6, endpoint.remoteAddress, address, sizeof(address));
+    return "[" + std::string(address) + "]:" + std::to_string(endpoint.remotePort);
+}
+
+std::string formatCodes(const Stats& stats) {
+    // Most frequent codes first, at most four
+    std::vector<std::pair<uint64_t, int>> codes;
+    for (int code = 0; code < 256; code++) {
+        if (stats.codes[code] > 0) {
+            codes.push_back(std::make_pair(stats.codes[code], code));
+        }
+    }
+    std::sort(codes.rbegin(), codes.rend());
+    std::string text;
+    for (size_t i = 0; i < codes.size() && i < 4; i++) {
+        char entry[32];
+        std::snprintf(entry, sizeof(entry), "%s%d.%02d:%llu", i > 0 ? " " : "",
+                      codes[i].second >> 5, codes[i].second & 0x1F,
+                      static_cast<unsigned long long>(codes[i].first));
+        text += entry;
+    }
+    return text;
+}
+
+void printRow(const std::string& key, const Stats& stats) {
+    double retransmitRatio = stats.messages > 0 ? static_cast<double>(stats.retransmits) / stats.messages : 0.0;
+    double payloadMean = stats.messages > 0 ? static_cast<double>(stats.payloadBytes) / stats.messages : 0.0;
+    std::printf("  %-40s %10llu %8.4f %9.1f %8llu  %s\n", key.c_str(),
+                static_cast<unsigned long long>(stats.messages), retransmitRatio, payloadMean,
+                static_cast<unsigned long long>(stats.payloadMax), formatCodes(stats).c_str());
+}
+
+template <typename Map, typename Format>
+void printTop(const char* title, const Map& map, size_t top, Format format) {
+    std::vector<std::pair<uint64_t, typename Map::const_iterator>> rows;
+    for (typename Map::const_iterator it = map.begin(); it != map.end(); ++it) {
+        rows.push_back(std::make_pair(it->second.messages, it));
+    }
+    std::sort(rows.begin(), rows.end(),
+              [](const std::pair<uint64_t, typename Map::const_iterator>& a,
+                 const std::pair<uint64_t, typename Map::const_iterator>& b) {
+                  return a.first > b.first;
+              });
+
+    std::printf("\n%s (%zu total, top %zu)\n", title, map.size(), std::min(top, rows.size()));
+    std::printf("  %-40s %10s %8s %9s %8s  %s\n", "key", "messages", "retx", "payload", "max", "codes");
+    for (size_t i = 0; i < rows.size() && i < top; i++) {
+        printRow(format(rows[i].second->first), rows[i].second->second);
+    }
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.ports.push_back(static_cast<uint16_t>(std::atoi(argv[++i])));
+        } else if (arg == "--all-udp") {
+            options.allUdp = true;
+        } else if (arg == "--top" && i + 1 < argc) {
+            options.top = static_cast<size_t>(std::atoi(argv[++i]));
+        } else if (arg[0] != '-' && options.path == nullptr) {
+            options.path = argv[i];
+        } else {
+            return false;
+        }
+    }
+    if (options.ports.empty()) {
+        options.ports.push_back(5683);
+        options.ports.push_back(5684);
+    }
+    if (options.threads == 0) {
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return options.path != nullptr;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--threads N] [--port P]... [--all-udp] [--top N] capture.pcap\n",
+                     argv[0]);
+        return 2;
+    }
+
+    Capture capture;
+    if (!openCapture(options.path, capture)) {
+        return 1;
+    }
+
+    std::vector<size_t> bounds = splitCapture(capture, options.threads);
+    std::vector<ChunkResult> results(options.threads);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < options.threads; i++) {
+        workers.push_back(std::thread(analyseChunk, std::cref(capture), std::cref(options),
+                                      bounds[i], bounds[i + 1], std::ref(results[i])));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Merge per-thread results
+    ChunkResult total;
+    for (const auto& result : results) {
+        total.records += result.records;
+        total.udpDatagrams += result.udpDatagrams;
+        total.parseErrors += result.parseErrors;
+        for (const auto& entry : result.endpoints) {
+            total.endpoints[entry.first].merge(entry.second);
+        }
+        for (const auto& entry : result.resources) {
+            total.resources[entry.first].merge(entry.second);
+        }
+    }
+
+    Stats all;
+    for (const auto& entry : total.endpoints) {
+        all.merge(entry.second);
+    }
+
+    std::printf("records: %llu  udp datagrams: %llu  coap messages: %llu  parse errors: %llu  threads: %u\n",
+                static_cast<unsigned long long>(total.records),
+                static_cast<unsigned long long>(total.udpDatagrams),
+                static_cast<unsigned long long>(all.messages),
+                static_cast<unsigned long long>(total.parseErrors), options.threads);
+    std::printf("\nall messages\n");
+    printRow("*", all);
+    printTop("endpoints", total.endpoints, options.top, formatEndpoint);
+    printTop("resources (requests)", total.resources, options.top,
+             [](const std::string& path) { return path; });
+
+    munmap(const_cast<uint8_t*>(capture.data), capture.size);
+    return 0;
+}
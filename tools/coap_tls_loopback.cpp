@@ -0,0 +1,390 @@
+// CoAP over TLS loopback test
+//
+// Generates a self-signed certificate for "localhost", then runs a server
+// and a client over 127.0.0.1 with CoapOpenSslTlsEngine. The client
+// verifies the certificate and host name, then sends --count CoAP
+// requests (RFC 8323 framing) split across writes at random points. The
+// server parses them with CoapStreamDecoder straight from the stream and
+// answers each with a 2.05 echoing its token and payload; the client
+// checks every reply and ends with close_notify.
+//
+// The exchange runs once through the engines' read and write paths and
+// once per AES-GCM cipher suite with kernel TLS enabled on both sockets
+// by enableKernelOffload(), reading from CoapFdStream. The server's
+// session tickets then reach the client's kernel and must be skipped.
+// The kernel TLS rounds are reported as skipped when the kernel has no
+// "tls" ULP. Exits 0 when all checks pass.
+//
+// Build:
+//   c++ -std=c++11 -O2 -pthread -DCOAP_PACKET_WITH_OPENSSL=1 -Isrc -o coap-tls-loopback
+//       tools/coap_tls_loopback.cpp src/CoapPacketUnity.cpp -lssl -lcrypto
+//
+// Usage:
+//   coap-tls-loopback [--count N] [--seed S]
+
+#include "CoapBuilder.h"
+#include "CoapOpenSsl.h"
+#include "CoapStreamDecoder.h"
+#include "CoapTcpCodec.h"
+
+#if !COAP_PACKET_WITH_OPENSSL
+#error "build with -DCOAP_PACKET_WITH_OPENSSL=1"
+#endif
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/x509v3.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace CoapPacket;
+
+namespace {
+
+struct Options {
+    size_t count;
+    uint64_t seed;
+
+    Options() : count(200), seed(1) {}
+};
+
+// Requests sent before the client waits for their responses
+const size_t WINDOW = 8;
+
+uint64_t nextRandom(uint64_t& state) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return state >> 33;
+}
+
+bool check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+    }
+    return condition;
+}
+
+/**
+ * Self-signed P-256 certificate for "localhost", valid for a day
+ */
+bool makeCertificate(EVP_PKEY*& key, X509*& certificate) {
+    key = EVP_EC_gen("P-256");
+    certificate = X509_new();
+    if (key == nullptr || certificate == nullptr) {
+        return false;
+    }
+    X509_set_version(certificate, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certificate), -60);
+    X509_gmtime_adj(X509_getm_notAfter(certificate), 24 * 3600);
+    X509_NAME* name = X509_get_subject_name(certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1,
+                               -1, 0);
+    X509_set_issuer_name(certificate, name);
+    X509_set_pubkey(certificate, key);
+
+    X509V3_CTX context;
+    X509V3_set_ctx_nodb(&context);
+    X509V3_set_ctx(&context, certificate, certificate, nullptr, nullptr, 0);
+    X509_EXTENSION* altName = X509V3_EXT_conf_nid(nullptr, &context, NID_subject_alt_name, "DNS:localhost");
+    bool ok = altName != nullptr && X509_add_ext(certificate, altName, -1) == 1 &&
+              X509_sign(certificate, key, EVP_sha256()) > 0;
+    X509_EXTENSION_free(altName);
+    return ok;
+}
+
+/**
+ * True if the kernel can attach the "tls" ULP to a connected TCP socket
+ */
+bool kernelTlsAvailable() {
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    bool available = listener >= 0 && fd >= 0 &&
+                     ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+                     ::listen(listener, 1) == 0 &&
+                     ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressLength) == 0 &&
+                     ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+                     ::setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+    ::close(fd);
+    ::close(listener);
+    return available;
+}
+
+bool writeAll(CoapByteStream& stream, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t sent = 0;
+        if (stream.write(data, length, sent) != CoapError::OK || sent == 0) {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+/**
+ * Send a close_notify alert on a kernel TLS socket (TLS_SET_RECORD_TYPE)
+ */
+bool sendCloseNotify(int fd) {
+    const int solTls = 282;
+    const int setRecordType = 1;
+    uint8_t alert[2] = {1, 0};  // warning, close_notify
+    union {
+        char buffer[CMSG_SPACE(sizeof(uint8_t))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov;
+    iov.iov_base = alert;
+    iov.iov_len = sizeof(alert);
+    struct msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = solTls;
+    cmsg->cmsg_type = setRecordType;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint8_t));
+    *CMSG_DATA(cmsg) = 21;  // Alert record
+    return ::sendmsg(fd, &message, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(alert));
+}
+
+struct ServerStats {
+    size_t requests;
+    bool handshake;
+    bool offloaded;
+    bool closed;
+
+    ServerStats() : requests(0), handshake(false), offloaded(false), closed(false) {}
+};
+
+void runServer(int listener, CoapOpenSslContext& context, bool kernel, ServerStats& stats) {
+    int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+        return;
+    }
+
+    CoapOpenSslTlsEngine engine(context, fd);
+    bool done = false;
+    while (!done && engine.handshake(done) == CoapError::OK) {
+    }
+    stats.handshake = done;
+    if (done && kernel) {
+        stats.offloaded = engine.enableKernelOffload();
+    }
+    // After offload the socket yields plaintext; read it without the engine
+    CoapByteStream& stream = stats.offloaded ? static_cast<CoapByteStream&>(engine.getFdStream())
+                                             : static_cast<CoapByteStream&>(engine);
+
+    CoapStreamDecoder decoder;
+    std::vector<uint8_t> out;
+    while (done) {
+        size_t received = 0;
+        if (decoder.fill(stream, received) != CoapError::OK) {
+            break;
+        }
+        if (received == 0 && (stats.offloaded ? engine.getFdStream().isClosed() : engine.isClosed())) {
+            stats.closed = decoder.getBuffered() == 0;
+            break;
+        }
+
+        CoapPacketView view;
+        while (decoder.next(view) == CoapError::OK) {
+            stats.requests++;
+            CoapPacket::CoapPacket response;
+            CoapBuilder builder;
+            builder.setCode(CoapCode::CONTENT_2_05)
+                .setToken(view.token, view.token_length)
+                .setPayload(view.payload, view.payload_length)
+                .build(response);
+            if (CoapTcpCodec::serialize(response, out) != CoapError::OK || !writeAll(stream, out.data(), out.size())) {
+                done = false;
+                break;
+            }
+        }
+    }
+    ::close(fd);
+}
+
+bool runClient(uint16_t port, CoapOpenSslContext& context, bool kernel, const Options& options, bool& offloaded) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (!check(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0, "connect")) {
+        ::close(fd);
+        return false;
+    }
+
+    CoapOpenSslTlsEngine engine(context, fd, "localhost");
+    bool done = false;
+    while (!done && engine.handshake(done) == CoapError::OK) {
+    }
+    if (!check(done, "client handshake")) {
+        ::close(fd);
+        return false;
+    }
+    offloaded = kernel && engine.enableKernelOffload();
+    CoapByteStream& stream = offloaded ? static_cast<CoapByteStream&>(engine.getFdStream())
+                                       : static_cast<CoapByteStream&>(engine);
+
+    uint64_t state = options.seed;
+    CoapStreamDecoder decoder;
+    std::vector<uint8_t> message;
+    std::vector<uint8_t> window;
+    std::vector<std::string> sent;
+    size_t responses = 0;
+    bool ok = true;
+    while (ok && responses < options.count) {
+        window.clear();
+        for (size_t i = sent.size(); i < options.count && i < responses + WINDOW; i++) {
+            uint8_t token[4] = {static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 0xC0, 0xAB};
+            std::string body(static_cast<size_t>(nextRandom(state) % 1000), static_cast<char>('a' + i % 26));
+            sent.push_back(body);
+
+            CoapPacket::CoapPacket request;
+            CoapBuilder builder;
+            builder.setCode(CoapCode::POST).setToken(token, sizeof(token)).setUriPath("/echo");
+            if (!body.empty()) {
+                builder.setPayload(body);
+            }
+            builder.build(request);
+            CoapTcpCodec::serialize(request, message);
+            window.insert(window.end(), message.begin(), message.end());
+        }
+        // Split so the server sees partial messages
+        size_t split = static_cast<size_t>(nextRandom(state) % (window.size() + 1));
+        ok = check(writeAll(stream, window.data(), split) &&
+                   writeAll(stream, window.data() + split, window.size() - split), "write requests");
+
+        while (ok && responses < sent.size()) {
+            size_t received = 0;
+            ok = check(decoder.fill(stream, received) == CoapError::OK, "read responses") &&
+                 check(received > 0, "connection open");
+            CoapPacketView view;
+            while (ok && decoder.next(view) == CoapError::OK) {
+                size_t index = static_cast<size_t>(view.token[0]) | (static_cast<size_t>(view.token[1]) << 8);
+                ok = check(view.code == CoapCode::CONTENT_2_05, "response code") &&
+                     check(index == responses, "responses in order") &&
+                     check(std::string(reinterpret_cast<const char*>(view.payload), view.payload_length) ==
+                           sent[index], "echoed payload");
+                responses++;
+            }
+        }
+    }
+
+    if (offloaded) {
+        ok = check(sendCloseNotify(fd), "close_notify") && ok;
+    } else {
+        ok = check(SSL_shutdown(engine.getNative()) >= 0, "close_notify") && ok;
+    }
+    ::close(fd);
+    return ok && check(responses == options.count, "all requests answered");
+}
+
+/**
+ * Run one exchange; suites selects the TLS 1.3 cipher suites (nullptr for the default)
+ */
+bool runRound(const char* label, CoapOpenSslContext& server, X509* certificate,
+              const char* suites, bool kernel, const Options& options) {
+    CoapOpenSslContext client(false);
+    SSL_CTX* native = client.getNative();
+    if (!check(native != nullptr && X509_STORE_add_cert(SSL_CTX_get_cert_store(native), certificate) == 1,
+               "trust certificate")) {
+        return false;
+    }
+    SSL_CTX_set_verify(native, SSL_VERIFY_PEER, nullptr);
+    if (suites != nullptr) {
+        SSL_CTX_set_ciphersuites(native, suites);
+    }
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, 1) != 0 ||
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0) {
+        std::perror("listen");
+        return false;
+    }
+
+    ServerStats stats;
+    bool offloaded = false;
+    std::thread thread(runServer, listener, std::ref(server), kernel, std::ref(stats));
+    bool ok = runClient(ntohs(address.sin_port), client, kernel, options, offloaded);
+    thread.join();
+    ::close(listener);
+
+    ok = check(stats.handshake, "server handshake") && check(stats.requests == options.count, "server requests") &&
+         check(stats.closed, "close_notify seen") && ok;
+    if (kernel) {
+        ok = check(offloaded, "client kernel offload") && check(stats.offloaded, "server kernel offload") && ok;
+    }
+    std::printf("%s: requests %zu: %s\n", label, stats.requests, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            options.count = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = static_cast<uint64_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return options.count > 0 && options.count <= 65536;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--count N] [--seed S]\n", argv[0]);
+        return 2;
+    }
+
+    EVP_PKEY* key = nullptr;
+    X509* certificate = nullptr;
+    CoapOpenSslContext server(true);
+    if (!check(makeCertificate(key, certificate), "self-signed certificate") ||
+        !check(SSL_CTX_use_certificate(server.getNative(), certificate) == 1 &&
+               SSL_CTX_use_PrivateKey(server.getNative(), key) == 1, "server certificate")) {
+        return 1;
+    }
+
+    bool ok = runRound("engine", server, certificate, nullptr, false, options);
+    if (kernelTlsAvailable()) {
+        ok = runRound("kernel TLS, TLS_AES_128_GCM_SHA256", server, certificate, "TLS_AES_128_GCM_SHA256",
+                      true, options) && ok;
+        ok = runRound("kernel TLS, TLS_AES_256_GCM_SHA384", server, certificate, "TLS_AES_256_GCM_SHA384",
+                      true, options) && ok;
+    } else {
+        std::printf("kernel TLS: skipped (no \"tls\" ULP in this kernel)\n");
+    }
+
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+// Token matching benchmark
+//
+// Compares the 64-bit token keys of CoapToken.h with byte-wise handling:
+// equality of two tokens (byte loop vs tokenEquals), building a key from a
+// CoapPacket (getTokenKey, including the length mask) and exchange lookup
+// (std::map keyed by std::vector<uint8_t> vs std::unordered_map keyed by
+// CoapTokenKey). Tokens are random, half 4 and half 8 bytes long.
+//
+// Build:
+//   c++ -std=c++11 -O2 -Isrc -o coap-token-bench
+//       tools/coap_token_bench.cpp src/CoapPacketUnity.cpp
+//
+// Usage:
+//   coap-token-bench [--count N] [--rounds R] [--seed S]
+
+#include "CoapPacket.h"
+#include "CoapToken.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace CoapPacket;
+
+namespace {
+
+struct Options {
+    size_t count;
+    size_t rounds;
+    uint64_t seed;
+
+    Options() : count(1000000), rounds(5), seed(1) {}
+};
+
+struct Token {
+    uint8_t bytes[8];
+    uint8_t length;
+};
+
+uint64_t nextRandom(uint64_t& state) {
+    state += 0x9E3779B97F4A7C15ull;
+    return hashToken(state, 8);
+}
+
+std::vector<Token> makeTokens(const Options& options) {
+    uint64_t state = options.seed;
+    std::vector<Token> tokens(options.count);
+    for (Token& token : tokens) {
+        uint64_t value = nextRandom(state);
+        std::memcpy(token.bytes, &value, sizeof(value));
+        token.length = (value >> 63) ? 8 : 4;
+    }
+    return tokens;
+}
+
+double nowNs() {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void printRow(const char* name, double nanoseconds, size_t operations, uint64_t check) {
+    std::printf("%-40s %10.2f ns/op   (check %llu)\n", name, nanoseconds / static_cast<double>(operations),
+                static_cast<unsigned long long>(check));
+}
+
+bool byteEquals(const Token& a, const Token& b) {
+    if (a.length != b.length) {
+        return false;
+    }
+    for (uint8_t i = 0; i < a.length; i++) {
+        if (a.bytes[i] != b.bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Each token is compared with its successor and with a copy of itself, so
+// half the comparisons match
+void benchCompare(const std::vector<Token>& tokens, const Options& options) {
+    size_t n = tokens.size();
+    std::vector<Token> copies(tokens);
+    uint64_t matches = 0;
+    double start = nowNs();
+    for (size_t round = 0; round < options.rounds; round++) {
+        for (size_t i = 0; i < n; i++) {
+            const Token& next = tokens[(i + 1) % n];
+            matches += byteEquals(tokens[i], next) + byteEquals(tokens[i], copies[i]);
+        }
+    }
+    printRow("compare: byte loop", nowNs() - start, 2 * n * options.rounds, matches);
+
+    matches = 0;
+    start = nowNs();
+    for (size_t round = 0; round < options.rounds; round++) {
+        for (size_t i = 0; i < n; i++) {
+            const Token& a = tokens[i];
+            const Token& next = tokens[(i + 1) % n];
+            const Token& copy = copies[i];
+            matches += tokenEquals(a.bytes, a.length, next.bytes, next.length) +
+                       tokenEquals(a.bytes, a.length, copy.bytes, copy.length);
+        }
+    }
+    printRow("compare: tokenEquals", nowNs() - start, 2 * n * options.rounds, matches);
+}
+
+void benchPacketKey(const std::vector<Token>& tokens, const Options& options) {
+    size_t n = tokens.size() < 4096 ? tokens.size() : 4096;
+    std::vector<CoapPacket::CoapPacket> packets(n);
+    for (size_t i = 0; i < n; i++) {
+        packets[i].setToken(tokens[i].bytes, tokens[i].length);
+    }
+    uint64_t sum = 0;
+    size_t operations = options.rounds * 1000 * n;
+    double start = nowNs();
+    for (size_t round = 0; round < options.rounds * 1000; round++) {
+        for (const CoapPacket::CoapPacket& packet : packets) {
+            CoapTokenKey key = packet.getTokenKey();
+            sum += key.value ^ key.length;
+        }
+    }
+    printRow("CoapPacket::getTokenKey", nowNs() - start, operations, sum & 0xFFFF);
+}
+
+void benchLookup(const std::vector<Token>& tokens, const Options& options) {
+    std::map<std::vector<uint8_t>, uint32_t> byteMap;
+    std::unordered_map<CoapTokenKey, uint32_t, CoapTokenKeyHash> keyMap;
+    keyMap.reserve(tokens.size());
+    for (size_t i = 0; i < tokens.size(); i++) {
+        const Token& token = tokens[i];
+        byteMap[std::vector<uint8_t>(token.bytes, token.bytes + token.length)] = static_cast<uint32_t>(i);
+        keyMap[CoapTokenKey(loadToken(token.bytes, token.length), token.length)] = static_cast<uint32_t>(i);
+    }
+
+    // Probe in a shuffled order so lookups miss the cache as a server's would
+    std::vector<uint32_t> order(tokens.size());
+    uint64_t state = options.seed ^ 0xABCDEF;
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    for (size_t i = order.size(); i > 1; i--) {
+        std::swap(order[i - 1], order[nextRandom(state) % i]);
+    }
+
+    // A received message carries its token as bytes, so both probes start from them
+    uint64_t sum = 0;
+    double start = nowNs();
+    for (uint32_t i : order) {
+        const Token& token = tokens[i];
+        sum += byteMap.find(std::vector<uint8_t>(token.bytes, token.bytes + token.length))->second;
+    }
+    printRow("lookup: std::map<std::vector<uint8_t>>", nowNs() - start, order.size(), sum);
+
+    sum = 0;
+    start = nowNs();
+    for (uint32_t i : order) {
+        const Token& token = tokens[i];
+        sum += keyMap.find(CoapTokenKey(loadToken(token.bytes, token.length), token.length))->second;
+    }
+    printRow("lookup: unordered_map<CoapTokenKey>", nowNs() - start, order.size(), sum);
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            options.count = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            options.rounds = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = static_cast<uint64_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return options.count > 1 && options.rounds > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--count N] [--rounds R] [--seed S]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<Token> tokens = makeTokens(options);
+    benchCompare(tokens, options);
+    benchPacketKey(tokens, options);
+    benchLookup(tokens, options);
+    return 0;
+}
@@ -0,0 +1,455 @@
+// CoAP over WebSockets loopback test
+//
+// Runs a server and a client over 127.0.0.1. The client performs the HTTP
+// upgrade (RFC 6455 section 4, subprotocol "coap", RFC 8323 section 4),
+// then sends --count masked CoAP requests, split across writes at random
+// points, with a text frame, a ping and finally a close frame mixed in.
+// The server parses frames with CoapWebSocket::parseMessage(), skips the
+// text frame using consumed, answers each request with a 2.05 echoing its
+// token and payload, answers the ping with a pong and the close with a
+// close. The client checks every reply. Exits 0 when all checks pass.
+//
+// Build:
+//   c++ -std=c++11 -O2 -pthread -Isrc -o coap-ws-loopback
+//       tools/coap_ws_loopback.cpp src/CoapPacketUnity.cpp
+//
+// Usage:
+//   coap-ws-loopback [--count N] [--seed S]
+
+#include "CoapBuilder.h"
+#include "CoapWebSocket.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace CoapPacket;
+
+namespace {
+
+struct Options {
+    size_t count;
+    uint64_t seed;
+
+    Options() : count(200), seed(1) {}
+};
+
+// RFC 6455 section 1.3
+const char WEBSOCKET_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+/**
+ * SHA-1 (RFC 3174), only used for Sec-WebSocket-Accept
+ */
+void sha1(const std::string& message, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::vector<uint8_t> data(message.begin(), message.end());
+    uint64_t bitLength = static_cast<uint64_t>(data.size()) * 8;
+    data.push_back(0x80);
+    while (data.size() % 64 != 56) {
+        data.push_back(0);
+    }
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        data.push_back(static_cast<uint8_t>(bitLength >> shift));
+    }
+
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t* p = &data[block + i * 4];
+            w[i] = (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotateLeft(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) {
+        digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+std::string base64(const uint8_t* data, size_t length) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t chunk = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < length) {
+            chunk |= static_cast<uint32_t>(data[i + 1]) << 8;
+        }
+        if (i + 2 < length) {
+            chunk |= data[i + 2];
+        }
+        out.push_back(alphabet[(chunk >> 18) & 0x3F]);
+        out.push_back(alphabet[(chunk >> 12) & 0x3F]);
+        out.push_back(i + 1 < length ? alphabet[(chunk >> 6) & 0x3F] : '=');
+        out.push_back(i + 2 < length ? alphabet[chunk & 0x3F] : '=');
+    }
+    return out;
+}
+
+std::string acceptKey(const std::string& key) {
+    uint8_t digest[20];
+    sha1(key + WEBSOCKET_GUID, digest);
+    return base64(digest, sizeof(digest));
+}
+
+uint64_t nextRandom(uint64_t& state) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return state >> 33;
+}
+
+bool sendAll(int fd, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool sendAll(int fd, const std::string& text) {
+    return sendAll(fd, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+/**
+ * Read the HTTP head (up to and including the blank line)
+ */
+bool readHead(int fd, std::string& head) {
+    char c;
+    while (head.size() < 4096) {
+        if (::recv(fd, &c, 1, 0) != 1) {
+            return false;
+        }
+        head.push_back(c);
+        if (head.size() >= 4 && head.compare(head.size() - 4, 4, "\r\n\r\n") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string headerValue(const std::string& head, const std::string& name) {
+    size_t pos = head.find("\r\n" + name + ": ");
+    if (pos == std::string::npos) {
+        return std::string();
+    }
+    pos += name.size() + 4;
+    return head.substr(pos, head.find("\r\n", pos) - pos);
+}
+
+/**
+ * Frame reader over a socket: parses frames in place, keeps partial ones
+ */
+class FrameReader {
+public:
+    explicit FrameReader(int fd) : fd_(fd), start_(0) {}
+
+    /**
+     * Returns the parse result of the next frame; TRANSPORT_ERROR when the
+     * connection closes first
+     */
+    CoapError next(CoapWebSocketFrame& frame, CoapPacketView& view, const uint8_t*& payload) {
+        for (;;) {
+            if (start_ > 0 && start_ == buffer_.size()) {
+                buffer_.clear();
+                start_ = 0;
+            }
+            size_t consumed = 0;
+            CoapError err = CoapWebSocket::parseMessage(buffer_.data() + start_, buffer_.size() - start_, frame,
+                                                        view, consumed);
+            if (err != CoapError::DATAGRAM_TOO_SHORT) {
+                payload = buffer_.data() + start_ + frame.headerLength;
+                start_ += consumed;
+                return err;
+            }
+            uint8_t chunk[4096];
+            ssize_t n = ::recv(fd_, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return CoapError::TRANSPORT_ERROR;
+            }
+            // The view of the previous frame is no longer used; shift out consumed bytes
+            buffer_.erase(buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(start_));
+            start_ = 0;
+            buffer_.insert(buffer_.end(), chunk, chunk + n);
+        }
+    }
+
+private:
+    int fd_;
+    std::vector<uint8_t> buffer_;
+    size_t start_;
+};
+
+struct ServerStats {
+    size_t requests;
+    size_t pings;
+    size_t skipped;
+    bool closed;
+    bool handshake;
+
+    ServerStats() : requests(0), pings(0), skipped(0), closed(false), handshake(false) {}
+};
+
+void runServer(int listener, ServerStats& stats) {
+    int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+        return;
+    }
+
+    std::string head;
+    if (!readHead(fd, head) || head.compare(0, 4, "GET ") != 0 ||
+        headerValue(head, "Upgrade") != "websocket" || headerValue(head, "Sec-WebSocket-Protocol") != "coap") {
+        ::close(fd);
+        return;
+    }
+    sendAll(fd, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                "Sec-WebSocket-Accept: " + acceptKey(headerValue(head, "Sec-WebSocket-Key")) +
+                "\r\nSec-WebSocket-Protocol: coap\r\n\r\n");
+    stats.handshake = true;
+
+    FrameReader reader(fd);
+    std::vector<uint8_t> out;
+    for (;;) {
+        CoapWebSocketFrame frame;
+        CoapPacketView view;
+        const uint8_t* payload = nullptr;
+        CoapError err = reader.next(frame, view, payload);
+        if (err == CoapError::TRANSPORT_ERROR) {
+            break;
+        }
+        if (err != CoapError::OK) {
+            // consumed already moved past the bad frame
+            stats.skipped++;
+            continue;
+        }
+
+        if (frame.isControl()) {
+            size_t length = static_cast<size_t>(frame.payloadLength);
+            if (frame.opcode == WEBSOCKET_OPCODE_PING) {
+                stats.pings++;
+                CoapWebSocket::buildControl(WEBSOCKET_OPCODE_PONG, payload, length, out);
+                sendAll(fd, out.data(), out.size());
+            } else if (frame.opcode == WEBSOCKET_OPCODE_CLOSE) {
+                stats.closed = true;
+                CoapWebSocket::buildControl(WEBSOCKET_OPCODE_CLOSE, payload, length, out);
+                sendAll(fd, out.data(), out.size());
+                break;
+            }
+            continue;
+        }
+
+        stats.requests++;
+        CoapPacket::CoapPacket response;
+        CoapBuilder builder;
+        builder.setCode(CoapCode::CONTENT_2_05)
+            .setToken(view.token, view.token_length)
+            .setPayload(view.payload, view.payload_length)
+            .build(response);
+        size_t frameOffset = 0;
+        if (CoapWebSocket::buildMessage(response, out, frameOffset) == CoapError::OK) {
+            sendAll(fd, out.data() + frameOffset, out.size() - frameOffset);
+        }
+    }
+    ::close(fd);
+}
+
+bool check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+    }
+    return condition;
+}
+
+/**
+ * Send frame split at a random point, so the server sees partial frames
+ */
+bool sendSplit(int fd, const uint8_t* data, size_t length, uint64_t& state) {
+    size_t split = static_cast<size_t>(nextRandom(state) % (length + 1));
+    return sendAll(fd, data, split) && sendAll(fd, data + split, length - split);
+}
+
+bool runClient(uint16_t port, const Options& options) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (!check(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0, "connect")) {
+        ::close(fd);
+        return false;
+    }
+
+    // Key and accept value from RFC 6455 section 1.3
+    const std::string key = "dGhlIHNhbXBsZSBub25jZQ==";
+    sendAll(fd, "GET /.well-known/coap HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\n"
+                "Connection: Upgrade\r\nSec-WebSocket-Key: " + key +
+                "\r\nSec-WebSocket-Protocol: coap\r\nSec-WebSocket-Version: 13\r\n\r\n");
+    std::string head;
+    bool ok = check(readHead(fd, head), "upgrade response") &&
+              check(head.compare(0, 12, "HTTP/1.1 101") == 0, "101 Switching Protocols") &&
+              check(headerValue(head, "Sec-WebSocket-Accept") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=",
+                    "Sec-WebSocket-Accept");
+    if (!ok) {
+        ::close(fd);
+        return false;
+    }
+
+    uint64_t state = options.seed;
+    std::vector<uint8_t> frame;
+    std::vector<std::string> sent;
+    for (size_t i = 0; i < options.count; i++) {
+        uint8_t mask[4];
+        uint32_t random = static_cast<uint32_t>(nextRandom(state));
+        std::memcpy(mask, &random, sizeof(mask));
+        uint8_t token[4] = {static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 0xC0, 0xAB};
+        std::string body(static_cast<size_t>(nextRandom(state) % 300), static_cast<char>('a' + i % 26));
+        sent.push_back(body);
+
+        CoapPacket::CoapPacket request;
+        CoapBuilder builder;
+        builder.setCode(CoapCode::POST).setToken(token, sizeof(token)).setUriPath("/echo");
+        if (!body.empty()) {
+            builder.setPayload(body);
+        }
+        builder.build(request);
+        size_t frameOffset = 0;
+        CoapWebSocket::buildMessage(request, frame, frameOffset, mask);
+        sendSplit(fd, frame.data() + frameOffset, frame.size() - frameOffset, state);
+
+        if (i == options.count / 2) {
+            // CoAP over WebSockets only uses binary frames; the server skips this one
+            const uint8_t text[] = {0x81, 0x82, 1, 2, 3, 4, 'h' ^ 1, 'i' ^ 2};
+            sendSplit(fd, text, sizeof(text), state);
+            const uint8_t ping[] = {'h', 'b'};
+            CoapWebSocket::buildControl(WEBSOCKET_OPCODE_PING, ping, sizeof(ping), frame, mask);
+            sendSplit(fd, frame.data(), frame.size(), state);
+        }
+    }
+    const uint8_t status[] = {0x03, 0xE8};  // 1000, normal closure
+    uint8_t mask[4] = {9, 8, 7, 6};
+    CoapWebSocket::buildControl(WEBSOCKET_OPCODE_CLOSE, status, sizeof(status), frame, mask);
+    sendSplit(fd, frame.data(), frame.size(), state);
+
+    FrameReader reader(fd);
+    size_t responses = 0;
+    bool pong = false;
+    bool closed = false;
+    while (ok && !closed) {
+        CoapWebSocketFrame reply;
+        CoapPacketView view;
+        const uint8_t* payload = nullptr;
+        CoapError err = reader.next(reply, view, payload);
+        if (!check(err == CoapError::OK, "reply frame parses")) {
+            ok = false;
+            break;
+        }
+        if (reply.opcode == WEBSOCKET_OPCODE_PONG) {
+            pong = reply.payloadLength == 2 && payload[0] == 'h' && payload[1] == 'b';
+        } else if (reply.opcode == WEBSOCKET_OPCODE_CLOSE) {
+            closed = reply.payloadLength == 2 && payload[0] == 0x03 && payload[1] == 0xE8;
+        } else {
+            size_t index = static_cast<size_t>(view.token[0]) | (static_cast<size_t>(view.token[1]) << 8);
+            ok = check(view.code == CoapCode::CONTENT_2_05, "response code") &&
+                 check(index == responses, "responses in order") &&
+                 check(std::string(reinterpret_cast<const char*>(view.payload), view.payload_length) ==
+                       sent[index], "echoed payload");
+            responses++;
+        }
+    }
+    ::close(fd);
+    return ok && check(responses == options.count, "all requests answered") && check(pong, "pong") &&
+           check(closed, "close echoed");
+}
+
+bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            options.count = static_cast<size_t>(std::atoll(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = static_cast<uint64_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return options.count > 0 && options.count <= 65536;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--count N] [--seed S]\n", argv[0]);
+        return 2;
+    }
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, 1) != 0 ||
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0) {
+        std::perror("listen");
+        return 1;
+    }
+
+    ServerStats stats;
+    std::thread server(runServer, listener, std::ref(stats));
+    bool ok = runClient(ntohs(address.sin_port), options);
+    server.join();
+    ::close(listener);
+
+    ok = check(stats.handshake, "server handshake") && check(stats.skipped == 1, "text frame skipped") &&
+         check(stats.pings == 1, "ping seen") && check(stats.closed, "close seen") && ok;
+    std::printf("requests %zu, pings %zu, skipped %zu: %s\n", stats.requests, stats.pings, stats.skipped,
+                ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+# Report .text/.data/.bss per feature of the single-TU build
+# Fails if the embedded profile references the heap (operator new/delete)
+# or the exception helpers of the standard library.
+#
+# Usage: tools/size_report.sh
+# Cross-compile by overriding the toolchain, e.g.
+#   CXX=arm-none-eabi-g++ SIZE=arm-none-eabi-size NM=arm-none-eabi-nm \
+#   CXXFLAGS="-mcpu=cortex-m4 -mthumb" tools/size_report.sh
+
+set -e
+
+CXX=${CXX:-c++}
+SIZE=${SIZE:-size}
+NM=${NM:-nm}
+CXXFLAGS=${CXXFLAGS:-}
+SRC_DIR=$(cd "$(dirname "$0")/../src" && pwd)
+OUT_DIR=$(mktemp -d)
+trap 'rm -rf "$OUT_DIR"' EXIT
+
+BASE_FLAGS="-std=c++11 -Os -fno-exceptions -fno-rtti -ffunction-sections -fdata-sections"
+FEATURES="VIEW WRITER EDITOR PARSER BUILDER RELIABLE TRANSPORT FILTER FORMATTER HASH COMPARE ACK_BATCH BATCH RECORDER LINK_FORMAT TIMER RD SCHEDULER SIM TRACING STRING_TABLE C_API"
+
+# Defines that switch every feature off
+all_off() {
+    for f in $FEATURES; do
+        printf ' -DCOAP_PACKET_FEATURE_%s=0' "$f"
+    done
+}
+
+# report <name> <defines...>
+report() {
+    name=$1
+    shift
+    # shellcheck disable=SC2086
+    "$CXX" $BASE_FLAGS $CXXFLAGS "$@" -c "$SRC_DIR/CoapPacketUnity.cpp" -o "$OUT_DIR/$name.o"
+    "$SIZE" "$OUT_DIR/$name.o" | awk -v name="$name" 'NR == 2 { printf "%-12s %8s %8s %8s\n", name, $1, $2, $3 }'
+}
+
+printf "%-12s %8s %8s %8s\n" "feature" "text" "data" "bss"
+
+# shellcheck disable=SC2046
+report core $(all_off)
+for f in $FEATURES; do
+    # shellcheck disable=SC2046
+    report "$(echo "$f" | tr 'A-Z' 'a-z')" $(all_off | sed "s/FEATURE_$f=0/FEATURE_$f=1/")
+done
+report embedded -DCOAP_PACKET_EMBEDDED=1
+# Mangled operator new/new[]/delete/delete[] and std::__throw_* helpers
+if "$NM" -u "$OUT_DIR/embedded.o" | grep -E '_Zn[wa][jmy]|_Zd[la]Pv|__throw_' >"$OUT_DIR/heap.txt"; then
+    echo "error: embedded profile references the heap:" >&2
+    cat "$OUT_DIR/heap.txt" >&2
+    exit 1
+fi
+report full